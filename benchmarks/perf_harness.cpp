@@ -10,11 +10,13 @@
  *   ZOO_BENCHMARK_MODEL=/path/to/model.gguf build/benchmarks/zoo_benchmarks
  */
 
+#include "core/batch.hpp"
 #include "zoo/agent.hpp"
 #include "zoo/core/model.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
@@ -231,6 +233,86 @@ HistorySnapshot make_history_snapshot(std::string final_user_prompt) {
     return history;
 }
 
+constexpr int kAllocationPromptTokens = 1500;
+constexpr int kAllocationDecodeTokens = 16;
+constexpr int kAllocationBatchSize = 512;
+
+void fill_batch(llama_batch& batch, int n_tokens, llama_pos base_pos) {
+    for (int i = 0; i < n_tokens; ++i) {
+        zoo::core::set_batch_token(batch, i, static_cast<llama_token>(i), base_pos + i, 0,
+                                   i == n_tokens - 1);
+    }
+    batch.n_tokens = n_tokens;
+    g_benchmark_sink += static_cast<std::size_t>(batch.token[n_tokens - 1]);
+}
+
+struct ReplayCounts {
+    std::size_t batch_inits = 0;
+    std::size_t chunks = 0;
+};
+
+// Replays one request's batch usage, prefill chunks of the context's n_batch
+// then the decode loop, borrowing every batch from `arena`. Both counts come from the batch code:
+// the chunk plan and the arena's own `llama_batch_init` count.
+ReplayCounts replay_request(zoo::core::BatchArena& arena) {
+    const std::size_t before = arena.allocations();
+    const auto chunks =
+        zoo::core::compute_prefill_chunks(kAllocationPromptTokens, kAllocationBatchSize);
+    for (const auto& chunk : chunks) {
+        auto batch = arena.borrow(chunk.count);
+        fill_batch(batch.get(), chunk.count, chunk.offset);
+    }
+    auto step = arena.borrow(1);
+    for (int i = 0; i < kAllocationDecodeTokens; ++i) {
+        fill_batch(step.get(), 1, kAllocationPromptTokens + i);
+    }
+    return ReplayCounts{arena.allocations() - before, chunks.size()};
+}
+
+void run_batch_allocation_benchmark() {
+    constexpr int kRequests = 8;
+    const auto print_row = [](std::string_view label, const std::vector<ReplayCounts>& counts,
+                              double elapsed_ms) {
+        std::size_t total = 0;
+        for (const auto& count : counts) {
+            total += count.batch_inits;
+        }
+        std::cout << "  " << std::left << std::setw(14) << label << " batch_inits/request avg="
+                  << std::fixed << std::setprecision(2) << std::setw(6)
+                  << static_cast<double>(total) / static_cast<double>(counts.size())
+                  << " first=" << std::setw(3) << counts.front().batch_inits
+                  << " last=" << std::setw(3) << counts.back().batch_inits
+                  << " chunks=" << std::setw(3) << counts.front().chunks
+                  << " elapsed=" << elapsed_ms << " ms\n";
+    };
+
+    std::cout << "batch_alloc.request  requests=" << kRequests
+              << " prompt_tokens=" << kAllocationPromptTokens
+              << " decode_tokens=" << kAllocationDecodeTokens
+              << " n_batch=" << kAllocationBatchSize << '\n';
+
+    // A zero-capacity arena never pools, so every borrow initializes a fresh
+    // batch, as inference did before session arenas.
+    std::vector<ReplayCounts> counts;
+    counts.reserve(kRequests);
+    auto start_time = Clock::now();
+    for (int request = 0; request < kRequests; ++request) {
+        zoo::core::BatchArena unpooled(0);
+        counts.push_back(replay_request(unpooled));
+    }
+    print_row("per_chunk", counts,
+              std::chrono::duration<double, std::milli>(Clock::now() - start_time).count());
+
+    counts.clear();
+    zoo::core::BatchArena arena(kAllocationBatchSize);
+    start_time = Clock::now();
+    for (int request = 0; request < kRequests; ++request) {
+        counts.push_back(replay_request(arena));
+    }
+    print_row("session_arena", counts,
+              std::chrono::duration<double, std::milli>(Clock::now() - start_time).count());
+}
+
 void run_live_model_benchmarks(const std::string& model_path) {
     auto model_result =
         zoo::core::Model::load(make_model_config(model_path), make_generation_options());
@@ -304,19 +386,21 @@ void run_live_model_benchmarks(const std::string& model_path) {
 
 int main(int argc, char** argv) {
     try {
-        const auto model_path = benchmark_model_path(argc, argv);
-        if (!model_path) {
-            std::cerr << "benchmark failed: provide a GGUF path as argv[1] or set "
-                         "ZOO_BENCHMARK_MODEL\n";
-            return 1;
-        }
-
         std::cout << "Zoo-Keeper benchmark harness\n";
         std::cout << "sizeof(RequestHandle<TextResponse>)="
                   << sizeof(zoo::RequestHandle<TextResponse>)
                   << " sizeof(MessageView)=" << sizeof(zoo::MessageView)
                   << " sizeof(OwnedMessage)=" << sizeof(zoo::OwnedMessage) << '\n';
 
+        // Needs no model, so it runs even when the live benchmarks cannot.
+        run_batch_allocation_benchmark();
+
+        const auto model_path = benchmark_model_path(argc, argv);
+        if (!model_path) {
+            std::cerr << "benchmark failed: provide a GGUF path as argv[1] or set "
+                         "ZOO_BENCHMARK_MODEL\n";
+            return 1;
+        }
         run_live_model_benchmarks(*model_path);
 
         std::cout << "benchmark_sink=" << g_benchmark_sink << '\n';
@@ -13,6 +13,7 @@ add_library(zoo STATIC
     ${PROJECT_SOURCE_DIR}/src/agent/backend_model.cpp
     ${PROJECT_SOURCE_DIR}/src/agent/request_handle.cpp
     ${PROJECT_SOURCE_DIR}/src/agent/runtime.cpp
+    ${PROJECT_SOURCE_DIR}/src/agent/runtime_batching.cpp
     ${PROJECT_SOURCE_DIR}/src/agent/runtime_commands.cpp
     ${PROJECT_SOURCE_DIR}/src/agent/runtime_inference.cpp
     ${PROJECT_SOURCE_DIR}/src/agent/runtime_lifecycle.cpp
@@ -21,10 +22,13 @@ add_library(zoo STATIC
     ${PROJECT_SOURCE_DIR}/src/core/model.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_init.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_inference.cpp
+    ${PROJECT_SOURCE_DIR}/src/core/model_speculative.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_prompt.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_history.cpp
+    ${PROJECT_SOURCE_DIR}/src/core/model_session.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_sampling.cpp
     ${PROJECT_SOURCE_DIR}/src/core/model_tool_calling.cpp
+    ${PROJECT_SOURCE_DIR}/src/core/session_snapshot.cpp
     ${PROJECT_SOURCE_DIR}/src/core/stream_filter.cpp
     ${PROJECT_SOURCE_DIR}/src/core/gguf_inspector.cpp
     ${PROJECT_SOURCE_DIR}/src/core/system_probe.cpp
@@ -107,6 +107,20 @@ class Agent {
     create(const ModelConfig& model_config, const AgentConfig& agent_config = AgentConfig{},
            const GenerationOptions& default_generation = GenerationOptions{});
 
+    /**
+     * @brief Creates and starts an agent for an independent conversation on the
+     *        same loaded weights.
+     *
+     * The new agent shares weights, vocabulary and chat templates with this
+     * one but has its own history, KV cache, inference thread and tool
+     * registry (initially empty). It uses this agent's configuration and may
+     * outlive it.
+     *
+     * @return The new agent, or `ContextCreationFailed` if its context could
+     *         not be allocated.
+     */
+    Expected<std::unique_ptr<Agent>> open_session() const;
+
     ~Agent();
 
     Agent(const Agent&) = delete;
@@ -136,34 +150,61 @@ class Agent {
 
     /**
      * @brief Queues a structured extraction request (stateful).
+     *
+     * `on_field`, when set, receives each top-level field as soon as its value
+     * has been generated and may stop generation early.
      */
     template <internal::agent::ExtractMessage Message>
     RequestHandle<ExtractionResponse> extract(const nlohmann::json& output_schema,
                                               Message&& message, GenerationOverride generation = {},
-                                              AsyncTokenCallback callback = {}) {
+                                              AsyncTokenCallback callback = {},
+                                              ExtractionFieldCallback on_field = {}) {
         if constexpr (std::same_as<std::remove_cvref_t<Message>, MessageView>) {
-            return extract_stateful(output_schema, message, generation, std::move(callback));
+            return extract_stateful(output_schema, message, generation, std::move(callback),
+                                    std::move(on_field));
         } else {
             return extract_stateful(
                 output_schema,
                 MessageView{Role::User, std::string_view{std::forward<Message>(message)}},
-                generation, std::move(callback));
+                generation, std::move(callback), std::move(on_field));
         }
     }
 
     /**
      * @brief Queues a structured extraction request (stateless).
+     *
+     * `on_field` behaves as in the stateful overload.
      */
     RequestHandle<ExtractionResponse> extract(const nlohmann::json& output_schema,
                                               ConversationView messages,
                                               GenerationOverride generation = {},
-                                              AsyncTokenCallback callback = {});
+                                              AsyncTokenCallback callback = {},
+                                              ExtractionFieldCallback on_field = {});
 
     /**
      * @brief Requests cancellation of a queued or running request.
      */
     void cancel(RequestId id);
 
+    /**
+     * @brief Estimates how long a request submitted now would wait in the queue.
+     *
+     * Multiplies the requests queued ahead of `priority` by a moving average of
+     * recent request durations and adds the expected remainder of the request in
+     * progress. Returns zero until one request has completed. Use it to shed
+     * load, or to pick a `GenerationOptions::deadline`, before submitting.
+     */
+    [[nodiscard]] std::chrono::nanoseconds
+    estimated_queue_wait(RequestPriority priority = RequestPriority::Normal) const;
+
+    /**
+     * @brief Returns counters of the extraction schema cache.
+     *
+     * Compiled output schemas are cached by canonical JSON and shared by every
+     * agent in the process, so the counters are process-wide.
+     */
+    [[nodiscard]] static SchemaCacheStats schema_cache_stats();
+
     /// Best-effort system-prompt replacement. Use `try_set_system_prompt()` to observe errors.
     void set_system_prompt(std::string_view prompt);
 
@@ -229,6 +270,32 @@ class Agent {
     /// @param timeout Maximum time to wait; returns `RequestTimeout` on expiry.
     Expected<void> clear_history(std::chrono::nanoseconds timeout);
 
+    /**
+     * @brief Saves history and KV cache state to a session snapshot file.
+     *
+     * Runs on the inference thread between requests. See
+     * `core::Model::save_session()` for the file format guarantees.
+     *
+     * @param path Destination file.
+     * @param model_id Identity recorded in the snapshot, typically `hub::ModelEntry::id`.
+     * @param timeout Maximum time to wait; returns `RequestTimeout` on expiry.
+     */
+    Expected<void> save_session(std::string_view path, std::string_view model_id = {},
+                                std::optional<std::chrono::nanoseconds> timeout = {});
+
+    /**
+     * @brief Restores history and KV cache state from a session snapshot file.
+     *
+     * Returns `SessionSnapshotMismatch` when the snapshot belongs to another
+     * model id, other weights, or an older format. Registered tools are kept.
+     *
+     * @param path Snapshot written by `save_session()`.
+     * @param model_id Identity the snapshot must have been saved with.
+     * @param timeout Maximum time to wait; returns `RequestTimeout` on expiry.
+     */
+    Expected<void> load_session(std::string_view path, std::string_view model_id = {},
+                                std::optional<std::chrono::nanoseconds> timeout = {});
+
     /// @brief Registers a typed callable as a tool.
     template <typename Func>
     Expected<void> register_tool(std::string_view name, std::string_view description,
@@ -280,6 +347,16 @@ class Agent {
 
     [[nodiscard]] size_t tool_count() const noexcept;
 
+    /**
+     * @brief Returns counters of this agent's tool result cache.
+     *
+     * The cache is updated on the inference thread, so the snapshot is taken
+     * there, between requests.
+     * @param timeout Maximum time to wait; returns `RequestTimeout` on expiry.
+     */
+    [[nodiscard]] Expected<tools::ToolCacheStats>
+    tool_cache_stats(std::optional<std::chrono::nanoseconds> timeout = {}) const;
+
   private:
     struct Impl;
 
@@ -288,7 +365,8 @@ class Agent {
     RequestHandle<ExtractionResponse> extract_stateful(const nlohmann::json& output_schema,
                                                        MessageView message,
                                                        GenerationOverride generation,
-                                                       AsyncTokenCallback callback);
+                                                       AsyncTokenCallback callback,
+                                                       ExtractionFieldCallback on_field);
     Expected<void> register_tool(tools::ToolDefinition definition,
                                  std::optional<std::chrono::nanoseconds> timeout = {});
 
@@ -9,6 +9,7 @@
 #include "zoo/core/system_probe.hpp"
 #include "zoo/core/types.hpp"
 
+#include <cstdint>
 #include <string>
 
 namespace zoo::core {
@@ -39,13 +40,18 @@ class GgufInspector {
      *
      * Heuristics:
      * - `context_size` is bounded by training context, KV-cache RAM budget,
-     *   and a v1 sanity ceiling of 32k.
+     *   and a v1 sanity ceiling of 32k. The budget is divided by the exact
+     *   per-token footprint of `type_k`/`type_v`, so quantized caches buy a
+     *   proportionally longer context.
      * - `n_gpu_layers` reflects whether the model fits in available VRAM
      *   (full offload, partial layer count, or CPU only).
      * - `use_mmap` is always enabled.
      * - `use_mlock` is enabled when total RAM comfortably exceeds model size.
+     * - `cache_type_k`/`cache_type_v` are set to the requested types.
      */
-    static Expected<ModelConfig> auto_configure(const ModelInfo& info, const SystemInfo& sys);
+    static Expected<ModelConfig> auto_configure(const ModelInfo& info, const SystemInfo& sys,
+                                                KvCacheType type_k = KvCacheType::F16,
+                                                KvCacheType type_v = KvCacheType::F16);
 
     /**
      * @brief Convenience overload that probes the host system internally.
@@ -53,6 +59,17 @@ class GgufInspector {
      * Equivalent to calling `auto_configure(info, *SystemProbe::probe())`.
      */
     static Expected<ModelConfig> auto_configure(const ModelInfo& info);
+
+    /**
+     * @brief Returns the KV cache size in bytes for `context_size` tokens.
+     *
+     * Sums one K and one V row per layer per token at the given storage
+     * types, using GGUF key/value head widths when present. Returns 0 when
+     * layer or embedding metadata is missing.
+     */
+    static uint64_t kv_cache_bytes(const ModelInfo& info, int context_size,
+                                   KvCacheType type_k = KvCacheType::F16,
+                                   KvCacheType type_v = KvCacheType::F16);
 };
 
 } // namespace zoo::core
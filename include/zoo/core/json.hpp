@@ -88,11 +88,71 @@ inline void from_json(const nlohmann::json& j, SamplingParams& params) {
 inline void to_json(nlohmann::json& j, const ModelConfig& config) {
     j = nlohmann::json{{"model_path", config.model_path}, {"context_size", config.context_size},
                        {"n_batch", config.n_batch},       {"n_gpu_layers", config.n_gpu_layers},
-                       {"use_mmap", config.use_mmap},     {"use_mlock", config.use_mlock}};
+                       {"use_mmap", config.use_mmap},     {"use_mlock", config.use_mlock},
+                       {"max_sequences", config.max_sequences},
+                       {"draft_model_path", config.draft_model_path},
+                       {"draft_tokens", config.draft_tokens},
+                       {"n_threads", config.n_threads},
+                       {"n_threads_batch", config.n_threads_batch},
+                       {"n_ubatch", config.n_ubatch},
+                       {"cpu_mask", config.cpu_mask},
+                       {"cpu_mask_batch", config.cpu_mask_batch},
+                       {"numa", to_string(config.numa)},
+                       {"cache_type_k", to_string(config.cache_type_k)},
+                       {"cache_type_v", to_string(config.cache_type_v)},
+                       {"flash_attn", to_string(config.flash_attn)},
+                       {"offload_kqv", config.offload_kqv},
+                       {"kv_reuse_min_tokens", config.kv_reuse_min_tokens},
+                       {"context_shift", config.context_shift}};
 }
 
 namespace detail {
 
+inline NumaStrategy parse_numa_strategy(const std::string& name) {
+    if (name == "disabled") {
+        return NumaStrategy::Disabled;
+    }
+    if (name == "distribute") {
+        return NumaStrategy::Distribute;
+    }
+    if (name == "isolate") {
+        return NumaStrategy::Isolate;
+    }
+    if (name == "numactl") {
+        return NumaStrategy::Numactl;
+    }
+    if (name == "mirror") {
+        return NumaStrategy::Mirror;
+    }
+    throw std::invalid_argument("Unknown numa strategy: " + name);
+}
+
+inline KvCacheType parse_kv_cache_type(const std::string& name) {
+    if (name == "f16") {
+        return KvCacheType::F16;
+    }
+    if (name == "q8_0") {
+        return KvCacheType::Q8_0;
+    }
+    if (name == "q4_0") {
+        return KvCacheType::Q4_0;
+    }
+    throw std::invalid_argument("Unknown KV cache type: " + name);
+}
+
+inline FlashAttention parse_flash_attention(const std::string& name) {
+    if (name == "auto") {
+        return FlashAttention::Auto;
+    }
+    if (name == "enabled") {
+        return FlashAttention::Enabled;
+    }
+    if (name == "disabled") {
+        return FlashAttention::Disabled;
+    }
+    throw std::invalid_argument("Unknown flash_attn mode: " + name);
+}
+
 // Applies explicit JSON overrides on top of an existing ModelConfig. Used by
 // both the pure deserializer and the auto-configure resolver.
 inline void apply_model_config_overrides(const nlohmann::json& j, ModelConfig& config) {
@@ -111,6 +171,51 @@ inline void apply_model_config_overrides(const nlohmann::json& j, ModelConfig& c
     if (auto it = j.find("use_mlock"); it != j.end()) {
         it->get_to(config.use_mlock);
     }
+    if (auto it = j.find("max_sequences"); it != j.end()) {
+        it->get_to(config.max_sequences);
+    }
+    if (auto it = j.find("draft_model_path"); it != j.end()) {
+        it->get_to(config.draft_model_path);
+    }
+    if (auto it = j.find("draft_tokens"); it != j.end()) {
+        it->get_to(config.draft_tokens);
+    }
+    if (auto it = j.find("n_threads"); it != j.end()) {
+        it->get_to(config.n_threads);
+    }
+    if (auto it = j.find("n_threads_batch"); it != j.end()) {
+        it->get_to(config.n_threads_batch);
+    }
+    if (auto it = j.find("n_ubatch"); it != j.end()) {
+        it->get_to(config.n_ubatch);
+    }
+    if (auto it = j.find("cpu_mask"); it != j.end()) {
+        it->get_to(config.cpu_mask);
+    }
+    if (auto it = j.find("cpu_mask_batch"); it != j.end()) {
+        it->get_to(config.cpu_mask_batch);
+    }
+    if (auto it = j.find("numa"); it != j.end()) {
+        config.numa = parse_numa_strategy(it->get<std::string>());
+    }
+    if (auto it = j.find("cache_type_k"); it != j.end()) {
+        config.cache_type_k = parse_kv_cache_type(it->get<std::string>());
+    }
+    if (auto it = j.find("cache_type_v"); it != j.end()) {
+        config.cache_type_v = parse_kv_cache_type(it->get<std::string>());
+    }
+    if (auto it = j.find("flash_attn"); it != j.end()) {
+        config.flash_attn = parse_flash_attention(it->get<std::string>());
+    }
+    if (auto it = j.find("offload_kqv"); it != j.end()) {
+        it->get_to(config.offload_kqv);
+    }
+    if (auto it = j.find("kv_reuse_min_tokens"); it != j.end()) {
+        it->get_to(config.kv_reuse_min_tokens);
+    }
+    if (auto it = j.find("context_shift"); it != j.end()) {
+        it->get_to(config.context_shift);
+    }
 }
 
 } // namespace detail
@@ -121,9 +226,13 @@ inline void apply_model_config_overrides(const nlohmann::json& j, ModelConfig& c
 inline void from_json(const nlohmann::json& j, ModelConfig& config) {
     // "auto_configure" is consumed by `load_model_config`, not here. Listed so
     // strict key validation does not reject configs that opt into auto-config.
-    static constexpr std::array<const char*, 7> kAllowedKeys = {
-        "model_path", "context_size", "n_batch",       "n_gpu_layers",
-        "use_mmap",   "use_mlock",    "auto_configure"};
+    static constexpr std::array<const char*, 22> kAllowedKeys = {
+        "model_path",    "context_size",   "n_batch",         "n_gpu_layers",
+        "use_mmap",      "use_mlock",      "max_sequences",   "draft_model_path",
+        "draft_tokens",  "n_threads",      "n_threads_batch", "n_ubatch",
+        "cpu_mask",      "cpu_mask_batch", "numa",            "cache_type_k",
+        "cache_type_v",  "flash_attn",     "offload_kqv",     "kv_reuse_min_tokens",
+        "context_shift", "auto_configure"};
 
     detail::reject_unknown_keys(j, "model config", kAllowedKeys);
 
@@ -143,7 +252,9 @@ namespace detail {
 // Inspects a GGUF file and probes the host hardware to produce a ModelConfig.
 // Extracted from `load_model_config` so the entry point stays small enough to
 // unit test cheaply.
-inline Expected<ModelConfig> auto_configure_model_path(const std::string& model_path) {
+inline Expected<ModelConfig> auto_configure_model_path(const std::string& model_path,
+                                                       KvCacheType type_k = KvCacheType::F16,
+                                                       KvCacheType type_v = KvCacheType::F16) {
     auto info = core::GgufInspector::inspect(model_path);
     if (!info) {
         return std::unexpected(info.error());
@@ -152,7 +263,7 @@ inline Expected<ModelConfig> auto_configure_model_path(const std::string& model_
     if (!sys) {
         return std::unexpected(sys.error());
     }
-    return core::GgufInspector::auto_configure(*info, *sys);
+    return core::GgufInspector::auto_configure(*info, *sys, type_k, type_v);
 }
 
 } // namespace detail
@@ -174,7 +285,16 @@ inline Expected<ModelConfig> load_model_config(const nlohmann::json& j) {
     if (!j.contains("model_path")) {
         throw std::invalid_argument("ModelConfig JSON must contain required key: model_path");
     }
-    auto resolved = detail::auto_configure_model_path(j.at("model_path").get<std::string>());
+    // Cache types change the per-token KV footprint, so they must be known
+    // before the context size is planned.
+    const auto type_k = j.contains("cache_type_k")
+                            ? detail::parse_kv_cache_type(j.at("cache_type_k").get<std::string>())
+                            : KvCacheType::F16;
+    const auto type_v = j.contains("cache_type_v")
+                            ? detail::parse_kv_cache_type(j.at("cache_type_v").get<std::string>())
+                            : KvCacheType::F16;
+    auto resolved = detail::auto_configure_model_path(j.at("model_path").get<std::string>(),
+                                                      type_k, type_v);
     if (!resolved) {
         return std::unexpected(resolved.error());
     }
@@ -184,15 +304,23 @@ inline Expected<ModelConfig> load_model_config(const nlohmann::json& j) {
 
 inline void to_json(nlohmann::json& j, const AgentConfig& config) {
     j = nlohmann::json{{"max_history_messages", config.max_history_messages},
+                       {"max_history_tokens", config.max_history_tokens},
                        {"request_queue_capacity", config.request_queue_capacity},
                        {"max_tool_iterations", config.max_tool_iterations},
-                       {"max_tool_retries", config.max_tool_retries}};
+                       {"max_tool_retries", config.max_tool_retries},
+                       {"tool_workers", config.tool_workers},
+                       {"stream_chunk_bytes", config.stream_chunk_bytes},
+                       {"stream_chunk_interval_ms", config.stream_chunk_interval_ms},
+                       {"async_token_actions", config.async_token_actions},
+                       {"batch_sequences", config.batch_sequences}};
 }
 
 inline void from_json(const nlohmann::json& j, AgentConfig& config) {
-    static constexpr std::array<const char*, 4> kAllowedKeys = {
-        "max_history_messages", "request_queue_capacity", "max_tool_iterations",
-        "max_tool_retries"};
+    static constexpr std::array<const char*, 10> kAllowedKeys = {
+        "max_history_messages", "max_history_tokens",       "request_queue_capacity",
+        "max_tool_iterations",  "max_tool_retries",         "tool_workers",
+        "stream_chunk_bytes",   "stream_chunk_interval_ms", "async_token_actions",
+        "batch_sequences"};
 
     detail::reject_unknown_keys(j, "agent config", kAllowedKeys);
 
@@ -200,6 +328,9 @@ inline void from_json(const nlohmann::json& j, AgentConfig& config) {
     if (auto it = j.find("max_history_messages"); it != j.end()) {
         it->get_to(parsed.max_history_messages);
     }
+    if (auto it = j.find("max_history_tokens"); it != j.end()) {
+        it->get_to(parsed.max_history_tokens);
+    }
     if (auto it = j.find("request_queue_capacity"); it != j.end()) {
         it->get_to(parsed.request_queue_capacity);
     }
@@ -209,20 +340,74 @@ inline void from_json(const nlohmann::json& j, AgentConfig& config) {
     if (auto it = j.find("max_tool_retries"); it != j.end()) {
         it->get_to(parsed.max_tool_retries);
     }
+    if (auto it = j.find("tool_workers"); it != j.end()) {
+        it->get_to(parsed.tool_workers);
+    }
+    if (auto it = j.find("stream_chunk_bytes"); it != j.end()) {
+        it->get_to(parsed.stream_chunk_bytes);
+    }
+    if (auto it = j.find("stream_chunk_interval_ms"); it != j.end()) {
+        it->get_to(parsed.stream_chunk_interval_ms);
+    }
+    if (auto it = j.find("async_token_actions"); it != j.end()) {
+        it->get_to(parsed.async_token_actions);
+    }
+    if (auto it = j.find("batch_sequences"); it != j.end()) {
+        it->get_to(parsed.batch_sequences);
+    }
 
     config = std::move(parsed);
 }
 
+inline void to_json(nlohmann::json& j, const SpeculativeOptions& options) {
+    j = nlohmann::json{{"mode", to_string(options.mode)},
+                       {"ngram_size", options.ngram_size},
+                       {"max_draft_tokens", options.max_draft_tokens}};
+}
+
+inline void from_json(const nlohmann::json& j, SpeculativeOptions& options) {
+    static constexpr std::array<const char*, 3> kAllowedKeys = {"mode", "ngram_size",
+                                                                "max_draft_tokens"};
+
+    detail::reject_unknown_keys(j, "speculative options", kAllowedKeys);
+
+    SpeculativeOptions parsed;
+    if (auto it = j.find("mode"); it != j.end()) {
+        const auto mode = it->get<std::string>();
+        if (mode == "default") {
+            parsed.mode = SpeculativeMode::Default;
+        } else if (mode == "off") {
+            parsed.mode = SpeculativeMode::Off;
+        } else if (mode == "prompt_lookup") {
+            parsed.mode = SpeculativeMode::PromptLookup;
+        } else {
+            throw std::invalid_argument("Unknown speculative mode: " + mode);
+        }
+    }
+    if (auto it = j.find("ngram_size"); it != j.end()) {
+        it->get_to(parsed.ngram_size);
+    }
+    if (auto it = j.find("max_draft_tokens"); it != j.end()) {
+        it->get_to(parsed.max_draft_tokens);
+    }
+
+    options = std::move(parsed);
+}
+
 inline void to_json(nlohmann::json& j, const GenerationOptions& options) {
     j = nlohmann::json{{"sampling", options.sampling},
                        {"max_tokens", options.max_tokens},
                        {"stop_sequences", options.stop_sequences},
-                       {"record_tool_trace", options.record_tool_trace}};
+                       {"record_tool_trace", options.record_tool_trace},
+                       {"speculative", options.speculative},
+                       {"priority", to_string(options.priority)},
+                       {"deadline_ms", options.deadline.count()}};
 }
 
 inline void from_json(const nlohmann::json& j, GenerationOptions& options) {
-    static constexpr std::array<const char*, 4> kAllowedKeys = {
-        "sampling", "max_tokens", "stop_sequences", "record_tool_trace"};
+    static constexpr std::array<const char*, 7> kAllowedKeys = {
+        "sampling",    "max_tokens", "stop_sequences", "record_tool_trace",
+        "speculative", "priority",   "deadline_ms"};
 
     detail::reject_unknown_keys(j, "generation options", kAllowedKeys);
 
@@ -239,6 +424,24 @@ inline void from_json(const nlohmann::json& j, GenerationOptions& options) {
     if (auto it = j.find("record_tool_trace"); it != j.end()) {
         it->get_to(parsed.record_tool_trace);
     }
+    if (auto it = j.find("speculative"); it != j.end()) {
+        it->get_to(parsed.speculative);
+    }
+    if (auto it = j.find("priority"); it != j.end()) {
+        const auto priority = it->get<std::string>();
+        if (priority == "interactive") {
+            parsed.priority = RequestPriority::Interactive;
+        } else if (priority == "normal") {
+            parsed.priority = RequestPriority::Normal;
+        } else if (priority == "background") {
+            parsed.priority = RequestPriority::Background;
+        } else {
+            throw std::invalid_argument("Unknown request priority: " + priority);
+        }
+    }
+    if (auto it = j.find("deadline_ms"); it != j.end()) {
+        parsed.deadline = std::chrono::milliseconds(it->get<int64_t>());
+    }
 
     options = std::move(parsed);
 }
@@ -7,6 +7,7 @@
 
 #include "types.hpp"
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -14,6 +15,19 @@
 namespace zoo::core {
 
 struct ModelTestAccess;
+class ContinuousBatch;
+
+/**
+ * @brief Where a session opened with `Model::open_session()` keeps its KV cache.
+ */
+enum class SessionPlacement {
+    /// Lease a sequence in a context shared with sibling sessions. Sessions
+    /// sharing a context must be driven from one thread at a time.
+    SharedContext,
+    /// Create a single-sequence context owned by the session, so it can run on
+    /// its own thread alongside its siblings.
+    DedicatedContext,
+};
 
 /**
  * @brief Direct llama.cpp wrapper for model lifecycle, history, and generation.
@@ -39,6 +53,24 @@ class Model {
     load(const ModelConfig& model_config,
          const GenerationOptions& default_generation = GenerationOptions{});
 
+    /**
+     * @brief Opens an independent conversation on the same loaded weights.
+     *
+     * The returned model shares this model's weights, vocabulary and chat
+     * templates, and owns its own history, sampler and KV sequence, so memory
+     * grows with active KV cache rather than with model copies. Shared
+     * contexts hold `ModelConfig::max_sequences` sessions each; a new context
+     * is created when every pooled sequence is leased. The loaded weights stay
+     * alive until the last session is destroyed.
+     *
+     * @param placement Whether to lease from the shared context pool or create
+     *        a dedicated context.
+     * @return A session with empty history and no tools registered, or
+     *         `ContextCreationFailed` if a new context could not be created.
+     */
+    [[nodiscard]] Expected<std::unique_ptr<Model>>
+    open_session(SessionPlacement placement = SessionPlacement::SharedContext) const;
+
     ~Model();
     Model(const Model&) = delete;
     Model& operator=(const Model&) = delete;
@@ -69,6 +101,9 @@ class Model {
             false;                  ///< Whether tool calling detected a tool call in the output.
         std::string parsed_content; ///< Visible content after stripping tool syntax.
         std::vector<OwnedToolCall> tool_calls; ///< Structured tool calls extracted from the output.
+        int draft_tokens_proposed = 0;         ///< Speculative tokens proposed during the pass.
+        int draft_tokens_accepted = 0;         ///< Speculative tokens the target model accepted.
+        int forced_tokens = 0;                 ///< Grammar-forced tokens appended without sampling.
     };
 
     /**
@@ -81,7 +116,48 @@ class Model {
                                                      CancellationCallback should_cancel = {});
 
     /**
-     * @brief Advances the incremental chat-template checkpoint to the current history.
+     * @brief Renders and tokenizes `messages` without touching session state.
+     *
+     * Reads only the loaded chat templates and vocabulary, so it is safe to
+     * call from another thread while this session generates. The tokens cover
+     * the full prompt; KV prefix reuse happens in `generate_from_prepared()`.
+     */
+    [[nodiscard]] Expected<std::vector<int>>
+    prepare_prompt(std::span<const Message> messages) const;
+
+    /**
+     * @brief Like `generate_from_history()`, but starts from tokens returned by `prepare_prompt()`.
+     *
+     * The caller guarantees the current history equals the prepared messages.
+     * When native tool calling is active the prompt is rendered again, because
+     * tool definitions and parser state come from the render.
+     */
+    Expected<GenerationResult> generate_from_prepared(std::span<const int> prompt_tokens,
+                                                      GenerationOverride generation = {},
+                                                      TokenCallback on_token = {},
+                                                      CancellationCallback should_cancel = {});
+
+    /**
+     * @brief Prefills the KV cache with the current history ahead of the next message.
+     *
+     * Renders the history followed by a `next_role` message and decodes the
+     * prompt up to where that message's content begins, so the next pass only
+     * prefills the new content. Call it while the next message is produced,
+     * for example while a tool runs. History is not modified.
+     *
+     * @param next_role Role of the message that will be appended next.
+     * @param tool_call_id Correlation id rendered with a `Role::Tool` message.
+     * @return The number of tokens decoded, which is zero when the prefix was
+     *         already resident or the template does not render the content.
+     */
+    Expected<int> prefill_history(Role next_role, std::string_view tool_call_id = {},
+                                  CancellationCallback should_cancel = {});
+
+    /**
+     * @brief Retained for source compatibility; has no effect.
+     *
+     * Prompts are diffed against the tokens resident in the KV cache, so no
+     * explicit chat-template checkpoint needs to be advanced after a turn.
      */
     void finalize_response();
 
@@ -103,6 +179,18 @@ class Model {
 
     void trim_history(size_t max_non_system_messages);
 
+    /**
+     * @brief Drops the oldest exchanges until retained history fits `max_tokens`.
+     *
+     * Uses the per-message token counts cached when messages are added and
+     * calibrated after each prefill, so no message is re-tokenized. After a
+     * prefill the retained total is exact, but messages added together share
+     * it in proportion to their estimates, so a cut between them is
+     * approximate. The system prompt is always kept and the cut lands on a
+     * user-message boundary.
+     */
+    void trim_history_to_tokens(size_t max_tokens);
+
     /**
      * @brief Replaces the retained message history without flushing the KV cache.
      */
@@ -113,6 +201,28 @@ class Model {
      */
     [[nodiscard]] HistorySnapshot swap_history(HistorySnapshot snapshot);
 
+    /**
+     * @brief Persists history and the resident KV sequence to `path`.
+     *
+     * The file is written to a temporary sibling and renamed into place.
+     * Tool-calling and schema state are not persisted; re-register tools after
+     * restoring.
+     *
+     * @param path Destination file.
+     * @param model_id Identity recorded in the snapshot header, typically
+     *        `hub::ModelEntry::id`. `load_session()` must be given the same id.
+     */
+    Expected<void> save_session(const std::string& path, std::string_view model_id = {});
+
+    /**
+     * @brief Restores history and KV state written by `save_session()`.
+     *
+     * Returns `SessionSnapshotMismatch` when the snapshot was taken with a
+     * different `model_id`, different weights, or an older format version. On
+     * failure the current history is left unchanged.
+     */
+    Expected<void> load_session(const std::string& path, std::string_view model_id = {});
+
     /**
      * @brief Configures template-driven tool calling from registered tool metadata.
      */
@@ -120,8 +230,16 @@ class Model {
 
     /**
      * @brief Enables grammar-constrained schema output for future generations.
+     *
+     * When `forced` is set, text it reports as forced is tokenized and
+     * decoded in one batch instead of being sampled token by token
+     * (jump-forward decoding). Speculative decoding takes precedence.
+     * When `free_text` is set, tokens it reports as admitted regardless of
+     * context are kept from a precomputed vocabulary mask, and only the
+     * remaining tokens are checked against the grammar.
      */
-    bool set_schema_grammar(const std::string& grammar_str);
+    bool set_schema_grammar(const std::string& grammar_str, ForcedContinuation forced = {},
+                            FreeTextProbe free_text = {});
 
     /// Disables any active grammar/tool calling and restores the default sampler chain.
     void clear_tool_grammar() noexcept;
@@ -147,10 +265,99 @@ class Model {
 
   private:
     friend struct ModelTestAccess;
+    friend class ContinuousBatch;
 
     explicit Model(ModelConfig model_config, GenerationOptions default_generation);
+    explicit Model(std::unique_ptr<Impl> impl);
 
     std::unique_ptr<Impl> impl_;
 };
 
+/**
+ * @brief Decodes generation passes of several sessions in shared batches.
+ *
+ * Each lane is a session on its own sequence of one context. A `step()`
+ * packs the next token of every decoding lane, then prompt prefill for lanes
+ * that just started, into one `llama_decode` of at most `n_batch` tokens, and
+ * samples each lane that produced logits with its own sampler chain. Lanes
+ * start and finish independently, so a new pass joins as soon as a lane
+ * frees up (continuous batching).
+ *
+ * Passes decode one token per step; speculative and jump-forward decoding do
+ * not apply. Like `Model`, a batch must be driven from one thread at a time.
+ */
+class ContinuousBatch {
+  public:
+    /// A pass that ended during `step()`.
+    struct Finished {
+        size_t lane = 0;
+        Expected<Model::GenerationResult> result;
+    };
+
+    /**
+     * @brief Opens `lanes` sessions on `model`'s weights in a new context.
+     *
+     * The context holds one sequence, with a full `context_size` window, per
+     * lane and belongs to the batch alone, so it is independent of the
+     * `ModelConfig::max_sequences` pool. Lanes start with empty history and
+     * no tools; draft models are not attached.
+     */
+    [[nodiscard]] static Expected<std::unique_ptr<ContinuousBatch>> open(const Model& model,
+                                                                         size_t lanes);
+
+    ~ContinuousBatch();
+    ContinuousBatch(const ContinuousBatch&) = delete;
+    ContinuousBatch& operator=(const ContinuousBatch&) = delete;
+    ContinuousBatch(ContinuousBatch&&) = delete;
+    ContinuousBatch& operator=(ContinuousBatch&&) = delete;
+
+    [[nodiscard]] size_t size() const noexcept;
+
+    /// The session behind `lane`; set its history while the lane is not running.
+    [[nodiscard]] Model& session(size_t lane) noexcept;
+
+    /// Whether `lane` has a pass in progress.
+    [[nodiscard]] bool running(size_t lane) const noexcept;
+
+    /// Whether no lane has a pass in progress.
+    [[nodiscard]] bool idle() const noexcept;
+
+    /**
+     * @brief Starts a pass from `lane`'s current history.
+     *
+     * Behaves like `Model::generate_from_history()`, except that the prompt
+     * is only rendered and diffed against the lane's resident tokens here;
+     * prefill and generation happen in the following `step()` calls.
+     * `on_token` and `should_cancel` are called from `step()` and must stay
+     * valid until the pass finishes.
+     */
+    Expected<void> start(size_t lane, GenerationOverride generation = {},
+                         TokenCallback on_token = {}, CancellationCallback should_cancel = {});
+
+    /**
+     * @brief Like `start()`, but starts from tokens returned by `Model::prepare_prompt()`.
+     *
+     * The caller guarantees `lane`'s history equals the prepared messages.
+     * Lanes have no tools, so the prompt is never rendered again.
+     */
+    Expected<void> start(size_t lane, std::span<const int> prompt_tokens,
+                         GenerationOverride generation = {}, TokenCallback on_token = {},
+                         CancellationCallback should_cancel = {});
+
+    /// Decodes one step of every running pass and returns the passes that ended.
+    [[nodiscard]] std::vector<Finished> step();
+
+  private:
+    struct State;
+
+    explicit ContinuousBatch(std::unique_ptr<State> state);
+
+    // Shared body of both start() overloads; renders unless `prepared` is set.
+    Expected<void> start_pass(size_t lane, const std::span<const int>* prepared,
+                              GenerationOverride generation, TokenCallback on_token,
+                              CancellationCallback should_cancel);
+
+    std::unique_ptr<State> state_;
+};
+
 } // namespace zoo::core
@@ -28,6 +28,8 @@ struct ModelInfo {
     int32_t layer_count = 0;
     int32_t head_count = 0;
     int32_t kv_head_count = 0;  ///< Equals head_count for MHA; smaller for GQA.
+    int32_t key_length = 0;     ///< Per-head K width; 0 when derived from embedding_dim.
+    int32_t value_length = 0;   ///< Per-head V width; 0 when derived from embedding_dim.
     int32_t context_length = 0; ///< Training context length, not the runtime context.
     std::string quantization;
     std::map<std::string, std::string> metadata;
@@ -40,6 +40,18 @@ struct SystemInfo {
     bool operator==(const SystemInfo& other) const = default;
 };
 
+/**
+ * @brief Suggested `ModelConfig` thread counts for one model on a host.
+ *
+ * Zero means "no recommendation"; llama.cpp's defaults then apply.
+ */
+struct ThreadRecommendation {
+    int n_threads = 0;       ///< Decode threads.
+    int n_threads_batch = 0; ///< Prompt-processing threads.
+
+    bool operator==(const ThreadRecommendation& other) const = default;
+};
+
 /**
  * @brief Probes the host for resources relevant to model loading.
  */
@@ -54,6 +66,18 @@ class SystemProbe {
      * failures (e.g. unsupported platform).
      */
     static Expected<SystemInfo> probe();
+
+    /**
+     * @brief Splits the host's logical CPUs across `concurrent_models` models.
+     *
+     * Prompt processing is compute-bound and gets each model's full share of
+     * logical CPUs. Single-token decode is memory-bandwidth-bound and gets
+     * half of it, approximating one thread per physical core on SMT hosts;
+     * extra decode threads only contend for the same bandwidth. Pure function
+     * of its inputs.
+     */
+    static ThreadRecommendation recommend_threads(const SystemInfo& sys,
+                                                  int concurrent_models = 1);
 };
 
 } // namespace zoo::core
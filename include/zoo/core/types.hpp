@@ -391,6 +391,9 @@ enum class ErrorCode {
     ContextWindowExceeded = 300,  ///< Prompt or generation exceeded available context.
     InvalidMessageSequence = 301, ///< Conversation roles violate sequencing rules.
     TemplateRenderFailed = 302,   ///< Chat template rendering failed.
+    SessionSnapshotInvalid = 303, ///< A session snapshot could not be written, read, or parsed.
+    SessionSnapshotMismatch =
+        304, ///< A session snapshot was taken against a different model or format version.
 
     // Runtime errors (400-499)
     AgentNotRunning = 400,  ///< A request targeted an agent that is not accepting work.
@@ -517,6 +520,34 @@ using TokenCallback = FunctionRef<TokenAction(std::string_view)>;
  */
 using CancellationCallback = FunctionRef<bool()>;
 
+/**
+ * @brief Returns the text a constrained grammar forces after `generated`.
+ *
+ * An empty result means the model still has a choice to make. Used for
+ * jump-forward decoding of schema output; see `Model::set_schema_grammar()`.
+ * Within one generation each call's `generated` extends the previous one,
+ * and a new generation starts from shorter text.
+ */
+using ForcedContinuation = std::function<std::string(std::string_view generated)>;
+
+/**
+ * @brief Kinds of free text a constrained grammar admits regardless of context.
+ */
+enum class FreeTextKind {
+    None,   ///< The grammar must check every token.
+    String, ///< Inside string content: any text without quotes, backslashes or NUL.
+    Digits, ///< Inside or at the start of a number: any run of ASCII digits.
+};
+
+/**
+ * @brief Returns the kind of free text a constrained grammar admits after `generated`.
+ *
+ * Lets grammar-constrained sampling keep tokens from a precomputed mask
+ * without evaluating the grammar for them; see `Model::set_schema_grammar()`.
+ * Calls see growing text, as with `ForcedContinuation`.
+ */
+using FreeTextProbe = std::function<FreeTextKind(std::string_view generated)>;
+
 /**
  * @brief Async streaming callback stored by the agent runtime.
  *
@@ -572,10 +603,104 @@ class AsyncTokenCallback {
 
 using AsyncTextCallback = AsyncTokenCallback;
 
+/**
+ * @brief Callback invoked with each top-level field of an extraction once its value is complete.
+ *
+ * Runs on the inference thread between tokens, so it should return quickly.
+ * Returning `TokenAction::Stop` ends generation; the request then resolves
+ * with the fields completed so far and `ExtractionResponse::partial` set,
+ * and a stateful request leaves history as it was before the request.
+ */
+using ExtractionFieldCallback =
+    std::function<TokenAction(std::string_view field, const nlohmann::json& value)>;
+
+/**
+ * @brief Process-wide NUMA placement applied before the first model is loaded.
+ *
+ * Mirrors llama.cpp's `ggml_numa_strategy`. NUMA initialization happens once
+ * per process, so the first loaded model with a non-`Disabled` strategy wins.
+ */
+enum class NumaStrategy {
+    Disabled,   ///< Leave thread and memory placement to the OS.
+    Distribute, ///< Spread threads evenly across all NUMA nodes.
+    Isolate,    ///< Keep threads on the node the process started on.
+    Numactl,    ///< Follow the CPU map supplied by `numactl`.
+    Mirror,     ///< Mirror model weights on every node.
+};
+
+[[nodiscard]] inline const char* to_string(NumaStrategy strategy) noexcept {
+    switch (strategy) {
+    case NumaStrategy::Disabled:
+        return "disabled";
+    case NumaStrategy::Distribute:
+        return "distribute";
+    case NumaStrategy::Isolate:
+        return "isolate";
+    case NumaStrategy::Numactl:
+        return "numactl";
+    case NumaStrategy::Mirror:
+        return "mirror";
+    }
+    return "disabled";
+}
+
+/**
+ * @brief Storage type for the K or V half of the KV cache.
+ *
+ * `F16` decodes fastest. `Q8_0` roughly halves the cache with little quality
+ * loss and `Q4_0` roughly quarters it, at the cost of dequantization work in
+ * every attention pass.
+ */
+enum class KvCacheType {
+    F16,
+    Q8_0,
+    Q4_0,
+};
+
+[[nodiscard]] inline const char* to_string(KvCacheType type) noexcept {
+    switch (type) {
+    case KvCacheType::F16:
+        return "f16";
+    case KvCacheType::Q8_0:
+        return "q8_0";
+    case KvCacheType::Q4_0:
+        return "q4_0";
+    }
+    return "f16";
+}
+
+/**
+ * @brief Flash-attention policy for llama contexts.
+ */
+enum class FlashAttention {
+    Auto,     ///< Let llama.cpp enable it when the backend supports it.
+    Enabled,  ///< Always use flash attention.
+    Disabled, ///< Never use flash attention.
+};
+
+[[nodiscard]] inline const char* to_string(FlashAttention mode) noexcept {
+    switch (mode) {
+    case FlashAttention::Auto:
+        return "auto";
+    case FlashAttention::Enabled:
+        return "enabled";
+    case FlashAttention::Disabled:
+        return "disabled";
+    }
+    return "auto";
+}
+
 /**
  * @brief Model loading and backend configuration.
+ *
+ * Thread counts of 0 keep llama.cpp's defaults. Setting `cpu_mask` (and
+ * optionally `cpu_mask_batch`) pins decode and prompt processing to dedicated
+ * threadpools, which keeps several models on one host from oversubscribing
+ * the same cores.
  */
 struct ModelConfig {
+    static constexpr int kMaxDraftTokens = 64; ///< Upper bound for `draft_tokens`.
+
     std::string model_path;  ///< Filesystem path to the GGUF model.
     int context_size = 8192; ///< Requested context window size in tokens.
     int n_batch = 2048;      ///< Maximum tokens decoded per llama_decode() call.
@@ -583,6 +708,51 @@ struct ModelConfig {
         0; ///< Number of layers to offload to GPU. Defaults to CPU-only for portability.
     bool use_mmap = true;   ///< Whether to memory-map the model file.
     bool use_mlock = false; ///< Whether to lock model pages in memory.
+    /// Independent llama sequences reserved in the context, each with `context_size` tokens.
+    int max_sequences = 1;
+    /// Optional GGUF used to draft tokens for speculative decoding; empty disables it.
+    /// Must share the target model's vocabulary.
+    std::string draft_model_path;
+    int draft_tokens = 8;    ///< Maximum tokens drafted per speculative verification step.
+    int n_threads = 0;       ///< Threads used for single-token decode; 0 keeps the default.
+    int n_threads_batch = 0; ///< Threads used for prompt processing; 0 keeps the default.
+    int n_ubatch = 512;      ///< Physical micro-batch size; clamped to `n_batch`.
+    /// Hex CPU affinity mask for decode threads (e.g. "0xFF00"); empty disables pinning.
+    std::string cpu_mask;
+    /// Hex CPU affinity mask for prompt-processing threads; empty reuses `cpu_mask`.
+    std::string cpu_mask_batch;
+    NumaStrategy numa = NumaStrategy::Disabled;          ///< Process-wide NUMA placement.
+    KvCacheType cache_type_k = KvCacheType::F16;         ///< Storage type for cached keys.
+    KvCacheType cache_type_v = KvCacheType::F16;         ///< Storage type for cached values.
+    FlashAttention flash_attn = FlashAttention::Enabled; ///< Quantized V requires flash attention.
+    /// Keep the KV cache on the GPU alongside offloaded layers. Ignored when
+    /// `n_gpu_layers` is 0.
+    bool offload_kqv = true;
+    /// Shortest resident token run shifted into place, instead of prefilled
+    /// again, when history rewrites drop earlier messages. Shifted runs keep
+    /// KV computed against their old context, so output can differ from a
+    /// fresh prefill; 0 (the default) keeps exact prefix-only reuse.
+    int kv_reuse_min_tokens = 0;
+    /// When generation fills the context, discard the older half of the window
+    /// after the system prompt and keep generating instead of stopping.
+    bool context_shift = false;
+
+    /// Returns true when `mask` is an optionally `0x`-prefixed hex string with a bit set.
+    [[nodiscard]] static bool is_valid_cpu_mask(std::string_view mask) noexcept {
+        if (mask.starts_with("0x") || mask.starts_with("0X")) {
+            mask.remove_prefix(2);
+        }
+        bool any_bit = false;
+        for (const char c : mask) {
+            const bool digit = c >= '0' && c <= '9';
+            const bool hex = (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+            if (!digit && !hex) {
+                return false;
+            }
+            any_bit = any_bit || c != '0';
+        }
+        return any_bit;
+    }
 
     [[nodiscard]] Expected<void> validate() const {
         if (model_path.empty()) {
@@ -606,6 +776,55 @@ struct ModelConfig {
         if (n_batch <= 0) {
             return std::unexpected(Error{ErrorCode::InvalidBatchSize, "n_batch must be positive"});
         }
+        if (max_sequences < 1) {
+            return std::unexpected(
+                Error{ErrorCode::InvalidConfig, "max_sequences must be >= 1 (got " +
+                                                    std::to_string(max_sequences) + ")"});
+        }
+        if (!draft_model_path.empty()) {
+            const bool draft_exists = std::filesystem::exists(draft_model_path, ec);
+            if (ec) {
+                return std::unexpected(Error{ErrorCode::InvalidModelPath,
+                                             "Cannot access draft model path: " + draft_model_path,
+                                             ec.message()});
+            }
+            if (!draft_exists) {
+                return std::unexpected(Error{ErrorCode::InvalidModelPath,
+                                             "Draft model file does not exist: " +
+                                                 draft_model_path});
+            }
+        }
+        if (draft_tokens < 1 || draft_tokens > kMaxDraftTokens) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "draft_tokens must be in [1, " +
+                                             std::to_string(kMaxDraftTokens) + "] (got " +
+                                             std::to_string(draft_tokens) + ")"});
+        }
+        if (n_ubatch <= 0) {
+            return std::unexpected(Error{ErrorCode::InvalidBatchSize, "n_ubatch must be positive"});
+        }
+        if (n_threads < 0 || n_threads_batch < 0) {
+            return std::unexpected(
+                Error{ErrorCode::InvalidConfig, "n_threads and n_threads_batch must be >= 0"});
+        }
+        if (!cpu_mask.empty() && !is_valid_cpu_mask(cpu_mask)) {
+            return std::unexpected(
+                Error{ErrorCode::InvalidConfig, "cpu_mask must be a non-zero hex mask", cpu_mask});
+        }
+        if (!cpu_mask_batch.empty() && !is_valid_cpu_mask(cpu_mask_batch)) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "cpu_mask_batch must be a non-zero hex mask",
+                                         cpu_mask_batch});
+        }
+        if (kv_reuse_min_tokens < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "kv_reuse_min_tokens must be >= 0 (got " +
+                                             std::to_string(kv_reuse_min_tokens) + ")"});
+        }
+        if (cache_type_v != KvCacheType::F16 && flash_attn == FlashAttention::Disabled) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "A quantized cache_type_v requires flash attention"});
+        }
         return {};
     }
 
@@ -617,9 +836,15 @@ struct ModelConfig {
  */
 struct AgentConfig {
     size_t max_history_messages = 64;   ///< Maximum number of non-system messages retained.
+    size_t max_history_tokens = 0;      ///< Token budget for retained history; 0 disables it.
     size_t request_queue_capacity = 64; ///< Fixed number of request slots the agent may own.
     int max_tool_iterations = 5;        ///< Maximum detect/execute/respond iterations per request.
     int max_tool_retries = 2;           ///< Maximum validation retries for malformed tool calls.
+    size_t tool_workers = 4;            ///< Threads that run the tool calls of a turn concurrently.
+    size_t stream_chunk_bytes = 0;      ///< Coalesce streamed text into chunks of this many bytes.
+    int stream_chunk_interval_ms = 0;   ///< Also flush coalesced text after this long; 0 disables.
+    bool async_token_actions = false;   ///< Don't block decoding on action-returning callbacks.
+    size_t batch_sequences = 1;         ///< Stateless requests decoded together; 1 disables.
 
     [[nodiscard]] Expected<void> validate() const {
         if (max_history_messages == 0) {
@@ -640,12 +865,103 @@ struct AgentConfig {
                 Error{ErrorCode::InvalidConfig, "max_tool_retries must be >= 0 (got " +
                                                     std::to_string(max_tool_retries) + ")"});
         }
+        if (tool_workers == 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig, "tool_workers must be >= 1"});
+        }
+        if (stream_chunk_interval_ms < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "stream_chunk_interval_ms must be >= 0 (got " +
+                                             std::to_string(stream_chunk_interval_ms) + ")"});
+        }
+        if (batch_sequences == 0) {
+            return std::unexpected(
+                Error{ErrorCode::InvalidConfig, "batch_sequences must be >= 1"});
+        }
         return {};
     }
 
     bool operator==(const AgentConfig& other) const = default;
 };
 
+/**
+ * @brief Speculative decoding strategy for one generation call.
+ */
+enum class SpeculativeMode {
+    Default,      ///< Use the configured draft model, if any; otherwise decode normally.
+    Off,          ///< Decode one token per target pass, even with a draft model configured.
+    PromptLookup, ///< Propose continuations copied from earlier matching n-grams in the context.
+};
+
+[[nodiscard]] inline const char* to_string(SpeculativeMode mode) noexcept {
+    switch (mode) {
+    case SpeculativeMode::Default:
+        return "default";
+    case SpeculativeMode::Off:
+        return "off";
+    case SpeculativeMode::PromptLookup:
+        return "prompt_lookup";
+    }
+    return "default";
+}
+
+/**
+ * @brief Per-call speculative decoding settings.
+ *
+ * `PromptLookup` needs no draft model: the trailing `ngram_size` tokens are
+ * matched against the prompt and earlier output, and the tokens that followed
+ * the most recent match are verified in one batch. It pays off when output
+ * copies long spans of the input, as in extraction or summarization.
+ */
+struct SpeculativeOptions {
+    static constexpr int kMaxNgramSize = 16; ///< Upper bound for `ngram_size`.
+
+    SpeculativeMode mode = SpeculativeMode::Default; ///< Strategy for this call.
+    int ngram_size = 3;       ///< Trailing tokens matched in `PromptLookup` mode.
+    int max_draft_tokens = 8; ///< Tokens proposed per verification step in `PromptLookup` mode.
+
+    [[nodiscard]] Expected<void> validate() const {
+        if (ngram_size < 1 || ngram_size > kMaxNgramSize) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "speculative ngram_size must be in [1, " +
+                                             std::to_string(kMaxNgramSize) + "] (got " +
+                                             std::to_string(ngram_size) + ")"});
+        }
+        if (max_draft_tokens < 1 || max_draft_tokens > ModelConfig::kMaxDraftTokens) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "speculative max_draft_tokens must be in [1, " +
+                                             std::to_string(ModelConfig::kMaxDraftTokens) +
+                                             "] (got " + std::to_string(max_draft_tokens) + ")"});
+        }
+        return {};
+    }
+
+    bool operator==(const SpeculativeOptions& other) const = default;
+};
+
+/**
+ * @brief Scheduling class of an agent request.
+ *
+ * Queued requests are served strictly by class; within a class, earlier
+ * deadlines go first and requests without a deadline keep submission order.
+ */
+enum class RequestPriority {
+    Interactive, ///< Latency-sensitive work, served before anything else.
+    Normal,      ///< Default class.
+    Background,  ///< Bulk work that only runs when nothing else is queued.
+};
+
+[[nodiscard]] inline const char* to_string(RequestPriority priority) noexcept {
+    switch (priority) {
+    case RequestPriority::Interactive:
+        return "interactive";
+    case RequestPriority::Normal:
+        return "normal";
+    case RequestPriority::Background:
+        return "background";
+    }
+    return "normal";
+}
+
 /**
  * @brief Per-call generation behavior shared by model and agent operations.
  */
@@ -654,18 +970,32 @@ struct GenerationOptions {
     int max_tokens = -1;     ///< Completion cap, or `-1` for the context-limited maximum.
     std::vector<std::string> stop_sequences; ///< User-defined stop sequences.
     bool record_tool_trace = false;          ///< When true, materialize detailed tool diagnostics.
+    SpeculativeOptions speculative;          ///< Speculative decoding strategy.
+    RequestPriority priority = RequestPriority::Normal; ///< Agent queue scheduling class.
+    /// Agent requests still queued this long after submission fail with
+    /// `RequestTimeout` instead of running; zero waits indefinitely.
+    std::chrono::milliseconds deadline{0};
 
     [[nodiscard]] Expected<void> validate() const {
         if (max_tokens == 0 || (max_tokens < 0 && max_tokens != -1)) {
             return std::unexpected(
                 Error{ErrorCode::InvalidConfig, "max_tokens must be positive or -1 (unlimited)"});
         }
+        if (deadline.count() < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "deadline must be >= 0 (got " +
+                                             std::to_string(deadline.count()) + "ms)"});
+        }
+        if (auto result = speculative.validate(); !result) {
+            return result;
+        }
         return sampling.validate();
     }
 
     [[nodiscard]] bool is_default() const noexcept {
         return max_tokens == -1 && stop_sequences.empty() && !record_tool_trace &&
-               sampling == SamplingParams{};
+               sampling == SamplingParams{} && speculative == SpeculativeOptions{} &&
+               priority == RequestPriority::Normal && deadline.count() == 0;
     }
 
     bool operator==(const GenerationOptions& other) const = default;
@@ -728,6 +1058,10 @@ struct Metrics {
     std::chrono::milliseconds latency_ms{0};             ///< End-to-end request latency.
     std::chrono::milliseconds time_to_first_token_ms{0}; ///< Delay until the first streamed token.
     double tokens_per_second = 0.0; ///< Throughput after the first token arrives.
+    int draft_tokens_proposed = 0;  ///< Speculative tokens proposed for verification.
+    int draft_tokens_accepted = 0;  ///< Proposed tokens that matched the target's samples.
+    double draft_acceptance_rate = 0.0; ///< Accepted over proposed, or `0.0` without speculation.
+    int forced_tokens = 0;              ///< Grammar-forced tokens decoded without sampling.
 
     bool operator==(const Metrics& other) const = default;
 };
@@ -763,6 +1097,7 @@ struct ToolInvocation {
     ToolInvocationStatus status = ToolInvocationStatus::Succeeded; ///< Final outcome category.
     std::optional<std::string> result_json; ///< Serialized handler result when execution succeeded.
     std::optional<Error> error; ///< Validation or execution error when the attempt failed.
+    bool cached = false; ///< True when the result came from the registry's result cache.
 
     bool operator==(const ToolInvocation& other) const = default;
 };
@@ -801,10 +1136,26 @@ struct ExtractionResponse {
     TokenUsage usage;                    ///< Prompt and completion token usage.
     Metrics metrics;                     ///< Latency and throughput data.
     std::optional<ToolTrace> tool_trace; ///< Tool diagnostics when explicitly requested.
+    /// A field callback stopped generation; `data` holds only the fields
+    /// completed by then and was not validated against the schema. Neither
+    /// the request message nor the cut-off output was added to history.
+    bool partial = false;
 
     bool operator==(const ExtractionResponse& other) const = default;
 };
 
+/**
+ * @brief Counters of the process-wide extraction schema cache.
+ */
+struct SchemaCacheStats {
+    uint64_t hits = 0;      ///< Extraction requests whose schema was already compiled.
+    uint64_t misses = 0;    ///< Extraction requests that normalized and compiled their schema.
+    uint64_t evictions = 0; ///< Compiled schemas dropped to stay within the cache capacity.
+    size_t entries = 0;     ///< Compiled schemas currently cached.
+
+    bool operator==(const SchemaCacheStats& other) const = default;
+};
+
 /**
  * @brief Monotonic identifier assigned to queued agent requests.
  */
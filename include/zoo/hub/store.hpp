@@ -89,6 +89,16 @@ class ModelStore {
      */
     Expected<ModelConfig> model_config(const std::string& name_or_alias) const;
 
+    /**
+     * @brief Returns the target's ModelConfig with a stored draft model attached
+     *        for speculative decoding.
+     *
+     * Both references are resolved like `find()`. Vocabulary compatibility is
+     * checked when the model is loaded.
+     */
+    Expected<ModelConfig> model_config(const std::string& name_or_alias,
+                                       const std::string& draft_name_or_alias) const;
+
     /**
      * @brief Loads a core::Model directly from the store.
      */
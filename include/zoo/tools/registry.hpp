@@ -6,10 +6,12 @@
 #pragma once
 
 #include "types.hpp"
+#include <chrono>
 #include <concepts>
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
+#include <list>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <span>
@@ -308,10 +310,13 @@ Expected<ToolDefinition> make_tool_definition(const std::string& name,
  * The registry owns normalized tool metadata, exposes deterministic JSON Schema
  * definitions for prompt construction and grammar generation, and invokes
  * registered handlers. It has no internal synchronization; callers must
- * externally serialize any access that can overlap with mutation.
+ * externally serialize any access that can overlap with mutation. Cache
+ * lookups and stores count as mutation.
  */
 class ToolRegistry {
   public:
+    using CacheClock = std::chrono::steady_clock;
+
     /**
      * @brief Registers a strongly typed callable as a tool.
      */
@@ -357,7 +362,9 @@ class ToolRegistry {
      * @brief Registers a normalized tool definition.
      *
      * Existing entries with the same name are replaced in place while
-     * preserving registration order.
+     * preserving registration order, and their cached results are dropped.
+     * Fails with `InvalidConfig` when the definition's execution or cache
+     * policy is invalid.
      */
     Expected<void> register_tool(ToolDefinition definition);
 
@@ -365,7 +372,9 @@ class ToolRegistry {
      * @brief Registers multiple tool definitions as one ordered batch.
      *
      * Existing entries with the same name are replaced in place while
-     * preserving registration order.
+     * preserving registration order, and their cached results are dropped.
+     * Nothing is registered when any definition's execution or cache policy
+     * is invalid.
      *
      * @param definitions Tool definitions to register.
      * @return Void on success.
@@ -390,6 +399,38 @@ class ToolRegistry {
      */
     [[nodiscard]] std::optional<ToolHandler> find_handler(const std::string& name) const;
 
+    /**
+     * @brief Returns the execution policy for a registered tool, or nullopt if not found.
+     */
+    [[nodiscard]] std::optional<ToolExecutionPolicy>
+    get_execution_policy(const std::string& name) const;
+
+    /**
+     * @brief Returns a cached result for `name` called with `args`, if one is live.
+     *
+     * Counts a hit or a miss for tools whose `ToolCachePolicy` is enabled and
+     * returns nullopt without counting for all other tools. Expired entries
+     * are dropped on lookup.
+     */
+    [[nodiscard]] std::optional<nlohmann::json>
+    find_cached_result(const std::string& name, const nlohmann::json& args,
+                       CacheClock::time_point now = CacheClock::now());
+
+    /**
+     * @brief Caches a successful result of `name` called with `args`.
+     *
+     * Does nothing for unknown tools or tools without an enabled cache policy.
+     * Evicts the least recently used entry when the tool's cache is full.
+     */
+    void store_cached_result(const std::string& name, const nlohmann::json& args,
+                             nlohmann::json result, CacheClock::time_point now = CacheClock::now());
+
+    /// Returns the cache counters and the number of live entries.
+    [[nodiscard]] ToolCacheStats cache_stats() const;
+
+    /// Drops every cached result. Counters are kept.
+    void clear_cache();
+
     /**
      * @brief Returns the OpenAI-style tool schema for one registered tool.
      */
@@ -427,8 +468,25 @@ class ToolRegistry {
     /// Converts tool metadata into the schema shape consumed by prompts.
     static nlohmann::json build_schema_json(const ToolMetadata& metadata);
 
+    /// Replaces or appends one definition. Requires a validated definition.
+    void insert_definition(ToolDefinition definition);
+
+    /// One tool's cached results in least-recently-used order, most recent first.
+    struct ResultCache {
+        struct Entry {
+            std::string key;
+            nlohmann::json result;
+            CacheClock::time_point expires_at;
+        };
+
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
     std::vector<ToolDefinition> tools_;
     std::unordered_map<std::string, size_t> index_by_name_;
+    std::unordered_map<std::string, ResultCache> caches_;
+    ToolCacheStats cache_stats_;
 };
 
 } // namespace zoo::tools
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -87,12 +90,85 @@ struct ToolMetadata {
     bool operator==(const ToolMetadata& other) const = default;
 };
 
+/**
+ * @brief Limits the agent applies when it executes a tool's handler.
+ */
+struct ToolExecutionPolicy {
+    int max_concurrency = 0; ///< Maximum simultaneous invocations of this tool; 0 is unlimited.
+    /// How long the tool loop waits for a result before reporting a timeout
+    /// to the model; 0 waits indefinitely. The handler itself is not interrupted.
+    std::chrono::milliseconds timeout{0};
+
+    [[nodiscard]] Expected<void> validate() const {
+        if (max_concurrency < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "max_concurrency must be >= 0 (got " +
+                                             std::to_string(max_concurrency) + ")"});
+        }
+        if (timeout.count() < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "timeout must be >= 0 (got " +
+                                             std::to_string(timeout.count()) + "ms)"});
+        }
+        return {};
+    }
+
+    /// Compares two policies field-by-field.
+    bool operator==(const ToolExecutionPolicy& other) const = default;
+};
+
+/**
+ * @brief Opt-in memoization of a deterministic tool's successful results.
+ *
+ * Results are keyed on the tool name and the canonical serialization of the
+ * call arguments, so argument key order does not matter. Failed invocations
+ * are never cached.
+ */
+struct ToolCachePolicy {
+    /// Results kept for this tool, least recently used evicted first; 0 disables caching.
+    size_t max_entries = 0;
+    /// How long a cached result stays valid; 0 keeps it until it is evicted.
+    std::chrono::milliseconds ttl{0};
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return max_entries > 0;
+    }
+
+    [[nodiscard]] Expected<void> validate() const {
+        if (ttl.count() < 0) {
+            return std::unexpected(Error{ErrorCode::InvalidConfig,
+                                         "cache ttl must be >= 0 (got " +
+                                             std::to_string(ttl.count()) + "ms)"});
+        }
+        return {};
+    }
+
+    /// Compares two policies field-by-field.
+    bool operator==(const ToolCachePolicy& other) const = default;
+};
+
+/**
+ * @brief Counters reported by the registry's tool result cache.
+ */
+struct ToolCacheStats {
+    uint64_t hits = 0;        ///< Lookups answered from the cache.
+    uint64_t misses = 0;      ///< Lookups for cache-enabled tools that found no live entry.
+    uint64_t evictions = 0;   ///< Entries dropped to stay within `max_entries`.
+    uint64_t expirations = 0; ///< Entries dropped because their ttl elapsed.
+    size_t entries = 0;       ///< Results currently cached across all tools.
+
+    /// Compares two snapshots field-by-field.
+    bool operator==(const ToolCacheStats& other) const = default;
+};
+
 /**
  * @brief Metadata plus executable handler for a registered tool.
  */
 struct ToolDefinition {
-    ToolMetadata metadata; ///< Public metadata exposed to prompts and validators.
-    ToolHandler handler;   ///< Callable invoked when the tool is executed.
+    ToolMetadata metadata;           ///< Public metadata exposed to prompts and validators.
+    ToolHandler handler;             ///< Callable invoked when the tool is executed.
+    ToolExecutionPolicy execution{}; ///< Concurrency and timeout limits for agent execution.
+    ToolCachePolicy cache{};         ///< Result memoization; disabled by default.
 };
 
 } // namespace zoo::tools
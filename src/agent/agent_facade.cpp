@@ -7,6 +7,7 @@
 
 #include "agent/backend_model.hpp"
 #include "agent/runtime.hpp"
+#include "tools/schema_cache.hpp"
 #include "zoo/core/model.hpp"
 
 namespace zoo {
@@ -46,6 +47,18 @@ Expected<std::unique_ptr<Agent>> Agent::create(const ModelConfig& model_config,
         new Agent(model_config, agent_config, default_generation, std::move(agent_impl)));
 }
 
+Expected<std::unique_ptr<Agent>> Agent::open_session() const {
+    auto backend = impl_->runtime.open_backend_session();
+    if (!backend) {
+        return std::unexpected(backend.error());
+    }
+
+    auto agent_impl = std::make_unique<Impl>(model_config_, agent_config_,
+                                             default_generation_options_, std::move(*backend));
+    return std::unique_ptr<Agent>(new Agent(model_config_, agent_config_,
+                                            default_generation_options_, std::move(agent_impl)));
+}
+
 Agent::Agent(ModelConfig model_config, AgentConfig agent_config,
              GenerationOptions default_generation, std::unique_ptr<Impl> impl)
     : model_config_(std::move(model_config)), agent_config_(agent_config),
@@ -73,21 +86,33 @@ RequestHandle<TextResponse> Agent::complete(ConversationView messages,
 RequestHandle<ExtractionResponse> Agent::extract_stateful(const nlohmann::json& output_schema,
                                                           MessageView message,
                                                           GenerationOverride generation,
-                                                          AsyncTokenCallback callback) {
-    return impl_->runtime.extract(output_schema, message, generation, std::move(callback));
+                                                          AsyncTokenCallback callback,
+                                                          ExtractionFieldCallback on_field) {
+    return impl_->runtime.extract(output_schema, message, generation, std::move(callback),
+                                  std::move(on_field));
 }
 
 RequestHandle<ExtractionResponse> Agent::extract(const nlohmann::json& output_schema,
                                                  ConversationView messages,
                                                  GenerationOverride generation,
-                                                 AsyncTokenCallback callback) {
-    return impl_->runtime.extract(output_schema, messages, generation, std::move(callback));
+                                                 AsyncTokenCallback callback,
+                                                 ExtractionFieldCallback on_field) {
+    return impl_->runtime.extract(output_schema, messages, generation, std::move(callback),
+                                  std::move(on_field));
 }
 
 void Agent::cancel(RequestId id) {
     impl_->runtime.cancel(id);
 }
 
+std::chrono::nanoseconds Agent::estimated_queue_wait(RequestPriority priority) const {
+    return impl_->runtime.estimated_queue_wait(priority);
+}
+
+SchemaCacheStats Agent::schema_cache_stats() {
+    return tools::SchemaGrammarCache::shared().stats();
+}
+
 void Agent::set_system_prompt(std::string_view prompt) {
     impl_->runtime.set_system_prompt(prompt);
 }
@@ -141,6 +166,16 @@ Expected<void> Agent::clear_history(std::chrono::nanoseconds timeout) {
     return impl_->runtime.clear_history(timeout);
 }
 
+Expected<void> Agent::save_session(std::string_view path, std::string_view model_id,
+                                   std::optional<std::chrono::nanoseconds> timeout) {
+    return impl_->runtime.save_session(path, model_id, timeout);
+}
+
+Expected<void> Agent::load_session(std::string_view path, std::string_view model_id,
+                                   std::optional<std::chrono::nanoseconds> timeout) {
+    return impl_->runtime.load_session(path, model_id, timeout);
+}
+
 Expected<void> Agent::register_tool(tools::ToolDefinition definition,
                                     std::optional<std::chrono::nanoseconds> timeout) {
     return impl_->runtime.register_tool(std::move(definition), timeout);
@@ -168,4 +203,9 @@ size_t Agent::tool_count() const noexcept {
     return impl_->runtime.tool_count();
 }
 
+Expected<tools::ToolCacheStats>
+Agent::tool_cache_stats(std::optional<std::chrono::nanoseconds> timeout) const {
+    return impl_->runtime.tool_cache_stats(timeout);
+}
+
 } // namespace zoo
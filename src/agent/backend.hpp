@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <zoo/core/types.hpp>
 
@@ -30,6 +33,9 @@ struct GenerationResult {
     std::string parsed_content;
     /// Structured tool calls extracted from the output (empty when none detected).
     std::vector<ToolCallInfo> tool_calls;
+    int draft_tokens_proposed = 0; ///< Speculative tokens proposed during the pass.
+    int draft_tokens_accepted = 0; ///< Speculative tokens the target model accepted.
+    int forced_tokens = 0;         ///< Grammar-forced tokens appended without sampling.
 };
 
 /**
@@ -42,6 +48,37 @@ struct ParsedToolResponse {
     std::vector<ToolCallInfo> tool_calls;
 };
 
+/// Outcome of a pass run on one `BatchLanes` lane.
+struct LaneResult {
+    size_t lane = 0;
+    Expected<GenerationResult> result;
+};
+
+/**
+ * @brief Sessions whose generation passes decode together in shared batches.
+ *
+ * Mirrors `core::ContinuousBatch`. Each lane keeps its own history and KV
+ * sequence; a pass started on a free lane joins the next `step()`.
+ */
+class BatchLanes {
+  public:
+    virtual ~BatchLanes() = default;
+
+    [[nodiscard]] virtual size_t size() const noexcept = 0;
+
+    /// Replaces `lane`'s history with `messages` and starts a pass from it.
+    /// `prepared_prompt`, when set, holds `prepare_prompt(messages)` and is
+    /// used instead of rendering again. The callbacks are called from
+    /// `step()` and must stay valid until the lane's result is returned.
+    virtual Expected<void> start(size_t lane, const std::vector<Message>& messages,
+                                 const std::vector<int>* prepared_prompt,
+                                 const GenerationOptions& options, TokenCallback on_token,
+                                 CancellationCallback should_cancel) = 0;
+
+    /// Decodes one step of every running lane and returns the passes that ended.
+    virtual std::vector<LaneResult> step() = 0;
+};
+
 /**
  * @brief Minimal model surface consumed by the agent runtime.
  *
@@ -56,7 +93,20 @@ class AgentBackend {
     virtual Expected<GenerationResult>
     generate_from_history(const GenerationOptions& options, TokenCallback on_token,
                           CancellationCallback should_cancel) = 0;
-    virtual void finalize_response() = 0;
+
+    /// Renders and tokenizes `messages` without touching backend state; see
+    /// `core::Model::prepare_prompt()`. Safe to call from any thread.
+    virtual Expected<std::vector<int>>
+    prepare_prompt(const std::vector<Message>& messages) const = 0;
+    /// Generates from the current history starting from `prepare_prompt()` tokens.
+    virtual Expected<GenerationResult>
+    generate_from_prepared(std::span<const int> prompt_tokens, const GenerationOptions& options,
+                           TokenCallback on_token, CancellationCallback should_cancel) = 0;
+
+    /// Prefills the KV cache ahead of the next `next_role` message; see
+    /// `core::Model::prefill_history()`.
+    virtual Expected<int> prefill_history(Role next_role, std::string_view tool_call_id,
+                                          CancellationCallback should_cancel) = 0;
 
     virtual void set_system_prompt(std::string_view prompt) = 0;
     virtual HistorySnapshot get_history() const = 0;
@@ -69,6 +119,21 @@ class AgentBackend {
     virtual HistorySnapshot swap_history(HistorySnapshot snapshot) = 0;
 
     virtual void trim_history(size_t max_non_system_messages) = 0;
+    /// Trims retained history to a token budget; see `core::Model::trim_history_to_tokens()`.
+    virtual void trim_history_to_tokens(size_t max_tokens) = 0;
+
+    /// Persists history and KV state; see `core::Model::save_session()`.
+    virtual Expected<void> save_session(const std::string& path, std::string_view model_id) = 0;
+    /// Restores state written by `save_session()`.
+    virtual Expected<void> load_session(const std::string& path, std::string_view model_id) = 0;
+
+    /// Opens an independent backend on the same loaded weights with its own
+    /// history and KV cache. Safe to call from any thread.
+    virtual Expected<std::unique_ptr<AgentBackend>> open_session() const = 0;
+
+    /// Opens `lanes` sessions on the same loaded weights that decode in shared
+    /// batches; see `core::ContinuousBatch::open()`. Safe to call from any thread.
+    virtual Expected<std::unique_ptr<BatchLanes>> open_batch_lanes(size_t lanes) const = 0;
 
     /**
      * @brief Configures template-driven tool calling.
@@ -82,9 +147,15 @@ class AgentBackend {
      * @brief Enables immediate grammar-constrained generation for schema output.
      *
      * @param grammar_str GBNF grammar string rooted at `root`.
+     * @param forced Reports output the grammar forces, for jump-forward
+     *        decoding; empty to sample every token.
+     * @param free_text Reports where the grammar admits free text, so most
+     *        candidates are settled by a precomputed token mask; empty to
+     *        check every candidate against the grammar.
      * @return `true` when the sampler chain was rebuilt successfully.
      */
-    virtual bool set_schema_grammar(const std::string& grammar_str) = 0;
+    virtual bool set_schema_grammar(const std::string& grammar_str, ForcedContinuation forced,
+                                    FreeTextProbe free_text) = 0;
 
     /// Disables any active grammar/tool calling and restores the default sampler chain.
     virtual void clear_tool_grammar() = 0;
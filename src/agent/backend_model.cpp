@@ -11,6 +11,52 @@ namespace zoo::internal::agent {
 
 namespace {
 
+Expected<GenerationResult> to_backend_result(Expected<core::Model::GenerationResult> result) {
+    if (!result) {
+        return std::unexpected(result.error());
+    }
+
+    return GenerationResult{std::move(result->text), result->prompt_tokens,
+                            result->tool_call_detected, std::move(result->parsed_content),
+                            std::move(result->tool_calls), result->draft_tokens_proposed,
+                            result->draft_tokens_accepted, result->forced_tokens};
+}
+
+class ModelBatchLanes final : public BatchLanes {
+  public:
+    explicit ModelBatchLanes(std::unique_ptr<core::ContinuousBatch> batch)
+        : batch_(std::move(batch)) {}
+
+    size_t size() const noexcept override {
+        return batch_->size();
+    }
+
+    Expected<void> start(size_t lane, const std::vector<Message>& messages,
+                         const std::vector<int>* prepared_prompt, const GenerationOptions& options,
+                         TokenCallback on_token, CancellationCallback should_cancel) override {
+        // Replacing keeps the lane's resident tokens, so a shared system
+        // prompt is only prefilled once per lane.
+        batch_->session(lane).replace_history(HistorySnapshot{messages});
+        if (prepared_prompt != nullptr) {
+            return batch_->start(lane, std::span<const int>(*prepared_prompt), options, on_token,
+                                 should_cancel);
+        }
+        return batch_->start(lane, options, on_token, should_cancel);
+    }
+
+    std::vector<LaneResult> step() override {
+        std::vector<LaneResult> results;
+        for (auto& finished : batch_->step()) {
+            results.push_back(
+                LaneResult{finished.lane, to_backend_result(std::move(finished.result))});
+        }
+        return results;
+    }
+
+  private:
+    std::unique_ptr<core::ContinuousBatch> batch_;
+};
+
 class ModelBackend final : public AgentBackend {
   public:
     explicit ModelBackend(std::unique_ptr<core::Model> model) : model_(std::move(model)) {}
@@ -22,19 +68,25 @@ class ModelBackend final : public AgentBackend {
     Expected<GenerationResult> generate_from_history(const GenerationOptions& options,
                                                      TokenCallback on_token,
                                                      CancellationCallback should_cancel) override {
-        auto result = model_->generate_from_history(options, on_token, should_cancel);
-        if (!result) {
-            return std::unexpected(result.error());
-        }
+        return to_backend_result(model_->generate_from_history(options, on_token, should_cancel));
+    }
+
+    Expected<std::vector<int>> prepare_prompt(const std::vector<Message>& messages) const override {
+        return model_->prepare_prompt(messages);
+    }
 
-        return GenerationResult{std::move(result->text), result->prompt_tokens,
-                                result->tool_call_detected, std::move(result->parsed_content),
-                                std::move(result->tool_calls)};
+    Expected<GenerationResult>
+    generate_from_prepared(std::span<const int> prompt_tokens, const GenerationOptions& options,
+                           TokenCallback on_token, CancellationCallback should_cancel) override {
+        return to_backend_result(
+            model_->generate_from_prepared(prompt_tokens, options, on_token, should_cancel));
     }
 
-    void finalize_response() override {
-        model_->finalize_response();
+    Expected<int> prefill_history(Role next_role, std::string_view tool_call_id,
+                                  CancellationCallback should_cancel) override {
+        return model_->prefill_history(next_role, tool_call_id, std::move(should_cancel));
     }
+
     void set_system_prompt(std::string_view prompt) override {
         model_->set_system_prompt(prompt);
     }
@@ -54,13 +106,42 @@ class ModelBackend final : public AgentBackend {
     void trim_history(size_t max_non_system_messages) override {
         model_->trim_history(max_non_system_messages);
     }
+    void trim_history_to_tokens(size_t max_tokens) override {
+        model_->trim_history_to_tokens(max_tokens);
+    }
+
+    Expected<void> save_session(const std::string& path, std::string_view model_id) override {
+        return model_->save_session(path, model_id);
+    }
+
+    Expected<void> load_session(const std::string& path, std::string_view model_id) override {
+        return model_->load_session(path, model_id);
+    }
+
+    Expected<std::unique_ptr<AgentBackend>> open_session() const override {
+        // Each agent runs its own inference thread, so it cannot share a context.
+        auto session = model_->open_session(core::SessionPlacement::DedicatedContext);
+        if (!session) {
+            return std::unexpected(session.error());
+        }
+        return make_model_backend(std::move(*session));
+    }
+
+    Expected<std::unique_ptr<BatchLanes>> open_batch_lanes(size_t lanes) const override {
+        auto batch = core::ContinuousBatch::open(*model_, lanes);
+        if (!batch) {
+            return std::unexpected(batch.error());
+        }
+        return std::make_unique<ModelBatchLanes>(std::move(*batch));
+    }
 
     bool set_tool_calling(const std::vector<CoreToolInfo>& tools) override {
         return model_->set_tool_calling(tools);
     }
 
-    bool set_schema_grammar(const std::string& grammar_str) override {
-        return model_->set_schema_grammar(grammar_str);
+    bool set_schema_grammar(const std::string& grammar_str, ForcedContinuation forced,
+                            FreeTextProbe free_text) override {
+        return model_->set_schema_grammar(grammar_str, std::move(forced), std::move(free_text));
     }
 
     void clear_tool_grammar() override {
@@ -6,41 +6,78 @@
 #pragma once
 
 #include "log.hpp"
+#include "spsc_ring.hpp"
 #include "zoo/core/types.hpp"
 
-#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <exception>
-#include <future>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <utility>
 
 namespace zoo::internal::agent {
 
+/// Buffering and delivery policy for `CallbackDispatcher`.
+struct StreamingOptions {
+    /// Bytes of preallocated ring storage between the two threads.
+    size_t ring_capacity = 64 * 1024;
+    /// Coalesce pieces until this many bytes are buffered; 0 sends each piece.
+    size_t chunk_bytes = 0;
+    /// Also send buffered pieces once the oldest is this old; zero disables.
+    std::chrono::microseconds chunk_interval{0};
+    /// Run action-returning callbacks without blocking the caller; a returned
+    /// `TokenAction::Stop` is reported by a later `dispatch()`.
+    bool async_actions = false;
+
+    [[nodiscard]] bool coalesces() const noexcept {
+        return chunk_bytes > 0 || chunk_interval.count() > 0;
+    }
+};
+
+/// Maps the agent's streaming settings onto dispatcher options.
+inline StreamingOptions streaming_options(const AgentConfig& config) {
+    StreamingOptions options;
+    options.chunk_bytes = config.stream_chunk_bytes;
+    options.chunk_interval = std::chrono::milliseconds(config.stream_chunk_interval_ms);
+    options.async_actions = config.async_token_actions;
+    return options;
+}
+
 /**
  * @brief Dispatches streaming callbacks on a dedicated thread.
  *
- * The inference thread calls `dispatch()` to enqueue a callback invocation on
- * the dispatcher thread. For action-returning callbacks (`AsyncTokenCallback`
- * built from a callable that returns `TokenAction`), `dispatch()` blocks until
- * the dispatcher thread has executed the callback and returns its action. For
- * void-returning callbacks, `dispatch()` enqueues and returns
+ * The inference thread calls `dispatch()` to hand a piece to the dispatcher
+ * thread through a lock-free single-producer/single-consumer byte ring, so the
+ * hot path copies the piece once and takes no lock. For action-returning
+ * callbacks (`AsyncTokenCallback` built from a callable that returns
+ * `TokenAction`), `dispatch()` blocks until the dispatcher thread has executed
+ * the callback and returns its action, unless `StreamingOptions::async_actions`
+ * is set. For void-returning callbacks, `dispatch()` enqueues and returns
  * `TokenAction::Continue` immediately; any exception thrown by the callback is
  * captured and rethrown on the next `dispatch()` or `drain()` call. `drain()`
  * provides a synchronization point between generation passes.
+ *
+ * With coalescing enabled, non-blocking pieces are buffered on the inference
+ * thread and delivered as one chunk once `chunk_bytes` or `chunk_interval` is
+ * reached (checked when the next piece arrives) or at `drain()`.
  */
 class CallbackDispatcher {
   public:
-    CallbackDispatcher() : thread_([this] { run(); }) {}
+    explicit CallbackDispatcher(StreamingOptions options = {})
+        : options_(options), ring_(options.ring_capacity), thread_([this] { run(); }) {
+        if (options_.coalesces()) {
+            pending_.reserve(std::min(max_payload(), std::max<size_t>(options_.chunk_bytes, 256)));
+        }
+    }
 
     ~CallbackDispatcher() {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            shutdown_ = true;
-        }
-        cv_.notify_one();
+        flush_pending();
+        push(Record{}, {});
         if (thread_.joinable()) {
             thread_.join();
         }
@@ -52,130 +89,207 @@ class CallbackDispatcher {
     CallbackDispatcher& operator=(CallbackDispatcher&&) = delete;
 
     /**
-     * @brief Enqueues a callback invocation for execution on the dispatcher thread.
+     * @brief Hands a piece to the dispatcher thread.
      *
-     * The token string is copied into the queue. The callback reference must
-     * remain valid until `dispatch()` returns (action callbacks) or until the
-     * next `drain()` returns (void callbacks).
+     * The token bytes are copied into the ring. The callback reference must
+     * remain valid until `dispatch()` returns (blocking action callbacks) or
+     * until the next `drain()` returns (everything else).
      */
     TokenAction dispatch(AsyncTokenCallback& callback, std::string_view token) {
-        if (callback.returns_action()) {
+        if (callback.returns_action() && !options_.async_actions) {
+            flush_pending();
             return dispatch_sync(callback, token);
         }
-        dispatch_async(callback, token);
+
+        if (options_.async_actions && stop_requested_.load(std::memory_order_acquire)) {
+            return TokenAction::Stop;
+        }
+        if (options_.coalesces()) {
+            coalesce(callback, token);
+        } else {
+            post(callback, token);
+        }
+        rethrow_failure();
         return TokenAction::Continue;
     }
 
     /**
      * @brief Blocks until all previously dispatched callbacks have completed.
      *
-     * Rethrows any exception captured from a void-returning callback that ran
-     * on the dispatcher thread since the last `drain()` or `dispatch()` call.
+     * Delivers any coalesced pieces first. Rethrows any exception captured from
+     * a non-blocking callback that ran on the dispatcher thread since the last
+     * `drain()` or `dispatch()` call, and clears a pending asynchronous stop.
      */
     void drain() {
-        std::exception_ptr captured;
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            drain_cv_.wait(lock, [this] { return queue_.empty() && !executing_; });
-            captured = std::exchange(failure_, nullptr);
-        }
-        if (captured) {
-            std::rethrow_exception(captured);
-        }
+        flush_pending();
+        ring_.wait_empty();
+        stop_requested_.store(false, std::memory_order_release);
+        rethrow_failure();
     }
 
   private:
-    struct Entry {
-        AsyncTokenCallback* callback;
-        std::string token;
-        // Set for action-returning callbacks; the inference thread waits on it.
-        // Null for void-returning callbacks; exceptions are captured into
-        // `failure_` and surfaced at the next `dispatch()`/`drain()`.
-        std::shared_ptr<std::promise<TokenAction>> done;
+    // Fixed-size prefix of every ring entry; `length` payload bytes follow.
+    // A null callback tells the dispatcher thread to exit. `sync` marks a
+    // blocking action callback, whose result goes to the `sync_*` members.
+    struct Record {
+        AsyncTokenCallback* callback = nullptr;
+        size_t length = 0;
+        bool sync = false;
     };
 
+    [[nodiscard]] size_t max_payload() const noexcept {
+        return ring_.capacity() - sizeof(Record);
+    }
+
+    void push(const Record& record, std::string_view payload) {
+        const std::string_view header(reinterpret_cast<const char*>(&record), sizeof(Record));
+        ring_.wait_writable(header.size() + payload.size());
+        ring_.write(header, payload);
+    }
+
+    // Posts `token` for non-blocking delivery, split if it exceeds the ring.
+    void post(AsyncTokenCallback& callback, std::string_view token) {
+        do {
+            const std::string_view part = token.substr(0, max_payload());
+            push(Record{&callback, part.size(), false}, part);
+            token.remove_prefix(part.size());
+        } while (!token.empty());
+    }
+
+    void coalesce(AsyncTokenCallback& callback, std::string_view token) {
+        if (pending_callback_ != &callback) {
+            flush_pending();
+            pending_callback_ = &callback;
+        }
+        if (pending_.empty()) {
+            pending_since_ = std::chrono::steady_clock::now();
+        }
+        pending_.append(token);
+
+        const bool full = options_.chunk_bytes > 0 &&
+                          pending_.size() >= std::min(options_.chunk_bytes, max_payload());
+        const bool due = options_.chunk_interval.count() > 0 &&
+                         std::chrono::steady_clock::now() - pending_since_ >=
+                             options_.chunk_interval;
+        if (full || due) {
+            flush_pending();
+        }
+    }
+
+    void flush_pending() {
+        if (pending_callback_ != nullptr && !pending_.empty()) {
+            post(*pending_callback_, pending_);
+        }
+        pending_.clear();
+        pending_callback_ = nullptr;
+    }
+
     TokenAction dispatch_sync(AsyncTokenCallback& callback, std::string_view token) {
-        auto done = std::make_shared<std::promise<TokenAction>>();
-        auto future = done->get_future();
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (shutdown_) {
-                return TokenAction::Continue;
+        do {
+            const std::string_view part = token.substr(0, max_payload());
+            const uint64_t ticket = ++sync_issued_;
+            push(Record{&callback, part.size(), true}, part);
+            for (uint64_t completed = sync_completed_.load(std::memory_order_acquire);
+                 completed != ticket; completed = sync_completed_.load(std::memory_order_acquire)) {
+                sync_completed_.wait(completed, std::memory_order_acquire);
             }
-            queue_.push(Entry{&callback, std::string(token), std::move(done)});
-        }
-        cv_.notify_one();
-        return future.get();
+            if (sync_error_) {
+                std::rethrow_exception(std::exchange(sync_error_, nullptr));
+            }
+            if (sync_action_ == TokenAction::Stop) {
+                return TokenAction::Stop;
+            }
+            token.remove_prefix(part.size());
+        } while (!token.empty());
+        return TokenAction::Continue;
     }
 
-    void dispatch_async(AsyncTokenCallback& callback, std::string_view token) {
+    void rethrow_failure() {
+        if (!has_failure_.load(std::memory_order_acquire)) {
+            return;
+        }
         std::exception_ptr captured;
         {
-            std::lock_guard<std::mutex> lock(mutex_);
+            std::lock_guard<std::mutex> lock(failure_mutex_);
             captured = std::exchange(failure_, nullptr);
-            if (!shutdown_) {
-                queue_.push(Entry{&callback, std::string(token), nullptr});
-            }
+            has_failure_.store(false, std::memory_order_release);
         }
-        cv_.notify_one();
         if (captured) {
             std::rethrow_exception(captured);
         }
     }
 
-    void route_exception(const Entry& entry, std::unique_lock<std::mutex>& lock) {
-        if (entry.done) {
-            entry.done->set_exception(std::current_exception());
+    void route_exception(const Record& record) {
+        if (record.sync) {
+            sync_error_ = std::current_exception();
             return;
         }
-        lock.lock();
+        std::lock_guard<std::mutex> lock(failure_mutex_);
         if (!failure_) {
             failure_ = std::current_exception();
+            has_failure_.store(true, std::memory_order_release);
+        }
+    }
+
+    void deliver(const Record& record, std::string_view payload) {
+        // After an asynchronous stop the rest of the pass is not delivered.
+        if (!record.sync && stop_requested_.load(std::memory_order_acquire)) {
+            return;
+        }
+        try {
+            const TokenAction action = (*record.callback)(payload);
+            if (record.sync) {
+                sync_action_ = action;
+            } else if (action == TokenAction::Stop) {
+                stop_requested_.store(true, std::memory_order_release);
+            }
+        } catch (const std::exception& e) {
+            ZOO_LOG("error", "streaming callback threw: %s", e.what());
+            route_exception(record);
+        } catch (...) {
+            ZOO_LOG("error", "streaming callback threw unknown exception");
+            route_exception(record);
         }
-        lock.unlock();
     }
 
     void run() {
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::string scratch;
         while (true) {
-            cv_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
-
-            while (!queue_.empty()) {
-                auto entry = std::move(queue_.front());
-                queue_.pop();
-                executing_ = true;
-                lock.unlock();
-
-                try {
-                    TokenAction action = (*entry.callback)(entry.token);
-                    if (entry.done) {
-                        entry.done->set_value(action);
-                    }
-                } catch (const std::exception& e) {
-                    ZOO_LOG("error", "streaming callback threw: %s", e.what());
-                    route_exception(entry, lock);
-                } catch (...) {
-                    ZOO_LOG("error", "streaming callback threw unknown exception");
-                    route_exception(entry, lock);
-                }
-
-                lock.lock();
-                executing_ = false;
-                drain_cv_.notify_one();
+            ring_.wait_readable();
+            Record record;
+            ring_.read(0, &record, sizeof(Record));
+            if (record.callback == nullptr) {
+                ring_.consume(sizeof(Record));
+                return;
             }
 
-            if (shutdown_) {
-                return;
+            deliver(record, ring_.view(sizeof(Record), record.length, scratch));
+            // Release the bytes only after the callback is done with them.
+            ring_.consume(sizeof(Record) + record.length);
+            if (record.sync) {
+                sync_completed_.fetch_add(1, std::memory_order_release);
+                sync_completed_.notify_one();
             }
         }
     }
 
-    std::mutex mutex_;
-    std::condition_variable cv_;
-    std::condition_variable drain_cv_;
-    std::queue<Entry> queue_;
-    bool shutdown_ = false;
-    bool executing_ = false;
+    const StreamingOptions options_;
+    SpscByteRing ring_;
+    // Producer-side coalescing buffer; only touched by the dispatching thread.
+    std::string pending_;
+    AsyncTokenCallback* pending_callback_ = nullptr;
+    std::chrono::steady_clock::time_point pending_since_;
+    // Result of the blocking action callback in flight; at most one is, since
+    // its producer waits for it. The dispatcher owns this state rather than
+    // the waiting frame, so completing never touches memory the waiter may
+    // already have released. `sync_issued_` is producer-only.
+    TokenAction sync_action_ = TokenAction::Continue;
+    std::exception_ptr sync_error_;
+    std::atomic<uint64_t> sync_completed_{0};
+    uint64_t sync_issued_ = 0;
+    std::atomic<bool> stop_requested_{false};
+    std::atomic<bool> has_failure_{false};
+    std::mutex failure_mutex_;
     std::exception_ptr failure_;
     std::thread thread_;
 };
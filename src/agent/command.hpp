@@ -40,6 +40,20 @@ struct AddSystemMessageCmd {
     std::shared_ptr<std::promise<Expected<void>>> done;
 };
 
+/// Writes the conversation history and KV state to a session snapshot file.
+struct SaveSessionCmd {
+    std::string path;
+    std::string model_id;
+    std::shared_ptr<std::promise<Expected<void>>> done;
+};
+
+/// Restores the conversation history and KV state from a session snapshot file.
+struct LoadSessionCmd {
+    std::string path;
+    std::string model_id;
+    std::shared_ptr<std::promise<Expected<void>>> done;
+};
+
 /// Registers a single tool on the inference thread.
 struct RegisterToolCmd {
     tools::ToolDefinition definition;
@@ -52,9 +66,15 @@ struct RegisterToolsCmd {
     std::shared_ptr<std::promise<Expected<void>>> done;
 };
 
+/// Snapshots the counters of the tool result cache.
+struct GetToolCacheStatsCmd {
+    std::shared_ptr<std::promise<Expected<tools::ToolCacheStats>>> done;
+};
+
 /// Discriminated union of all control commands the runtime accepts.
 using Command = std::variant<SetSystemPromptCmd, GetHistoryCmd, ClearHistoryCmd,
-                             AddSystemMessageCmd, RegisterToolCmd, RegisterToolsCmd>;
+                             AddSystemMessageCmd, SaveSessionCmd, LoadSessionCmd, RegisterToolCmd,
+                             RegisterToolsCmd, GetToolCacheStatsCmd>;
 
 /// Helper for exhaustive std::visit with overloaded lambdas.
 template <class... Ts> struct overloaded : Ts... {
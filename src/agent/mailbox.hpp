@@ -7,11 +7,16 @@
 
 #include "command.hpp"
 #include "request.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <optional>
 #include <queue>
 #include <variant>
+#include <vector>
 
 namespace zoo::internal::agent {
 
@@ -21,14 +26,21 @@ using WorkItem = std::variant<QueuedRequest, Command>;
 /**
  * @brief Thread-safe dual-lane mailbox for the agent runtime.
  *
- * Both lanes are unbounded queues. Backpressure for requests is managed
- * externally by `RequestSlots`; the command lane is unbounded because control
- * commands are rare and callers block on their result. The pop order
- * prioritizes pending commands over queued requests so that model-affecting
- * operations are applied between requests, never mid-generation.
+ * Both lanes are unbounded. Backpressure for requests is managed externally by
+ * `RequestSlots`; the command lane is unbounded because control commands are
+ * rare and callers block on their result. The pop order prioritizes pending
+ * commands over queued requests so that model-affecting operations are applied
+ * between requests, never mid-generation.
+ *
+ * Requests are kept in a heap ordered by priority class, then earliest
+ * deadline, then submission order. The runtime brackets each request it
+ * actually runs with `begin_service()`/`end_service()`, which feeds the
+ * moving average behind `estimated_wait()`.
  */
 class RuntimeMailbox {
   public:
+    using Clock = QueuedRequest::Clock;
+
     RuntimeMailbox() : shutdown_(false) {}
 
     /**
@@ -42,7 +54,9 @@ class RuntimeMailbox {
             return false;
         }
 
-        requests_.push(std::move(request));
+        ++queued_by_priority_[priority_index(request.priority)];
+        requests_.push_back(QueuedEntry{request, next_sequence_++});
+        std::push_heap(requests_.begin(), requests_.end(), ServedAfter{});
         cv_.notify_one();
         return true;
     }
@@ -67,7 +81,8 @@ class RuntimeMailbox {
     /**
      * @brief Pops the next work item, blocking until one is available or shutdown.
      *
-     * Pending commands are always dequeued before queued requests.
+     * Pending commands are always dequeued before queued requests. Requests
+     * whose deadline has passed are still returned; the caller resolves them.
      *
      * @return The next work item, or `std::nullopt` after shutdown once both
      *         queues drain.
@@ -75,20 +90,18 @@ class RuntimeMailbox {
     std::optional<WorkItem> pop() {
         std::unique_lock<std::mutex> lock(mutex_);
         cv_.wait(lock, [this] { return !commands_.empty() || !requests_.empty() || shutdown_; });
+        return take_next(true);
+    }
 
-        if (!commands_.empty()) {
-            Command cmd = std::move(commands_.front());
-            commands_.pop();
-            return cmd;
-        }
-
-        if (!requests_.empty()) {
-            QueuedRequest req = std::move(requests_.front());
-            requests_.pop();
-            return req;
-        }
-
-        return std::nullopt;
+    /**
+     * @brief Pops the next work item without blocking.
+     *
+     * Used between continuous-batching steps. Commands come first, as in
+     * `pop()`; a queued request is only returned when `take_request` is set.
+     */
+    std::optional<WorkItem> try_pop(bool take_request) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return take_next(take_request);
     }
 
     /// Marks the mailbox closed and wakes blocked waiters.
@@ -110,8 +123,99 @@ class RuntimeMailbox {
         return commands_.size();
     }
 
+    /// Marks the start of a popped request's generation.
+    void begin_service(Clock::time_point now = Clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        service_started_ = now;
+    }
+
+    /// Marks the end of the request started by `begin_service()` and folds its
+    /// duration into the service-time average.
+    void end_service(Clock::time_point now = Clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!service_started_) {
+            return;
+        }
+        const auto elapsed = now - *service_started_;
+        service_started_.reset();
+        // Exponential moving average with weight 1/8, seeded by the first sample.
+        average_service_ = average_service_.count() == 0
+                               ? elapsed
+                               : average_service_ + (elapsed - average_service_) / 8;
+    }
+
+    /**
+     * @brief Estimates how long a request submitted now with `priority` would
+     *        wait before it starts.
+     *
+     * Counts the queued requests served no later than it, plus the expected
+     * remainder of the request in service, at the average service time.
+     * Returns zero until one request has completed.
+     */
+    Clock::duration estimated_wait(RequestPriority priority,
+                                   Clock::time_point now = Clock::now()) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t ahead = 0;
+        for (size_t index = 0; index <= priority_index(priority); ++index) {
+            ahead += queued_by_priority_[index];
+        }
+        Clock::duration wait = average_service_ * static_cast<int64_t>(ahead);
+        if (service_started_) {
+            wait += std::max(Clock::duration::zero(),
+                             average_service_ - (now - *service_started_));
+        }
+        return wait;
+    }
+
   private:
-    std::queue<QueuedRequest> requests_;
+    struct QueuedEntry {
+        QueuedRequest request;
+        uint64_t sequence = 0;
+    };
+
+    // Heap comparator: true when `lhs` is served after `rhs`.
+    struct ServedAfter {
+        bool operator()(const QueuedEntry& lhs, const QueuedEntry& rhs) const noexcept {
+            if (lhs.request.priority != rhs.request.priority) {
+                return lhs.request.priority > rhs.request.priority;
+            }
+            if (lhs.request.deadline != rhs.request.deadline) {
+                return lhs.request.deadline > rhs.request.deadline;
+            }
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    static constexpr size_t kPriorityCount = 3;
+
+    static size_t priority_index(RequestPriority priority) noexcept {
+        return std::min(static_cast<size_t>(priority), kPriorityCount - 1);
+    }
+
+    // Caller holds `mutex_`.
+    std::optional<WorkItem> take_next(bool take_request) {
+        if (!commands_.empty()) {
+            Command cmd = std::move(commands_.front());
+            commands_.pop();
+            return cmd;
+        }
+
+        if (take_request && !requests_.empty()) {
+            std::pop_heap(requests_.begin(), requests_.end(), ServedAfter{});
+            const QueuedRequest req = requests_.back().request;
+            requests_.pop_back();
+            --queued_by_priority_[priority_index(req.priority)];
+            return req;
+        }
+
+        return std::nullopt;
+    }
+
+    std::vector<QueuedEntry> requests_;
+    std::array<size_t, kPriorityCount> queued_by_priority_{};
+    uint64_t next_sequence_ = 0;
+    std::optional<Clock::time_point> service_started_;
+    Clock::duration average_service_{0};
     std::queue<Command> commands_;
     mutable std::mutex mutex_;
     std::condition_variable cv_;
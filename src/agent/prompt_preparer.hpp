@@ -0,0 +1,112 @@
+/**
+ * @file prompt_preparer.hpp
+ * @brief Renders and tokenizes queued Replace-mode requests ahead of the inference thread.
+ */
+
+#pragma once
+
+#include "backend.hpp"
+#include "log.hpp"
+#include "request_slots.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+
+namespace zoo::internal::agent {
+
+/**
+ * @brief Front pipeline stage that prepares prompts while earlier requests decode.
+ *
+ * A Replace-mode request carries its complete history, so its chat-template
+ * render and tokenization do not depend on the requests ahead of it. The
+ * preparer runs that work on its own thread and stores the tokens in the
+ * request's slot. The inference thread claims the slot when it pops the
+ * request and falls back to rendering inline if preparation has not finished,
+ * so a slow or failed preparation never delays a request.
+ */
+class PromptPreparer {
+  public:
+    PromptPreparer(const AgentBackend& backend, std::shared_ptr<RequestSlots> request_slots)
+        : backend_(backend), request_slots_(std::move(request_slots)), thread_([this] { run(); }) {}
+
+    ~PromptPreparer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutdown_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    PromptPreparer(const PromptPreparer&) = delete;
+    PromptPreparer& operator=(const PromptPreparer&) = delete;
+    PromptPreparer(PromptPreparer&&) = delete;
+    PromptPreparer& operator=(PromptPreparer&&) = delete;
+
+    /// Queues a request for preparation. Ignored after shutdown.
+    void submit(QueuedRequest request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (shutdown_) {
+                return;
+            }
+            queue_.push(request);
+        }
+        cv_.notify_one();
+    }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+            if (shutdown_) {
+                return;
+            }
+
+            const QueuedRequest request = queue_.front();
+            queue_.pop();
+            lock.unlock();
+            prepare(request);
+            lock.lock();
+        }
+    }
+
+    void prepare(const QueuedRequest& request) {
+        auto messages = request_slots_->prompt_source(request);
+        if (!messages) {
+            return;
+        }
+
+        try {
+            auto tokens = backend_.prepare_prompt(*messages);
+            if (!tokens) {
+                ZOO_LOG("debug", "prompt preparation skipped: %s",
+                        tokens.error().message.c_str());
+                return;
+            }
+            request_slots_->store_prepared_prompt(request, std::move(*tokens));
+        } catch (const std::exception& e) {
+            ZOO_LOG("warn", "prompt preparation threw: %s", e.what());
+        } catch (...) {
+            ZOO_LOG("warn", "prompt preparation threw unknown exception");
+        }
+    }
+
+    const AgentBackend& backend_;
+    std::shared_ptr<RequestSlots> request_slots_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::queue<QueuedRequest> queue_;
+    bool shutdown_ = false;
+    std::thread thread_;
+};
+
+} // namespace zoo::internal::agent
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <nlohmann/json.hpp>
@@ -40,6 +41,7 @@ struct RequestPayload {
     GenerationOptions options;
     AsyncTokenCallback streaming_callback;
     std::optional<nlohmann::json> extraction_schema;
+    ExtractionFieldCallback field_callback;
     ResultKind result_kind = ResultKind::Text;
 };
 
@@ -47,8 +49,17 @@ struct RequestPayload {
  * @brief Small queued descriptor pointing at one occupied request slot.
  */
 struct QueuedRequest {
+    using Clock = std::chrono::steady_clock;
+
     uint32_t slot = 0;
     uint32_t generation = 0;
+    RequestPriority priority = RequestPriority::Normal;
+    /// Absolute dispatch deadline; `time_point::max()` when the request has none.
+    Clock::time_point deadline = Clock::time_point::max();
+
+    [[nodiscard]] bool expired(Clock::time_point now) const noexcept {
+        return deadline != Clock::time_point::max() && now >= deadline;
+    }
 
     bool operator==(const QueuedRequest& other) const = default;
 };
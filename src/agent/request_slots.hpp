@@ -43,8 +43,12 @@ struct ActiveRequest {
     const GenerationOptions* options = nullptr;
     AsyncTokenCallback* streaming_callback = nullptr;
     const std::optional<nlohmann::json>* extraction_schema = nullptr;
+    /// Extraction only: receives completed top-level fields, or empty.
+    const ExtractionFieldCallback* field_callback = nullptr;
     const std::atomic<bool>* cancelled = nullptr;
     ResultKind result_kind = ResultKind::Text;
+    /// Prompt tokens prepared ahead of time for a Replace-mode request, or null.
+    const std::vector<int>* prepared_prompt = nullptr;
 };
 
 /**
@@ -88,6 +92,8 @@ class RequestSlots {
         slot.request_id = request_id;
         slot.cancelled.store(false, std::memory_order_release);
         slot.payload = std::move(payload);
+        slot.prepared_prompt.reset();
+        slot.prompt_claimed = false;
         slot.result = std::monostate{};
         return RequestReservation{
             slot.request_id,
@@ -96,6 +102,8 @@ class RequestSlots {
         };
     }
 
+    /// Returns the inference-thread view of a queued request. This claims the
+    /// slot's prompt: a preparation still in flight is discarded when it lands.
     [[nodiscard]] std::optional<ActiveRequest>
     active_request(const QueuedRequest& request) noexcept {
         if (request.slot >= slots_.size()) {
@@ -108,6 +116,7 @@ class RequestSlots {
             return std::nullopt;
         }
 
+        slot.prompt_claimed = true;
         return ActiveRequest{
             slot.request_id,
             slot.payload.history_mode,
@@ -115,11 +124,46 @@ class RequestSlots {
             &slot.payload.options,
             &slot.payload.streaming_callback,
             &slot.payload.extraction_schema,
+            &slot.payload.field_callback,
             &slot.cancelled,
             slot.payload.result_kind,
+            slot.prepared_prompt ? &*slot.prepared_prompt : nullptr,
         };
     }
 
+    /// Copies the messages of a queued Replace-mode request for off-thread
+    /// prompt preparation. Returns nullopt once the request was claimed,
+    /// cancelled or finished, or when it appends to retained history.
+    [[nodiscard]] std::optional<std::vector<Message>> prompt_source(const QueuedRequest& request) {
+        if (request.slot >= slots_.size()) {
+            return std::nullopt;
+        }
+
+        Slot& slot = *slots_[request.slot];
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (!slot.occupied || slot.generation != request.generation || slot.prompt_claimed ||
+            slot.payload.history_mode != HistoryMode::Replace ||
+            slot.cancelled.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        return slot.payload.messages;
+    }
+
+    /// Stores prepared prompt tokens unless the inference thread already claimed the request.
+    bool store_prepared_prompt(const QueuedRequest& request, std::vector<int> tokens) {
+        if (request.slot >= slots_.size()) {
+            return false;
+        }
+
+        Slot& slot = *slots_[request.slot];
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (!slot.occupied || slot.generation != request.generation || slot.prompt_claimed) {
+            return false;
+        }
+        slot.prepared_prompt = std::move(tokens);
+        return true;
+    }
+
     void cancel(RequestId id) {
         std::optional<uint32_t> slot_index;
         {
@@ -310,6 +354,10 @@ class RequestSlots {
         RequestId request_id = 0;
         std::atomic<bool> cancelled{false};
         RequestPayload payload;
+        // Written by the prompt preparer until `prompt_claimed` is set by
+        // active_request(); read-only afterwards.
+        std::optional<std::vector<int>> prepared_prompt;
+        bool prompt_claimed = false;
         std::variant<std::monostate, Expected<TextResponse>, Expected<ExtractionResponse>> result;
     };
 
@@ -361,6 +409,8 @@ class RequestSlots {
         slot.request_id = 0;
         slot.cancelled.store(false, std::memory_order_release);
         slot.payload = RequestPayload{};
+        slot.prepared_prompt.reset();
+        slot.prompt_claimed = false;
         slot.result = std::monostate{};
         ++slot.generation;
         if (slot.generation == 0) {
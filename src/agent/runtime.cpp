@@ -63,15 +63,17 @@ RequestHandle<TextResponse> AgentRuntime::complete(ConversationView messages,
 RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& output_schema,
                                                         std::string_view user_message,
                                                         GenerationOverride generation,
-                                                        AsyncTokenCallback callback) {
+                                                        AsyncTokenCallback callback,
+                                                        ExtractionFieldCallback on_field) {
     return extract(output_schema, MessageView{Role::User, user_message}, generation,
-                   std::move(callback));
+                   std::move(callback), std::move(on_field));
 }
 
 RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& output_schema,
                                                         MessageView message,
                                                         GenerationOverride generation,
-                                                        AsyncTokenCallback callback) {
+                                                        AsyncTokenCallback callback,
+                                                        ExtractionFieldCallback on_field) {
     auto params = tools::detail::normalize_schema(output_schema);
     if (!params) {
         return make_immediate_error_handle<ExtractionResponse>(
@@ -84,6 +86,7 @@ RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& ou
     payload.options = resolve_generation_options(generation);
     payload.streaming_callback = std::move(callback);
     payload.extraction_schema = nlohmann::json(output_schema);
+    payload.field_callback = std::move(on_field);
     payload.result_kind = ResultKind::Extraction;
     return enqueue_request<ExtractionResponse>(std::move(payload));
 }
@@ -91,7 +94,8 @@ RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& ou
 RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& output_schema,
                                                         ConversationView messages,
                                                         GenerationOverride generation,
-                                                        AsyncTokenCallback callback) {
+                                                        AsyncTokenCallback callback,
+                                                        ExtractionFieldCallback on_field) {
     auto params = tools::detail::normalize_schema(output_schema);
     if (!params) {
         return make_immediate_error_handle<ExtractionResponse>(
@@ -104,6 +108,7 @@ RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& ou
     payload.options = resolve_generation_options(generation);
     payload.streaming_callback = std::move(callback);
     payload.extraction_schema = nlohmann::json(output_schema);
+    payload.field_callback = std::move(on_field);
     payload.result_kind = ResultKind::Extraction;
 
     if (payload.messages.empty()) {
@@ -114,10 +119,20 @@ RequestHandle<ExtractionResponse> AgentRuntime::extract(const nlohmann::json& ou
     return enqueue_request<ExtractionResponse>(std::move(payload));
 }
 
+Expected<std::unique_ptr<AgentBackend>> AgentRuntime::open_backend_session() const {
+    // Only reads the immutable loaded model, so it bypasses the command lane.
+    return backend_->open_session();
+}
+
 void AgentRuntime::cancel(RequestId id) {
     request_slots_->cancel(id);
 }
 
+std::chrono::nanoseconds AgentRuntime::estimated_queue_wait(RequestPriority priority) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        request_mailbox_.estimated_wait(priority));
+}
+
 GenerationOptions AgentRuntime::resolve_generation_options(GenerationOverride generation) const {
     if (!generation.options()) {
         return default_generation_options_;
@@ -143,6 +158,9 @@ RequestHandle<Result> AgentRuntime::enqueue_request(RequestPayload&& payload) {
         return make_immediate_error_handle<Result>(validation.error());
     }
 
+    const bool replaces_history = payload.history_mode == HistoryMode::Replace;
+    const RequestPriority priority = payload.options.priority;
+    const auto deadline = payload.options.deadline;
     auto reservation = request_slots_->emplace(std::move(payload));
     if (!reservation) {
         return make_immediate_error_handle<Result>(reservation.error());
@@ -152,9 +170,16 @@ RequestHandle<Result> AgentRuntime::enqueue_request(RequestPayload&& payload) {
         request_slots_, reservation->id, reservation->slot, reservation->generation);
     RequestHandle<Result> handle{std::move(state), reservation->id};
 
-    if (!request_mailbox_.push_request(QueuedRequest{reservation->slot, reservation->generation})) {
+    QueuedRequest queued{reservation->slot, reservation->generation, priority};
+    if (deadline.count() > 0) {
+        queued.deadline = QueuedRequest::Clock::now() + deadline;
+    }
+    if (!request_mailbox_.push_request(queued)) {
         request_slots_->resolve_error(reservation->slot, reservation->generation,
                                       Error{ErrorCode::AgentNotRunning, "Agent is not running"});
+    } else if (replaces_history) {
+        // The full history is known up front, so render it while earlier requests decode.
+        prompt_preparer_.submit(queued);
     }
 
     return handle;
@@ -8,16 +8,19 @@
 #include "backend.hpp"
 #include "callback_dispatcher.hpp"
 #include "mailbox.hpp"
+#include "prompt_preparer.hpp"
 #include "request_slots.hpp"
 #include "tool_executor.hpp"
 #include "zoo/agent.hpp"
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string_view>
 #include <thread>
+#include <vector>
 
 namespace zoo::internal::agent {
 
@@ -49,17 +52,21 @@ class AgentRuntime {
     RequestHandle<ExtractionResponse> extract(const nlohmann::json& output_schema,
                                               std::string_view user_message,
                                               GenerationOverride generation = {},
-                                              AsyncTokenCallback callback = {});
+                                              AsyncTokenCallback callback = {},
+                                              ExtractionFieldCallback on_field = {});
     RequestHandle<ExtractionResponse> extract(const nlohmann::json& output_schema,
                                               MessageView message,
                                               GenerationOverride generation = {},
-                                              AsyncTokenCallback callback = {});
+                                              AsyncTokenCallback callback = {},
+                                              ExtractionFieldCallback on_field = {});
     RequestHandle<ExtractionResponse> extract(const nlohmann::json& output_schema,
                                               ConversationView messages,
                                               GenerationOverride generation = {},
-                                              AsyncTokenCallback callback = {});
+                                              AsyncTokenCallback callback = {},
+                                              ExtractionFieldCallback on_field = {});
 
     void cancel(RequestId id);
+    std::chrono::nanoseconds estimated_queue_wait(RequestPriority priority) const;
     void set_system_prompt(std::string_view prompt);
     Expected<void> try_set_system_prompt(std::string_view prompt);
     Expected<void> set_system_prompt(std::string_view prompt, std::chrono::nanoseconds timeout);
@@ -74,16 +81,46 @@ class AgentRuntime {
     void clear_history();
     Expected<void> try_clear_history();
     Expected<void> clear_history(std::chrono::nanoseconds timeout);
+    Expected<void> save_session(std::string_view path, std::string_view model_id,
+                                std::optional<std::chrono::nanoseconds> timeout = {});
+    Expected<void> load_session(std::string_view path, std::string_view model_id,
+                                std::optional<std::chrono::nanoseconds> timeout = {});
+    Expected<std::unique_ptr<AgentBackend>> open_backend_session() const;
 
     Expected<void> register_tool(tools::ToolDefinition definition,
                                  std::optional<std::chrono::nanoseconds> timeout = {});
     Expected<void> register_tools(std::vector<tools::ToolDefinition> definitions,
                                   std::optional<std::chrono::nanoseconds> timeout = {});
     size_t tool_count() const noexcept;
+    Expected<tools::ToolCacheStats>
+    tool_cache_stats(std::optional<std::chrono::nanoseconds> timeout = {}) const;
 
   private:
+    // A request decoding on a continuous-batching lane. Heap-allocated so the
+    // callbacks handed to the lane keep their address until it finishes.
+    struct BatchedRequest {
+        QueuedRequest queued;
+        ActiveRequest active;
+        std::chrono::steady_clock::time_point start_time;
+        std::chrono::steady_clock::time_point first_token_time;
+        bool first_token_received = false;
+        int completion_tokens = 0;
+        std::function<TokenAction(std::string_view)> on_token;
+        std::function<bool()> should_cancel;
+    };
+
     void inference_loop();
     void handle_request(QueuedRequest request);
+    /// Resolves `request` when it was cancelled or expired while queued.
+    bool resolve_stale_request(const QueuedRequest& request, const ActiveRequest& active,
+                               QueuedRequest::Clock::time_point now);
+    [[nodiscard]] bool batch_running() const noexcept;
+    /// Starts `request` on a free lane; false when it must run on the main session.
+    bool start_batched_request(const QueuedRequest& request);
+    /// Serves queued commands and, when `admit` is set, starts queued requests
+    /// on free lanes, then decodes one batch step.
+    void step_batched_requests(bool admit);
+    void finish_batched_request(LaneResult finished);
     void handle_command(Command& cmd);
     Expected<TextResponse> process_request(const ActiveRequest& request);
     Expected<ExtractionResponse> process_extraction_request(const ActiveRequest& request);
@@ -119,6 +156,13 @@ class AgentRuntime {
     AgentConfig agent_config_;
     GenerationOptions default_generation_options_;
     std::unique_ptr<AgentBackend> backend_;
+    // Continuous batching, when `AgentConfig::batch_sequences` > 1; inference
+    // thread only. `batched_requests_` is indexed by lane, null when free.
+    std::unique_ptr<BatchLanes> batch_lanes_;
+    std::vector<std::unique_ptr<BatchedRequest>> batched_requests_;
+    // A request popped while lanes were busy that cannot join them; it runs
+    // on the main session once the batch drains.
+    std::optional<QueuedRequest> deferred_request_;
     tools::ToolRegistry tool_registry_;
     std::shared_ptr<RequestSlots> request_slots_;
     mutable RuntimeMailbox request_mailbox_;
@@ -127,10 +171,13 @@ class AgentRuntime {
     std::atomic<bool> tool_grammar_active_{false};
     std::atomic<size_t> tool_count_{0};
     CallbackDispatcher callback_dispatcher_;
-    // Declared after callback_dispatcher_: ~AgentRuntime() calls stop() which joins
-    // the inference thread before any member destructor runs, so ordering here is for
-    // grouping only — both worker threads are already stopped at that point.
+    // Declared after agent_config_, which sizes its pool. ~AgentRuntime() calls stop()
+    // which joins the inference thread before any member destructor runs, so no new
+    // tool jobs arrive while the pool drains and joins.
     ToolExecutor tool_executor_;
+    // Declared after backend_ and request_slots_, which it borrows; destroyed
+    // (and joined) before either.
+    PromptPreparer prompt_preparer_;
 };
 
 } // namespace zoo::internal::agent
@@ -0,0 +1,157 @@
+/**
+ * @file runtime_batching.cpp
+ * @brief Continuous batching of stateless requests on the inference thread.
+ */
+
+#include "agent/runtime.hpp"
+
+#include "agent/runtime_helpers.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace zoo::internal::agent {
+
+bool AgentRuntime::batch_running() const noexcept {
+    return std::ranges::any_of(batched_requests_,
+                               [](const auto& batched) { return batched != nullptr; });
+}
+
+bool AgentRuntime::start_batched_request(const QueuedRequest& request) {
+    if (!batch_lanes_) {
+        return false;
+    }
+    const auto lane = std::find(batched_requests_.begin(), batched_requests_.end(), nullptr);
+    if (lane == batched_requests_.end()) {
+        return false;
+    }
+    const auto active_request = request_slots_->active_request(request);
+    if (!active_request.has_value()) {
+        return true;
+    }
+
+    // Lanes generate plain text from the request's own history, so requests
+    // that run the tool loop, a schema grammar or keep history stay on the
+    // main session. An asynchronous stop is reported dispatcher-wide and
+    // would end every lane, so those callbacks stay there too.
+    const bool async_stop = agent_config_.async_token_actions &&
+                            active_request->streaming_callback != nullptr &&
+                            active_request->streaming_callback->returns_action();
+    if (active_request->result_kind != ResultKind::Text ||
+        active_request->history_mode != HistoryMode::Replace || tool_registry_.size() > 0 ||
+        async_stop) {
+        return false;
+    }
+
+    const auto now = QueuedRequest::Clock::now();
+    if (resolve_stale_request(request, *active_request, now)) {
+        return true;
+    }
+
+    auto batched = std::make_unique<BatchedRequest>();
+    batched->queued = request;
+    batched->active = *active_request;
+    batched->start_time = std::chrono::steady_clock::now();
+    BatchedRequest* state = batched.get();
+    state->on_token = [this, state](std::string_view token) -> TokenAction {
+        TokenAction action = TokenAction::Continue;
+        if (state->active.streaming_callback != nullptr && *state->active.streaming_callback) {
+            action = callback_dispatcher_.dispatch(*state->active.streaming_callback, token);
+        }
+        if (!state->first_token_received) {
+            state->first_token_time = std::chrono::steady_clock::now();
+            state->first_token_received = true;
+        }
+        ++state->completion_tokens;
+        return action;
+    };
+    state->should_cancel = [state]() {
+        return state->active.cancelled &&
+               state->active.cancelled->load(std::memory_order_acquire);
+    };
+
+    const auto index = static_cast<size_t>(lane - batched_requests_.begin());
+    auto started = batch_lanes_->start(index, *active_request->messages,
+                                       active_request->prepared_prompt, *active_request->options,
+                                       TokenCallback(state->on_token),
+                                       CancellationCallback(state->should_cancel));
+    if (!started) {
+        request_slots_->resolve_error(request.slot, request.generation, started.error());
+        return true;
+    }
+
+    ZOO_LOG("debug", "request %lu joined batch lane %zu",
+            static_cast<unsigned long>(active_request->id), index);
+    // Lanes overlap, so the service average approaches the interval between
+    // completions, which is what a queued request waits for.
+    request_mailbox_.begin_service(now);
+    *lane = std::move(batched);
+    return true;
+}
+
+void AgentRuntime::step_batched_requests(bool admit) {
+    // Commands only touch the main session, so they run between steps.
+    while (admit) {
+        const bool lane_free =
+            !deferred_request_ && std::find(batched_requests_.begin(), batched_requests_.end(),
+                                            nullptr) != batched_requests_.end();
+        auto item_opt = request_mailbox_.try_pop(lane_free);
+        if (!item_opt) {
+            break;
+        }
+
+        std::visit(overloaded{
+                       [this](QueuedRequest request) {
+                           if (!start_batched_request(request)) {
+                               deferred_request_ = request;
+                           }
+                       },
+                       [this](Command& cmd) { handle_command(cmd); },
+                   },
+                   *item_opt);
+    }
+
+    for (auto& finished : batch_lanes_->step()) {
+        finish_batched_request(std::move(finished));
+    }
+}
+
+void AgentRuntime::finish_batched_request(LaneResult finished) {
+    const auto batched = std::move(batched_requests_[finished.lane]);
+    const QueuedRequest& request = batched->queued;
+    try {
+        callback_dispatcher_.drain();
+        if (!finished.result) {
+            request_slots_->resolve_error(request.slot, request.generation,
+                                          std::move(finished.result.error()));
+        } else {
+            const auto end_time = std::chrono::steady_clock::now();
+            GenerationStats stats(batched->start_time);
+            stats.record_pass(batched->start_time, end_time, batched->first_token_received,
+                              batched->first_token_time, finished.result->prompt_tokens,
+                              batched->completion_tokens);
+
+            TextResponse response;
+            response.text = std::move(finished.result->text);
+            response.usage = stats.usage();
+            response.metrics = stats.metrics(end_time);
+            request_slots_->resolve_text(request.slot, request.generation, std::move(response));
+        }
+    } catch (const std::exception& e) {
+        ZOO_LOG("error", "unhandled exception in batched inference: %s", e.what());
+        request_slots_->resolve_error(
+            request.slot, request.generation,
+            Error{ErrorCode::InferenceFailed, std::string("Unhandled exception: ") + e.what()});
+    } catch (...) {
+        ZOO_LOG("error", "unknown exception in batched inference");
+        request_slots_->resolve_error(
+            request.slot, request.generation,
+            Error{ErrorCode::InferenceFailed, "Unknown exception in inference thread"});
+    }
+    request_mailbox_.end_service();
+}
+
+} // namespace zoo::internal::agent
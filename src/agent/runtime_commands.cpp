@@ -123,6 +123,24 @@ Expected<void> AgentRuntime::clear_history(std::chrono::nanoseconds timeout) {
     return clear_history_impl(timeout);
 }
 
+Expected<void> AgentRuntime::save_session(std::string_view path, std::string_view model_id,
+                                          std::optional<std::chrono::nanoseconds> timeout) {
+    return send_sync_command<void>(
+        [p = std::string(path), id = std::string(model_id)](auto done) mutable -> Command {
+            return SaveSessionCmd{std::move(p), std::move(id), std::move(done)};
+        },
+        timeout, "save_session");
+}
+
+Expected<void> AgentRuntime::load_session(std::string_view path, std::string_view model_id,
+                                          std::optional<std::chrono::nanoseconds> timeout) {
+    return send_sync_command<void>(
+        [p = std::string(path), id = std::string(model_id)](auto done) mutable -> Command {
+            return LoadSessionCmd{std::move(p), std::move(id), std::move(done)};
+        },
+        timeout, "load_session");
+}
+
 Expected<void> AgentRuntime::register_tool_impl(tools::ToolDefinition definition,
                                                 std::optional<std::chrono::nanoseconds> timeout) {
     assert(!inference_thread_.joinable() ||
@@ -162,6 +180,13 @@ size_t AgentRuntime::tool_count() const noexcept {
     return tool_count_.load(std::memory_order_acquire);
 }
 
+Expected<tools::ToolCacheStats>
+AgentRuntime::tool_cache_stats(std::optional<std::chrono::nanoseconds> timeout) const {
+    return const_cast<AgentRuntime*>(this)->send_sync_command<tools::ToolCacheStats>(
+        [](auto done) -> Command { return GetToolCacheStatsCmd{std::move(done)}; }, timeout,
+        "tool_cache_stats");
+}
+
 void AgentRuntime::handle_command(Command& cmd) {
     std::visit(
         overloaded{
@@ -179,6 +204,12 @@ void AgentRuntime::handle_command(Command& cmd) {
             [this](AddSystemMessageCmd& c) {
                 c.done->set_value(backend_->add_message(MessageView{Role::System, c.message}));
             },
+            [this](SaveSessionCmd& c) {
+                c.done->set_value(backend_->save_session(c.path, c.model_id));
+            },
+            [this](LoadSessionCmd& c) {
+                c.done->set_value(backend_->load_session(c.path, c.model_id));
+            },
             [this](RegisterToolCmd& c) {
                 if (auto result = tool_registry_.register_tool(std::move(c.definition)); !result) {
                     c.done->set_value(std::unexpected(result.error()));
@@ -200,6 +231,9 @@ void AgentRuntime::handle_command(Command& cmd) {
                 tool_count_.store(tool_registry_.size(), std::memory_order_release);
                 c.done->set_value({});
             },
+            [this](GetToolCacheStatsCmd& c) {
+                c.done->set_value(Expected<tools::ToolCacheStats>{tool_registry_.cache_stats()});
+            },
         },
         cmd);
 }
@@ -213,8 +247,11 @@ void AgentRuntime::resolve_command_on_shutdown(Command& cmd) {
                    [&](GetHistoryCmd& c) { c.done->set_value(shutdown_error()); },
                    [&](ClearHistoryCmd& c) { c.done->set_value(shutdown_error()); },
                    [&](AddSystemMessageCmd& c) { c.done->set_value(shutdown_error()); },
+                   [&](SaveSessionCmd& c) { c.done->set_value(shutdown_error()); },
+                   [&](LoadSessionCmd& c) { c.done->set_value(shutdown_error()); },
                    [&](RegisterToolCmd& c) { c.done->set_value(shutdown_error()); },
                    [&](RegisterToolsCmd& c) { c.done->set_value(shutdown_error()); },
+                   [&](GetToolCacheStatsCmd& c) { c.done->set_value(shutdown_error()); },
                },
                cmd);
 }
@@ -1,13 +1,15 @@
 /**
  * @file runtime_extraction.cpp
- * @brief Structured output extraction: schema-constrained single-pass generation.
+ * @brief Structured output extraction: schema-constrained single-pass generation,
+ *        parsed field by field as it streams.
  */
 
 #include "agent/runtime.hpp"
 
 #include "agent/runtime_helpers.hpp"
 #include "log.hpp"
-#include "tools/grammar.hpp"
+#include "tools/json_stream.hpp"
+#include "tools/schema_cache.hpp"
 #include "zoo/core/model.hpp"
 #include "zoo/tools/registry.hpp"
 #include "zoo/tools/validation.hpp"
@@ -19,17 +21,31 @@ Expected<ExtractionResponse>
 AgentRuntime::process_extraction_request(const ActiveRequest& request) {
     auto start_time = std::chrono::steady_clock::now();
 
-    // Normalize schema and build GBNF grammar
-    auto params = tools::detail::normalize_schema(request.extraction_schema->value());
-    if (!params) {
-        return std::unexpected(Error{ErrorCode::InvalidOutputSchema, params.error().message});
+    // Normalize schema and build GBNF grammar, or reuse an earlier compilation
+    auto compiled = tools::SchemaGrammarCache::shared().get(request.extraction_schema->value());
+    if (!compiled) {
+        return std::unexpected(compiled.error());
     }
-
-    std::string grammar_str = tools::GrammarBuilder::build_schema(*params);
+    const auto& params = (*compiled)->parameters;
+    const std::string& grammar_str = (*compiled)->grammar;
+    // Keys and separators the grammar fixes are decoded in batches rather
+    // than sampled one token at a time, and inside string and number values
+    // most tokens are admitted by a precomputed mask instead of the grammar.
+    // Each callback sees its own growing text and keeps its own scan, so a
+    // step only scans the bytes generated since the previous one.
+    ForcedContinuation jump_forward = [schema = *compiled, scan = tools::SchemaJumpForward::Scan{}](
+                                          std::string_view generated) mutable {
+        return schema->jump_forward.forced_continuation(generated, scan);
+    };
+    FreeTextProbe free_text = [schema = *compiled, scan = tools::SchemaJumpForward::Scan{}](
+                                  std::string_view generated) mutable {
+        return schema->jump_forward.free_text(generated, scan);
+    };
 
     auto history_scope =
         RequestHistoryScope::enter(*backend_, request.history_mode, *request.messages,
-                                   agent_config_.max_history_messages, "extraction");
+                                   agent_config_.max_history_messages, "extraction",
+                                   agent_config_.max_history_tokens);
     if (!history_scope) {
         return std::unexpected(history_scope.error());
     }
@@ -37,56 +53,93 @@ AgentRuntime::process_extraction_request(const ActiveRequest& request) {
     // Set schema grammar, restore previous tool calling state on exit
     const bool had_tool_calling = tool_grammar_active_.load(std::memory_order_acquire);
 
-    auto grammar_override =
-        ScopedGrammarOverride::activate(*backend_, grammar_str, [this, had_tool_calling] {
-            if (had_tool_calling) {
-                refresh_tool_calling_state();
-            } else {
-                backend_->clear_tool_grammar();
-                tool_grammar_active_.store(false, std::memory_order_release);
-            }
-        });
+    auto restore_tool_calling = [this, had_tool_calling] {
+        if (had_tool_calling) {
+            refresh_tool_calling_state();
+        } else {
+            backend_->clear_tool_grammar();
+            tool_grammar_active_.store(false, std::memory_order_release);
+        }
+    };
+    auto grammar_override = ScopedGrammarOverride::activate(
+        *backend_, grammar_str, std::move(jump_forward), std::move(free_text),
+        std::move(restore_tool_calling));
     if (!grammar_override) {
         return std::unexpected(grammar_override.error());
     }
 
+    // Top-level fields are parsed as pieces arrive, so the field callback sees
+    // each one as soon as it is complete and can stop generation early.
+    tools::JsonFieldStream fields;
+    bool stopped_by_field = false;
+    const ExtractionFieldCallback* on_field =
+        request.field_callback != nullptr && *request.field_callback ? request.field_callback
+                                                                     : nullptr;
+    auto observe_piece = [&](std::string_view piece) {
+        return fields.feed(piece, [&](std::string_view field, const nlohmann::json& value) {
+            if (on_field == nullptr || (*on_field)(field, value) == TokenAction::Continue) {
+                return TokenAction::Continue;
+            }
+            stopped_by_field = true;
+            return TokenAction::Stop;
+        });
+    };
+
     GenerationStats stats(start_time);
     GenerationRunner generation_runner(*backend_, callback_dispatcher_);
     auto cancellation_check = [&request]() {
         return request.cancelled && request.cancelled->load(std::memory_order_acquire);
     };
     auto pass = generation_runner.run(*request.options, request.streaming_callback,
-                                      CancellationCallback(cancellation_check), stats);
+                                      CancellationCallback(cancellation_check), stats,
+                                      request.prepared_prompt, TokenCallback(observe_piece));
     if (!pass) {
         return std::unexpected(pass.error());
     }
     auto generated = std::move(pass->generation);
 
-    // Parse and validate extracted JSON
-    nlohmann::json extracted;
-    try {
-        extracted = nlohmann::json::parse(generated.text);
-    } catch (const nlohmann::json::parse_error& e) {
-        return std::unexpected(
-            Error{ErrorCode::ExtractionFailed,
-                  std::string("Failed to parse extraction output as JSON: ") + e.what()});
+    // The streamed pieces are a prefix of the final text; parse whatever was
+    // not streamed. Should they ever diverge, parse the final text afresh.
+    if (!stopped_by_field) {
+        if (std::string_view(generated.text).starts_with(fields.consumed())) {
+            observe_piece(std::string_view(generated.text).substr(fields.consumed().size()));
+        } else {
+            fields = tools::JsonFieldStream{};
+            (void)fields.feed(generated.text, [](std::string_view, const nlohmann::json&) {
+                return TokenAction::Continue;
+            });
+        }
     }
 
-    if (auto validation = tools::validate_json_against_schema(extracted, *params); !validation) {
-        return std::unexpected(
-            Error{ErrorCode::ExtractionFailed,
-                  "Extracted JSON failed schema validation: " + validation.error().message});
+    if (!stopped_by_field) {
+        if (!fields.complete()) {
+            const std::string reason =
+                fields.failed() ? fields.error() : std::string("unexpected end of output");
+            return std::unexpected(Error{
+                ErrorCode::ExtractionFailed, "Failed to parse extraction output as JSON: " + reason});
+        }
+        if (auto validation = tools::validate_json_against_schema(fields.object(), params);
+            !validation) {
+            return std::unexpected(
+                Error{ErrorCode::ExtractionFailed,
+                      "Extracted JSON failed schema validation: " + validation.error().message});
+        }
     }
 
-    // Commit the assistant response to history
-    backend_->add_message(Message::assistant(generated.text).view());
-    backend_->finalize_response();
+    // Commit the assistant response to history. Output cut short by the field
+    // callback is not valid JSON, so a stopped request leaves no turn behind.
+    if (stopped_by_field) {
+        history_scope->discard();
+    } else {
+        backend_->add_message(Message::assistant(generated.text).view());
+    }
 
     auto end_time = std::chrono::steady_clock::now();
 
     ExtractionResponse response;
     response.text = std::move(generated.text);
-    response.data = std::move(extracted);
+    response.data = fields.take_object();
+    response.partial = stopped_by_field;
     response.usage = stats.usage();
     response.metrics = stats.metrics(end_time);
 
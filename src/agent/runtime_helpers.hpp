@@ -53,8 +53,10 @@ class ScopedGrammarOverride {
   public:
     static Expected<ScopedGrammarOverride> activate(AgentBackend& backend,
                                                     const std::string& grammar,
+                                                    ForcedContinuation forced,
+                                                    FreeTextProbe free_text,
                                                     std::function<void()> restore_callback) {
-        if (!backend.set_schema_grammar(grammar)) {
+        if (!backend.set_schema_grammar(grammar, std::move(forced), std::move(free_text))) {
             return std::unexpected(
                 Error{ErrorCode::ExtractionFailed, "Failed to initialize schema grammar"});
         }
@@ -90,8 +92,9 @@ class RequestHistoryScope {
     static Expected<RequestHistoryScope> enter(AgentBackend& backend, HistoryMode mode,
                                                const std::vector<Message>& messages,
                                                size_t max_retained_messages,
-                                               std::string_view stateful_request_name) {
-        RequestHistoryScope scope(backend, mode, max_retained_messages);
+                                               std::string_view stateful_request_name,
+                                               size_t max_retained_tokens = 0) {
+        RequestHistoryScope scope(backend, mode, max_retained_messages, max_retained_tokens);
         if (mode == HistoryMode::Replace) {
             scope.original_history_ = swap_history(backend, messages);
             scope.active_ = true;
@@ -119,7 +122,8 @@ class RequestHistoryScope {
         : backend_(std::exchange(other.backend_, nullptr)), mode_(other.mode_),
           original_history_(std::move(other.original_history_)),
           max_retained_messages_(other.max_retained_messages_),
-          active_(std::exchange(other.active_, false)) {}
+          max_retained_tokens_(other.max_retained_tokens_),
+          active_(std::exchange(other.active_, false)), discard_(other.discard_) {}
 
     RequestHistoryScope& operator=(RequestHistoryScope&& other) noexcept {
         if (this == &other) {
@@ -130,7 +134,9 @@ class RequestHistoryScope {
         mode_ = other.mode_;
         original_history_ = std::move(other.original_history_);
         max_retained_messages_ = other.max_retained_messages_;
+        max_retained_tokens_ = other.max_retained_tokens_;
         active_ = std::exchange(other.active_, false);
+        discard_ = other.discard_;
         return *this;
     }
 
@@ -138,9 +144,17 @@ class RequestHistoryScope {
         close();
     }
 
+    /// Leaves history as it was before the request: on exit, a stateful
+    /// request's own message is removed again.
+    void discard() noexcept {
+        discard_ = true;
+    }
+
   private:
-    RequestHistoryScope(AgentBackend& backend, HistoryMode mode, size_t max_retained_messages)
-        : backend_(&backend), mode_(mode), max_retained_messages_(max_retained_messages) {}
+    RequestHistoryScope(AgentBackend& backend, HistoryMode mode, size_t max_retained_messages,
+                        size_t max_retained_tokens)
+        : backend_(&backend), mode_(mode), max_retained_messages_(max_retained_messages),
+          max_retained_tokens_(max_retained_tokens) {}
 
     void close() {
         if (!active_ || backend_ == nullptr) {
@@ -149,8 +163,17 @@ class RequestHistoryScope {
         active_ = false;
         if (mode_ == HistoryMode::Replace) {
             backend_->swap_history(std::move(*original_history_));
+        } else if (discard_) {
+            auto history = backend_->get_history();
+            if (!history.empty()) {
+                history.messages.pop_back();
+                backend_->replace_history(std::move(history));
+            }
         } else {
             backend_->trim_history(max_retained_messages_);
+            if (max_retained_tokens_ > 0) {
+                backend_->trim_history_to_tokens(max_retained_tokens_);
+            }
         }
     }
 
@@ -158,7 +181,9 @@ class RequestHistoryScope {
     HistoryMode mode_;
     std::optional<HistorySnapshot> original_history_;
     size_t max_retained_messages_;
+    size_t max_retained_tokens_;
     bool active_ = false;
+    bool discard_ = false;
 };
 
 /// Aggregates token usage and latency across one or more generation passes.
@@ -187,6 +212,15 @@ class GenerationStats {
         completion_tokens_ += completion_tokens;
     }
 
+    void record_speculation(int proposed, int accepted) {
+        draft_tokens_proposed_ += proposed;
+        draft_tokens_accepted_ += accepted;
+    }
+
+    void record_forced_tokens(int forced) {
+        forced_tokens_ += forced;
+    }
+
     [[nodiscard]] TokenUsage usage() const {
         return TokenUsage{
             prompt_tokens_,
@@ -208,6 +242,13 @@ class GenerationStats {
                 result.tokens_per_second = (completion_tokens_ * 1000.0) / generation_ms.count();
             }
         }
+        result.draft_tokens_proposed = draft_tokens_proposed_;
+        result.draft_tokens_accepted = draft_tokens_accepted_;
+        if (draft_tokens_proposed_ > 0) {
+            result.draft_acceptance_rate =
+                static_cast<double>(draft_tokens_accepted_) / draft_tokens_proposed_;
+        }
+        result.forced_tokens = forced_tokens_;
         return result;
     }
 
@@ -218,6 +259,9 @@ class GenerationStats {
     std::chrono::steady_clock::duration generation_time_after_first_token_{};
     int prompt_tokens_ = 0;
     int completion_tokens_ = 0;
+    int draft_tokens_proposed_ = 0;
+    int draft_tokens_accepted_ = 0;
+    int forced_tokens_ = 0;
 };
 
 struct GenerationPassResult {
@@ -231,9 +275,14 @@ class GenerationRunner {
     GenerationRunner(AgentBackend& backend, CallbackDispatcher& callback_dispatcher)
         : backend_(backend), callback_dispatcher_(callback_dispatcher) {}
 
+    /// `prepared_prompt`, when set, must match the backend's current history.
+    /// `observe_piece`, when set, sees each piece on the inference thread after
+    /// the streaming callback and may also stop generation.
     Expected<GenerationPassResult> run(const GenerationOptions& options,
                                        AsyncTokenCallback* streaming_callback,
-                                       CancellationCallback should_cancel, GenerationStats& stats) {
+                                       CancellationCallback should_cancel, GenerationStats& stats,
+                                       const std::vector<int>* prepared_prompt = nullptr,
+                                       TokenCallback observe_piece = {}) {
         int completion_tokens = 0;
         const auto generation_start_time = std::chrono::steady_clock::now();
         std::chrono::steady_clock::time_point first_token_time_this_pass;
@@ -244,6 +293,9 @@ class GenerationRunner {
             if (streaming_callback != nullptr && *streaming_callback) {
                 action = callback_dispatcher_.dispatch(*streaming_callback, token);
             }
+            if (action == TokenAction::Continue && observe_piece) {
+                action = observe_piece(token);
+            }
             if (!first_token_received_this_pass) {
                 first_token_time_this_pass = std::chrono::steady_clock::now();
                 first_token_received_this_pass = true;
@@ -252,8 +304,12 @@ class GenerationRunner {
             return action;
         };
 
-        auto generated =
-            backend_.generate_from_history(options, TokenCallback(callback), should_cancel);
+        auto generated = prepared_prompt != nullptr
+                             ? backend_.generate_from_prepared(*prepared_prompt, options,
+                                                               TokenCallback(callback),
+                                                               should_cancel)
+                             : backend_.generate_from_history(options, TokenCallback(callback),
+                                                              should_cancel);
         callback_dispatcher_.drain();
         if (!generated) {
             return std::unexpected(generated.error());
@@ -262,6 +318,9 @@ class GenerationRunner {
         stats.record_pass(generation_start_time, std::chrono::steady_clock::now(),
                           first_token_received_this_pass, first_token_time_this_pass,
                           generated->prompt_tokens, completion_tokens);
+        stats.record_speculation(generated->draft_tokens_proposed,
+                                 generated->draft_tokens_accepted);
+        stats.record_forced_tokens(generated->forced_tokens);
         return GenerationPassResult{std::move(*generated), completion_tokens};
     }
 
@@ -22,7 +22,7 @@ namespace {
 
 class ToolLoopController {
   public:
-    ToolLoopController(AgentBackend& backend, const tools::ToolRegistry& tool_registry,
+    ToolLoopController(AgentBackend& backend, tools::ToolRegistry& tool_registry,
                        ToolExecutor& tool_executor, CallbackDispatcher& callback_dispatcher,
                        const AgentConfig& agent_config, bool use_native_tool_calling)
         : backend_(backend), tool_registry_(tool_registry), tool_executor_(tool_executor),
@@ -41,18 +41,22 @@ class ToolLoopController {
             }
 
             auto cancellation_check = [&request]() { return is_cancelled(request); };
-            auto pass = generation_runner.run(*request.options, request.streaming_callback,
-                                              CancellationCallback(cancellation_check), stats);
+            // A prepared prompt only matches the history before the first pass.
+            auto pass = generation_runner.run(
+                *request.options, request.streaming_callback,
+                CancellationCallback(cancellation_check), stats,
+                iteration == 1 ? request.prepared_prompt : nullptr);
             if (!pass) {
                 return std::unexpected(pass.error());
             }
 
-            ToolDetection detection = detect_tool_call(std::move(pass->generation));
-            if (detection.tool_call.has_value()) {
+            ToolDetection detection = detect_tool_calls(std::move(pass->generation));
+            if (!detection.tool_calls.empty()) {
                 auto tool_result =
-                    handle_tool_call(*detection.tool_call, std::move(detection.response_text),
-                                     std::move(detection.structured_tool_calls), iteration,
-                                     request.options->record_tool_trace);
+                    handle_tool_calls(request, detection.tool_calls,
+                                      std::move(detection.response_text),
+                                      std::move(detection.structured_tool_calls), iteration,
+                                      request.options->record_tool_trace);
                 if (!tool_result) {
                     return std::unexpected(tool_result.error());
                 }
@@ -80,7 +84,7 @@ class ToolLoopController {
 
   private:
     struct ToolDetection {
-        std::optional<tools::ToolCall> tool_call;
+        std::vector<tools::ToolCall> tool_calls;
         std::string response_text;
         std::vector<ToolCallInfo> structured_tool_calls;
     };
@@ -89,7 +93,7 @@ class ToolLoopController {
         return request.cancelled && request.cancelled->load(std::memory_order_acquire);
     }
 
-    ToolDetection detect_tool_call(GenerationResult generated) const {
+    ToolDetection detect_tool_calls(GenerationResult generated) const {
         ToolDetection detection;
         if (!use_native_tool_calling_ || !generated.tool_call_detected) {
             detection.response_text = std::move(generated.text);
@@ -105,51 +109,116 @@ class ToolLoopController {
             detection.structured_tool_calls = std::move(parsed.tool_calls);
         }
 
-        if (detection.structured_tool_calls.empty()) {
-            return detection;
-        }
-
-        const auto& first_tc = detection.structured_tool_calls.front();
-        tools::ToolCall tool_call;
-        tool_call.id = first_tc.id;
-        tool_call.name = first_tc.name;
-        try {
-            tool_call.arguments = nlohmann::json::parse(first_tc.arguments_json);
-        } catch (const nlohmann::json::exception&) {
-            tool_call.arguments = nlohmann::json::object();
+        detection.tool_calls.reserve(detection.structured_tool_calls.size());
+        for (const auto& info : detection.structured_tool_calls) {
+            tools::ToolCall tool_call;
+            tool_call.id = info.id;
+            tool_call.name = info.name;
+            try {
+                tool_call.arguments = nlohmann::json::parse(info.arguments_json);
+            } catch (const nlohmann::json::exception&) {
+                tool_call.arguments = nlohmann::json::object();
+            }
+            detection.tool_calls.push_back(std::move(tool_call));
         }
-        detection.tool_call = std::move(tool_call);
         return detection;
     }
 
-    Expected<void> handle_tool_call(const tools::ToolCall& tool_call, std::string response_text,
-                                    std::vector<ToolCallInfo> structured_tool_calls, int iteration,
-                                    bool record_tool_trace) {
-        if (!structured_tool_calls.empty()) {
-            backend_.add_message(
-                Message::assistant_with_tool_calls(response_text, structured_tool_calls).view());
-        } else {
-            backend_.add_message(Message::assistant(response_text).view());
+    // Validates every call of the turn first, so an exhausted retry budget fails
+    // the turn before any handler runs. Valid calls then run concurrently on the
+    // executor, overlapped with the prefill of the assistant turn, and their
+    // results are appended in call order.
+    Expected<void> handle_tool_calls(const ActiveRequest& request,
+                                     const std::vector<tools::ToolCall>& tool_calls,
+                                     std::string response_text,
+                                     std::vector<ToolCallInfo> structured_tool_calls,
+                                     int iteration, bool record_tool_trace) {
+        backend_.add_message(
+            Message::assistant_with_tool_calls(response_text, structured_tool_calls).view());
+
+        std::vector<std::optional<Error>> validation_errors(tool_calls.size());
+        for (size_t index = 0; index < tool_calls.size(); ++index) {
+            const auto& tool_call = tool_calls[index];
+            auto validation_result = validator_.validate(tool_call, tool_registry_);
+            if (validation_result) {
+                continue;
+            }
+            if (auto budget = consume_retry(tool_call.name, validation_result.error()); !budget) {
+                return budget;
+            }
+            validation_errors[index] = std::move(validation_result.error());
+        }
+
+        std::vector<std::optional<PendingToolCall>> pending(tool_calls.size());
+        std::vector<std::optional<nlohmann::json>> cached(tool_calls.size());
+        for (size_t index = 0; index < tool_calls.size(); ++index) {
+            if (validation_errors[index]) {
+                continue;
+            }
+            const auto& tool_call = tool_calls[index];
+            cached[index] = tool_registry_.find_cached_result(tool_call.name, tool_call.arguments);
+            if (cached[index]) {
+                ZOO_LOG("info", "tool '%s' served from cache (iteration %d, call %zu/%zu)",
+                        tool_call.name.c_str(), iteration, index + 1, tool_calls.size());
+                continue;
+            }
+            auto handler = tool_registry_.find_handler(tool_call.name);
+            if (!handler) {
+                continue;
+            }
+            ZOO_LOG("info", "invoking tool '%s' (iteration %d, call %zu/%zu, native_tc=%d)",
+                    tool_call.name.c_str(), iteration, index + 1, tool_calls.size(),
+                    use_native_tool_calling_);
+            pending[index] = tool_executor_.submit(
+                tool_call.name, std::move(*handler), tool_call.arguments,
+                tool_registry_.get_execution_policy(tool_call.name).value_or(
+                    tools::ToolExecutionPolicy{}));
         }
-        backend_.finalize_response();
-
-        std::string args_json = structured_tool_calls.empty()
-                                    ? tool_call.arguments.dump()
-                                    : structured_tool_calls.front().arguments_json;
-        if (auto validation_result = validator_.validate(tool_call, tool_registry_);
-            !validation_result) {
-            return handle_validation_failure(tool_call, std::move(args_json),
-                                             validation_result.error(), record_tool_trace);
+
+        // Prefill the assistant turn and the framing of the first tool result
+        // while the handlers run, leaving only the results for the next pass.
+        auto cancellation_check = [&request]() { return is_cancelled(request); };
+        if (auto prefilled = backend_.prefill_history(Role::Tool, tool_calls.front().id,
+                                                      CancellationCallback(cancellation_check));
+            !prefilled) {
+            ZOO_LOG("debug", "tool-turn prefill skipped: %s", prefilled.error().message.c_str());
         }
 
-        ZOO_LOG("info", "invoking tool '%s' (iteration %d, native_tc=%d)", tool_call.name.c_str(),
-                iteration, use_native_tool_calling_);
-        auto handler = tool_registry_.find_handler(tool_call.name);
-        Expected<nlohmann::json> invoke_result =
-            handler ? tool_executor_.submit(std::move(*handler), tool_call.arguments).get()
-                    : std::unexpected(
-                          Error{ErrorCode::ToolNotFound, "Tool not found: " + tool_call.name});
+        for (size_t index = 0; index < tool_calls.size(); ++index) {
+            const auto& tool_call = tool_calls[index];
+            std::string args_json = structured_tool_calls[index].arguments_json;
+            if (validation_errors[index]) {
+                append_validation_failure(tool_call, std::move(args_json),
+                                          std::move(*validation_errors[index]), record_tool_trace);
+                continue;
+            }
+
+            if (cached[index]) {
+                append_tool_result(tool_call, std::move(args_json), std::move(*cached[index]),
+                                   record_tool_trace, true);
+                continue;
+            }
+
+            Expected<nlohmann::json> invoke_result =
+                pending[index] ? pending[index]->get()
+                               : std::unexpected(Error{ErrorCode::ToolNotFound,
+                                                       "Tool not found: " + tool_call.name});
+            if (invoke_result) {
+                tool_registry_.store_cached_result(tool_call.name, tool_call.arguments,
+                                                   *invoke_result);
+            }
+            append_tool_result(tool_call, std::move(args_json), std::move(invoke_result),
+                               record_tool_trace);
+        }
+
+        tool_invoked_ = true;
+        callback_dispatcher_.drain();
+        return {};
+    }
 
+    void append_tool_result(const tools::ToolCall& tool_call, std::string args_json,
+                            Expected<nlohmann::json> invoke_result, bool record_tool_trace,
+                            bool cached = false) {
         std::string tool_result_str;
         std::optional<std::string> result_json;
         std::optional<Error> tool_error;
@@ -164,43 +233,41 @@ class ToolLoopController {
         }
 
         backend_.add_message(Message::tool(std::move(tool_result_str), tool_call.id).view());
-        tool_invoked_ = true;
         if (record_tool_trace) {
             tool_invocations_.push_back(
                 ToolInvocation{tool_call.id, tool_call.name, std::move(args_json), status,
-                               std::move(result_json), std::move(tool_error)});
+                               std::move(result_json), std::move(tool_error), cached});
         }
-        callback_dispatcher_.drain();
-        return {};
     }
 
-    Expected<void> handle_validation_failure(const tools::ToolCall& tool_call,
-                                             std::string args_json, Error validation_error,
-                                             bool record_tool_trace) {
-        int& retry_count = retry_count_for(tool_call.name);
+    Expected<void> consume_retry(const std::string& tool_name, const Error& validation_error) {
+        int& retry_count = retry_count_for(tool_name);
         if (retry_count >= agent_config_.max_tool_retries) {
-            ZOO_LOG("error", "tool retries exhausted for '%s': %s", tool_call.name.c_str(),
+            ZOO_LOG("error", "tool retries exhausted for '%s': %s", tool_name.c_str(),
                     validation_error.message.c_str());
             return std::unexpected(Error{ErrorCode::ToolRetriesExhausted,
-                                         "Tool retries exhausted for '" + tool_call.name +
+                                         "Tool retries exhausted for '" + tool_name +
                                              "': " + validation_error.message});
         }
 
         ++retry_count;
-        ZOO_LOG("warn", "tool '%s' validation failed (retry %d/%d): %s", tool_call.name.c_str(),
+        ZOO_LOG("warn", "tool '%s' validation failed (retry %d/%d): %s", tool_name.c_str(),
                 retry_count, agent_config_.max_tool_retries, validation_error.message.c_str());
+        return {};
+    }
 
+    void append_validation_failure(const tools::ToolCall& tool_call, std::string args_json,
+                                   Error validation_error, bool record_tool_trace) {
         std::string error_content = "Error: " + validation_error.message;
         backend_.add_message(
             Message::tool(error_content + "\nPlease correct the arguments.", tool_call.id).view());
-        tool_invoked_ = true;
         if (record_tool_trace) {
-            tool_invocations_.push_back(ToolInvocation{
-                tool_call.id, tool_call.name, std::move(args_json),
-                ToolInvocationStatus::ValidationFailed, std::nullopt, std::move(validation_error)});
+            tool_invocations_.push_back(ToolInvocation{tool_call.id, tool_call.name,
+                                                       std::move(args_json),
+                                                       ToolInvocationStatus::ValidationFailed,
+                                                       std::nullopt, std::move(validation_error),
+                                                       false});
         }
-        callback_dispatcher_.drain();
-        return {};
     }
 
     int& retry_count_for(std::string_view tool_name) {
@@ -218,7 +285,6 @@ class ToolLoopController {
         const auto end_time = std::chrono::steady_clock::now();
 
         backend_.add_message(Message::assistant(response_text).view());
-        backend_.finalize_response();
         callback_dispatcher_.drain();
 
         TextResponse response;
@@ -232,7 +298,7 @@ class ToolLoopController {
     }
 
     AgentBackend& backend_;
-    const tools::ToolRegistry& tool_registry_;
+    tools::ToolRegistry& tool_registry_;
     ToolExecutor& tool_executor_;
     CallbackDispatcher& callback_dispatcher_;
     const AgentConfig& agent_config_;
@@ -248,18 +314,37 @@ class ToolLoopController {
 void AgentRuntime::inference_loop() {
     try {
         while (running_.load(std::memory_order_acquire)) {
+            if (batch_running()) {
+                step_batched_requests(true);
+                continue;
+            }
+            if (deferred_request_) {
+                handle_request(*std::exchange(deferred_request_, std::nullopt));
+                continue;
+            }
+
             auto item_opt = request_mailbox_.pop();
             if (!item_opt) {
                 break;
             }
 
             std::visit(overloaded{
-                           [this](QueuedRequest request) { handle_request(request); },
+                           [this](QueuedRequest request) {
+                               if (!start_batched_request(request)) {
+                                   handle_request(request);
+                               }
+                           },
                            [this](Command& cmd) { handle_command(cmd); },
                        },
                        *item_opt);
         }
 
+        // Like a request already running on the main session, requests that
+        // are decoding on lanes finish; queued ones fail below.
+        while (batch_running()) {
+            step_batched_requests(false);
+        }
+
         fail_pending(
             Error{ErrorCode::AgentNotRunning, "Agent stopped before request could be processed"});
     } catch (const std::exception& e) {
@@ -278,13 +363,12 @@ void AgentRuntime::handle_request(QueuedRequest request) {
         return;
     }
 
-    if (active_request->cancelled && active_request->cancelled->load(std::memory_order_acquire)) {
-        request_slots_->resolve_error(
-            request.slot, request.generation,
-            Error{ErrorCode::RequestCancelled, "Request cancelled before processing"});
+    const auto now = QueuedRequest::Clock::now();
+    if (resolve_stale_request(request, *active_request, now)) {
         return;
     }
 
+    request_mailbox_.begin_service(now);
     try {
         if (active_request->result_kind == ResultKind::Extraction) {
             request_slots_->resolve_extraction(request.slot, request.generation,
@@ -304,6 +388,25 @@ void AgentRuntime::handle_request(QueuedRequest request) {
             request.slot, request.generation,
             Error{ErrorCode::InferenceFailed, "Unknown exception in inference thread"});
     }
+    request_mailbox_.end_service();
+}
+
+bool AgentRuntime::resolve_stale_request(const QueuedRequest& request, const ActiveRequest& active,
+                                         QueuedRequest::Clock::time_point now) {
+    if (active.cancelled && active.cancelled->load(std::memory_order_acquire)) {
+        request_slots_->resolve_error(
+            request.slot, request.generation,
+            Error{ErrorCode::RequestCancelled, "Request cancelled before processing"});
+        return true;
+    }
+
+    if (request.expired(now)) {
+        request_slots_->resolve_error(
+            request.slot, request.generation,
+            Error{ErrorCode::RequestTimeout, "Request deadline passed before processing"});
+        return true;
+    }
+    return false;
 }
 
 Expected<TextResponse> AgentRuntime::process_request(const ActiveRequest& request) {
@@ -311,7 +414,8 @@ Expected<TextResponse> AgentRuntime::process_request(const ActiveRequest& reques
 
     auto history_scope =
         RequestHistoryScope::enter(*backend_, request.history_mode, *request.messages,
-                                   agent_config_.max_history_messages, "chat");
+                                   agent_config_.max_history_messages, "chat",
+                                   agent_config_.max_history_tokens);
     if (!history_scope) {
         return std::unexpected(history_scope.error());
     }
@@ -5,6 +5,7 @@
 
 #include "agent/runtime.hpp"
 
+#include "log.hpp"
 #include <thread>
 #include <utility>
 
@@ -16,7 +17,17 @@ AgentRuntime::AgentRuntime(ModelConfig model_config, AgentConfig agent_config,
     : model_config_(std::move(model_config)), agent_config_(agent_config),
       default_generation_options_(std::move(default_generation)), backend_(std::move(backend)),
       request_slots_(std::make_shared<RequestSlots>(agent_config_.request_queue_capacity)),
-      request_mailbox_() {
+      request_mailbox_(), callback_dispatcher_(streaming_options(agent_config_)),
+      tool_executor_(agent_config_.tool_workers), prompt_preparer_(*backend_, request_slots_) {
+    if (agent_config_.batch_sequences > 1) {
+        auto lanes = backend_->open_batch_lanes(agent_config_.batch_sequences);
+        if (lanes) {
+            batch_lanes_ = std::move(*lanes);
+            batched_requests_.resize(batch_lanes_->size());
+        } else {
+            ZOO_LOG("warn", "continuous batching disabled: %s", lanes.error().message.c_str());
+        }
+    }
     inference_thread_ = std::thread([this]() { inference_loop(); });
 }
 
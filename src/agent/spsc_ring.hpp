@@ -0,0 +1,124 @@
+/**
+ * @file spsc_ring.hpp
+ * @brief Lock-free single-producer/single-consumer byte ring.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace zoo::internal::agent {
+
+/**
+ * @brief Fixed-capacity byte ring shared by exactly one producer and one consumer thread.
+ *
+ * Storage is allocated once. Positions grow monotonically and are masked into
+ * the power-of-two buffer, so a write copies bytes and publishes them with one
+ * release store. Either side sleeps on the other's position with
+ * `std::atomic::wait` instead of a mutex when the ring is full or empty.
+ */
+class SpscByteRing {
+  public:
+    explicit SpscByteRing(size_t capacity)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 64))),
+          storage_(std::make_unique<char[]>(capacity_)) {}
+
+    SpscByteRing(const SpscByteRing&) = delete;
+    SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+    [[nodiscard]] size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+    // Producer side.
+
+    /// Blocks until `bytes` (at most `capacity()`) can be written.
+    void wait_writable(size_t bytes) const noexcept {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        while (capacity_ - (head - tail) < bytes) {
+            tail_.wait(tail, std::memory_order_acquire);
+            tail = tail_.load(std::memory_order_acquire);
+        }
+    }
+
+    /// Copies `parts` in order and publishes them together. The caller must
+    /// have made room with `wait_writable()`.
+    template <typename... Parts> void write(const Parts&... parts) noexcept {
+        size_t head = head_.load(std::memory_order_relaxed);
+        ((copy_in(head, parts.data(), parts.size()), head += parts.size()), ...);
+        head_.store(head, std::memory_order_release);
+        head_.notify_one();
+    }
+
+    /// Blocks until every written byte has been consumed.
+    void wait_empty() const noexcept {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        while (tail != head) {
+            tail_.wait(tail, std::memory_order_acquire);
+            tail = tail_.load(std::memory_order_acquire);
+        }
+    }
+
+    // Consumer side.
+
+    /// Blocks until at least one byte is readable.
+    void wait_readable() const noexcept {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        head_.wait(tail, std::memory_order_acquire);
+    }
+
+    /// Copies `size` bytes starting `offset` bytes past the read position.
+    void read(size_t offset, void* destination, size_t size) const noexcept {
+        const size_t start = tail_.load(std::memory_order_relaxed) + offset;
+        const size_t first = std::min(size, capacity_ - (start & (capacity_ - 1)));
+        std::memcpy(destination, storage_.get() + (start & (capacity_ - 1)), first);
+        std::memcpy(static_cast<char*>(destination) + first, storage_.get(), size - first);
+    }
+
+    /// Views `size` bytes starting `offset` bytes past the read position, in
+    /// place when they do not wrap and through `scratch` otherwise.
+    [[nodiscard]] std::string_view view(size_t offset, size_t size, std::string& scratch) const {
+        const size_t start = (tail_.load(std::memory_order_relaxed) + offset) & (capacity_ - 1);
+        if (start + size <= capacity_) {
+            return {storage_.get() + start, size};
+        }
+        scratch.resize(size);
+        read(offset, scratch.data(), size);
+        return scratch;
+    }
+
+    /// Releases `size` bytes back to the producer.
+    void consume(size_t size) noexcept {
+        tail_.store(tail_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+        tail_.notify_one();
+    }
+
+  private:
+    void copy_in(size_t position, const void* source, size_t size) noexcept {
+        if (size == 0) {
+            return;
+        }
+        const size_t start = position & (capacity_ - 1);
+        const size_t first = std::min(size, capacity_ - start);
+        std::memcpy(storage_.get() + start, source, first);
+        std::memcpy(storage_.get(), static_cast<const char*>(source) + first, size - first);
+    }
+
+    const size_t capacity_;
+    std::unique_ptr<char[]> storage_;
+    // Written by the producer only.
+    alignas(64) std::atomic<size_t> head_{0};
+    // Written by the consumer only.
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace zoo::internal::agent
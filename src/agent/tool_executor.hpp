@@ -1,6 +1,6 @@
 /**
  * @file tool_executor.hpp
- * @brief Offloads tool handler invocations to a dedicated worker thread.
+ * @brief Offloads tool handler invocations to a pool of worker threads.
  */
 
 #pragma once
@@ -9,38 +9,83 @@
 #include "zoo/core/types.hpp"
 #include "zoo/tools/types.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <future>
 #include <mutex>
 #include <nlohmann/json.hpp>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace zoo::internal::agent {
 
 /**
- * @brief Executes tool handlers on a dedicated worker thread.
- *
- * The inference thread calls submit() to hand off a handler invocation and
- * then blocks on the returned future. This keeps arbitrary user-supplied tool
- * code off the inference thread while preserving sequential tool-loop semantics.
+ * @brief One submitted tool invocation whose result is bounded by the tool's timeout.
+ */
+struct PendingToolCall {
+    using Clock = std::chrono::steady_clock;
+
+    std::future<Expected<nlohmann::json>> future;
+    std::string tool_name;
+    std::chrono::milliseconds timeout{0};
+    Clock::time_point deadline = Clock::time_point::max();
+
+    /// Builds the error reported when `tool_name` does not finish within `timeout`.
+    [[nodiscard]] static Error timeout_error(const std::string& tool_name,
+                                             std::chrono::milliseconds timeout) {
+        return Error{ErrorCode::ToolExecutionFailed, "Tool '" + tool_name + "' timed out after " +
+                                                         std::to_string(timeout.count()) + "ms"};
+    }
+
+    /**
+     * @brief Blocks until the handler returns or the deadline passes.
+     *
+     * A timed-out handler is not interrupted; it keeps its worker until it
+     * returns and its result is discarded.
+     */
+    [[nodiscard]] Expected<nlohmann::json> get() {
+        if (deadline != Clock::time_point::max() &&
+            future.wait_until(deadline) == std::future_status::timeout) {
+            return std::unexpected(timeout_error(tool_name, timeout));
+        }
+        return future.get();
+    }
+};
+
+/**
+ * @brief Executes tool handlers on a fixed pool of worker threads.
  *
- * MVP: thread isolation only. The inference thread still blocks on the future,
- * so a slow handler delays the tool loop but does not block the command lane.
- * TODO(tool-timeouts): add per-tool timeout/cancellation once basic isolation is validated.
+ * The inference thread submits every tool call of a turn, then collects the
+ * results in call order, so independent calls run concurrently. Jobs start in
+ * submission order, except that a job whose tool already has
+ * `ToolExecutionPolicy::max_concurrency` invocations running waits while later
+ * jobs for other tools go ahead. A job still queued when its timeout expires
+ * is resolved with the timeout error without running.
  */
 class ToolExecutor {
   public:
-    ToolExecutor() : thread_([this] { run(); }) {}
+    explicit ToolExecutor(size_t worker_count = 1) {
+        worker_count = std::max<size_t>(worker_count, 1);
+        workers_.reserve(worker_count);
+        for (size_t index = 0; index < worker_count; ++index) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
 
     ~ToolExecutor() {
         {
             std::lock_guard<std::mutex> lock(mutex_);
             shutdown_ = true;
         }
-        cv_.notify_one();
-        if (thread_.joinable()) {
-            thread_.join();
+        cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
         }
     }
 
@@ -49,74 +94,117 @@ class ToolExecutor {
     ToolExecutor(ToolExecutor&&) = delete;
     ToolExecutor& operator=(ToolExecutor&&) = delete;
 
+    /// Returns the number of worker threads.
+    [[nodiscard]] size_t worker_count() const noexcept {
+        return workers_.size();
+    }
+
     /**
-     * @brief Submits a tool handler for execution on the worker thread.
+     * @brief Submits a tool handler for execution on the pool.
      *
-     * Returns a future that resolves to the handler's return value. If called
-     * after shutdown, the future resolves immediately with AgentNotRunning.
+     * The returned call resolves to the handler's return value. If called
+     * after shutdown, it resolves immediately with AgentNotRunning.
      */
-    [[nodiscard]] std::future<Expected<nlohmann::json>> submit(tools::ToolHandler handler,
-                                                               nlohmann::json args) {
+    [[nodiscard]] PendingToolCall submit(std::string tool_name, tools::ToolHandler handler,
+                                         nlohmann::json args,
+                                         const tools::ToolExecutionPolicy& policy = {}) {
         auto promise = std::make_shared<std::promise<Expected<nlohmann::json>>>();
-        auto future = promise->get_future();
+        PendingToolCall pending{promise->get_future(), tool_name, policy.timeout};
+        if (policy.timeout.count() > 0) {
+            pending.deadline = PendingToolCall::Clock::now() + policy.timeout;
+        }
         {
             std::lock_guard<std::mutex> lock(mutex_);
             if (shutdown_) {
                 promise->set_value(std::unexpected(
                     Error{ErrorCode::AgentNotRunning, "Tool executor is shut down"}));
-                return future;
+                return pending;
             }
-            queue_.push(Job{std::move(handler), std::move(args), std::move(promise)});
+            queue_.push_back(Job{std::move(tool_name), std::move(handler), std::move(args),
+                                 policy, pending.deadline, std::move(promise)});
         }
         cv_.notify_one();
-        return future;
+        return pending;
     }
 
   private:
     struct Job {
+        std::string tool_name;
         tools::ToolHandler handler;
         nlohmann::json args;
+        tools::ToolExecutionPolicy policy;
+        PendingToolCall::Clock::time_point deadline;
         std::shared_ptr<std::promise<Expected<nlohmann::json>>> promise;
     };
 
+    // Returns the first job that may start now, or queue_.end(). Requires mutex_.
+    std::deque<Job>::iterator next_runnable(PendingToolCall::Clock::time_point now) {
+        return std::find_if(queue_.begin(), queue_.end(), [&](const Job& job) {
+            if (job.deadline <= now || job.policy.max_concurrency <= 0) {
+                return true;
+            }
+            auto it = in_flight_.find(job.tool_name);
+            return it == in_flight_.end() || it->second < job.policy.max_concurrency;
+        });
+    }
+
+    static Expected<nlohmann::json> invoke(const Job& job) {
+        try {
+            return job.handler(job.args);
+        } catch (const std::exception& e) {
+            ZOO_LOG("error", "tool handler threw: %s", e.what());
+            return std::unexpected(Error{ErrorCode::ToolExecutionFailed,
+                                         std::string("Tool handler threw: ") + e.what()});
+        } catch (...) {
+            ZOO_LOG("error", "tool handler threw unknown exception");
+            return std::unexpected(
+                Error{ErrorCode::ToolExecutionFailed, "Tool handler threw unknown exception"});
+        }
+    }
+
     void run() {
         std::unique_lock<std::mutex> lock(mutex_);
         while (true) {
-            cv_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
-
-            while (!queue_.empty()) {
-                auto job = std::move(queue_.front());
-                queue_.pop();
-                lock.unlock();
+            auto it = queue_.end();
+            cv_.wait(lock, [&] {
+                it = next_runnable(PendingToolCall::Clock::now());
+                return it != queue_.end() || (shutdown_ && queue_.empty());
+            });
+            if (it == queue_.end()) {
+                return;
+            }
 
-                Expected<nlohmann::json> result;
-                try {
-                    result = job.handler(job.args);
-                } catch (const std::exception& e) {
-                    ZOO_LOG("error", "tool handler threw: %s", e.what());
-                    result = std::unexpected(Error{ErrorCode::ToolExecutionFailed,
-                                                   std::string("Tool handler threw: ") + e.what()});
-                } catch (...) {
-                    ZOO_LOG("error", "tool handler threw unknown exception");
-                    result = std::unexpected(Error{ErrorCode::ToolExecutionFailed,
-                                                   "Tool handler threw unknown exception"});
-                }
-                job.promise->set_value(std::move(result));
+            Job job = std::move(*it);
+            queue_.erase(it);
 
+            if (job.deadline <= PendingToolCall::Clock::now()) {
+                lock.unlock();
+                job.promise->set_value(std::unexpected(
+                    PendingToolCall::timeout_error(job.tool_name, job.policy.timeout)));
                 lock.lock();
+                continue;
             }
 
-            if (shutdown_) {
-                return;
+            ++in_flight_[job.tool_name];
+            lock.unlock();
+
+            job.promise->set_value(invoke(job));
+
+            lock.lock();
+            if (--in_flight_[job.tool_name] == 0) {
+                in_flight_.erase(job.tool_name);
             }
+            // A finished job may unblock a queued call held back by its tool's limit.
+            cv_.notify_all();
         }
     }
 
     std::mutex mutex_;
     std::condition_variable cv_;
-    std::queue<Job> queue_;
+    std::deque<Job> queue_;
+    std::unordered_map<std::string, int> in_flight_;
     bool shutdown_ = false;
-    std::thread thread_;
+    std::vector<std::thread> workers_;
 };
 
 } // namespace zoo::internal::agent
@@ -6,7 +6,9 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
 #include <llama.h>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -50,11 +52,147 @@ struct BatchChunk {
     return chunks;
 }
 
+/**
+ * @brief Describes the share of one sequence's pending tokens packed into a
+ *        continuous-batching decode step.
+ */
+struct SequenceSlice {
+    size_t sequence;  ///< Index into the caller's pending-token array.
+    int count;        ///< Number of pending tokens from that sequence in this step.
+    bool emit_logits; ///< Whether the slice drains the sequence and needs a sample.
+
+    /// Compares two slice plans for equality.
+    bool operator==(const SequenceSlice& other) const = default;
+};
+
+/**
+ * @brief Packs pending work from several sequences into one `n_batch` step.
+ *
+ * Sequences with exactly one pending token are decoding and are scheduled
+ * first so active generations keep their per-token latency. Remaining budget
+ * is filled with prompt prefill for joining sequences, in index order; a
+ * prefill that does not fit is split and continues on the next step.
+ *
+ * @param pending_tokens Tokens each sequence still needs decoded. Zero means
+ *        the sequence is idle this step.
+ * @param n_batch Maximum number of tokens the backend may decode per batch.
+ * @return Slices in batch order, or an empty vector when nothing fits.
+ */
+[[nodiscard]] inline std::vector<SequenceSlice>
+plan_continuous_batch(std::span<const int> pending_tokens, int n_batch) {
+    std::vector<SequenceSlice> slices;
+    if (n_batch <= 0) {
+        return slices;
+    }
+
+    int budget = n_batch;
+    for (size_t i = 0; i < pending_tokens.size() && budget > 0; ++i) {
+        if (pending_tokens[i] == 1) {
+            slices.push_back({i, 1, true});
+            --budget;
+        }
+    }
+    for (size_t i = 0; i < pending_tokens.size() && budget > 0; ++i) {
+        if (pending_tokens[i] > 1) {
+            const int count = std::min(budget, pending_tokens[i]);
+            slices.push_back({i, count, count == pending_tokens[i]});
+            budget -= count;
+        }
+    }
+    return slices;
+}
+
+/// Writes one token entry into a batch allocated with at least one seq id per token.
+inline void set_batch_token(llama_batch& batch, int index, llama_token token, llama_pos pos,
+                            llama_seq_id seq_id, bool emit_logits) noexcept {
+    batch.token[index] = token;
+    batch.pos[index] = pos;
+    batch.n_seq_id[index] = 1;
+    batch.seq_id[index][0] = seq_id;
+    batch.logits[index] = emit_logits;
+}
+
+/**
+ * @brief Per-sequence progress for continuous batching.
+ *
+ * `pending` holds tokens not yet decoded into the sequence's KV cells, and
+ * `next_pos` is the position the next pending token occupies. After a step,
+ * `logits_index` names the batch row to sample from, or -1 when the sequence
+ * still has prefill outstanding or sat the step out.
+ */
+struct SequenceCursor {
+    llama_seq_id seq_id = 0;
+    llama_pos next_pos = 0;
+    std::vector<int> pending;
+    size_t consumed = 0;
+    int logits_index = -1;
+
+    [[nodiscard]] int remaining() const noexcept {
+        return static_cast<int>(pending.size() - consumed);
+    }
+};
+
+/**
+ * @brief Fills `batch` with the next continuous-batching step and advances cursors.
+ *
+ * Drained cursors have their `pending` tokens cleared so the caller can push
+ * the next sampled token. `batch` must have room for `n_batch` tokens.
+ *
+ * @return Number of tokens written into `batch`.
+ */
+inline int pack_continuous_batch(llama_batch& batch, std::span<SequenceCursor> cursors,
+                                 int n_batch) {
+    std::vector<int> remaining;
+    remaining.reserve(cursors.size());
+    for (auto& cursor : cursors) {
+        remaining.push_back(cursor.remaining());
+        cursor.logits_index = -1;
+    }
+
+    int row = 0;
+    for (const auto& slice : plan_continuous_batch(remaining, n_batch)) {
+        auto& cursor = cursors[slice.sequence];
+        for (int i = 0; i < slice.count; ++i) {
+            const bool last = slice.emit_logits && i == slice.count - 1;
+            set_batch_token(batch, row, static_cast<llama_token>(cursor.pending[cursor.consumed]),
+                            cursor.next_pos, cursor.seq_id, last);
+            if (last) {
+                cursor.logits_index = row;
+            }
+            ++cursor.consumed;
+            ++cursor.next_pos;
+            ++row;
+        }
+        if (slice.emit_logits) {
+            cursor.pending.clear();
+            cursor.consumed = 0;
+        }
+    }
+    batch.n_tokens = row;
+    return row;
+}
+
+/**
+ * @brief Owning or borrowed wrapper around a `llama_batch`.
+ *
+ * Owning handles free their batch on destruction; borrowed handles view
+ * storage owned by a `BatchArena` and leave it intact.
+ */
 class LlamaBatchHandle {
   public:
+    LlamaBatchHandle() = default;
+
     LlamaBatchHandle(int n_tokens, int embd, int n_seq_max)
         : batch_(llama_batch_init(n_tokens, embd, n_seq_max)), owns_(true) {}
 
+    /// Wraps `batch` without taking ownership. The view starts empty.
+    [[nodiscard]] static LlamaBatchHandle borrowed(const llama_batch& batch) noexcept {
+        LlamaBatchHandle handle;
+        handle.batch_ = batch;
+        handle.batch_.n_tokens = 0;
+        return handle;
+    }
+
     LlamaBatchHandle(const LlamaBatchHandle&) = delete;
     LlamaBatchHandle& operator=(const LlamaBatchHandle&) = delete;
 
@@ -80,17 +218,63 @@ class LlamaBatchHandle {
         return batch_;
     }
 
+    [[nodiscard]] bool owns_storage() const noexcept {
+        return owns_;
+    }
+
   private:
     void reset() noexcept {
         if (owns_) {
             llama_batch_free(batch_);
             owns_ = false;
-            batch_ = llama_batch{};
         }
+        batch_ = llama_batch{};
     }
 
     llama_batch batch_{};
     bool owns_ = false;
 };
 
+/**
+ * @brief Reusable single-sequence token batch owned by one session.
+ *
+ * The storage is allocated on first use with room for `capacity` tokens
+ * (the context's `n_batch`) and lent out to every prefill chunk and decode
+ * step afterwards, so steady-state requests make no `llama_batch_init`
+ * calls. Larger requests fall back to a one-off owning batch. Only one
+ * borrowed handle may be in use at a time, and it must not outlive the arena.
+ */
+class BatchArena {
+  public:
+    BatchArena() = default;
+    explicit BatchArena(int capacity) noexcept : capacity_(std::max(0, capacity)) {}
+
+    /// Returns a batch with room for `n_tokens` tokens and `n_tokens` reset to zero.
+    [[nodiscard]] LlamaBatchHandle borrow(int n_tokens) {
+        if (n_tokens > capacity_) {
+            ++allocations_;
+            return LlamaBatchHandle(n_tokens, 0, 1);
+        }
+        if (!storage_.owns_storage()) {
+            storage_ = LlamaBatchHandle(capacity_, 0, 1);
+            ++allocations_;
+        }
+        return LlamaBatchHandle::borrowed(storage_.get());
+    }
+
+    [[nodiscard]] int capacity() const noexcept {
+        return capacity_;
+    }
+
+    /// Number of `llama_batch_init` calls made on behalf of borrowers.
+    [[nodiscard]] size_t allocations() const noexcept {
+        return allocations_;
+    }
+
+  private:
+    LlamaBatchHandle storage_;
+    int capacity_ = 0;
+    size_t allocations_ = 0;
+};
+
 } // namespace zoo::core
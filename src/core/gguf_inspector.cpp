@@ -4,6 +4,7 @@
  */
 
 #include "zoo/core/gguf_inspector.hpp"
+#include "core/kv_cache.hpp"
 #include "zoo/core/system_probe.hpp"
 
 #include <algorithm>
@@ -234,6 +235,9 @@ void read_gguf_metadata(const gguf_context* ctx, ModelInfo& info) {
         info.head_count = read_arch_gguf_u32_as_i32(ctx, info.architecture, "attention.head_count");
         info.kv_head_count =
             read_arch_gguf_u32_as_i32(ctx, info.architecture, "attention.head_count_kv");
+        info.key_length = read_arch_gguf_u32_as_i32(ctx, info.architecture, "attention.key_length");
+        info.value_length =
+            read_arch_gguf_u32_as_i32(ctx, info.architecture, "attention.value_length");
     }
     if (info.context_length == 0) {
         info.context_length = read_gguf_u32_as_i32(ctx, "llm.context_length");
@@ -275,20 +279,42 @@ void derive_quantization(ModelInfo& info) {
     }
 }
 
-uint64_t per_token_kv_bytes(const ModelInfo& info) {
+// Per-head width for K or V: the explicit GGUF value when present, else
+// embedding_dim / head_count. Returns 0 when neither is known.
+uint64_t head_width(const ModelInfo& info, int32_t explicit_length) {
+    if (explicit_length > 0) {
+        return static_cast<uint64_t>(explicit_length);
+    }
+    if (info.head_count > 0) {
+        return static_cast<uint64_t>(info.embedding_dim) / static_cast<uint64_t>(info.head_count);
+    }
+    return 0;
+}
+
+// Bytes for one row of `elements` values of `type`, rounding partial
+// quantization blocks up.
+uint64_t row_bytes(KvCacheType type, uint64_t elements) {
+    const ggml_type ggml = to_ggml_type(type);
+    const auto block = static_cast<uint64_t>(ggml_blck_size(ggml));
+    return (elements + block - 1) / block * static_cast<uint64_t>(ggml_type_size(ggml));
+}
+
+uint64_t per_token_kv_bytes(const ModelInfo& info, KvCacheType type_k, KvCacheType type_v) {
     if (info.layer_count <= 0 || info.embedding_dim <= 0) {
         return 0;
     }
-    // KV per token = 2 (K+V) * layers * kv_dim * 2 (fp16) = 4 * layers * kv_dim.
-    // For GQA, kv_dim = head_dim * kv_head_count, where head_dim = embedding_dim / head_count.
-    // For MHA (or unknown head metadata), kv_dim = embedding_dim.
-    uint64_t kv_dim = static_cast<uint64_t>(info.embedding_dim);
+    // Each layer stores one K row of key_length * kv_heads values and one V
+    // row of value_length * kv_heads values per token. Without usable head
+    // metadata this falls back to MHA, where both rows are embedding_dim wide.
+    uint64_t k_dim = static_cast<uint64_t>(info.embedding_dim);
+    uint64_t v_dim = k_dim;
     if (info.head_count > 0 && info.kv_head_count > 0 && info.kv_head_count <= info.head_count) {
-        const uint64_t head_dim =
-            static_cast<uint64_t>(info.embedding_dim) / static_cast<uint64_t>(info.head_count);
-        kv_dim = head_dim * static_cast<uint64_t>(info.kv_head_count);
+        const auto kv_heads = static_cast<uint64_t>(info.kv_head_count);
+        k_dim = head_width(info, info.key_length) * kv_heads;
+        v_dim = head_width(info, info.value_length) * kv_heads;
     }
-    return static_cast<uint64_t>(info.layer_count) * kv_dim * 4;
+    return static_cast<uint64_t>(info.layer_count) *
+           (row_bytes(type_k, k_dim) + row_bytes(type_v, v_dim));
 }
 
 // Returns the RAM that should be assumed available for the KV cache. Prefers
@@ -307,12 +333,13 @@ uint64_t aggregate_vram_bytes(const SystemInfo& sys) {
     return total;
 }
 
-int compute_context_size(const ModelInfo& info, const SystemInfo& sys) {
+int compute_context_size(const ModelInfo& info, const SystemInfo& sys, KvCacheType type_k,
+                         KvCacheType type_v) {
     const int training_ctx =
         info.context_length > 0 ? info.context_length : kFallbackTrainingContext;
 
     int ctx_from_ram = kContextHardCap;
-    const uint64_t per_token_kv = per_token_kv_bytes(info);
+    const uint64_t per_token_kv = per_token_kv_bytes(info, type_k, type_v);
     if (per_token_kv > 0) {
         const uint64_t ram = usable_ram_bytes(sys);
         const uint64_t reserved = info.file_size_bytes + kRamOverheadBytes;
@@ -387,7 +414,16 @@ Expected<ModelInfo> GgufInspector::inspect(const std::string& file_path) {
     return info;
 }
 
-Expected<ModelConfig> GgufInspector::auto_configure(const ModelInfo& info, const SystemInfo& sys) {
+uint64_t GgufInspector::kv_cache_bytes(const ModelInfo& info, int context_size,
+                                       KvCacheType type_k, KvCacheType type_v) {
+    if (context_size <= 0) {
+        return 0;
+    }
+    return per_token_kv_bytes(info, type_k, type_v) * static_cast<uint64_t>(context_size);
+}
+
+Expected<ModelConfig> GgufInspector::auto_configure(const ModelInfo& info, const SystemInfo& sys,
+                                                    KvCacheType type_k, KvCacheType type_v) {
     if (info.file_path.empty()) {
         return std::unexpected(
             Error{ErrorCode::InvalidModelPath, "ModelInfo has no file_path set"});
@@ -395,13 +431,18 @@ Expected<ModelConfig> GgufInspector::auto_configure(const ModelInfo& info, const
 
     ModelConfig config;
     config.model_path = info.file_path;
-    config.context_size = compute_context_size(info, sys);
+    config.cache_type_k = type_k;
+    config.cache_type_v = type_v;
+    config.context_size = compute_context_size(info, sys, type_k, type_v);
     config.n_batch = std::min(config.context_size, kDefaultBatchCap);
     config.n_gpu_layers = compute_n_gpu_layers(info, sys);
     config.use_mmap = true;
     // Use available RAM (when known) so mlock doesn't starve other processes
     // already consuming a large share of memory.
     config.use_mlock = usable_ram_bytes(sys) >= info.file_size_bytes * 5 / 2;
+    const auto threads = SystemProbe::recommend_threads(sys);
+    config.n_threads = threads.n_threads;
+    config.n_threads_batch = threads.n_threads_batch;
     return config;
 }
 
@@ -0,0 +1,27 @@
+/**
+ * @file kv_cache.hpp
+ * @brief Maps public KV cache settings onto ggml tensor types.
+ */
+
+#pragma once
+
+#include "zoo/core/types.hpp"
+
+#include <ggml.h>
+
+namespace zoo::core {
+
+/// ggml tensor type used to store one half of the KV cache.
+[[nodiscard]] inline ggml_type to_ggml_type(KvCacheType type) noexcept {
+    switch (type) {
+    case KvCacheType::F16:
+        return GGML_TYPE_F16;
+    case KvCacheType::Q8_0:
+        return GGML_TYPE_Q8_0;
+    case KvCacheType::Q4_0:
+        return GGML_TYPE_Q4_0;
+    }
+    return GGML_TYPE_F16;
+}
+
+} // namespace zoo::core
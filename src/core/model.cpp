@@ -7,6 +7,7 @@
 #include "core/backend_init.hpp"
 #include "core/model_impl.hpp"
 
+#include <ggml-cpu.h>
 #include <llama.h>
 
 namespace zoo::core {
@@ -18,6 +19,8 @@ void initialize_model_backend() {
 Model::Model(ModelConfig model_config, GenerationOptions default_generation)
     : impl_(std::make_unique<Impl>(std::move(model_config), std::move(default_generation))) {}
 
+Model::Model(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
 void LlamaModelDeleter::operator()(llama_model* model) const noexcept {
     if (model) {
         llama_model_free(model);
@@ -36,6 +39,12 @@ void LlamaSamplerDeleter::operator()(llama_sampler* sampler) const noexcept {
     }
 }
 
+void GgmlThreadpoolDeleter::operator()(ggml_threadpool* threadpool) const noexcept {
+    if (threadpool) {
+        ggml_threadpool_free(threadpool);
+    }
+}
+
 void ChatTemplatesDeleter::operator()(common_chat_templates* tmpls) const noexcept {
     if (tmpls) {
         common_chat_templates_free(tmpls);
@@ -77,4 +86,26 @@ Expected<std::unique_ptr<Model>> Model::load(const ModelConfig& model_config,
     return model;
 }
 
+Expected<std::unique_ptr<Model>> Model::open_session(SessionPlacement placement) const {
+    if (!impl_->loaded_.llama_model) {
+        return std::unexpected(
+            Error{ErrorCode::BackendInitFailed, "Cannot open a session on an unloaded model"});
+    }
+
+    auto session = std::unique_ptr<Model>(new Model(std::make_unique<Impl>(impl_->loaded_owner_)));
+    session->impl_->session_.sampler = create_sampler_chain(*session->impl_);
+    if (!session->impl_->session_.sampler) {
+        return std::unexpected(
+            Error{ErrorCode::BackendInitFailed, "Failed to create sampler chain"});
+    }
+    if (auto leased = lease_sequence(*session->impl_, placement); !leased) {
+        return std::unexpected(leased.error());
+    }
+    if (auto drafted = attach_draft(*session->impl_); !drafted) {
+        return std::unexpected(drafted.error());
+    }
+
+    return session;
+}
+
 } // namespace zoo::core
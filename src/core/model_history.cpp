@@ -9,36 +9,132 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <llama.h>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace zoo::core {
 
+namespace {
+
+using MessageTokens = Model::Impl::MessageTokens;
+
+void hash_combine(size_t& seed, std::string_view text) {
+    seed ^= std::hash<std::string_view>{}(text) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+size_t message_fingerprint(const Message& message) {
+    size_t seed = static_cast<size_t>(message.role);
+    hash_combine(seed, message.content);
+    hash_combine(seed, message.tool_call_id);
+    for (const auto& tc : message.tool_calls) {
+        hash_combine(seed, tc.id);
+        hash_combine(seed, tc.name);
+        hash_combine(seed, tc.arguments_json);
+    }
+    return seed;
+}
+
+MessageTokens provisional_tokens(const Model::Impl& impl, const Message& message) {
+    return MessageTokens{estimate_message_tokens(impl, message), false};
+}
+
+void sum_message_tokens(Model::Impl::Session& session) {
+    session.estimated_tokens = 0;
+    for (const auto& tokens : session.message_tokens) {
+        session.estimated_tokens += tokens.count;
+    }
+}
+
+// Removes messages [begin, end) along with their cached counts.
+void erase_messages(Model::Impl::Session& session, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+        session.estimated_tokens -= session.message_tokens[index].count;
+    }
+    session.estimated_tokens = std::max(session.estimated_tokens, 0);
+    session.messages.erase(session.messages.begin() + static_cast<std::ptrdiff_t>(begin),
+                           session.messages.begin() + static_cast<std::ptrdiff_t>(end));
+    session.message_tokens.erase(
+        session.message_tokens.begin() + static_cast<std::ptrdiff_t>(begin),
+        session.message_tokens.begin() + static_cast<std::ptrdiff_t>(end));
+}
+
+size_t system_offset(const Model::Impl::Session& session) {
+    const auto& messages = session.messages;
+    return (!messages.empty() && messages.front().role == Role::System) ? 1u : 0u;
+}
+
+// Advances `index` to the next user message so trimming never starts mid-exchange.
+size_t align_to_user_boundary(const Model::Impl::Session& session, size_t index) {
+    while (index < session.messages.size() && session.messages[index].role != Role::User) {
+        ++index;
+    }
+    return index;
+}
+
+// Installs `incoming` as the retained history and returns the previous one.
+// Counts for messages that match the last history swapped out, position by
+// position, are reused instead of re-tokenized.
+std::vector<Message> exchange_history(Model::Impl& impl, std::vector<Message> incoming) {
+    auto& session = impl.session_;
+
+    std::vector<std::pair<size_t, MessageTokens>> outgoing;
+    outgoing.reserve(session.messages.size());
+    for (size_t index = 0; index < session.messages.size(); ++index) {
+        outgoing.emplace_back(message_fingerprint(session.messages[index]),
+                              session.message_tokens[index]);
+    }
+
+    std::vector<MessageTokens> tokens;
+    tokens.reserve(incoming.size());
+    const auto& stashed = session.replaced_tokens;
+    for (size_t index = 0; index < incoming.size(); ++index) {
+        if (index < stashed.size() &&
+            stashed[index].first == message_fingerprint(incoming[index])) {
+            tokens.push_back(stashed[index].second);
+        } else {
+            tokens.push_back(provisional_tokens(impl, incoming[index]));
+        }
+    }
+
+    std::vector<Message> previous = std::exchange(session.messages, std::move(incoming));
+    session.message_tokens = std::move(tokens);
+    session.replaced_tokens = std::move(outgoing);
+    sum_message_tokens(session);
+    return previous;
+}
+
+} // namespace
+
 void Model::set_system_prompt(std::string_view prompt) {
+    auto& session = impl_->session_;
     Message sys_msg = Message::system(std::string(prompt));
+    const MessageTokens tokens = provisional_tokens(*impl_, sys_msg);
 
-    if (!impl_->session_.messages.empty() && impl_->session_.messages[0].role == Role::System) {
-        impl_->session_.estimated_tokens -=
-            estimate_message_tokens(*impl_, impl_->session_.messages[0]);
-        impl_->session_.messages[0] = std::move(sys_msg);
+    if (!session.messages.empty() && session.messages[0].role == Role::System) {
+        session.estimated_tokens -= session.message_tokens[0].count;
+        session.messages[0] = std::move(sys_msg);
+        session.message_tokens[0] = tokens;
     } else {
-        impl_->session_.messages.insert(impl_->session_.messages.begin(), std::move(sys_msg));
+        session.messages.insert(session.messages.begin(), std::move(sys_msg));
+        session.message_tokens.insert(session.message_tokens.begin(), tokens);
     }
 
-    impl_->session_.estimated_tokens +=
-        estimate_message_tokens(*impl_, impl_->session_.messages[0]);
-    note_history_rewrite(*impl_);
+    session.estimated_tokens += tokens.count;
 }
 
 Expected<void> Model::add_message(MessageView message) {
-    auto err = validate_role_sequence(impl_->session_.messages, message.role());
+    auto& session = impl_->session_;
+    auto err = validate_role_sequence(session.messages, message.role());
     if (!err) {
         return std::unexpected(err.error());
     }
 
-    impl_->session_.messages.push_back(Message::from_view(message));
-    impl_->session_.estimated_tokens +=
-        estimate_message_tokens(*impl_, impl_->session_.messages.back());
-    note_history_append(*impl_);
+    session.messages.push_back(Message::from_view(message));
+    session.message_tokens.push_back(provisional_tokens(*impl_, session.messages.back()));
+    session.estimated_tokens += session.message_tokens.back().count;
     trim_history_to_fit(*impl_);
     return {};
 }
@@ -49,23 +145,17 @@ HistorySnapshot Model::get_history() const {
 
 void Model::clear_history() {
     impl_->session_.messages.clear();
+    impl_->session_.message_tokens.clear();
     impl_->session_.estimated_tokens = 0;
-    note_history_reset(*impl_);
+    clear_kv_cache(*impl_);
 }
 
 void Model::replace_history(HistorySnapshot snapshot) {
-    impl_->session_.messages = std::move(snapshot.messages);
-    impl_->session_.estimated_tokens = 0;
-    for (const auto& m : impl_->session_.messages) {
-        impl_->session_.estimated_tokens += estimate_message_tokens(*impl_, m);
-    }
-    note_history_rewrite(*impl_);
+    (void)exchange_history(*impl_, std::move(snapshot.messages));
 }
 
 HistorySnapshot Model::swap_history(HistorySnapshot snapshot) {
-    HistorySnapshot previous{std::move(impl_->session_.messages)};
-    replace_history(std::move(snapshot));
-    return previous;
+    return HistorySnapshot{exchange_history(*impl_, std::move(snapshot.messages))};
 }
 
 int Model::context_size() const noexcept {
@@ -107,35 +197,32 @@ int estimate_message_tokens(const Model::Impl& impl, const Message& message) {
 }
 
 void Model::trim_history(size_t max_non_system_messages) {
-    const size_t system_offset =
-        (!impl_->session_.messages.empty() && impl_->session_.messages.front().role == Role::System)
-            ? 1u
-            : 0u;
-
-    if (impl_->session_.messages.size() <= system_offset + max_non_system_messages) {
+    auto& session = impl_->session_;
+    const size_t offset = system_offset(session);
+    if (session.messages.size() <= offset + max_non_system_messages) {
         return;
     }
 
-    size_t erase_end = impl_->session_.messages.size() - max_non_system_messages;
+    const size_t erase_end =
+        align_to_user_boundary(session, session.messages.size() - max_non_system_messages);
+    erase_messages(session, offset, erase_end);
+}
 
-    // Align to a user-message boundary so we don't start mid-exchange.
-    while (erase_end < impl_->session_.messages.size() &&
-           impl_->session_.messages[erase_end].role != Role::User) {
-        ++erase_end;
+void Model::trim_history_to_tokens(size_t max_tokens) {
+    auto& session = impl_->session_;
+    const size_t offset = system_offset(session);
+    auto retained = static_cast<size_t>(std::max(session.estimated_tokens, 0));
+    if (retained <= max_tokens) {
+        return;
     }
 
-    for (size_t index = system_offset; index < erase_end; ++index) {
-        impl_->session_.estimated_tokens -=
-            estimate_message_tokens(*impl_, impl_->session_.messages[index]);
-    }
-    if (impl_->session_.estimated_tokens < 0) {
-        impl_->session_.estimated_tokens = 0;
+    size_t erase_end = offset;
+    while (erase_end < session.messages.size() && retained > max_tokens) {
+        const auto count = static_cast<size_t>(session.message_tokens[erase_end].count);
+        retained -= std::min(retained, count);
+        ++erase_end;
     }
-
-    impl_->session_.messages.erase(
-        impl_->session_.messages.begin() + static_cast<std::ptrdiff_t>(system_offset),
-        impl_->session_.messages.begin() + static_cast<std::ptrdiff_t>(erase_end));
-    note_history_rewrite(*impl_);
+    erase_messages(session, offset, align_to_user_boundary(session, erase_end));
 }
 
 void trim_history_to_fit(Model::Impl&) {
@@ -143,18 +230,42 @@ void trim_history_to_fit(Model::Impl&) {
     // The agent runtime owns retention policy via trim_history().
 }
 
-void rollback_last_message(Model::Impl& impl) noexcept {
-    if (impl.session_.messages.empty()) {
+void record_prompt_tokens(Model::Impl& impl, size_t prompt_tokens) {
+    auto& session = impl.session_;
+    int64_t calibrated = 0;
+    int64_t provisional = 0;
+    for (const auto& tokens : session.message_tokens) {
+        (tokens.calibrated ? calibrated : provisional) += tokens.count;
+    }
+    if (provisional == 0) {
         return;
     }
 
-    impl.session_.estimated_tokens -= estimate_message_tokens(impl, impl.session_.messages.back());
-    if (impl.session_.estimated_tokens < 0) {
-        impl.session_.estimated_tokens = 0;
+    // Template framing around the new messages (role headers, the generation
+    // prompt) lands in their share, so later trims account for it.
+    const int64_t remainder =
+        std::max<int64_t>(static_cast<int64_t>(prompt_tokens) - calibrated, 0);
+    int64_t assigned = 0;
+    int64_t seen = 0;
+    for (auto& tokens : session.message_tokens) {
+        if (tokens.calibrated) {
+            continue;
+        }
+        seen += tokens.count;
+        const int64_t cumulative = remainder * seen / provisional;
+        tokens.count = static_cast<int>(cumulative - assigned);
+        tokens.calibrated = true;
+        assigned = cumulative;
     }
+    session.estimated_tokens = static_cast<int>(calibrated + remainder);
+}
 
-    impl.session_.messages.pop_back();
-    note_history_rewrite(impl);
+void rollback_last_message(Model::Impl& impl) noexcept {
+    auto& session = impl.session_;
+    if (session.messages.empty()) {
+        return;
+    }
+    erase_messages(session, session.messages.size() - 1, session.messages.size());
 }
 
 } // namespace zoo::core
@@ -5,13 +5,20 @@
 
 #pragma once
 
+#include "core/batch.hpp"
 #include "core/stream_filter.hpp"
+#include "core/token_mask.hpp"
 #include "zoo/core/model.hpp"
 
+#include <algorithm>
 #include <chat.h>
 #include <common.h>
+#include <cstddef>
 #include <llama.h>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -31,16 +38,30 @@ struct LlamaSamplerDeleter {
 struct ChatTemplatesDeleter {
     void operator()(common_chat_templates* tmpls) const noexcept;
 };
+struct GgmlThreadpoolDeleter {
+    void operator()(ggml_threadpool* threadpool) const noexcept;
+};
 
 using LlamaModelHandle = std::unique_ptr<llama_model, LlamaModelDeleter>;
 using LlamaContextHandle = std::unique_ptr<llama_context, LlamaContextDeleter>;
 using LlamaSamplerHandle = std::unique_ptr<llama_sampler, LlamaSamplerDeleter>;
 using ChatTemplatesHandle = std::unique_ptr<common_chat_templates, ChatTemplatesDeleter>;
+using GgmlThreadpoolHandle = std::unique_ptr<ggml_threadpool, GgmlThreadpoolDeleter>;
+
+// Pinned threadpools attached to a llama context when `ModelConfig::cpu_mask`
+// is set. Either handle may be null, in which case llama.cpp runs that phase
+// on its own unpinned threads.
+struct ContextThreadpools {
+    GgmlThreadpoolHandle decode;
+    GgmlThreadpoolHandle batch;
+};
 
 struct Model::Impl {
     struct ToolCallingState {
         std::vector<common_chat_tool> tools;
         common_chat_parser_params parser_params;
+        // Serialized PEG parser `parser_params.parser` was loaded from.
+        std::string parser_source;
         std::string grammar;
         bool grammar_lazy = false;
         std::vector<common_grammar_trigger> grammar_triggers;
@@ -50,8 +71,10 @@ struct Model::Impl {
     };
 
     struct PromptState {
-        int committed_prompt_len = 0;
-        bool dirty = true;
+        // Mirrors the tokens decoded into the session's KV sequence, in order.
+        // Every prompt is rendered and tokenized in full, then diffed against
+        // this sequence so only the divergent suffix is prefilled.
+        std::vector<int> kv_tokens;
     };
 
     struct SamplerPolicy {
@@ -63,6 +86,10 @@ struct Model::Impl {
 
         Mode mode = Mode::Plain;
         std::string grammar;
+        // Schema mode only: reports grammar-forced output for jump-forward decoding.
+        ForcedContinuation forced_continuation;
+        // Schema mode only: classifies output positions for token-mask sampling.
+        FreeTextProbe free_text;
 
         [[nodiscard]] bool is_native_tool_call() const noexcept {
             return mode == Mode::NativeToolCall;
@@ -80,89 +107,236 @@ struct Model::Impl {
             return {Mode::NativeToolCall, std::move(grammar)};
         }
 
-        static SamplerPolicy schema(std::string grammar) {
-            return {Mode::Schema, std::move(grammar)};
+        static SamplerPolicy schema(std::string grammar, ForcedContinuation forced = {},
+                                    FreeTextProbe free_text = {}) {
+            return {Mode::Schema, std::move(grammar), std::move(forced), std::move(free_text)};
         }
 
         Expected<void> ensure_sampler_for_pass(Model::Impl& impl) const;
     };
 
-    // Loaded model state: set once during initialize() and immutable thereafter.
-    // Member declaration order matters for destruction: chat_templates is
-    // destroyed before llama_model (templates were initialized from the model).
+    // Inputs a grammar sampler chain was built from. When a pass's inputs
+    // match, the chain is reset and reused instead of re-parsing the grammar.
+    struct SamplerKey {
+        SamplerPolicy::Mode mode = SamplerPolicy::Mode::Plain;
+        std::string grammar;
+        bool grammar_lazy = false;
+        std::vector<common_grammar_trigger> grammar_triggers;
+        SamplingParams sampling;
+        bool masked = false; // Grammar wrapped for free-text token masks.
+    };
+
+    // A llama context whose KV sequences are leased to individual sessions.
+    // `leased` is indexed by sequence id and guarded by `mutex`.
+    // `threadpools` is declared before `ctx` so the pools outlive the context
+    // that computes on them.
+    struct SharedContext {
+        ContextThreadpools threadpools;
+        LlamaContextHandle ctx;
+        std::mutex mutex;
+        std::vector<bool> leased;
+    };
+
+    // Loaded model state: set once during initialize() and immutable thereafter,
+    // except for the context pool, which is guarded by `contexts_mutex`. Shared
+    // by every session opened from the same `Model::load()`.
+    // Member declaration order matters for destruction: contexts are destroyed
+    // before chat_templates, which is destroyed before llama_model (both were
+    // initialized from the model).
     struct LoadedModel {
         ModelConfig model_config;
         GenerationOptions default_generation_options;
 
         LlamaModelHandle llama_model;
+        // Optional speculative-decoding drafter; shares llama_model's vocabulary.
+        LlamaModelHandle draft_model;
         ChatTemplatesHandle chat_templates;
         const llama_vocab* vocab = nullptr;
         int context_size = 0;
+        // Vocabulary masks for grammar-constrained sampling, built on first use.
+        FreeTextMaskCache free_text_masks;
+
+        std::mutex contexts_mutex;
+        std::vector<std::shared_ptr<SharedContext>> contexts;
 
         LoadedModel(ModelConfig cfg, GenerationOptions defaults)
             : model_config(std::move(cfg)), default_generation_options(std::move(defaults)) {}
     };
 
+    // Per-session drafter for speculative decoding. `kv_tokens` mirrors the
+    // draft context's single sequence the same way PromptState does for the
+    // target. Member order: sampler is destroyed before ctx, and ctx before
+    // its threadpools.
+    struct DraftState {
+        ContextThreadpools threadpools;
+        LlamaContextHandle ctx;
+        LlamaSamplerHandle sampler;
+        std::vector<int> kv_tokens;
+        // Tokens decoded before drafting, kept to reuse its capacity.
+        std::vector<int> pending_tokens;
+        BatchArena batch_arena;
+    };
+
+    // Token cost of one retained message. Provisional counts come from
+    // estimate_message_tokens(). Once a prompt holding the message has been
+    // prefilled, the count is calibrated: the messages added since the last
+    // prefill split the real prompt size in proportion to their estimates.
+    // The sum over a prefilled history is exact; a single message's share is
+    // an approximation, since the prompt is not tokenized per message.
+    struct MessageTokens {
+        int count = 0;
+        bool calibrated = false;
+    };
+
     // Per-conversation state: mutates during chat/extraction.
     // Member declaration order matters for destruction: sampler is destroyed
-    // before ctx (sampler chain may reference vocab through grammar samplers
-    // and is built from the ctx).
+    // before context (sampler chain may reference vocab through grammar
+    // samplers and is built from the ctx).
     struct Session {
-        LlamaContextHandle ctx;
+        std::shared_ptr<SharedContext> context;
         LlamaSamplerHandle sampler;
+        // Inputs `sampler` was built from; nullopt for chains that are not
+        // reused, such as the plain chain outside grammar modes.
+        std::optional<SamplerKey> sampler_key;
+        // Grammar chains displaced from `sampler`, most recently used first,
+        // so alternating between schema and tool grammars does not re-parse.
+        std::vector<std::pair<SamplerKey, LlamaSamplerHandle>> sampler_cache;
+        // KV sequence leased to this conversation inside `context`.
+        llama_seq_id seq_id = 0;
 
         SamplerPolicy sampler_policy = SamplerPolicy::plain();
         std::unique_ptr<ToolCallingState> tool_state;
 
         PromptState prompt_state;
+        std::unique_ptr<DraftState> draft;
+        // Decode batch reused by every prefill chunk and decode step.
+        BatchArena batch_arena;
 
         std::vector<Message> messages;
+        // Parallel to `messages`; `estimated_tokens` is always their sum.
+        std::vector<MessageTokens> message_tokens;
         int estimated_tokens = 0;
+        // Counts of the history most recently swapped or replaced out, keyed
+        // by message fingerprint, so restoring it skips re-tokenizing.
+        std::vector<std::pair<size_t, MessageTokens>> replaced_tokens;
         std::vector<int> token_buffer;
         SamplingParams active_sampling;
 
         explicit Session(SamplingParams initial_sampling)
             : active_sampling(std::move(initial_sampling)) {}
+        // Clears the leased KV sequence and returns it to the context.
+        ~Session();
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        [[nodiscard]] llama_context* ctx() const noexcept {
+            return context ? context->ctx.get() : nullptr;
+        }
     };
 
     explicit Impl(ModelConfig model_config, GenerationOptions default_generation)
-        : loaded_(std::move(model_config), std::move(default_generation)),
+        : Impl(std::make_shared<LoadedModel>(std::move(model_config),
+                                             std::move(default_generation))) {}
+
+    explicit Impl(std::shared_ptr<LoadedModel> loaded)
+        : loaded_owner_(std::move(loaded)), loaded_(*loaded_owner_),
           session_(loaded_.default_generation_options.sampling) {}
 
-    // Destruction order: session_ first (samplers/ctx), then loaded_ (chat
-    // templates, then llama_model). This invariant must hold — see comments
-    // on each struct above.
-    LoadedModel loaded_;
+    // Destruction order: session_ first (samplers, sequence lease), then the
+    // last owner of the loaded model (contexts, chat templates, llama_model).
+    // This invariant must hold — see comments on each struct above.
+    std::shared_ptr<LoadedModel> loaded_owner_;
+    LoadedModel& loaded_;
     Session session_;
 
     static constexpr int kTemplateOverheadPerMessage = 8;
 };
 
-// The conversion constructor copies metadata fields (format, generation_prompt, …)
-// from `params`, but the PEG parser itself must be re-loaded from `params.parser`'s
-// serialized form before it is usable.
-inline common_chat_parser_params make_tool_parser_params(const common_chat_params& params) {
-    common_chat_parser_params parser_params(params);
-    parser_params.parse_tool_calls = true;
-    if (!params.parser.empty()) {
-        parser_params.parser.load(params.parser);
-    }
-    return parser_params;
+inline bool same_grammar_triggers(const std::vector<common_grammar_trigger>& lhs,
+                                  const std::vector<common_grammar_trigger>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](const common_grammar_trigger& a, const common_grammar_trigger& b) {
+                          return a.type == b.type && a.value == b.value && a.token == b.token;
+                      });
 }
 
+// Refreshes `state` from a template render that included its tools. The
+// metadata copied by the parser-params conversion constructor (format,
+// generation_prompt, …) is always refreshed; the PEG parser is only re-loaded
+// from `params.parser` when its serialized form changed, and the trigger
+// matcher only recompiled when the triggers changed. Throws if the parser
+// cannot be deserialized, leaving `state` untouched.
+void update_tool_calling_state(Model::Impl::ToolCallingState& state, common_chat_params& params);
+
 void initialize_model_backend();
 [[nodiscard]] Expected<void> initialize_model(Model::Impl& impl);
+// Leases a KV sequence for `impl.session_` from the loaded model's context
+// pool, creating a new context when every pooled sequence is in use.
+[[nodiscard]] Expected<void> lease_sequence(Model::Impl& impl, SessionPlacement placement);
+// Leases every sequence of a new context, one per session, for a continuous
+// batch. Sessions must come from the same loaded model.
+[[nodiscard]] Expected<void> lease_batch_sequences(std::span<Model::Impl* const> sessions);
+// Creates the session's draft context when a draft model is loaded.
+[[nodiscard]] Expected<void> attach_draft(Model::Impl& impl);
+// Runs the draft model over `context` followed by `next_token` and returns up
+// to `max_tokens` greedy proposals. `context` is normally the target's
+// resident tokens. Returns an empty vector when drafting is unavailable.
+[[nodiscard]] std::vector<int> propose_draft_tokens(Model::Impl& impl,
+                                                    std::span<const int> context, int next_token,
+                                                    int max_tokens);
 [[nodiscard]] Expected<std::vector<int>> tokenize(Model::Impl& impl, std::string_view text);
-[[nodiscard]] Expected<std::string>
+// Tokenizes a full prompt into `buffer` (BOS included) and returns a copy.
+// With `prompt` false the text is tokenized as plain output instead: no BOS
+// and no special-token parsing. Touches no session state, so it may run off
+// the inference thread.
+[[nodiscard]] Expected<std::vector<int>> tokenize_into(const llama_vocab* vocab,
+                                                       std::string_view text,
+                                                       std::vector<int>& buffer,
+                                                       bool prompt = true);
+// Generated text plus speculative-decoding counters for one inference pass.
+struct InferenceOutput {
+    std::string text;
+    int draft_tokens_proposed = 0;
+    int draft_tokens_accepted = 0;
+    int forced_tokens = 0; // Tokens appended by jump-forward decoding without sampling.
+};
+[[nodiscard]] Expected<InferenceOutput>
 run_inference(Model::Impl& impl, const std::vector<int>& prompt_tokens, int max_tokens,
-              const std::vector<std::string>& stop_sequences, TokenCallback on_token = {},
+              const std::vector<std::string>& stop_sequences,
+              const SpeculativeOptions& speculative = {}, TokenCallback on_token = {},
               CancellationCallback should_cancel = {});
-[[nodiscard]] Expected<std::string> render_prompt_delta(Model::Impl& impl);
+// Packs the next continuous-batching step of `cursors`, sequences of `ctx`,
+// into `batch` (room for `n_batch` tokens) and decodes it. Returns the number
+// of tokens decoded; callers sample drained cursors at `logits_index`.
+[[nodiscard]] Expected<int> decode_sequence_step(llama_context* ctx, llama_batch& batch,
+                                                 std::span<SequenceCursor> cursors);
+[[nodiscard]] Expected<std::string> render_prompt(Model::Impl& impl);
+// Applies the chat template to `messages`, adding `tools` when non-null.
+// Reads only the loaded model, so it may run off the inference thread.
+[[nodiscard]] Expected<common_chat_params>
+apply_chat_template(const Model::Impl::LoadedModel& loaded, std::span<const Message> messages,
+                    const Model::Impl::ToolCallingState* tools);
+// Tokenizes a full rendered prompt and returns only the tokens that are not
+// already resident, after trimming the KV sequence to the shared prefix.
+[[nodiscard]] Expected<std::vector<int>> prepare_prompt_tokens(Model::Impl& impl,
+                                                               std::string_view prompt);
+// Same as prepare_prompt_tokens() for a prompt tokenized ahead of time.
+[[nodiscard]] std::vector<int> reuse_prepared_tokens(Model::Impl& impl,
+                                                     std::span<const int> prompt_tokens);
 void clear_kv_cache(Model::Impl& impl);
-void note_history_append(Model::Impl& impl) noexcept;
-void note_history_rewrite(Model::Impl& impl) noexcept;
-void note_history_reset(Model::Impl& impl) noexcept;
+// Keeps the resident prefix shared with `prompt_tokens`, shifts later
+// resident runs that continue it into place (see plan_kv_reuse), drops every
+// other cell and returns how many leading prompt tokens no longer need prefill.
+size_t reuse_resident_prefix(Model::Impl& impl, std::span<const int> prompt_tokens);
+// Frees room in a full context by discarding the older half of the resident
+// tokens after the system prompt and shifting the rest down. Moves
+// `current_pos` back accordingly. Returns false when context shifting is
+// disabled or the memory cannot shift positions.
+[[nodiscard]] bool shift_context(Model::Impl& impl, int& current_pos);
 [[nodiscard]] LlamaSamplerHandle create_sampler_chain(Model::Impl& impl);
+// Makes a chain built outside the grammar cache active (possibly null) and
+// keeps the displaced grammar chain for later reuse.
+void install_sampler_chain(Model::Impl& impl, LlamaSamplerHandle chain);
 bool rebuild_sampler_with_tool_grammar(Model::Impl& impl);
 bool rebuild_sampler_with_schema_grammar(Model::Impl& impl);
 [[nodiscard]] Expected<void> ensure_grammar_sampler_for_pass(Model::Impl& impl);
@@ -171,6 +345,10 @@ bool rebuild_sampler_with_schema_grammar(Model::Impl& impl);
 [[nodiscard]] int estimate_tokens(const Model::Impl& impl, std::string_view text);
 [[nodiscard]] int estimate_message_tokens(const Model::Impl& impl, const Message& message);
 void trim_history_to_fit(Model::Impl& impl);
+// Attributes a prefilled prompt of `prompt_tokens` positions to the retained
+// messages: uncalibrated messages split whatever calibrated ones do not account
+// for, in proportion to their estimates. Only the total is exact.
+void record_prompt_tokens(Model::Impl& impl, size_t prompt_tokens);
 void rollback_last_message(Model::Impl& impl) noexcept;
 [[nodiscard]] GenerationOptions resolve_generation_options(const Model::Impl& impl,
                                                            GenerationOverride generation);
@@ -7,14 +7,20 @@
 #include "zoo/core/model.hpp"
 
 #include "core/batch.hpp"
+#include "core/prompt_bookkeeping.hpp"
 #include "core/stream_filter.hpp"
 
 #include <algorithm>
 #include <chrono>
 #include <exception>
+#include <functional>
 #include <llama.h>
+#include <memory>
+#include <optional>
 #include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace zoo::core {
 
@@ -31,15 +37,19 @@ struct InferenceCtx {
     llama_sampler* sampler;
     const llama_vocab* vocab;
     int context_size;
+    llama_seq_id seq_id;
 };
 
 struct InferencePhase {
     InferenceCtx phase_ctx;
     const CancellationCallback& should_cancel;
+    std::vector<int>& kv_tokens;
+    BatchArena& batch_arena;
 
-    [[nodiscard]] Expected<int> prefill(const std::vector<int>& prompt_tokens) const {
+    [[nodiscard]] Expected<int> prefill(std::span<const int> prompt_tokens) const {
         const int n_batch = static_cast<int>(llama_n_batch(phase_ctx.ctx));
-        const int base_pos = llama_memory_seq_pos_max(llama_get_memory(phase_ctx.ctx), 0) + 1;
+        const int base_pos =
+            llama_memory_seq_pos_max(llama_get_memory(phase_ctx.ctx), phase_ctx.seq_id) + 1;
 
         auto chunks = compute_prefill_chunks(static_cast<int>(prompt_tokens.size()), n_batch);
         for (const auto& chunk : chunks) {
@@ -54,14 +64,13 @@ struct InferencePhase {
                     Error{ErrorCode::ContextWindowExceeded, "Prompt tokens exceed context size"});
             }
 
-            LlamaBatchHandle batch(chunk.count, 0, 1);
+            auto batch = batch_arena.borrow(chunk.count);
             auto& raw_batch = batch.get();
             for (int i = 0; i < chunk.count; ++i) {
-                raw_batch.token[i] = static_cast<llama_token>(prompt_tokens[chunk.offset + i]);
-                raw_batch.pos[i] = static_cast<llama_pos>(base_pos + chunk.offset + i);
-                raw_batch.n_seq_id[i] = 1;
-                raw_batch.seq_id[i][0] = 0;
-                raw_batch.logits[i] = (chunk.emit_logits && i == chunk.count - 1);
+                set_batch_token(raw_batch, i,
+                                static_cast<llama_token>(prompt_tokens[chunk.offset + i]),
+                                static_cast<llama_pos>(base_pos + chunk.offset + i),
+                                phase_ctx.seq_id, chunk.emit_logits && i == chunk.count - 1);
             }
             raw_batch.n_tokens = chunk.count;
 
@@ -70,22 +79,40 @@ struct InferencePhase {
                 return std::unexpected(
                     Error{ErrorCode::InferenceFailed, "Failed to decode prefill batch"});
             }
+            kv_tokens.insert(kv_tokens.end(), prompt_tokens.begin() + chunk.offset,
+                             prompt_tokens.begin() + chunk.offset + chunk.count);
         }
 
         return base_pos + static_cast<int>(prompt_tokens.size());
     }
 
-    [[nodiscard]] Expected<DecodedToken> decode() const {
+    // Samples the next token from the logits of batch position `logits_index`.
+    [[nodiscard]] Expected<DecodedToken> decode(int32_t logits_index = -1) const {
         if (should_cancel && should_cancel()) {
             return std::unexpected(
                 Error{ErrorCode::RequestCancelled, "Request cancelled during generation"});
         }
 
-        const llama_token token = llama_sampler_sample(phase_ctx.sampler, phase_ctx.ctx, -1);
+        const llama_token token =
+            llama_sampler_sample(phase_ctx.sampler, phase_ctx.ctx, logits_index);
         if (llama_vocab_is_eog(phase_ctx.vocab, token)) {
             return DecodedToken{token, {}, true};
         }
+        return to_piece(token);
+    }
+
+    // Advances the sampler chain over a grammar-forced token without sampling it.
+    [[nodiscard]] Expected<DecodedToken> accept_forced(llama_token token) const {
+        try {
+            llama_sampler_accept(phase_ctx.sampler, token);
+        } catch (const std::exception& e) {
+            return std::unexpected(Error{ErrorCode::InferenceFailed,
+                                         "Grammar rejected a forced token", e.what()});
+        }
+        return to_piece(token);
+    }
 
+    [[nodiscard]] Expected<DecodedToken> to_piece(llama_token token) const {
         char buffer[256];
         const int bytes =
             llama_token_to_piece(phase_ctx.vocab, token, buffer, sizeof(buffer), 0, true);
@@ -98,20 +125,72 @@ struct InferencePhase {
 
     [[nodiscard]] Expected<void> finalize(llama_batch& batch, llama_token token,
                                           int& current_pos) const {
-        batch.token[0] = token;
-        batch.pos[0] = static_cast<llama_pos>(current_pos);
-        batch.n_seq_id[0] = 1;
-        batch.seq_id[0][0] = 0;
-        batch.logits[0] = true;
+        set_batch_token(batch, 0, token, static_cast<llama_pos>(current_pos), phase_ctx.seq_id,
+                        true);
         batch.n_tokens = 1;
 
         int rc = llama_decode(phase_ctx.ctx, batch);
         if (rc != 0) {
             return std::unexpected(Error{ErrorCode::InferenceFailed, "Failed to decode token"});
         }
+        kv_tokens.push_back(static_cast<int>(token));
         ++current_pos;
         return {};
     }
+
+    // Decodes `tokens` in one batch with logits only at the last position and
+    // commits them all to the KV sequence.
+    [[nodiscard]] Expected<void> advance(llama_batch& batch, std::span<const int> tokens,
+                                         int& current_pos) const {
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            set_batch_token(batch, static_cast<int>(i), static_cast<llama_token>(tokens[i]),
+                            static_cast<llama_pos>(current_pos + static_cast<int>(i)),
+                            phase_ctx.seq_id, i + 1 == tokens.size());
+        }
+        batch.n_tokens = static_cast<int32_t>(tokens.size());
+
+        if (llama_decode(phase_ctx.ctx, batch) != 0) {
+            return std::unexpected(
+                Error{ErrorCode::InferenceFailed, "Failed to decode forced tokens"});
+        }
+        kv_tokens.insert(kv_tokens.end(), tokens.begin(), tokens.end());
+        current_pos += static_cast<int>(tokens.size());
+        return {};
+    }
+
+    // Decodes `token` followed by `drafted` in one batch with logits at every
+    // position, so each draft can be checked against the target's sample.
+    [[nodiscard]] Expected<void> verify(llama_batch& batch, llama_token token,
+                                        std::span<const int> drafted, int current_pos) const {
+        set_batch_token(batch, 0, token, static_cast<llama_pos>(current_pos), phase_ctx.seq_id,
+                        true);
+        for (size_t i = 0; i < drafted.size(); ++i) {
+            set_batch_token(batch, static_cast<int>(i + 1), static_cast<llama_token>(drafted[i]),
+                            static_cast<llama_pos>(current_pos + 1 + static_cast<int>(i)),
+                            phase_ctx.seq_id, true);
+        }
+        batch.n_tokens = static_cast<int32_t>(drafted.size() + 1);
+
+        if (llama_decode(phase_ctx.ctx, batch) != 0) {
+            return std::unexpected(
+                Error{ErrorCode::InferenceFailed, "Failed to decode speculative batch"});
+        }
+        return {};
+    }
+
+    // Keeps the first `kept` tokens of a verified batch starting at
+    // `current_pos` and drops the rejected tail from the KV sequence.
+    void commit_verified(llama_token token, std::span<const int> drafted, size_t kept,
+                         int& current_pos) const {
+        llama_memory_seq_rm(llama_get_memory(phase_ctx.ctx), phase_ctx.seq_id,
+                            static_cast<llama_pos>(current_pos + static_cast<int>(kept)), -1);
+        if (kept > 0) {
+            kv_tokens.push_back(static_cast<int>(token));
+            kv_tokens.insert(kv_tokens.end(), drafted.begin(),
+                             drafted.begin() + static_cast<std::ptrdiff_t>(kept - 1));
+        }
+        current_pos += static_cast<int>(kept);
+    }
 };
 
 Expected<TokenAction> invoke_token_callback(const TokenCallback& callback, std::string_view token) {
@@ -129,23 +208,23 @@ Expected<TokenAction> invoke_token_callback(const TokenCallback& callback, std::
 StreamFilter make_stream_filter(const Model::Impl& impl, const TokenCallback& on_token) {
     if (on_token && impl.session_.tool_state &&
         impl.session_.sampler_policy.is_native_tool_call()) {
-        const auto& trigger_matcher = impl.session_.tool_state->trigger_matcher;
-        return StreamFilter(std::span<const std::string>(trigger_matcher.word_triggers()),
-                            &trigger_matcher);
+        return StreamFilter(impl.session_.tool_state->trigger_matcher);
     }
     return {};
 }
 
-bool consume_stop_suffix(std::string& generated_text, StopSequenceMatcher& stop_matcher,
-                         bool has_stop_sequences) {
+// Feeds `piece` (already appended to `generated_text`) to the stop matcher and
+// cuts the text at the first completed stop sequence.
+bool consume_stop_suffix(std::string& generated_text, std::string_view piece,
+                         StopSequenceMatcher& stop_matcher, bool has_stop_sequences) {
     if (!has_stop_sequences) {
         return false;
     }
-    const size_t match_len = stop_matcher.match_suffix(generated_text);
-    if (match_len == 0) {
+    const size_t trim = stop_matcher.feed(piece);
+    if (trim == 0) {
         return false;
     }
-    generated_text.resize(generated_text.size() - match_len);
+    generated_text.resize(generated_text.size() - trim);
     return true;
 }
 
@@ -184,72 +263,299 @@ Expected<void> flush_visible_chunk(const TokenCallback& on_token, StreamFilter&
     return {};
 }
 
-} // namespace
-
-Expected<std::string> run_inference(Model::Impl& impl, const std::vector<int>& prompt_tokens,
-                                    int max_tokens, const std::vector<std::string>& stop_sequences,
-                                    TokenCallback on_token, CancellationCallback should_cancel) {
+// Applies stop sequences, streaming and token budgets to each sampled token.
+struct GenerationSink {
+    const TokenCallback& on_token;
+    bool has_stop_sequences;
+    int effective_max;
+    StopSequenceMatcher stop_matcher;
+    StreamFilter stream_filter;
     std::string generated_text;
-    const int effective_max = (max_tokens > 0) ? max_tokens : impl.loaded_.context_size;
-    generated_text.reserve(std::min(static_cast<size_t>(effective_max) * 8, size_t{65536}));
     int token_count = 0;
     bool stopped_by_callback = false;
-    StopSequenceMatcher stop_matcher{std::span<const std::string>(stop_sequences)};
-    StreamFilter stream_filter = make_stream_filter(impl, on_token);
-
-    InferencePhase phase{InferenceCtx{impl.session_.ctx.get(), impl.session_.sampler.get(),
-                                      impl.loaded_.vocab, impl.loaded_.context_size},
-                         should_cancel};
-    auto current_pos_result = phase.prefill(prompt_tokens);
-    if (!current_pos_result) {
-        return std::unexpected(current_pos_result.error());
-    }
 
-    int current_pos = *current_pos_result;
-    LlamaBatchHandle ar_batch(1, 0, 1);
-
-    while (true) {
-        auto decoded = phase.decode();
-        if (!decoded) {
-            return std::unexpected(decoded.error());
-        }
-        if (decoded->end_of_generation) {
-            break;
+    // Returns true when generation must end with this token.
+    [[nodiscard]] Expected<bool> accept(const DecodedToken& decoded) {
+        if (decoded.end_of_generation) {
+            return true;
         }
 
-        generated_text.append(decoded->piece);
+        generated_text.append(decoded.piece);
         ++token_count;
 
-        if (consume_stop_suffix(generated_text, stop_matcher, !stop_sequences.empty())) {
-            break;
+        if (consume_stop_suffix(generated_text, decoded.piece, stop_matcher,
+                                has_stop_sequences)) {
+            return true;
         }
 
         auto callback_stop =
-            emit_visible_chunk(on_token, stream_filter, decoded->piece, generated_text);
+            emit_visible_chunk(on_token, stream_filter, decoded.piece, generated_text);
         if (!callback_stop) {
             return std::unexpected(callback_stop.error());
         }
         if (*callback_stop) {
             stopped_by_callback = true;
-            break;
+            return true;
+        }
+
+        return token_count >= effective_max;
+    }
+};
+
+// `on_token` and `stop_sequences` must outlive the sink.
+GenerationSink make_generation_sink(const Model::Impl& impl, const TokenCallback& on_token,
+                                    const std::vector<std::string>& stop_sequences,
+                                    int max_tokens) {
+    const int effective_max = (max_tokens > 0) ? max_tokens : impl.loaded_.context_size;
+    GenerationSink sink{on_token, !stop_sequences.empty(), effective_max,
+                        StopSequenceMatcher{std::span<const std::string>(stop_sequences)},
+                        make_stream_filter(impl, on_token)};
+    sink.generated_text.reserve(std::min(static_cast<size_t>(effective_max) * 8, size_t{65536}));
+    return sink;
+}
+
+// Produces up to `max_tokens` proposals to follow `token`.
+using DraftProposer = std::function<std::vector<int>(llama_token token, int max_tokens)>;
+
+// Drafts up to `draft_limit` continuations per step and verifies them with
+// one target decode. Every draft position is sampled through the target
+// sampler in order, so grammar state, stop sequences and the stream filter
+// see exactly the tokens plain decoding would have produced; the first
+// mismatch becomes the next token and the rejected tail leaves the KV cache.
+Expected<void> run_speculative_loop(Model::Impl& impl, const InferencePhase& phase,
+                                    GenerationSink& sink, int current_pos, int draft_limit,
+                                    const DraftProposer& propose, InferenceOutput& output) {
+    const int context_size = impl.loaded_.context_size;
+    const int n_batch = static_cast<int>(llama_n_batch(phase.phase_ctx.ctx));
+    draft_limit = std::max(0, std::min(draft_limit, n_batch - 1));
+    auto verify_batch = phase.batch_arena.borrow(draft_limit + 1);
+
+    auto next = phase.decode();
+    while (true) {
+        if (!next) {
+            return std::unexpected(next.error());
+        }
+        auto done = sink.accept(*next);
+        if (!done) {
+            return std::unexpected(done.error());
+        }
+        if (*done || (current_pos >= context_size && !shift_context(impl, current_pos))) {
+            return {};
+        }
+
+        const llama_token token = next->token;
+        const int room = std::min({draft_limit, context_size - current_pos - 1,
+                                   sink.effective_max - sink.token_count});
+        const std::vector<int> drafted = room > 0 ? propose(token, room) : std::vector<int>{};
+        output.draft_tokens_proposed += static_cast<int>(drafted.size());
+
+        if (auto verified = phase.verify(verify_batch.get(), token, drafted, current_pos);
+            !verified) {
+            return std::unexpected(verified.error());
+        }
+
+        // Batch position 0 is `token` itself; each accepted draft extends the
+        // kept prefix by one.
+        size_t kept = 1;
+        bool finished = false;
+        for (; kept <= drafted.size(); ++kept) {
+            next = phase.decode(static_cast<int32_t>(kept - 1));
+            if (!next || next->token != static_cast<llama_token>(drafted[kept - 1])) {
+                break;
+            }
+            ++output.draft_tokens_accepted;
+            done = sink.accept(*next);
+            if (!done || *done) {
+                finished = true;
+                break;
+            }
+        }
+        if (!finished && kept > drafted.size()) {
+            next = phase.decode(static_cast<int32_t>(drafted.size()));
+        }
+
+        phase.commit_verified(token, drafted, kept, current_pos);
+        if (finished) {
+            if (!done) {
+                return std::unexpected(done.error());
+            }
+            return {};
         }
+    }
+}
 
-        if (token_count >= effective_max || current_pos >= impl.loaded_.context_size) {
-            break;
+Expected<void> run_plain_loop(Model::Impl& impl, const InferencePhase& phase,
+                              GenerationSink& sink, int current_pos) {
+    auto ar_batch = phase.batch_arena.borrow(1);
+    while (true) {
+        auto decoded = phase.decode();
+        if (!decoded) {
+            return std::unexpected(decoded.error());
+        }
+        auto done = sink.accept(*decoded);
+        if (!done) {
+            return std::unexpected(done.error());
+        }
+        if (*done ||
+            (current_pos >= impl.loaded_.context_size && !shift_context(impl, current_pos))) {
+            return {};
         }
 
         if (auto result = phase.finalize(ar_batch.get(), decoded->token, current_pos); !result) {
             return std::unexpected(result.error());
         }
     }
+}
 
-    if (!stopped_by_callback) {
-        if (auto flush = flush_visible_chunk(on_token, stream_filter); !flush) {
+// Samples like `run_plain_loop`, but whenever the schema grammar forces the
+// next output, that text is tokenized and decoded together with the sampled
+// token in one batch. Forced tokens are accepted into the sampler chain so
+// grammar and penalty state stay in step, and go through the sink like
+// sampled ones, so stop sequences, streaming and the token budget still apply.
+Expected<void> run_jump_forward_loop(Model::Impl& impl, const InferencePhase& phase,
+                                     GenerationSink& sink, int current_pos,
+                                     const ForcedContinuation& forced_continuation,
+                                     InferenceOutput& output) {
+    const int context_size = impl.loaded_.context_size;
+    const int n_batch = static_cast<int>(llama_n_batch(phase.phase_ctx.ctx));
+    auto batch = phase.batch_arena.borrow(n_batch);
+    // Tokens for the next decode: the sampled token, if any, then forced ones.
+    std::vector<int> pending;
+
+    // Appends forced tokens to `pending`; returns true when one ends generation.
+    // That token stays out of the KV sequence, as the final sampled token does
+    // in the plain loop.
+    const auto append_forced = [&]() -> Expected<bool> {
+        const int room = std::min({n_batch - static_cast<int>(pending.size()),
+                                   context_size - current_pos - static_cast<int>(pending.size()),
+                                   sink.effective_max - sink.token_count});
+        if (room <= 0) {
+            return false;
+        }
+        const std::string text = forced_continuation(sink.generated_text);
+        if (text.empty()) {
+            return false;
+        }
+        auto forced =
+            tokenize_into(impl.loaded_.vocab, text, impl.session_.token_buffer, false);
+        if (!forced) {
+            return std::unexpected(forced.error());
+        }
+        const size_t count = std::min(forced->size(), static_cast<size_t>(room));
+        for (size_t i = 0; i < count; ++i) {
+            auto piece = phase.accept_forced(static_cast<llama_token>((*forced)[i]));
+            if (!piece) {
+                return std::unexpected(piece.error());
+            }
+            ++output.forced_tokens;
+            auto done = sink.accept(*piece);
+            if (!done || *done) {
+                return done;
+            }
+            pending.push_back((*forced)[i]);
+        }
+        return false;
+    };
+
+    auto finished = append_forced();
+    while (true) {
+        if (!finished) {
+            return std::unexpected(finished.error());
+        }
+        if (!pending.empty()) {
+            if (auto result = phase.advance(batch.get(), pending, current_pos); !result) {
+                return std::unexpected(result.error());
+            }
+        }
+        if (*finished) {
+            return {};
+        }
+
+        auto decoded = phase.decode();
+        if (!decoded) {
+            return std::unexpected(decoded.error());
+        }
+        auto done = sink.accept(*decoded);
+        if (!done) {
+            return std::unexpected(done.error());
+        }
+        if (*done || (current_pos >= context_size && !shift_context(impl, current_pos))) {
+            return {};
+        }
+
+        pending.assign(1, static_cast<int>(decoded->token));
+        finished = append_forced();
+    }
+}
+
+} // namespace
+
+Expected<InferenceOutput> run_inference(Model::Impl& impl, const std::vector<int>& prompt_tokens,
+                                        int max_tokens,
+                                        const std::vector<std::string>& stop_sequences,
+                                        const SpeculativeOptions& speculative,
+                                        TokenCallback on_token,
+                                        CancellationCallback should_cancel) {
+    GenerationSink sink = make_generation_sink(impl, on_token, stop_sequences, max_tokens);
+
+    InferencePhase phase{InferenceCtx{impl.session_.ctx(), impl.session_.sampler.get(),
+                                      impl.loaded_.vocab, impl.loaded_.context_size,
+                                      impl.session_.seq_id},
+                         should_cancel, impl.session_.prompt_state.kv_tokens,
+                         impl.session_.batch_arena};
+    auto current_pos_result = phase.prefill(prompt_tokens);
+    if (!current_pos_result) {
+        return std::unexpected(current_pos_result.error());
+    }
+
+    const int current_pos = *current_pos_result;
+    InferenceOutput output;
+    Expected<void> loop_result;
+    if (speculative.mode == SpeculativeMode::PromptLookup) {
+        // The resident sequence already holds the prompt and every committed
+        // output token, so lookups see both.
+        const auto propose = [&](llama_token token, int limit) {
+            return find_prompt_lookup_draft(phase.kv_tokens, static_cast<int>(token),
+                                            static_cast<size_t>(speculative.ngram_size),
+                                            static_cast<size_t>(limit));
+        };
+        loop_result = run_speculative_loop(impl, phase, sink, current_pos,
+                                           speculative.max_draft_tokens, propose, output);
+    } else if (speculative.mode == SpeculativeMode::Default && impl.session_.draft) {
+        const auto propose = [&](llama_token token, int limit) {
+            return propose_draft_tokens(impl, phase.kv_tokens, static_cast<int>(token), limit);
+        };
+        loop_result = run_speculative_loop(impl, phase, sink, current_pos,
+                                           impl.loaded_.model_config.draft_tokens, propose, output);
+    } else if (const auto& policy = impl.session_.sampler_policy;
+               policy.is_schema() && policy.forced_continuation) {
+        loop_result = run_jump_forward_loop(impl, phase, sink, current_pos,
+                                            policy.forced_continuation, output);
+    } else {
+        loop_result = run_plain_loop(impl, phase, sink, current_pos);
+    }
+    if (!loop_result) {
+        return std::unexpected(loop_result.error());
+    }
+
+    if (!sink.stopped_by_callback) {
+        if (auto flush = flush_visible_chunk(on_token, sink.stream_filter); !flush) {
             return std::unexpected(flush.error());
         }
     }
 
-    return generated_text;
+    output.text = std::move(sink.generated_text);
+    return output;
+}
+
+Expected<int> decode_sequence_step(llama_context* ctx, llama_batch& batch,
+                                   std::span<SequenceCursor> cursors) {
+    const int packed = pack_continuous_batch(batch, cursors, static_cast<int>(llama_n_batch(ctx)));
+    if (packed > 0 && llama_decode(ctx, batch) != 0) {
+        return std::unexpected(
+            Error{ErrorCode::InferenceFailed, "Failed to decode continuous batch"});
+    }
+    return packed;
 }
 
 Expected<TextResponse> Model::generate(std::string_view user_message, GenerationOverride generation,
@@ -288,7 +594,7 @@ Expected<TextResponse> Model::generate(MessageView message, GenerationOverride g
         return TokenAction::Continue;
     };
 
-    auto prompt_result = render_prompt_delta(*impl_);
+    auto prompt_result = render_prompt(*impl_);
     if (!prompt_result) {
         rollback_last_message(*impl_);
         return std::unexpected(prompt_result.error());
@@ -299,25 +605,29 @@ Expected<TextResponse> Model::generate(MessageView message, GenerationOverride g
         return std::unexpected(rebuild.error());
     }
 
-    auto tokens_result = tokenize(*impl_, *prompt_result);
+    auto tokens_result = prepare_prompt_tokens(*impl_, *prompt_result);
     if (!tokens_result) {
         rollback_last_message(*impl_);
         return std::unexpected(tokens_result.error());
     }
 
     const int prompt_tokens = static_cast<int>(tokens_result->size());
+    const size_t prompt_positions =
+        impl_->session_.prompt_state.kv_tokens.size() + tokens_result->size();
 
     auto all_stops = merge_stop_sequences(*impl_, effective_options.stop_sequences);
 
     auto generate_result = run_inference(*impl_, *tokens_result, effective_options.max_tokens,
-                                         all_stops, TokenCallback(wrapped_callback), should_cancel);
+                                         all_stops, effective_options.speculative,
+                                         TokenCallback(wrapped_callback), should_cancel);
 
     if (!generate_result) {
         rollback_last_message(*impl_);
         return std::unexpected(generate_result.error());
     }
+    record_prompt_tokens(*impl_, prompt_positions);
 
-    std::string generated_text = std::move(*generate_result);
+    std::string generated_text = std::move(generate_result->text);
 
     // When native tool calling is active, parse the output to extract
     // structured tool calls for proper history round-tripping.
@@ -333,16 +643,16 @@ Expected<TextResponse> Model::generate(MessageView message, GenerationOverride g
         impl_->session_.messages.push_back(Message::assistant(std::move(generated_text)));
     }
 
+    // Provisional until the next prefill calibrates it against the rendered prompt.
+    Model::Impl::MessageTokens reply_tokens;
     if (!impl_->session_.sampler_policy.is_native_tool_call() && all_stops.empty() &&
         completion_tokens > 0) {
-        impl_->session_.estimated_tokens +=
-            completion_tokens + Model::Impl::kTemplateOverheadPerMessage;
+        reply_tokens.count = completion_tokens + Model::Impl::kTemplateOverheadPerMessage;
     } else {
-        impl_->session_.estimated_tokens +=
-            estimate_message_tokens(*impl_, impl_->session_.messages.back());
+        reply_tokens.count = estimate_message_tokens(*impl_, impl_->session_.messages.back());
     }
-    note_history_append(*impl_);
-    finalize_response();
+    impl_->session_.message_tokens.push_back(reply_tokens);
+    impl_->session_.estimated_tokens += reply_tokens.count;
 
     auto end_time = std::chrono::steady_clock::now();
 
@@ -366,58 +676,154 @@ Expected<TextResponse> Model::generate(MessageView message, GenerationOverride g
         }
     }
 
+    response.metrics.draft_tokens_proposed = generate_result->draft_tokens_proposed;
+    response.metrics.draft_tokens_accepted = generate_result->draft_tokens_accepted;
+    if (generate_result->draft_tokens_proposed > 0) {
+        response.metrics.draft_acceptance_rate =
+            static_cast<double>(generate_result->draft_tokens_accepted) /
+            generate_result->draft_tokens_proposed;
+    }
+    response.metrics.forced_tokens = generate_result->forced_tokens;
+
     return response;
 }
 
-Expected<Model::GenerationResult> Model::generate_from_history(GenerationOverride generation,
-                                                               TokenCallback on_token,
-                                                               CancellationCallback should_cancel) {
-    auto effective_options = resolve_generation_options(*impl_, generation);
+namespace {
+
+// Tool call detection: if tool calling is active, parse the output and
+// return the structured result so callers avoid a redundant re-parse.
+Model::GenerationResult make_generation_result(Model& model, const Model::Impl& impl,
+                                               InferenceOutput output, int prompt_tokens) {
+    bool tool_detected = false;
+    std::string parsed_content;
+    std::vector<ToolCallInfo> parsed_tool_calls;
+    if (impl.session_.sampler_policy.is_native_tool_call()) {
+        auto parsed = model.parse_tool_response(output.text);
+        tool_detected = !parsed.tool_calls.empty();
+        parsed_content = std::move(parsed.content);
+        parsed_tool_calls = std::move(parsed.tool_calls);
+    }
+
+    return Model::GenerationResult{std::move(output.text),
+                                   prompt_tokens,
+                                   tool_detected,
+                                   std::move(parsed_content),
+                                   std::move(parsed_tool_calls),
+                                   output.draft_tokens_proposed,
+                                   output.draft_tokens_accepted,
+                                   output.forced_tokens};
+}
+
+// Shared body of generate_from_history() and generate_from_prepared().
+// `prepared` is used instead of rendering unless native tool calling needs
+// the render's tool grammar and parser state.
+Expected<Model::GenerationResult> generate_pass(Model& model, Model::Impl& impl,
+                                                const std::span<const int>* prepared,
+                                                GenerationOverride generation,
+                                                TokenCallback on_token,
+                                                CancellationCallback should_cancel) {
+    auto effective_options = resolve_generation_options(impl, generation);
     if (auto validation = effective_options.validate(); !validation) {
         return std::unexpected(validation.error());
     }
 
-    impl_->session_.active_sampling = effective_options.sampling;
+    impl.session_.active_sampling = effective_options.sampling;
 
-    auto prompt_result = render_prompt_delta(*impl_);
-    if (!prompt_result) {
-        return std::unexpected(prompt_result.error());
+    const bool render = prepared == nullptr || impl.session_.sampler_policy.is_native_tool_call();
+    Expected<std::string> prompt_result;
+    if (render) {
+        prompt_result = render_prompt(impl);
+        if (!prompt_result) {
+            return std::unexpected(prompt_result.error());
+        }
     }
 
-    if (auto rebuild = ensure_grammar_sampler_for_pass(*impl_); !rebuild) {
+    if (auto rebuild = ensure_grammar_sampler_for_pass(impl); !rebuild) {
         return std::unexpected(rebuild.error());
     }
 
-    auto tokens_result = tokenize(*impl_, *prompt_result);
+    auto tokens_result = render
+                             ? prepare_prompt_tokens(impl, *prompt_result)
+                             : Expected<std::vector<int>>(reuse_prepared_tokens(impl, *prepared));
     if (!tokens_result) {
         return std::unexpected(tokens_result.error());
     }
 
     const int prompt_tokens = static_cast<int>(tokens_result->size());
+    const size_t prompt_positions =
+        impl.session_.prompt_state.kv_tokens.size() + tokens_result->size();
 
-    auto all_stops = merge_stop_sequences(*impl_, effective_options.stop_sequences);
+    auto all_stops = merge_stop_sequences(impl, effective_options.stop_sequences);
 
-    auto text_result = run_inference(*impl_, *tokens_result, effective_options.max_tokens,
-                                     all_stops, on_token, should_cancel);
+    auto text_result = run_inference(impl, *tokens_result, effective_options.max_tokens,
+                                     all_stops, effective_options.speculative, on_token,
+                                     should_cancel);
 
     if (!text_result) {
         return std::unexpected(text_result.error());
     }
+    record_prompt_tokens(impl, prompt_positions);
+    return make_generation_result(model, impl, std::move(*text_result), prompt_tokens);
+}
 
-    // Tool call detection: if tool calling is active, parse the output and
-    // return the structured result so callers avoid a redundant re-parse.
-    bool tool_detected = false;
-    std::string parsed_content;
-    std::vector<ToolCallInfo> parsed_tool_calls;
-    if (impl_->session_.sampler_policy.is_native_tool_call()) {
-        auto parsed = parse_tool_response(*text_result);
-        tool_detected = !parsed.tool_calls.empty();
-        parsed_content = std::move(parsed.content);
-        parsed_tool_calls = std::move(parsed.tool_calls);
+} // namespace
+
+Expected<Model::GenerationResult> Model::generate_from_history(GenerationOverride generation,
+                                                               TokenCallback on_token,
+                                                               CancellationCallback should_cancel) {
+    return generate_pass(*this, *impl_, nullptr, generation, std::move(on_token),
+                         std::move(should_cancel));
+}
+
+Expected<Model::GenerationResult>
+Model::generate_from_prepared(std::span<const int> prompt_tokens, GenerationOverride generation,
+                              TokenCallback on_token, CancellationCallback should_cancel) {
+    return generate_pass(*this, *impl_, &prompt_tokens, generation, std::move(on_token),
+                         std::move(should_cancel));
+}
+
+Expected<int> Model::prefill_history(Role next_role, std::string_view tool_call_id,
+                                     CancellationCallback should_cancel) {
+    // Render a placeholder message after the history and cut the prompt where
+    // its content starts; everything before it is what the next pass renders.
+    static constexpr std::string_view kPlaceholder = "<zoo-prefill-placeholder>";
+    std::vector<Message> messages = impl_->session_.messages;
+    Message placeholder{next_role, std::string(kPlaceholder), std::string(tool_call_id), {}};
+    messages.push_back(std::move(placeholder));
+
+    const bool native_tools =
+        impl_->session_.sampler_policy.is_native_tool_call() && impl_->session_.tool_state;
+    auto rendered = apply_chat_template(impl_->loaded_, messages,
+                                        native_tools ? impl_->session_.tool_state.get() : nullptr);
+    if (!rendered) {
+        return std::unexpected(rendered.error());
+    }
+    const size_t cut = rendered->prompt.rfind(kPlaceholder);
+    if (cut == std::string::npos) {
+        return 0;
+    }
+
+    auto tokens = tokenize(*impl_, std::string_view(rendered->prompt).substr(0, cut));
+    if (!tokens) {
+        return std::unexpected(tokens.error());
+    }
+    auto& kv_tokens = impl_->session_.prompt_state.kv_tokens;
+    if (common_token_prefix(kv_tokens, *tokens) == tokens->size()) {
+        return 0;
     }
 
-    return GenerationResult{std::move(*text_result), prompt_tokens, tool_detected,
-                            std::move(parsed_content), std::move(parsed_tool_calls)};
+    // The tail token may merge with the real content once it is known; the
+    // next pass's token diff re-decodes from wherever the two diverge.
+    const size_t reused = reuse_resident_prefix(*impl_, *tokens);
+    const std::span<const int> pending = std::span<const int>(*tokens).subspan(reused);
+    InferencePhase phase{InferenceCtx{impl_->session_.ctx(), impl_->session_.sampler.get(),
+                                      impl_->loaded_.vocab, impl_->loaded_.context_size,
+                                      impl_->session_.seq_id},
+                         should_cancel, kv_tokens, impl_->session_.batch_arena};
+    if (auto prefilled = phase.prefill(pending); !prefilled) {
+        return std::unexpected(prefilled.error());
+    }
+    return static_cast<int>(pending.size());
 }
 
 Expected<void> ensure_grammar_sampler_for_pass(Model::Impl& impl) {
@@ -441,4 +847,249 @@ GenerationOptions resolve_generation_options(const Model::Impl& impl,
     return *generation.options();
 }
 
+// A lane runs while its sink is engaged. `cursors` is parallel to `lanes` so
+// that a step packs every lane from one span.
+struct ContinuousBatch::State {
+    struct Lane {
+        std::unique_ptr<Model> session;
+        Model::Impl* impl = nullptr;
+        TokenCallback on_token;
+        CancellationCallback should_cancel;
+        std::vector<std::string> stop_sequences;
+        std::optional<GenerationSink> sink;
+        int prompt_tokens = 0;
+        size_t prompt_positions = 0;
+    };
+
+    std::vector<Lane> lanes;
+    std::vector<SequenceCursor> cursors;
+    BatchArena batch_arena;
+
+    // Ends `lane`'s pass: flushes held-back output and assembles the result.
+    Expected<Model::GenerationResult> complete(Lane& lane) {
+        GenerationSink& sink = *lane.sink;
+        if (!sink.stopped_by_callback) {
+            if (auto flush = flush_visible_chunk(lane.on_token, sink.stream_filter); !flush) {
+                return std::unexpected(flush.error());
+            }
+        }
+        record_prompt_tokens(*lane.impl, lane.prompt_positions);
+        InferenceOutput output;
+        output.text = std::move(sink.generated_text);
+        return make_generation_result(*lane.session, *lane.impl, std::move(output),
+                                      lane.prompt_tokens);
+    }
+
+    // Appends the tokens of a decoded batch to their lanes' resident tokens.
+    void record_decoded(const llama_batch& batch) {
+        for (int row = 0; row < batch.n_tokens; ++row) {
+            for (size_t index = 0; index < cursors.size(); ++index) {
+                if (cursors[index].seq_id == batch.seq_id[row][0]) {
+                    lanes[index].impl->session_.prompt_state.kv_tokens.push_back(
+                        static_cast<int>(batch.token[row]));
+                    break;
+                }
+            }
+        }
+    }
+};
+
+ContinuousBatch::ContinuousBatch(std::unique_ptr<State> state) : state_(std::move(state)) {}
+
+ContinuousBatch::~ContinuousBatch() = default;
+
+Expected<std::unique_ptr<ContinuousBatch>> ContinuousBatch::open(const Model& model,
+                                                                 size_t lanes) {
+    if (!model.impl_->loaded_.llama_model) {
+        return std::unexpected(Error{ErrorCode::BackendInitFailed,
+                                     "Cannot open a continuous batch on an unloaded model"});
+    }
+    if (lanes == 0) {
+        return std::unexpected(
+            Error{ErrorCode::InvalidConfig, "A continuous batch needs at least one lane"});
+    }
+
+    auto state = std::make_unique<State>();
+    std::vector<Model::Impl*> sessions;
+    for (size_t index = 0; index < lanes; ++index) {
+        State::Lane lane;
+        lane.session = std::unique_ptr<Model>(
+            new Model(std::make_unique<Model::Impl>(model.impl_->loaded_owner_)));
+        lane.impl = lane.session->impl_.get();
+        lane.impl->session_.sampler = create_sampler_chain(*lane.impl);
+        if (!lane.impl->session_.sampler) {
+            return std::unexpected(
+                Error{ErrorCode::BackendInitFailed, "Failed to create sampler chain"});
+        }
+        sessions.push_back(lane.impl);
+        state->lanes.push_back(std::move(lane));
+    }
+    if (auto leased = lease_batch_sequences(sessions); !leased) {
+        return std::unexpected(leased.error());
+    }
+
+    state->cursors.resize(lanes);
+    for (size_t index = 0; index < lanes; ++index) {
+        state->cursors[index].seq_id = sessions[index]->session_.seq_id;
+    }
+    llama_context* ctx = sessions.front()->session_.ctx();
+    state->batch_arena = BatchArena(static_cast<int>(llama_n_batch(ctx)));
+    return std::unique_ptr<ContinuousBatch>(new ContinuousBatch(std::move(state)));
+}
+
+size_t ContinuousBatch::size() const noexcept {
+    return state_->lanes.size();
+}
+
+Model& ContinuousBatch::session(size_t lane) noexcept {
+    return *state_->lanes[lane].session;
+}
+
+bool ContinuousBatch::running(size_t lane) const noexcept {
+    return lane < state_->lanes.size() && state_->lanes[lane].sink.has_value();
+}
+
+bool ContinuousBatch::idle() const noexcept {
+    return std::none_of(state_->lanes.begin(), state_->lanes.end(),
+                        [](const State::Lane& lane) { return lane.sink.has_value(); });
+}
+
+Expected<void> ContinuousBatch::start(size_t lane, GenerationOverride generation,
+                                      TokenCallback on_token, CancellationCallback should_cancel) {
+    return start_pass(lane, nullptr, generation, on_token, should_cancel);
+}
+
+Expected<void> ContinuousBatch::start(size_t lane, std::span<const int> prompt_tokens,
+                                      GenerationOverride generation, TokenCallback on_token,
+                                      CancellationCallback should_cancel) {
+    return start_pass(lane, &prompt_tokens, generation, on_token, should_cancel);
+}
+
+Expected<void> ContinuousBatch::start_pass(size_t lane, const std::span<const int>* prepared,
+                                           GenerationOverride generation, TokenCallback on_token,
+                                           CancellationCallback should_cancel) {
+    if (lane >= size() || running(lane)) {
+        return std::unexpected(Error{ErrorCode::InferenceFailed,
+                                     "Continuous batch lane " + std::to_string(lane) +
+                                         " is not free"});
+    }
+
+    auto& slot = state_->lanes[lane];
+    Model::Impl& impl = *slot.impl;
+    auto effective_options = resolve_generation_options(impl, generation);
+    if (auto validation = effective_options.validate(); !validation) {
+        return std::unexpected(validation.error());
+    }
+    impl.session_.active_sampling = effective_options.sampling;
+
+    Expected<std::string> prompt_result;
+    if (prepared == nullptr) {
+        prompt_result = render_prompt(impl);
+        if (!prompt_result) {
+            return std::unexpected(prompt_result.error());
+        }
+    }
+    if (auto rebuild = ensure_grammar_sampler_for_pass(impl); !rebuild) {
+        return std::unexpected(rebuild.error());
+    }
+    auto tokens_result = prepared == nullptr
+                             ? prepare_prompt_tokens(impl, *prompt_result)
+                             : Expected<std::vector<int>>(reuse_prepared_tokens(impl, *prepared));
+    if (!tokens_result) {
+        return std::unexpected(tokens_result.error());
+    }
+
+    const auto& kv_tokens = impl.session_.prompt_state.kv_tokens;
+    if (kv_tokens.size() + tokens_result->size() > static_cast<size_t>(impl.loaded_.context_size)) {
+        return std::unexpected(
+            Error{ErrorCode::ContextWindowExceeded, "Prompt tokens exceed context size"});
+    }
+
+    slot.prompt_tokens = static_cast<int>(tokens_result->size());
+    slot.prompt_positions = kv_tokens.size() + tokens_result->size();
+    slot.on_token = on_token;
+    slot.should_cancel = should_cancel;
+    slot.stop_sequences =
+        merge_stop_sequences(impl, std::move(effective_options.stop_sequences));
+    slot.sink.emplace(make_generation_sink(impl, slot.on_token, slot.stop_sequences,
+                                           effective_options.max_tokens));
+
+    auto& cursor = state_->cursors[lane];
+    cursor.next_pos =
+        llama_memory_seq_pos_max(llama_get_memory(impl.session_.ctx()), impl.session_.seq_id) + 1;
+    cursor.pending = std::move(*tokens_result);
+    cursor.consumed = 0;
+    cursor.logits_index = -1;
+    return {};
+}
+
+std::vector<ContinuousBatch::Finished> ContinuousBatch::step() {
+    auto& lanes = state_->lanes;
+    auto& cursors = state_->cursors;
+    std::vector<Finished> finished;
+    const auto finish = [&](size_t lane, Expected<Model::GenerationResult> result) {
+        lanes[lane].sink.reset();
+        cursors[lane].pending.clear();
+        cursors[lane].consumed = 0;
+        finished.push_back(Finished{lane, std::move(result)});
+    };
+
+    for (size_t lane = 0; lane < lanes.size(); ++lane) {
+        if (running(lane) && lanes[lane].should_cancel && lanes[lane].should_cancel()) {
+            finish(lane, std::unexpected(Error{ErrorCode::RequestCancelled,
+                                               "Request cancelled during generation"}));
+        }
+    }
+    if (idle()) {
+        return finished;
+    }
+
+    llama_context* ctx = lanes.front().impl->session_.ctx();
+    auto batch = state_->batch_arena.borrow(state_->batch_arena.capacity());
+    if (auto decoded = decode_sequence_step(ctx, batch.get(), cursors); !decoded) {
+        // The failed step may have written cells of any running sequence.
+        for (size_t lane = 0; lane < lanes.size(); ++lane) {
+            if (running(lane)) {
+                clear_kv_cache(*lanes[lane].impl);
+                finish(lane, std::unexpected(decoded.error()));
+            }
+        }
+        return finished;
+    }
+    state_->record_decoded(batch.get());
+
+    // Drained lanes sample their next token; the others are still prefilling.
+    for (size_t lane = 0; lane < lanes.size(); ++lane) {
+        auto& cursor = cursors[lane];
+        if (!running(lane) || cursor.logits_index < 0) {
+            continue;
+        }
+        auto& slot = lanes[lane];
+        Model::Impl& impl = *slot.impl;
+        InferencePhase phase{InferenceCtx{ctx, impl.session_.sampler.get(), impl.loaded_.vocab,
+                                          impl.loaded_.context_size, impl.session_.seq_id},
+                             slot.should_cancel, impl.session_.prompt_state.kv_tokens,
+                             impl.session_.batch_arena};
+        auto decoded = phase.decode(cursor.logits_index);
+        if (!decoded) {
+            finish(lane, std::unexpected(decoded.error()));
+            continue;
+        }
+        auto done = slot.sink->accept(*decoded);
+        if (!done) {
+            finish(lane, std::unexpected(done.error()));
+            continue;
+        }
+
+        int next_pos = static_cast<int>(cursor.next_pos);
+        if (*done || (next_pos >= impl.loaded_.context_size && !shift_context(impl, next_pos))) {
+            finish(lane, state_->complete(slot));
+            continue;
+        }
+        cursor.next_pos = static_cast<llama_pos>(next_pos);
+        cursor.pending.assign(1, static_cast<int>(decoded->token));
+    }
+    return finished;
+}
+
 } // namespace zoo::core
@@ -3,21 +3,299 @@
  * @brief Backend initialization and tokenization for `zoo::core::Model`.
  */
 
+#include "core/kv_cache.hpp"
 #include "core/model_impl.hpp"
 #include "zoo/core/model.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chat.h>
 #include <climits>
+#include <common.h>
 #include <cstdint>
 #include <cstdio>
+#include <ggml-cpu.h>
+#include <iterator>
 #include <llama.h>
 #include <log.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
 
 namespace zoo::core {
 
+namespace {
+
+ggml_numa_strategy to_ggml_numa(NumaStrategy strategy) {
+    switch (strategy) {
+    case NumaStrategy::Disabled:
+        return GGML_NUMA_STRATEGY_DISABLED;
+    case NumaStrategy::Distribute:
+        return GGML_NUMA_STRATEGY_DISTRIBUTE;
+    case NumaStrategy::Isolate:
+        return GGML_NUMA_STRATEGY_ISOLATE;
+    case NumaStrategy::Numactl:
+        return GGML_NUMA_STRATEGY_NUMACTL;
+    case NumaStrategy::Mirror:
+        return GGML_NUMA_STRATEGY_MIRROR;
+    }
+    return GGML_NUMA_STRATEGY_DISABLED;
+}
+
+// ggml keeps NUMA placement in process-wide state, so only the first model
+// that asks for a strategy gets to choose it.
+void initialize_numa(NumaStrategy strategy) {
+    if (strategy == NumaStrategy::Disabled) {
+        return;
+    }
+    static std::once_flag flag;
+    std::call_once(flag, [strategy] { llama_numa_init(to_ggml_numa(strategy)); });
+}
+
+llama_flash_attn_type to_llama_flash_attn(FlashAttention mode) {
+    switch (mode) {
+    case FlashAttention::Auto:
+        return LLAMA_FLASH_ATTN_TYPE_AUTO;
+    case FlashAttention::Enabled:
+        return LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    case FlashAttention::Disabled:
+        return LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    }
+    return LLAMA_FLASH_ATTN_TYPE_AUTO;
+}
+
+const std::string& batch_cpu_mask(const ModelConfig& config) {
+    return config.cpu_mask_batch.empty() ? config.cpu_mask : config.cpu_mask_batch;
+}
+
+// Threads for one phase: the configured count, else one per core in the
+// phase's mask, else -1 to keep llama.cpp's default.
+int resolve_thread_count(int configured, const std::string& mask) {
+    if (configured > 0) {
+        return configured;
+    }
+    bool cores[GGML_MAX_N_THREADS] = {};
+    if (mask.empty() || !parse_cpu_mask(mask, cores)) {
+        return -1;
+    }
+    const auto pinned = std::count(std::begin(cores), std::end(cores), true);
+    return pinned > 0 ? static_cast<int>(pinned) : -1;
+}
+
+Expected<GgmlThreadpoolHandle> create_threadpool(const std::string& mask, int n_threads) {
+    auto params = ggml_threadpool_params_default(std::max(n_threads, 1));
+    if (!parse_cpu_mask(mask, params.cpumask)) {
+        return std::unexpected(Error{ErrorCode::InvalidConfig, "Invalid CPU mask", mask});
+    }
+    params.strict_cpu = true;
+
+    auto threadpool = GgmlThreadpoolHandle(ggml_threadpool_new(&params));
+    if (!threadpool) {
+        return std::unexpected(
+            Error{ErrorCode::ContextCreationFailed, "Failed to create CPU threadpool", mask});
+    }
+    return threadpool;
+}
+
+// Builds pinned threadpools for the phases that have a CPU mask; unpinned
+// phases keep null handles.
+Expected<ContextThreadpools> create_threadpools(const ModelConfig& config) {
+    ContextThreadpools threadpools;
+    if (!config.cpu_mask.empty()) {
+        auto decode = create_threadpool(
+            config.cpu_mask, resolve_thread_count(config.n_threads, config.cpu_mask));
+        if (!decode) {
+            return std::unexpected(decode.error());
+        }
+        threadpools.decode = std::move(*decode);
+    }
+    if (const auto& mask = batch_cpu_mask(config); !mask.empty()) {
+        auto batch = create_threadpool(mask, resolve_thread_count(config.n_threads_batch, mask));
+        if (!batch) {
+            return std::unexpected(batch.error());
+        }
+        threadpools.batch = std::move(*batch);
+    }
+    return threadpools;
+}
+
+// Creates a context on `model` and attaches any pinned threadpools to it.
+Expected<LlamaContextHandle> create_context(llama_model* model,
+                                            const llama_context_params& ctx_params,
+                                            const ContextThreadpools& threadpools) {
+    auto ctx = LlamaContextHandle(llama_init_from_model(model, ctx_params));
+    if (!ctx) {
+        return std::unexpected(
+            Error{ErrorCode::ContextCreationFailed, "Failed to create llama context"});
+    }
+    if (threadpools.decode || threadpools.batch) {
+        llama_attach_threadpool(ctx.get(), threadpools.decode.get(), threadpools.batch.get());
+    }
+    return ctx;
+}
+
+// Every sequence gets its own full window; a non-unified cache splits n_ctx
+// evenly across n_seq_max.
+llama_context_params make_context_params(const ModelConfig& config, int sequences) {
+    auto ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = static_cast<uint32_t>(config.context_size * sequences);
+    ctx_params.n_seq_max = static_cast<uint32_t>(sequences);
+    ctx_params.kv_unified = false;
+    ctx_params.n_batch = static_cast<uint32_t>(config.n_batch);
+    ctx_params.n_ubatch = static_cast<uint32_t>(std::min(config.n_ubatch, config.n_batch));
+    ctx_params.n_threads = resolve_thread_count(config.n_threads, config.cpu_mask);
+    ctx_params.n_threads_batch =
+        resolve_thread_count(config.n_threads_batch, batch_cpu_mask(config));
+    ctx_params.flash_attn_type = to_llama_flash_attn(config.flash_attn);
+    if (config.n_gpu_layers == 0) {
+        ctx_params.offload_kqv = false;
+        ctx_params.op_offload = false;
+    } else {
+        ctx_params.offload_kqv = config.offload_kqv;
+    }
+    ctx_params.type_k = to_ggml_type(config.cache_type_k);
+    ctx_params.type_v = to_ggml_type(config.cache_type_v);
+    return ctx_params;
+}
+
+Expected<std::shared_ptr<Model::Impl::SharedContext>>
+create_shared_context(const Model::Impl::LoadedModel& loaded, int sequences) {
+    auto threadpools = create_threadpools(loaded.model_config);
+    if (!threadpools) {
+        return std::unexpected(threadpools.error());
+    }
+    auto ctx = create_context(loaded.llama_model.get(),
+                              make_context_params(loaded.model_config, sequences), *threadpools);
+    if (!ctx) {
+        return std::unexpected(ctx.error());
+    }
+
+    auto shared = std::make_shared<Model::Impl::SharedContext>();
+    shared->threadpools = std::move(*threadpools);
+    shared->ctx = std::move(*ctx);
+    shared->leased.assign(static_cast<size_t>(sequences), false);
+    return shared;
+}
+
+// Marks the first free sequence in `shared` as leased; caller holds no lock.
+std::optional<llama_seq_id> try_lease(Model::Impl::SharedContext& shared) {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (size_t seq = 0; seq < shared.leased.size(); ++seq) {
+        if (!shared.leased[seq]) {
+            shared.leased[seq] = true;
+            return static_cast<llama_seq_id>(seq);
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+Model::Impl::Session::~Session() {
+    if (!context) {
+        return;
+    }
+    if (context->ctx) {
+        llama_memory_seq_rm(llama_get_memory(context->ctx.get()), seq_id, -1, -1);
+    }
+    std::lock_guard<std::mutex> lock(context->mutex);
+    if (static_cast<size_t>(seq_id) < context->leased.size()) {
+        context->leased[static_cast<size_t>(seq_id)] = false;
+    }
+}
+
+Expected<void> lease_sequence(Model::Impl& impl, SessionPlacement placement) {
+    auto& loaded = impl.loaded_;
+    impl.session_.batch_arena = BatchArena(loaded.model_config.n_batch);
+
+    if (placement == SessionPlacement::DedicatedContext) {
+        auto shared = create_shared_context(loaded, 1);
+        if (!shared) {
+            return std::unexpected(shared.error());
+        }
+        (*shared)->leased[0] = true;
+        impl.session_.context = std::move(*shared);
+        impl.session_.seq_id = 0;
+        return {};
+    }
+
+    std::lock_guard<std::mutex> lock(loaded.contexts_mutex);
+    for (const auto& shared : loaded.contexts) {
+        if (auto seq = try_lease(*shared)) {
+            impl.session_.context = shared;
+            impl.session_.seq_id = *seq;
+            return {};
+        }
+    }
+
+    auto shared = create_shared_context(loaded, loaded.model_config.max_sequences);
+    if (!shared) {
+        return std::unexpected(shared.error());
+    }
+    (*shared)->leased[0] = true;
+    loaded.contexts.push_back(*shared);
+    impl.session_.context = std::move(*shared);
+    impl.session_.seq_id = 0;
+    return {};
+}
+
+Expected<void> lease_batch_sequences(std::span<Model::Impl* const> sessions) {
+    auto& loaded = sessions.front()->loaded_;
+    auto shared = create_shared_context(loaded, static_cast<int>(sessions.size()));
+    if (!shared) {
+        return std::unexpected(shared.error());
+    }
+    for (size_t seq = 0; seq < sessions.size(); ++seq) {
+        auto& session = sessions[seq]->session_;
+        session.batch_arena = BatchArena(loaded.model_config.n_batch);
+        (*shared)->leased[seq] = true;
+        session.context = *shared;
+        session.seq_id = static_cast<llama_seq_id>(seq);
+    }
+    return {};
+}
+
+Expected<void> attach_draft(Model::Impl& impl) {
+    const auto& loaded = impl.loaded_;
+    if (!loaded.draft_model) {
+        return {};
+    }
+
+    // The draft gets its own pools: a context's threadpool cannot serve two
+    // contexts that may compute at the same time.
+    auto threadpools = create_threadpools(loaded.model_config);
+    if (!threadpools) {
+        return std::unexpected(threadpools.error());
+    }
+    auto ctx = create_context(loaded.draft_model.get(), make_context_params(loaded.model_config, 1),
+                              *threadpools);
+    if (!ctx) {
+        return std::unexpected(Error{ErrorCode::ContextCreationFailed,
+                                     "Failed to create draft model context", ctx.error().message});
+    }
+
+    auto chain = LlamaSamplerHandle(llama_sampler_chain_init(llama_sampler_chain_default_params()));
+    if (!chain) {
+        return std::unexpected(
+            Error{ErrorCode::BackendInitFailed, "Failed to create draft sampler"});
+    }
+    // Drafts are verified by the target sampler, so greedy proposals suffice.
+    llama_sampler_chain_add(chain.get(), llama_sampler_init_greedy());
+
+    auto draft = std::make_unique<Model::Impl::DraftState>();
+    draft->threadpools = std::move(*threadpools);
+    draft->ctx = std::move(*ctx);
+    draft->sampler = std::move(chain);
+    draft->batch_arena = BatchArena(loaded.model_config.n_batch);
+    impl.session_.draft = std::move(draft);
+    return {};
+}
+
 Expected<void> initialize_model(Model::Impl& impl) {
     initialize_model_backend();
+    initialize_numa(impl.loaded_.model_config.numa);
 
     llama_log_set(
         [](enum ggml_log_level level, const char* text, void*) {
@@ -48,35 +326,29 @@ Expected<void> initialize_model(Model::Impl& impl) {
                   "Failed to load model from path: " + impl.loaded_.model_config.model_path});
     }
 
-    auto ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = static_cast<uint32_t>(impl.loaded_.model_config.context_size);
-    ctx_params.n_batch = static_cast<uint32_t>(impl.loaded_.model_config.n_batch);
-    ctx_params.n_ubatch = 512;
-    ctx_params.n_threads = -1;
-    ctx_params.n_threads_batch = -1;
-    ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
-    if (cpu_only) {
-        ctx_params.offload_kqv = false;
-        ctx_params.op_offload = false;
-    }
-    // F16 uses more memory than Q8, but avoids KV dequant overhead in decode.
-    ctx_params.type_k = GGML_TYPE_F16;
-    ctx_params.type_v = GGML_TYPE_F16;
-
-    auto ctx = LlamaContextHandle(llama_init_from_model(llama_model.get(), ctx_params));
-    if (!ctx) {
-        return std::unexpected(
-            Error{ErrorCode::ContextCreationFailed, "Failed to create llama context"});
-    }
-
-    const int context_size = static_cast<int>(llama_n_ctx(ctx.get()));
-
     const llama_vocab* vocab = llama_model_get_vocab(llama_model.get());
     if (!vocab) {
         return std::unexpected(
             Error{ErrorCode::BackendInitFailed, "Failed to get model vocabulary"});
     }
 
+    LlamaModelHandle draft_model;
+    if (const auto& draft_path = impl.loaded_.model_config.draft_model_path; !draft_path.empty()) {
+        draft_model =
+            LlamaModelHandle(llama_model_load_from_file(draft_path.c_str(), model_params));
+        if (!draft_model) {
+            return std::unexpected(Error{ErrorCode::ModelLoadFailed,
+                                         "Failed to load draft model from path: " + draft_path});
+        }
+        const llama_vocab* draft_vocab = llama_model_get_vocab(draft_model.get());
+        if (!draft_vocab || llama_vocab_type(draft_vocab) != llama_vocab_type(vocab) ||
+            llama_vocab_n_tokens(draft_vocab) != llama_vocab_n_tokens(vocab)) {
+            return std::unexpected(Error{ErrorCode::ModelLoadFailed,
+                                         "Draft model vocabulary does not match the target model",
+                                         draft_path});
+        }
+    }
+
     auto sampler = create_sampler_chain(impl);
     if (!sampler) {
         return std::unexpected(
@@ -91,45 +363,60 @@ Expected<void> initialize_model(Model::Impl& impl) {
             Error{ErrorCode::TemplateRenderFailed, "Model has no chat template"});
     }
 
-    impl.session_.prompt_state = {};
-
     impl.loaded_.llama_model = std::move(llama_model);
-    impl.session_.ctx = std::move(ctx);
-    impl.session_.sampler = std::move(sampler);
-    impl.loaded_.context_size = context_size;
+    impl.loaded_.draft_model = std::move(draft_model);
     impl.loaded_.vocab = vocab;
     impl.loaded_.chat_templates = std::move(chat_tmpls);
 
+    if (auto leased = lease_sequence(impl, SessionPlacement::SharedContext); !leased) {
+        return std::unexpected(leased.error());
+    }
+    if (auto drafted = attach_draft(impl); !drafted) {
+        return std::unexpected(drafted.error());
+    }
+
+    impl.session_.prompt_state = {};
+    impl.session_.sampler = std::move(sampler);
+    impl.loaded_.context_size = static_cast<int>(llama_n_ctx(impl.session_.ctx())) /
+                                impl.loaded_.model_config.max_sequences;
+
     return {};
 }
 
 Expected<std::vector<int>> tokenize(Model::Impl& impl, std::string_view text) {
+    return tokenize_into(impl.loaded_.vocab, text, impl.session_.token_buffer);
+}
+
+Expected<std::vector<int>> tokenize_into(const llama_vocab* vocab, std::string_view text,
+                                         std::vector<int>& buffer, bool prompt) {
     static_assert(sizeof(int) == sizeof(llama_token));
     static_assert(alignof(int) == alignof(llama_token));
     if (text.size() > static_cast<size_t>(INT32_MAX - 8)) {
         return std::unexpected(Error{ErrorCode::TokenizationFailed, "Tokenization overflow"});
     }
 
-    const bool is_first =
-        llama_memory_seq_pos_max(llama_get_memory(impl.session_.ctx.get()), 0) == -1;
+    // Prompts are always rendered in full from position zero, so BOS is
+    // added even when a matching prefix is still resident in the KV cache.
+    const bool is_first = prompt;
+    const bool parse_special = prompt;
 
     const int32_t text_len = static_cast<int32_t>(text.size());
     // This usually avoids a count-only tokenization pass while keeping the
     // exact-size retry for unusual tokenizers.
-    impl.session_.token_buffer.resize(static_cast<size_t>(text_len + 8));
-    int32_t n =
-        llama_tokenize(impl.loaded_.vocab, text.data(), text_len,
-                       reinterpret_cast<llama_token*>(impl.session_.token_buffer.data()),
-                       static_cast<int32_t>(impl.session_.token_buffer.size()), is_first, true);
+    buffer.resize(static_cast<size_t>(text_len + 8));
+    int32_t n = llama_tokenize(vocab, text.data(), text_len,
+                               reinterpret_cast<llama_token*>(buffer.data()),
+                               static_cast<int32_t>(buffer.size()), is_first, parse_special);
     if (n == INT32_MIN) {
         return std::unexpected(Error{ErrorCode::TokenizationFailed, "Tokenization overflow"});
     }
     if (n < 0) {
         n = -n;
-        impl.session_.token_buffer.resize(static_cast<size_t>(n));
-        const int32_t filled = llama_tokenize(
-            impl.loaded_.vocab, text.data(), text_len,
-            reinterpret_cast<llama_token*>(impl.session_.token_buffer.data()), n, is_first, true);
+        buffer.resize(static_cast<size_t>(n));
+        const int32_t filled =
+            llama_tokenize(vocab, text.data(), text_len,
+                           reinterpret_cast<llama_token*>(buffer.data()), n, is_first,
+                           parse_special);
         if (filled < 0) {
             return std::unexpected(Error{ErrorCode::TokenizationFailed, "Tokenization failed"});
         }
@@ -137,12 +424,12 @@ Expected<std::vector<int>> tokenize(Model::Impl& impl, std::string_view text) {
     }
 
     if (n == 0) {
-        impl.session_.token_buffer.clear();
+        buffer.clear();
         return std::vector<int>{};
     }
 
-    impl.session_.token_buffer.resize(static_cast<size_t>(n));
-    return impl.session_.token_buffer;
+    buffer.resize(static_cast<size_t>(n));
+    return buffer;
 }
 
 } // namespace zoo::core
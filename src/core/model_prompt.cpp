@@ -1,6 +1,6 @@
 /**
  * @file model_prompt.cpp
- * @brief Incremental prompt rendering and KV-cache bookkeeping for `Model`.
+ * @brief Prompt rendering and token-level KV-cache reuse for `Model`.
  */
 
 #include "core/model_impl.hpp"
@@ -8,15 +8,20 @@
 
 #include "core/prompt_bookkeeping.hpp"
 
+#include <algorithm>
 #include <chat.h>
+#include <cstddef>
 #include <llama.h>
+#include <span>
+#include <string_view>
+#include <vector>
 
 namespace zoo::core {
 
 namespace {
 
 /// Converts zoo::Message history to common_chat_msg for the common layer.
-std::vector<common_chat_msg> to_chat_msgs(const std::vector<Message>& messages) {
+std::vector<common_chat_msg> to_chat_msgs(std::span<const Message> messages) {
     std::vector<common_chat_msg> result;
     result.reserve(messages.size());
     for (const auto& msg : messages) {
@@ -39,18 +44,17 @@ std::vector<common_chat_msg> to_chat_msgs(const std::vector<Message>& messages)
 
 } // namespace
 
-Expected<std::string> render_prompt_delta(Model::Impl& impl) {
-    auto chat_msgs = to_chat_msgs(impl.session_.messages);
-
+Expected<common_chat_params> apply_chat_template(const Model::Impl::LoadedModel& loaded,
+                                                 std::span<const Message> messages,
+                                                 const Model::Impl::ToolCallingState* tools) {
     // Build inputs for the template system.
     common_chat_templates_inputs inputs;
-    inputs.messages = std::move(chat_msgs);
+    inputs.messages = to_chat_msgs(messages);
     inputs.add_generation_prompt = true;
     inputs.use_jinja = true;
 
-    // Tool definitions belong to native tool-call generations, not schema extraction overrides.
-    if (impl.session_.sampler_policy.is_native_tool_call() && impl.session_.tool_state) {
-        inputs.tools = impl.session_.tool_state->tools;
+    if (tools) {
+        inputs.tools = tools->tools;
         inputs.tool_choice = COMMON_CHAT_TOOL_CHOICE_AUTO;
     }
 
@@ -58,116 +62,159 @@ Expected<std::string> render_prompt_delta(Model::Impl& impl) {
     // it. See docs/adr/007-thinking-disabled-by-default.md.
     inputs.enable_thinking = false;
 
-    common_chat_params params;
     try {
-        params = common_chat_templates_apply(impl.loaded_.chat_templates.get(), inputs);
+        return common_chat_templates_apply(loaded.chat_templates.get(), inputs);
     } catch (const std::exception& e) {
         return std::unexpected(
             Error{ErrorCode::TemplateRenderFailed,
                   std::string("common_chat_templates_apply failed: ") + e.what()});
     }
+}
 
-    const std::string& new_prompt = params.prompt;
-    const int new_len = static_cast<int>(new_prompt.size());
-
-    if (new_len == 0) {
-        return std::string{};
-    }
-
-    if (rendered_prompt_requires_kv_reset(impl.session_.prompt_state.committed_prompt_len,
-                                          new_len)) {
-        clear_kv_cache(impl);
-    }
-
-    // Extract the delta since the last committed prompt position.
-    std::string delta;
-    if (impl.session_.prompt_state.committed_prompt_len < new_len) {
-        delta =
-            new_prompt.substr(static_cast<size_t>(impl.session_.prompt_state.committed_prompt_len));
-    } else if (impl.session_.prompt_state.committed_prompt_len == 0) {
-        delta = new_prompt;
+Expected<std::string> render_prompt(Model::Impl& impl) {
+    // Tool definitions belong to native tool-call generations, not schema extraction overrides.
+    const bool native_tools =
+        impl.session_.sampler_policy.is_native_tool_call() && impl.session_.tool_state;
+    auto rendered = apply_chat_template(impl.loaded_, impl.session_.messages,
+                                        native_tools ? impl.session_.tool_state.get() : nullptr);
+    if (!rendered) {
+        return std::unexpected(rendered.error());
     }
-
-    impl.session_.prompt_state.dirty = false;
-
-    // If native tool calling is active, fully refresh the current
-    // format/parsing/grammar state from this render pass. The template output
-    // can vary with history. Skip this when in Schema mode (extraction) to
-    // avoid overwriting the caller's schema grammar with tool-call grammar.
-    if (impl.session_.sampler_policy.is_native_tool_call() && impl.session_.tool_state) {
-        common_chat_parser_params parser_params;
+    common_chat_params& params = *rendered;
+
+    // If native tool calling is active, refresh the current format/parsing/
+    // grammar state from this render pass. The template output can vary with
+    // history, though for a fixed tool set it rarely does, so unchanged parts
+    // are kept. Skip this when in Schema mode (extraction) to avoid
+    // overwriting the caller's schema grammar with tool-call grammar.
+    if (native_tools) {
         try {
-            parser_params = make_tool_parser_params(params);
+            update_tool_calling_state(*impl.session_.tool_state, params);
         } catch (const std::exception& e) {
             return std::unexpected(
                 Error{ErrorCode::TemplateRenderFailed,
                       std::string("Failed to deserialize tool parser: ") + e.what()});
         }
-
-        impl.session_.tool_state->parser_params = std::move(parser_params);
-        impl.session_.tool_state->grammar = params.grammar;
-        impl.session_.tool_state->grammar_lazy = params.grammar_lazy;
-        impl.session_.tool_state->grammar_triggers = std::move(params.grammar_triggers);
-        impl.session_.tool_state->trigger_matcher =
-            ToolCallTriggerMatcher(impl.session_.tool_state->grammar_triggers);
-        impl.session_.tool_state->preserved_tokens = std::move(params.preserved_tokens);
-        impl.session_.tool_state->additional_stops = std::move(params.additional_stops);
-        impl.session_.sampler_policy =
-            Model::Impl::SamplerPolicy::native_tool_call(impl.session_.tool_state->grammar);
+        if (impl.session_.sampler_policy.grammar != impl.session_.tool_state->grammar) {
+            impl.session_.sampler_policy =
+                Model::Impl::SamplerPolicy::native_tool_call(impl.session_.tool_state->grammar);
+        }
     }
 
-    return delta;
+    return std::move(params.prompt);
 }
 
-void Model::finalize_response() {
-    auto chat_msgs = to_chat_msgs(impl_->session_.messages);
-
-    common_chat_templates_inputs inputs;
-    inputs.messages = std::move(chat_msgs);
-    inputs.add_generation_prompt = false;
-    inputs.use_jinja = true;
-
-    if (impl_->session_.sampler_policy.is_native_tool_call() && impl_->session_.tool_state) {
-        inputs.tools = impl_->session_.tool_state->tools;
-        inputs.tool_choice = COMMON_CHAT_TOOL_CHOICE_AUTO;
+Expected<std::vector<int>> prepare_prompt_tokens(Model::Impl& impl, std::string_view prompt) {
+    auto tokens = tokenize(impl, prompt);
+    if (!tokens) {
+        return std::unexpected(tokens.error());
     }
 
-    // See docs/adr/007-thinking-disabled-by-default.md.
-    inputs.enable_thinking = false;
+    // Templates may re-render earlier turns differently (e.g. dropping
+    // reasoning), so the diff is against the decoded tokens, not the text.
+    const size_t reused = reuse_resident_prefix(impl, *tokens);
+    tokens->erase(tokens->begin(), tokens->begin() + static_cast<std::ptrdiff_t>(reused));
+    return tokens;
+}
 
-    common_chat_params params;
-    try {
-        params = common_chat_templates_apply(impl_->loaded_.chat_templates.get(), inputs);
-    } catch (const std::exception&) {
-        return;
+std::vector<int> reuse_prepared_tokens(Model::Impl& impl, std::span<const int> prompt_tokens) {
+    const size_t reused = reuse_resident_prefix(impl, prompt_tokens);
+    return {prompt_tokens.begin() + static_cast<std::ptrdiff_t>(reused), prompt_tokens.end()};
+}
+
+Expected<std::vector<int>> Model::prepare_prompt(std::span<const Message> messages) const {
+    auto rendered = apply_chat_template(impl_->loaded_, messages, nullptr);
+    if (!rendered) {
+        return std::unexpected(rendered.error());
     }
+    std::vector<int> buffer;
+    return tokenize_into(impl_->loaded_.vocab, rendered->prompt, buffer);
+}
 
-    const int new_prev_len = static_cast<int>(params.prompt.size());
-    commit_rendered_prompt(impl_->session_.prompt_state.committed_prompt_len, new_prev_len);
+void Model::finalize_response() {
+    // The resident token sequence is the checkpoint now; nothing to advance.
 }
 
 void clear_kv_cache(Model::Impl& impl) {
-    if (impl.session_.ctx) {
-        llama_memory_clear(llama_get_memory(impl.session_.ctx.get()), false);
+    if (impl.session_.ctx()) {
+        llama_memory_seq_rm(llama_get_memory(impl.session_.ctx()), impl.session_.seq_id, -1, -1);
     }
-    impl.session_.prompt_state.committed_prompt_len = 0;
+    impl.session_.prompt_state.kv_tokens.clear();
 }
 
-void note_history_append(Model::Impl& impl) noexcept {
-    note_history_mutation(PromptHistoryMutation::Append, impl.session_.prompt_state.dirty,
-                          impl.session_.prompt_state.committed_prompt_len);
-}
+size_t reuse_resident_prefix(Model::Impl& impl, std::span<const int> prompt_tokens) {
+    auto& kv_tokens = impl.session_.prompt_state.kv_tokens;
+    llama_memory_t memory = impl.session_.ctx() ? llama_get_memory(impl.session_.ctx()) : nullptr;
+    const llama_seq_id seq = impl.session_.seq_id;
+    const size_t min_run = memory && llama_memory_can_shift(memory)
+                               ? static_cast<size_t>(impl.loaded_.model_config.kv_reuse_min_tokens)
+                               : 0;
+    const KvReusePlan plan = plan_kv_reuse(kv_tokens, prompt_tokens, min_run);
+
+    // Each run first evicts the cells between the tokens already in place
+    // and its own start, then slides down over them.
+    for (const auto& shift : plan.shifts) {
+        if (!llama_memory_seq_rm(memory, seq, static_cast<llama_pos>(shift.to),
+                                 static_cast<llama_pos>(shift.from))) {
+            clear_kv_cache(impl);
+            return 0;
+        }
+        llama_memory_seq_add(memory, seq, static_cast<llama_pos>(shift.from),
+                             static_cast<llama_pos>(shift.from + shift.count),
+                             static_cast<llama_pos>(shift.to) -
+                                 static_cast<llama_pos>(shift.from));
+    }
 
-void note_history_rewrite(Model::Impl& impl) noexcept {
-    note_history_mutation(PromptHistoryMutation::Rewrite, impl.session_.prompt_state.dirty,
-                          impl.session_.prompt_state.committed_prompt_len);
-    clear_kv_cache(impl);
+    // Always trim past `reused`: an interrupted prefill can leave cells that
+    // were decoded but never recorded in `kv_tokens`.
+    if (memory && !llama_memory_seq_rm(memory, seq, static_cast<llama_pos>(plan.reused), -1)) {
+        // Some memory types cannot drop a partial range; start over instead.
+        clear_kv_cache(impl);
+        return 0;
+    }
+    kv_tokens.assign(prompt_tokens.begin(),
+                     prompt_tokens.begin() + static_cast<std::ptrdiff_t>(plan.reused));
+    return plan.reused;
 }
 
-void note_history_reset(Model::Impl& impl) noexcept {
-    note_history_mutation(PromptHistoryMutation::Reset, impl.session_.prompt_state.dirty,
-                          impl.session_.prompt_state.committed_prompt_len);
-    clear_kv_cache(impl);
+bool shift_context(Model::Impl& impl, int& current_pos) {
+    if (!impl.loaded_.model_config.context_shift || !impl.session_.ctx()) {
+        return false;
+    }
+    llama_memory_t memory = llama_get_memory(impl.session_.ctx());
+    if (!llama_memory_can_shift(memory)) {
+        return false;
+    }
+
+    // The system prompt is whatever prefix a system-only render shares with
+    // the resident tokens; without one, keep the first token (BOS).
+    auto& kv_tokens = impl.session_.prompt_state.kv_tokens;
+    const auto& messages = impl.session_.messages;
+    size_t keep = kv_tokens.empty() ? 0 : 1;
+    if (!messages.empty() && messages.front().role == Role::System) {
+        auto rendered = apply_chat_template(impl.loaded_, std::span(messages).first(1), nullptr);
+        std::vector<int> buffer;
+        if (rendered) {
+            if (auto system = tokenize_into(impl.loaded_.vocab, rendered->prompt, buffer)) {
+                keep = std::max(keep, common_token_prefix(kv_tokens, *system));
+            }
+        }
+    }
+
+    const size_t discard = context_shift_discard(kv_tokens.size(), keep);
+    if (discard == 0) {
+        return false;
+    }
+    const auto first = static_cast<llama_pos>(keep);
+    const auto last = static_cast<llama_pos>(keep + discard);
+    if (!llama_memory_seq_rm(memory, impl.session_.seq_id, first, last)) {
+        return false;
+    }
+    llama_memory_seq_add(memory, impl.session_.seq_id, last, -1, first - last);
+    kv_tokens.erase(kv_tokens.begin() + static_cast<std::ptrdiff_t>(keep),
+                    kv_tokens.begin() + static_cast<std::ptrdiff_t>(keep + discard));
+    current_pos -= static_cast<int>(discard);
+    return true;
 }
 
 } // namespace zoo::core
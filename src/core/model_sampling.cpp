@@ -6,6 +6,7 @@
 #include "core/model_impl.hpp"
 #include "zoo/core/model.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <common.h>
@@ -107,11 +108,221 @@ void collect_grammar_triggers(const std::vector<common_grammar_trigger>& trigger
     }
 }
 
+// State of a grammar sampler wrapped by make_masked_grammar_sampler().
+struct MaskedGrammar {
+    llama_sampler* grammar;
+    const llama_vocab* vocab;
+    FreeTextMaskCache* masks;
+    FreeTextProbe probe;
+    // Output accepted since the last reset, as the grammar has seen it.
+    std::string generated;
+    // Candidates the mask does not settle, and their indices in the input.
+    std::vector<llama_token_data> unresolved;
+    std::vector<size_t> unresolved_index;
+};
+
+// Text the grammar matches for `token`; empty when it does not fit the buffer.
+std::string grammar_piece(const llama_vocab* vocab, llama_token token) {
+    char buffer[256];
+    const int bytes = llama_token_to_piece(vocab, token, buffer, sizeof(buffer), 0, true);
+    return bytes > 0 ? std::string(buffer, static_cast<size_t>(bytes)) : std::string();
+}
+
+// Like grammar_piece(), but empty for end-of-generation and control tokens,
+// which the grammar must always check.
+std::string mask_piece(const llama_vocab* vocab, llama_token token) {
+    if (llama_vocab_is_eog(vocab, token) || llama_vocab_is_control(vocab, token)) {
+        return {};
+    }
+    return grammar_piece(vocab, token);
+}
+
+const char* masked_grammar_name(const llama_sampler*) {
+    return "zoo-masked-grammar";
+}
+
+void masked_grammar_accept(llama_sampler* sampler, llama_token token) {
+    auto* state = static_cast<MaskedGrammar*>(sampler->ctx);
+    llama_sampler_accept(state->grammar, token);
+    if (!llama_vocab_is_eog(state->vocab, token)) {
+        state->generated += grammar_piece(state->vocab, token);
+    }
+}
+
+// Keeps candidates in the precomputed mask for the current kind of free text
+// and runs only the others through the grammar. Outside free text, or in the
+// middle of a UTF-8 sequence the grammar is still decoding, the grammar sees
+// every candidate.
+void masked_grammar_apply(llama_sampler* sampler, llama_token_data_array* candidates) {
+    auto* state = static_cast<MaskedGrammar*>(sampler->ctx);
+    const FreeTextKind kind = ends_inside_utf8_sequence(state->generated)
+                                  ? FreeTextKind::None
+                                  : state->probe(state->generated);
+    if (kind == FreeTextKind::None) {
+        llama_sampler_apply(state->grammar, candidates);
+        return;
+    }
+
+    const llama_vocab* vocab = state->vocab;
+    const TokenMask& mask =
+        state->masks->get(kind, static_cast<size_t>(llama_vocab_n_tokens(vocab)),
+                          [vocab](size_t token) {
+                              return mask_piece(vocab, static_cast<llama_token>(token));
+                          });
+    state->unresolved.clear();
+    state->unresolved_index.clear();
+    for (size_t i = 0; i < candidates->size; ++i) {
+        if (!mask.test(static_cast<size_t>(candidates->data[i].id))) {
+            state->unresolved.push_back(candidates->data[i]);
+            state->unresolved_index.push_back(i);
+        }
+    }
+    if (state->unresolved.empty()) {
+        return;
+    }
+
+    llama_token_data_array subset{state->unresolved.data(), state->unresolved.size(), -1, false};
+    llama_sampler_apply(state->grammar, &subset);
+    for (size_t i = 0; i < state->unresolved.size(); ++i) {
+        candidates->data[state->unresolved_index[i]].logit = state->unresolved[i].logit;
+    }
+}
+
+void masked_grammar_reset(llama_sampler* sampler) {
+    auto* state = static_cast<MaskedGrammar*>(sampler->ctx);
+    llama_sampler_reset(state->grammar);
+    state->generated.clear();
+}
+
+llama_sampler* masked_grammar_clone(const llama_sampler* sampler);
+
+void masked_grammar_free(llama_sampler* sampler) {
+    auto* state = static_cast<MaskedGrammar*>(sampler->ctx);
+    llama_sampler_free(state->grammar);
+    delete state;
+}
+
+const llama_sampler_i* masked_grammar_interface() {
+    static const llama_sampler_i iface = [] {
+        llama_sampler_i result{};
+        result.name = masked_grammar_name;
+        result.accept = masked_grammar_accept;
+        result.apply = masked_grammar_apply;
+        result.reset = masked_grammar_reset;
+        result.clone = masked_grammar_clone;
+        result.free = masked_grammar_free;
+        return result;
+    }();
+    return &iface;
+}
+
+// Wraps `grammar`, taking ownership, so candidates the grammar admits
+// regardless of context are settled by a vocabulary mask from `masks`
+// instead of by grammar evaluation.
+llama_sampler* make_masked_grammar_sampler(llama_sampler* grammar, const llama_vocab* vocab,
+                                           FreeTextMaskCache& masks, FreeTextProbe probe) {
+    return llama_sampler_init(masked_grammar_interface(),
+                              new MaskedGrammar{grammar, vocab, &masks, std::move(probe), {}, {},
+                                                {}});
+}
+
+llama_sampler* masked_grammar_clone(const llama_sampler* sampler) {
+    const auto* state = static_cast<const MaskedGrammar*>(sampler->ctx);
+    auto* grammar = llama_sampler_clone(state->grammar);
+    if (!grammar) {
+        return nullptr;
+    }
+    auto* clone = new MaskedGrammar{grammar, state->vocab, state->masks, state->probe,
+                                    state->generated, {}, {}};
+    return llama_sampler_init(masked_grammar_interface(), clone);
+}
+
+// Grammar chains kept per session, including the active one. Covers the
+// schema/tool alternation of extraction requests with room to spare.
+constexpr size_t kSamplerCacheCapacity = 4;
+
+bool same_sampler_inputs(const Model::Impl::SamplerKey& key, const Model::Impl& impl) {
+    const auto& policy = impl.session_.sampler_policy;
+    if (key.mode != policy.mode || key.sampling != impl.session_.active_sampling ||
+        key.grammar != policy.grammar || key.masked != static_cast<bool>(policy.free_text)) {
+        return false;
+    }
+    if (!policy.is_native_tool_call()) {
+        return true;
+    }
+    const auto& tool_state = impl.session_.tool_state;
+    return tool_state && key.grammar_lazy == tool_state->grammar_lazy &&
+           same_grammar_triggers(key.grammar_triggers, tool_state->grammar_triggers);
+}
+
+Model::Impl::SamplerKey current_sampler_key(const Model::Impl& impl) {
+    Model::Impl::SamplerKey key;
+    key.mode = impl.session_.sampler_policy.mode;
+    key.grammar = impl.session_.sampler_policy.grammar;
+    key.sampling = impl.session_.active_sampling;
+    key.masked = static_cast<bool>(impl.session_.sampler_policy.free_text);
+    if (impl.session_.sampler_policy.is_native_tool_call() && impl.session_.tool_state) {
+        key.grammar_lazy = impl.session_.tool_state->grammar_lazy;
+        key.grammar_triggers = impl.session_.tool_state->grammar_triggers;
+    }
+    return key;
+}
+
+void install_sampler(Model::Impl& impl, LlamaSamplerHandle chain,
+                     std::optional<Model::Impl::SamplerKey> key) {
+    auto& session = impl.session_;
+    if (session.sampler && session.sampler_key) {
+        session.sampler_cache.emplace(session.sampler_cache.begin(),
+                                      std::move(*session.sampler_key), std::move(session.sampler));
+        if (session.sampler_cache.size() >= kSamplerCacheCapacity) {
+            session.sampler_cache.pop_back();
+        }
+    }
+    session.sampler = std::move(chain);
+    session.sampler_key = std::move(key);
+}
+
+// Returns the chain to the state of a freshly built one. With a runtime-chosen
+// seed the trailing dist sampler keeps its random stream, since resetting it
+// would replay the same seed on every pass; a configured seed is restored.
+void reset_sampler_chain(llama_sampler* chain, const SamplingParams& sampling) {
+    if (sampling.seed >= 0) {
+        llama_sampler_reset(chain);
+        return;
+    }
+    const int stages = llama_sampler_chain_n(chain);
+    for (int index = 0; index + 1 < stages; ++index) {
+        llama_sampler_reset(llama_sampler_chain_get(chain, index));
+    }
+}
+
+// Activates a chain previously built from the current inputs, reset for a
+// new pass. Returns false when the chain has to be built.
+bool reuse_cached_sampler(Model::Impl& impl) {
+    auto& session = impl.session_;
+    if (!session.sampler || !session.sampler_key ||
+        !same_sampler_inputs(*session.sampler_key, impl)) {
+        auto cached = std::find_if(
+            session.sampler_cache.begin(), session.sampler_cache.end(),
+            [&impl](const auto& entry) { return same_sampler_inputs(entry.first, impl); });
+        if (cached == session.sampler_cache.end()) {
+            return false;
+        }
+        auto entry = std::move(*cached);
+        session.sampler_cache.erase(cached);
+        install_sampler(impl, std::move(entry.second), std::move(entry.first));
+    }
+    reset_sampler_chain(session.sampler.get(), session.active_sampling);
+    return true;
+}
+
 } // namespace
 
-bool Model::set_schema_grammar(const std::string& grammar_str) {
+bool Model::set_schema_grammar(const std::string& grammar_str, ForcedContinuation forced,
+                               FreeTextProbe free_text) {
     auto previous_policy = impl_->session_.sampler_policy;
-    impl_->session_.sampler_policy = Impl::SamplerPolicy::schema(grammar_str);
+    impl_->session_.sampler_policy =
+        Impl::SamplerPolicy::schema(grammar_str, std::move(forced), std::move(free_text));
     if (!rebuild_sampler_with_schema_grammar(*impl_)) {
         impl_->session_.sampler_policy = std::move(previous_policy);
         return false;
@@ -124,6 +335,9 @@ bool rebuild_sampler_with_tool_grammar(Model::Impl& impl) {
     if (!impl.session_.tool_state || !policy.is_native_tool_call() || policy.grammar.empty()) {
         return false;
     }
+    if (reuse_cached_sampler(impl)) {
+        return true;
+    }
 
     auto chain_params = llama_sampler_chain_default_params();
     chain_params.no_perf = false;
@@ -164,7 +378,7 @@ bool rebuild_sampler_with_tool_grammar(Model::Impl& impl) {
     add_sampling_stages(chain.get(), impl.session_.active_sampling);
     add_dist_sampler(chain.get(), impl.session_.active_sampling);
 
-    impl.session_.sampler = std::move(chain);
+    install_sampler(impl, std::move(chain), current_sampler_key(impl));
     return true;
 }
 
@@ -173,6 +387,9 @@ bool rebuild_sampler_with_schema_grammar(Model::Impl& impl) {
     if (!policy.is_schema() || policy.grammar.empty()) {
         return false;
     }
+    if (reuse_cached_sampler(impl)) {
+        return true;
+    }
 
     auto chain_params = llama_sampler_chain_default_params();
     chain_params.no_perf = false;
@@ -188,12 +405,17 @@ bool rebuild_sampler_with_schema_grammar(Model::Impl& impl) {
     if (!grammar_sampler) {
         return false;
     }
+    if (policy.free_text) {
+        grammar_sampler = make_masked_grammar_sampler(grammar_sampler, impl.loaded_.vocab,
+                                                      impl.loaded_.free_text_masks,
+                                                      policy.free_text);
+    }
     llama_sampler_chain_add(chain.get(), grammar_sampler);
 
     add_sampling_stages(chain.get(), impl.session_.active_sampling);
     add_dist_sampler(chain.get(), impl.session_.active_sampling);
 
-    impl.session_.sampler = std::move(chain);
+    install_sampler(impl, std::move(chain), current_sampler_key(impl));
     return true;
 }
 
@@ -204,11 +426,15 @@ Expected<void> Model::Impl::SamplerPolicy::ensure_sampler_for_pass(Model::Impl&
 
     if (is_native_tool_call()) {
         if (grammar.empty()) {
-            impl.session_.sampler = create_sampler_chain(impl);
-            if (!impl.session_.sampler) {
+            if (reuse_cached_sampler(impl)) {
+                return {};
+            }
+            auto chain = create_sampler_chain(impl);
+            if (!chain) {
                 return std::unexpected(
                     Error{ErrorCode::InferenceFailed, "Failed to rebuild sampler chain"});
             }
+            install_sampler(impl, std::move(chain), current_sampler_key(impl));
             return {};
         }
         if (!rebuild_sampler_with_tool_grammar(impl)) {
@@ -239,4 +465,8 @@ LlamaSamplerHandle create_sampler_chain(Model::Impl& impl) {
     return chain;
 }
 
+void install_sampler_chain(Model::Impl& impl, LlamaSamplerHandle chain) {
+    install_sampler(impl, std::move(chain), std::nullopt);
+}
+
 } // namespace zoo::core
@@ -0,0 +1,147 @@
+/**
+ * @file model_session.cpp
+ * @brief Session snapshot persistence for `zoo::core::Model`.
+ */
+
+#include "core/model_impl.hpp"
+#include "zoo/core/model.hpp"
+
+#include "core/session_snapshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <llama.h>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace zoo::core {
+
+namespace {
+
+// FNV-1a over the loaded model's shape so snapshots taken with other weights
+// are rejected even when callers reuse a model id.
+uint64_t model_fingerprint(const Model::Impl& impl) {
+    const llama_model* model = impl.loaded_.llama_model.get();
+    if (!model) {
+        return 0;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    const uint64_t n_params = llama_model_n_params(model);
+    const uint64_t size = llama_model_size(model);
+    const int32_t n_embd = llama_model_n_embd(model);
+    const int32_t n_layer = llama_model_n_layer(model);
+    const int32_t n_vocab = impl.loaded_.vocab ? llama_vocab_n_tokens(impl.loaded_.vocab) : 0;
+    mix(&n_params, sizeof(n_params));
+    mix(&size, sizeof(size));
+    mix(&n_embd, sizeof(n_embd));
+    mix(&n_layer, sizeof(n_layer));
+    mix(&n_vocab, sizeof(n_vocab));
+
+    std::array<char, 256> desc{};
+    const int32_t desc_len = llama_model_desc(model, desc.data(), desc.size());
+    if (desc_len > 0) {
+        mix(desc.data(), std::min(static_cast<size_t>(desc_len), desc.size()));
+    }
+    return hash;
+}
+
+Error snapshot_io_error(std::string message, const std::string& path) {
+    return Error{ErrorCode::SessionSnapshotInvalid, std::move(message), path};
+}
+
+} // namespace
+
+Expected<void> Model::save_session(const std::string& path, std::string_view model_id) {
+    SessionSnapshot snapshot;
+    snapshot.model_id = std::string(model_id);
+    snapshot.model_fingerprint = model_fingerprint(*impl_);
+    snapshot.messages = impl_->session_.messages;
+
+    llama_context* ctx = impl_->session_.ctx();
+    if (ctx && !impl_->session_.prompt_state.kv_tokens.empty()) {
+        const llama_seq_id seq_id = impl_->session_.seq_id;
+        snapshot.sequence_state.resize(llama_state_seq_get_size(ctx, seq_id));
+        const size_t written = llama_state_seq_get_data(ctx, snapshot.sequence_state.data(),
+                                                        snapshot.sequence_state.size(), seq_id);
+        if (written == 0) {
+            return std::unexpected(snapshot_io_error("Failed to copy KV sequence state", path));
+        }
+        snapshot.sequence_state.resize(written);
+        snapshot.kv_tokens = impl_->session_.prompt_state.kv_tokens;
+    }
+
+    const std::string bytes = encode_session_snapshot(snapshot);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            return std::unexpected(snapshot_io_error("Failed to write session snapshot", path));
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return std::unexpected(snapshot_io_error("Failed to move session snapshot into place",
+                                                 path));
+    }
+    return {};
+}
+
+Expected<void> Model::load_session(const std::string& path, std::string_view model_id) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::unexpected(snapshot_io_error("Failed to open session snapshot", path));
+    }
+    const std::string bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    if (in.bad()) {
+        return std::unexpected(snapshot_io_error("Failed to read session snapshot", path));
+    }
+
+    auto snapshot = decode_session_snapshot(bytes);
+    if (!snapshot) {
+        return std::unexpected(snapshot.error());
+    }
+    if (auto check = check_session_snapshot_model(*snapshot, model_id, model_fingerprint(*impl_));
+        !check) {
+        return std::unexpected(check.error());
+    }
+    if (static_cast<int>(snapshot->kv_tokens.size()) > impl_->loaded_.context_size) {
+        return std::unexpected(Error{ErrorCode::ContextWindowExceeded,
+                                     "Session snapshot does not fit the context window", path});
+    }
+
+    clear_kv_cache(*impl_);
+    llama_context* ctx = impl_->session_.ctx();
+    if (ctx && !snapshot->sequence_state.empty()) {
+        const size_t read =
+            llama_state_seq_set_data(ctx, snapshot->sequence_state.data(),
+                                     snapshot->sequence_state.size(), impl_->session_.seq_id);
+        if (read == 0) {
+            clear_kv_cache(*impl_);
+            return std::unexpected(
+                snapshot_io_error("Failed to restore KV sequence state", path));
+        }
+        impl_->session_.prompt_state.kv_tokens = std::move(snapshot->kv_tokens);
+    }
+
+    replace_history(HistorySnapshot{std::move(snapshot->messages)});
+    return {};
+}
+
+} // namespace zoo::core
@@ -0,0 +1,111 @@
+/**
+ * @file model_speculative.cpp
+ * @brief Draft-model proposals for speculative decoding in `zoo::core::Model`.
+ */
+
+#include "core/model_impl.hpp"
+#include "core/prompt_bookkeeping.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <llama.h>
+#include <span>
+#include <vector>
+
+namespace zoo::core {
+
+namespace {
+
+void reset_draft(Model::Impl::DraftState& draft) {
+    llama_memory_seq_rm(llama_get_memory(draft.ctx.get()), 0, -1, -1);
+    draft.kv_tokens.clear();
+}
+
+// Decodes `tokens` after the resident draft sequence, requesting logits for
+// the final token only.
+bool decode_draft_tokens(Model::Impl::DraftState& draft, std::span<const int> tokens) {
+    const int n_batch = static_cast<int>(llama_n_batch(draft.ctx.get()));
+    for (const auto& chunk : compute_prefill_chunks(static_cast<int>(tokens.size()), n_batch)) {
+        auto batch = draft.batch_arena.borrow(chunk.count);
+        auto& raw_batch = batch.get();
+        const auto base_pos = static_cast<llama_pos>(draft.kv_tokens.size());
+        for (int i = 0; i < chunk.count; ++i) {
+            set_batch_token(raw_batch, i, static_cast<llama_token>(tokens[chunk.offset + i]),
+                            base_pos + i, 0, chunk.emit_logits && i == chunk.count - 1);
+        }
+        raw_batch.n_tokens = chunk.count;
+        if (llama_decode(draft.ctx.get(), raw_batch) != 0) {
+            return false;
+        }
+        draft.kv_tokens.insert(draft.kv_tokens.end(), tokens.begin() + chunk.offset,
+                               tokens.begin() + chunk.offset + chunk.count);
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<int> propose_draft_tokens(Model::Impl& impl, std::span<const int> context,
+                                      int next_token, int max_tokens) {
+    auto* draft = impl.session_.draft.get();
+    if (!draft || max_tokens <= 0) {
+        return {};
+    }
+
+    // The draft sequence should hold `context` plus the token just sampled;
+    // only the divergent tail is re-decoded.
+    const size_t target_size = context.size() + 1;
+    const int draft_ctx_size = static_cast<int>(llama_n_ctx(draft->ctx.get()));
+    max_tokens = std::min(max_tokens, draft_ctx_size - static_cast<int>(target_size));
+    if (max_tokens <= 0) {
+        return {};
+    }
+
+    size_t reused = common_token_prefix(draft->kv_tokens, context);
+    if (reused == context.size() && draft->kv_tokens.size() > reused &&
+        draft->kv_tokens[reused] == next_token) {
+        ++reused;
+    }
+    if (reused == target_size) {
+        --reused; // The last token is decoded again for its logits.
+    }
+    if (!llama_memory_seq_rm(llama_get_memory(draft->ctx.get()), 0,
+                             static_cast<llama_pos>(reused), -1)) {
+        reset_draft(*draft);
+    } else {
+        draft->kv_tokens.resize(reused);
+    }
+
+    auto& pending = draft->pending_tokens;
+    pending.assign(context.begin() + static_cast<std::ptrdiff_t>(draft->kv_tokens.size()),
+                   context.end());
+    pending.push_back(next_token);
+    if (!decode_draft_tokens(*draft, pending)) {
+        reset_draft(*draft);
+        return {};
+    }
+
+    std::vector<int> proposals;
+    proposals.reserve(static_cast<size_t>(max_tokens));
+    auto step = draft->batch_arena.borrow(1);
+    while (true) {
+        const llama_token token = llama_sampler_sample(draft->sampler.get(), draft->ctx.get(), -1);
+        proposals.push_back(static_cast<int>(token));
+        if (static_cast<int>(proposals.size()) >= max_tokens ||
+            llama_vocab_is_eog(impl.loaded_.vocab, token)) {
+            break;
+        }
+
+        set_batch_token(step.get(), 0, token, static_cast<llama_pos>(draft->kv_tokens.size()), 0,
+                        true);
+        step.get().n_tokens = 1;
+        if (llama_decode(draft->ctx.get(), step.get()) != 0) {
+            reset_draft(*draft);
+            break;
+        }
+        draft->kv_tokens.push_back(static_cast<int>(token));
+    }
+    return proposals;
+}
+
+} // namespace zoo::core
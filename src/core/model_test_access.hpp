@@ -54,8 +54,12 @@ struct ModelTestAccess {
         zoo::core::rollback_last_message(*model.impl_);
     }
 
-    static Expected<std::string> render_prompt_delta(Model& model) {
-        return zoo::core::render_prompt_delta(*model.impl_);
+    static void record_prompt_tokens(Model& model, size_t prompt_tokens) {
+        zoo::core::record_prompt_tokens(*model.impl_, prompt_tokens);
+    }
+
+    static Expected<std::string> render_prompt(Model& model) {
+        return zoo::core::render_prompt(*model.impl_);
     }
 
     static GenerationOptions resolve_generation_options(Model& model,
@@ -13,6 +13,49 @@
 
 namespace zoo::core {
 
+namespace {
+
+bool same_tools(const std::vector<common_chat_tool>& lhs, const std::vector<common_chat_tool>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](const common_chat_tool& a, const common_chat_tool& b) {
+                          return a.name == b.name && a.description == b.description &&
+                                 a.parameters == b.parameters;
+                      });
+}
+
+} // namespace
+
+void update_tool_calling_state(Model::Impl::ToolCallingState& state, common_chat_params& params) {
+    common_chat_parser_params parser_params(params);
+    parser_params.parse_tool_calls = true;
+    if (state.parser_source == params.parser) {
+        parser_params.parser = std::move(state.parser_params.parser);
+    } else if (!params.parser.empty()) {
+        // The conversion constructor does not carry the PEG parser; it must be
+        // re-loaded from its serialized form before it is usable.
+        parser_params.parser.load(params.parser);
+    }
+    state.parser_params = std::move(parser_params);
+    if (state.parser_source != params.parser) {
+        state.parser_source = std::move(params.parser);
+    }
+
+    if (state.grammar != params.grammar) {
+        state.grammar = std::move(params.grammar);
+    }
+    state.grammar_lazy = params.grammar_lazy;
+    if (!same_grammar_triggers(state.grammar_triggers, params.grammar_triggers)) {
+        state.grammar_triggers = std::move(params.grammar_triggers);
+        state.trigger_matcher = ToolCallTriggerMatcher(state.grammar_triggers);
+    }
+    if (state.preserved_tokens != params.preserved_tokens) {
+        state.preserved_tokens = std::move(params.preserved_tokens);
+    }
+    if (state.additional_stops != params.additional_stops) {
+        state.additional_stops = std::move(params.additional_stops);
+    }
+}
+
 // ---------------------------------------------------------------------------
 // set_tool_calling
 // ---------------------------------------------------------------------------
@@ -30,6 +73,27 @@ bool Model::set_tool_calling(const std::vector<CoreToolInfo>& tools) {
         chat_tools.push_back({t.name, t.description, t.parameters_json});
     }
 
+    // The agent re-applies an unchanged tool set after every extraction
+    // request; the state derived for it is still valid, so skip re-probing.
+    if (impl_->session_.tool_state && same_tools(impl_->session_.tool_state->tools, chat_tools)) {
+        if (impl_->session_.sampler_policy.is_native_tool_call()) {
+            return true;
+        }
+        auto previous_policy = impl_->session_.sampler_policy;
+        impl_->session_.sampler_policy =
+            Impl::SamplerPolicy::native_tool_call(impl_->session_.tool_state->grammar);
+        if (impl_->session_.sampler_policy.grammar.empty()) {
+            install_sampler_chain(*impl_, create_sampler_chain(*impl_));
+            if (impl_->session_.sampler) {
+                return true;
+            }
+        } else if (rebuild_sampler_with_tool_grammar(*impl_)) {
+            return true;
+        }
+        impl_->session_.sampler_policy = std::move(previous_policy);
+        return false;
+    }
+
     // Build a minimal message set to probe the template for grammar/triggers.
     // We need at least one user message for the template to produce output.
     common_chat_templates_inputs inputs;
@@ -57,23 +121,14 @@ bool Model::set_tool_calling(const std::vector<CoreToolInfo>& tools) {
         return false;
     }
 
-    common_chat_parser_params parser_params;
+    auto state = std::make_unique<Impl::ToolCallingState>();
+    state->tools = std::move(chat_tools);
     try {
-        parser_params = make_tool_parser_params(params);
+        update_tool_calling_state(*state, params);
     } catch (const std::exception&) {
         return false;
     }
 
-    auto state = std::make_unique<Impl::ToolCallingState>();
-    state->tools = std::move(chat_tools);
-    state->parser_params = std::move(parser_params);
-    state->grammar = std::move(params.grammar);
-    state->grammar_lazy = params.grammar_lazy;
-    state->grammar_triggers = std::move(params.grammar_triggers);
-    state->trigger_matcher = ToolCallTriggerMatcher(state->grammar_triggers);
-    state->preserved_tokens = std::move(params.preserved_tokens);
-    state->additional_stops = std::move(params.additional_stops);
-
     impl_->session_.tool_state = std::move(state);
     impl_->session_.sampler_policy =
         Impl::SamplerPolicy::native_tool_call(impl_->session_.tool_state->grammar);
@@ -85,7 +140,7 @@ bool Model::set_tool_calling(const std::vector<CoreToolInfo>& tools) {
             return false;
         }
     } else {
-        impl_->session_.sampler = create_sampler_chain(*impl_);
+        install_sampler_chain(*impl_, create_sampler_chain(*impl_));
         if (!impl_->session_.sampler) {
             impl_->session_.tool_state.reset();
             impl_->session_.sampler_policy = Impl::SamplerPolicy::plain();
@@ -144,7 +199,7 @@ void Model::clear_tool_grammar() noexcept {
 
     impl_->session_.tool_state.reset();
     impl_->session_.sampler_policy = Impl::SamplerPolicy::plain();
-    impl_->session_.sampler = create_sampler_chain(*impl_);
+    install_sampler_chain(*impl_, create_sampler_chain(*impl_));
 }
 
 // ---------------------------------------------------------------------------
@@ -1,40 +1,142 @@
 /**
  * @file prompt_bookkeeping.hpp
- * @brief Pure helpers for incremental prompt checkpoint invalidation rules.
+ * @brief Pure helpers for matching rendered prompt tokens against the KV cache.
  */
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
 namespace zoo::core {
 
-enum class PromptHistoryMutation {
-    Append,
-    Rewrite,
-    Reset,
+/// Returns the length of the shared leading run of `resident` and `prompt`.
+[[nodiscard]] inline size_t common_token_prefix(std::span<const int> resident,
+                                                std::span<const int> prompt) noexcept {
+    const size_t limit = resident.size() < prompt.size() ? resident.size() : prompt.size();
+    size_t shared = 0;
+    while (shared < limit && resident[shared] == prompt[shared]) {
+        ++shared;
+    }
+    return shared;
+}
+
+/// A run of resident tokens moved from position `from` down to `to`.
+struct KvShift {
+    size_t from = 0;
+    size_t to = 0;
+    size_t count = 0;
+
+    bool operator==(const KvShift& other) const = default;
 };
 
-[[nodiscard]] inline bool
-history_mutation_requires_kv_reset(PromptHistoryMutation mutation) noexcept {
-    return mutation != PromptHistoryMutation::Append;
-}
+/// How much of the resident sequence a prompt can keep. The first `reused`
+/// prompt tokens end up resident: the shared prefix stays in place and each
+/// entry of `shifts`, applied in order, moves a later resident run down to
+/// its prompt position. Resident tokens outside those runs are discarded.
+struct KvReusePlan {
+    size_t reused = 0;
+    std::vector<KvShift> shifts;
+};
+
+/// Plans KV reuse for `prompt`. After the shared prefix, resident runs of at
+/// least `min_run` tokens that continue the prompt in order (such as the
+/// messages kept by a history trim) are shifted into place instead of being
+/// prefilled again. Shifted runs keep the KV computed against their old
+/// context, which is the same approximation as a context shift. `min_run` of
+/// 0 plans prefix reuse only. At least one prompt token is always left to
+/// decode.
+[[nodiscard]] inline KvReusePlan plan_kv_reuse(std::span<const int> resident,
+                                               std::span<const int> prompt, size_t min_run) {
+    KvReusePlan plan;
+    plan.reused = common_token_prefix(resident, prompt);
 
-inline void note_history_mutation(PromptHistoryMutation mutation, bool& cached_messages_dirty,
-                                  int& committed_prompt_len) noexcept {
-    cached_messages_dirty = true;
-    if (history_mutation_requires_kv_reset(mutation)) {
-        committed_prompt_len = 0;
+    if (min_run > 0) {
+        size_t head_resident = plan.reused;
+        while (head_resident < resident.size() && plan.reused < prompt.size()) {
+            size_t run = 0;
+            while (head_resident + run < resident.size() && plan.reused + run < prompt.size() &&
+                   resident[head_resident + run] == prompt[plan.reused + run]) {
+                ++run;
+            }
+            if (run >= min_run) {
+                plan.shifts.push_back(KvShift{head_resident, plan.reused, run});
+                head_resident += run;
+                plan.reused += run;
+            } else {
+                ++head_resident;
+            }
+        }
     }
+
+    if (plan.reused > 0 && plan.reused == prompt.size()) {
+        --plan.reused;
+        if (!plan.shifts.empty() && --plan.shifts.back().count == 0) {
+            plan.shifts.pop_back();
+        }
+    }
+    return plan;
+}
+
+/// Returns how many resident tokens a context shift discards: half of the
+/// tokens after the first `keep`, so generation can continue with the kept
+/// prefix and the most recent window.
+[[nodiscard]] inline size_t context_shift_discard(size_t resident, size_t keep) noexcept {
+    return resident > keep ? (resident - keep) / 2 : 0;
 }
 
-[[nodiscard]] inline bool rendered_prompt_requires_kv_reset(int committed_prompt_len,
-                                                            int rendered_prompt_len) noexcept {
-    return rendered_prompt_len < committed_prompt_len;
+/// Proposes up to `max_tokens` continuation tokens for prompt-lookup
+/// speculation over `resident` followed by `next_token`, without copying the
+/// resident tokens. The trailing `ngram_size` tokens are matched against
+/// earlier positions, most recent first, and the tokens that followed the
+/// match are returned. Returns an empty vector when nothing matches.
+[[nodiscard]] inline std::vector<int> find_prompt_lookup_draft(std::span<const int> resident,
+                                                               int next_token, size_t ngram_size,
+                                                               size_t max_tokens) {
+    const size_t size = resident.size() + 1;
+    if (ngram_size == 0 || max_tokens == 0 || size <= ngram_size) {
+        return {};
+    }
+
+    const auto at = [&](size_t index) {
+        return index < resident.size() ? resident[index] : next_token;
+    };
+    const size_t pattern = size - ngram_size;
+    for (size_t start = pattern; start-- > 0;) {
+        // The pattern always ends in `next_token`, which rejects most starts.
+        if (at(start + ngram_size - 1) != next_token) {
+            continue;
+        }
+        size_t matched = 0;
+        while (matched + 1 < ngram_size && at(start + matched) == at(pattern + matched)) {
+            ++matched;
+        }
+        if (matched + 1 < ngram_size) {
+            continue;
+        }
+        const size_t follow = start + ngram_size;
+        const size_t count = std::min(max_tokens, size - follow);
+        std::vector<int> draft;
+        draft.reserve(count);
+        for (size_t index = follow; index < follow + count; ++index) {
+            draft.push_back(at(index));
+        }
+        return draft;
+    }
+    return {};
 }
 
-inline void commit_rendered_prompt(int& committed_prompt_len, int rendered_prompt_len) noexcept {
-    if (rendered_prompt_len > 0) {
-        committed_prompt_len = rendered_prompt_len;
+/// Same as above for a `context` that already ends in the latest token.
+[[nodiscard]] inline std::vector<int> find_prompt_lookup_draft(std::span<const int> context,
+                                                               size_t ngram_size,
+                                                               size_t max_tokens) {
+    if (context.empty()) {
+        return {};
     }
+    return find_prompt_lookup_draft(context.first(context.size() - 1), context.back(), ngram_size,
+                                    max_tokens);
 }
 
 } // namespace zoo::core
@@ -0,0 +1,221 @@
+/**
+ * @file session_snapshot.cpp
+ * @brief Binary encoding of persisted `Model` session snapshots.
+ */
+
+#include "core/session_snapshot.hpp"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace zoo::core {
+
+namespace {
+
+constexpr std::array<char, 8> kMagic = {'Z', 'O', 'O', 'S', 'E', 'S', 'S', '\0'};
+
+class Writer {
+  public:
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void scalar(T value) {
+        const auto* raw = reinterpret_cast<const char*>(&value);
+        out_.append(raw, sizeof(T));
+    }
+
+    void string(std::string_view value) {
+        scalar(static_cast<uint64_t>(value.size()));
+        out_.append(value);
+    }
+
+    void bytes(const void* data, size_t size) {
+        out_.append(static_cast<const char*>(data), size);
+    }
+
+    [[nodiscard]] std::string take() {
+        return std::move(out_);
+    }
+
+  private:
+    std::string out_;
+};
+
+class Reader {
+  public:
+    explicit Reader(std::string_view in) : in_(in) {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    bool scalar(T& value) {
+        if (in_.size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, in_.data(), sizeof(T));
+        in_.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    bool string(std::string& value) {
+        uint64_t size = 0;
+        if (!scalar(size) || size > in_.size()) {
+            return false;
+        }
+        value.assign(in_.data(), static_cast<size_t>(size));
+        in_.remove_prefix(static_cast<size_t>(size));
+        return true;
+    }
+
+    bool bytes(void* data, size_t size) {
+        if (in_.size() < size) {
+            return false;
+        }
+        std::memcpy(data, in_.data(), size);
+        in_.remove_prefix(size);
+        return true;
+    }
+
+    // Guards element counts before reserving so a corrupt length cannot
+    // trigger a huge allocation.
+    bool count(uint64_t& value, size_t min_element_size) {
+        return scalar(value) && value <= in_.size() / min_element_size;
+    }
+
+    [[nodiscard]] bool exhausted() const noexcept {
+        return in_.empty();
+    }
+
+  private:
+    std::string_view in_;
+};
+
+Error invalid_snapshot(std::string detail) {
+    return Error{ErrorCode::SessionSnapshotInvalid, "Malformed session snapshot",
+                 std::move(detail)};
+}
+
+} // namespace
+
+std::string encode_session_snapshot(const SessionSnapshot& snapshot) {
+    Writer writer;
+    writer.bytes(kMagic.data(), kMagic.size());
+    writer.scalar(kSessionSnapshotVersion);
+    writer.string(snapshot.model_id);
+    writer.scalar(snapshot.model_fingerprint);
+
+    writer.scalar(static_cast<uint64_t>(snapshot.messages.size()));
+    for (const auto& message : snapshot.messages) {
+        writer.scalar(static_cast<uint8_t>(message.role));
+        writer.string(message.content);
+        writer.string(message.tool_call_id);
+        writer.scalar(static_cast<uint64_t>(message.tool_calls.size()));
+        for (const auto& call : message.tool_calls) {
+            writer.string(call.id);
+            writer.string(call.name);
+            writer.string(call.arguments_json);
+        }
+    }
+
+    writer.scalar(static_cast<uint64_t>(snapshot.kv_tokens.size()));
+    for (const int token : snapshot.kv_tokens) {
+        writer.scalar(static_cast<int32_t>(token));
+    }
+
+    writer.scalar(static_cast<uint64_t>(snapshot.sequence_state.size()));
+    writer.bytes(snapshot.sequence_state.data(), snapshot.sequence_state.size());
+    return writer.take();
+}
+
+Expected<SessionSnapshot> decode_session_snapshot(std::string_view bytes) {
+    Reader reader(bytes);
+
+    std::array<char, 8> magic{};
+    if (!reader.bytes(magic.data(), magic.size()) || magic != kMagic) {
+        return std::unexpected(invalid_snapshot("missing session snapshot header"));
+    }
+
+    uint32_t version = 0;
+    if (!reader.scalar(version)) {
+        return std::unexpected(invalid_snapshot("truncated header"));
+    }
+    if (version != kSessionSnapshotVersion) {
+        return std::unexpected(Error{ErrorCode::SessionSnapshotMismatch,
+                                     "Unsupported session snapshot version",
+                                     "found " + std::to_string(version) + ", expected " +
+                                         std::to_string(kSessionSnapshotVersion)});
+    }
+
+    SessionSnapshot snapshot;
+    if (!reader.string(snapshot.model_id) || !reader.scalar(snapshot.model_fingerprint)) {
+        return std::unexpected(invalid_snapshot("truncated header"));
+    }
+
+    uint64_t message_count = 0;
+    if (!reader.count(message_count, sizeof(uint8_t) + 3 * sizeof(uint64_t))) {
+        return std::unexpected(invalid_snapshot("bad message count"));
+    }
+    snapshot.messages.reserve(static_cast<size_t>(message_count));
+    for (uint64_t i = 0; i < message_count; ++i) {
+        Message message;
+        uint8_t role = 0;
+        uint64_t call_count = 0;
+        if (!reader.scalar(role) || role > static_cast<uint8_t>(Role::Tool) ||
+            !reader.string(message.content) || !reader.string(message.tool_call_id) ||
+            !reader.count(call_count, 3 * sizeof(uint64_t))) {
+            return std::unexpected(invalid_snapshot("truncated message " + std::to_string(i)));
+        }
+        message.role = static_cast<Role>(role);
+        message.tool_calls.resize(static_cast<size_t>(call_count));
+        for (auto& call : message.tool_calls) {
+            if (!reader.string(call.id) || !reader.string(call.name) ||
+                !reader.string(call.arguments_json)) {
+                return std::unexpected(
+                    invalid_snapshot("truncated tool call in message " + std::to_string(i)));
+            }
+        }
+        snapshot.messages.push_back(std::move(message));
+    }
+
+    uint64_t token_count = 0;
+    if (!reader.count(token_count, sizeof(int32_t))) {
+        return std::unexpected(invalid_snapshot("bad token count"));
+    }
+    snapshot.kv_tokens.resize(static_cast<size_t>(token_count));
+    for (auto& token : snapshot.kv_tokens) {
+        int32_t raw = 0;
+        reader.scalar(raw);
+        token = static_cast<int>(raw);
+    }
+
+    uint64_t state_size = 0;
+    if (!reader.count(state_size, 1)) {
+        return std::unexpected(invalid_snapshot("bad sequence state size"));
+    }
+    snapshot.sequence_state.resize(static_cast<size_t>(state_size));
+    reader.bytes(snapshot.sequence_state.data(), snapshot.sequence_state.size());
+
+    if (!reader.exhausted()) {
+        return std::unexpected(invalid_snapshot("trailing bytes after sequence state"));
+    }
+    return snapshot;
+}
+
+Expected<void> check_session_snapshot_model(const SessionSnapshot& snapshot,
+                                            std::string_view model_id,
+                                            uint64_t model_fingerprint) {
+    if (snapshot.model_id != model_id) {
+        return std::unexpected(Error{ErrorCode::SessionSnapshotMismatch,
+                                     "Session snapshot belongs to a different model",
+                                     "snapshot model id '" + snapshot.model_id + "', expected '" +
+                                         std::string(model_id) + "'"});
+    }
+    if (snapshot.model_fingerprint != model_fingerprint) {
+        return std::unexpected(Error{ErrorCode::SessionSnapshotMismatch,
+                                     "Session snapshot was taken against different weights"});
+    }
+    return {};
+}
+
+} // namespace zoo::core
@@ -0,0 +1,49 @@
+/**
+ * @file session_snapshot.hpp
+ * @brief Binary encoding of persisted `Model` session snapshots.
+ */
+
+#pragma once
+
+#include "zoo/core/types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace zoo::core {
+
+/// Bumped whenever the on-disk layout changes; older snapshots are rejected.
+inline constexpr uint32_t kSessionSnapshotVersion = 1;
+
+/**
+ * @brief Everything needed to resume a conversation without re-prefilling it.
+ *
+ * `model_id` is the caller-supplied identity (typically `hub::ModelEntry::id`)
+ * and `model_fingerprint` is derived from the loaded weights; both must match
+ * on restore. `sequence_state` is the opaque llama.cpp sequence blob whose
+ * cells correspond one-to-one with `kv_tokens`.
+ */
+struct SessionSnapshot {
+    std::string model_id;
+    uint64_t model_fingerprint = 0;
+    std::vector<Message> messages;
+    std::vector<int> kv_tokens;
+    std::vector<uint8_t> sequence_state;
+
+    bool operator==(const SessionSnapshot& other) const = default;
+};
+
+/// Serializes a snapshot, header first, in host byte order.
+[[nodiscard]] std::string encode_session_snapshot(const SessionSnapshot& snapshot);
+
+/// Parses a snapshot produced by `encode_session_snapshot()`.
+[[nodiscard]] Expected<SessionSnapshot> decode_session_snapshot(std::string_view bytes);
+
+/// Rejects snapshots taken against a different model identity or weights.
+[[nodiscard]] Expected<void> check_session_snapshot_model(const SessionSnapshot& snapshot,
+                                                          std::string_view model_id,
+                                                          uint64_t model_fingerprint);
+
+} // namespace zoo::core
@@ -1,27 +1,313 @@
 #include "core/stream_filter.hpp"
 #include <common.h>
 
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <queue>
+#include <utility>
+
 namespace zoo::core {
 
-size_t StopSequenceMatcher::match_suffix(std::string_view generated_text) const noexcept {
-    for (const auto& stop_sequence : stop_sequences_) {
-        if (stop_sequence.empty()) {
+namespace {
+
+// Recovers literals that every match of an ECMAScript regex must contain.
+// The scan is conservative: anything it does not understand (classes,
+// escapes such as \s, lookarounds, optional atoms) ends the current literal
+// run instead of extending it. A required alternation group yields the set of
+// its branches' literals, any one of which must appear.
+class RequiredLiteralScanner {
+  public:
+    explicit RequiredLiteralScanner(std::string_view pattern) : pattern_(pattern) {}
+
+    // Returns a set of literals at least one of which occurs in every match,
+    // or an empty set when none could be proven.
+    std::vector<std::string> scan() {
+        auto literals = alternation();
+        if (pos_ != pattern_.size()) {
+            return {};
+        }
+        return literals;
+    }
+
+  private:
+    static size_t shortest(const std::vector<std::string>& literals) {
+        size_t length = std::numeric_limits<size_t>::max();
+        for (const auto& literal : literals) {
+            length = std::min(length, literal.size());
+        }
+        return literals.empty() ? 0 : length;
+    }
+
+    std::vector<std::string> alternation() {
+        std::vector<std::string> literals;
+        bool every_branch = true;
+        while (true) {
+            auto branch = sequence();
+            if (branch.empty()) {
+                every_branch = false;
+            }
+            literals.insert(literals.end(), branch.begin(), branch.end());
+            if (pos_ < pattern_.size() && pattern_[pos_] == '|') {
+                ++pos_;
+                continue;
+            }
+            break;
+        }
+        return every_branch ? literals : std::vector<std::string>{};
+    }
+
+    std::vector<std::string> sequence() {
+        std::vector<std::string> best;
+        std::string run;
+        const auto keep_if_longer = [&best](std::vector<std::string> candidate) {
+            if (shortest(candidate) > shortest(best)) {
+                best = std::move(candidate);
+            }
+        };
+        const auto flush = [&] {
+            if (!run.empty()) {
+                keep_if_longer({run});
+                run.clear();
+            }
+        };
+
+        while (pos_ < pattern_.size() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+            const char c = pattern_[pos_];
+            if (c == '(') {
+                flush();
+                ++pos_;
+                bool lookaround = false;
+                if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+                    const bool non_capturing =
+                        pos_ + 1 < pattern_.size() && pattern_[pos_ + 1] == ':';
+                    lookaround = !non_capturing;
+                    pos_ += non_capturing ? 2 : 1;
+                }
+                auto inner = alternation();
+                if (pos_ < pattern_.size() && pattern_[pos_] == ')') {
+                    ++pos_;
+                }
+                const bool optional = skip_quantifier();
+                if (!lookaround && !optional) {
+                    keep_if_longer(std::move(inner));
+                }
+                continue;
+            }
+            if (c == '[') {
+                flush();
+                skip_class();
+                (void)skip_quantifier();
+                continue;
+            }
+
+            std::optional<char> literal;
+            if (c == '\\') {
+                if (pos_ + 1 >= pattern_.size()) {
+                    pos_ = pattern_.size();
+                    break;
+                }
+                const char escaped = pattern_[pos_ + 1];
+                pos_ += 2;
+                if (!std::isalnum(static_cast<unsigned char>(escaped))) {
+                    literal = escaped;
+                } else if (escaped == 'x') {
+                    pos_ = std::min(pos_ + 2, pattern_.size());
+                } else if (escaped == 'u') {
+                    pos_ = std::min(pos_ + 4, pattern_.size());
+                } else if (escaped == 'c') {
+                    pos_ = std::min(pos_ + 1, pattern_.size());
+                }
+            } else {
+                ++pos_;
+                if (c != '.' && c != '^' && c != '$') {
+                    literal = c;
+                }
+            }
+
+            if (!literal) {
+                flush();
+                (void)skip_quantifier();
+                continue;
+            }
+            if (at_quantifier()) {
+                if (!skip_quantifier()) {
+                    run.push_back(*literal);
+                }
+                flush();
+                continue;
+            }
+            run.push_back(*literal);
+        }
+        flush();
+        return best;
+    }
+
+    bool at_quantifier() const {
+        if (pos_ >= pattern_.size()) {
+            return false;
+        }
+        const char c = pattern_[pos_];
+        return c == '*' || c == '+' || c == '?' ||
+               (c == '{' && pattern_.find('}', pos_) != std::string_view::npos);
+    }
+
+    // Consumes a quantifier if one follows; returns true when it allows zero
+    // repetitions.
+    bool skip_quantifier() {
+        if (!at_quantifier()) {
+            return false;
+        }
+        bool optional = false;
+        const char c = pattern_[pos_];
+        if (c == '{') {
+            size_t minimum = 0;
+            size_t index = pos_ + 1;
+            while (index < pattern_.size() &&
+                   std::isdigit(static_cast<unsigned char>(pattern_[index]))) {
+                minimum = minimum * 10 + static_cast<size_t>(pattern_[index] - '0');
+                ++index;
+            }
+            optional = minimum == 0;
+            pos_ = pattern_.find('}', pos_) + 1;
+        } else {
+            optional = c != '+';
+            ++pos_;
+        }
+        if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+            ++pos_;
+        }
+        return optional;
+    }
+
+    void skip_class() {
+        ++pos_;
+        if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+            ++pos_;
+        }
+        if (pos_ < pattern_.size() && pattern_[pos_] == ']') {
+            ++pos_;
+        }
+        while (pos_ < pattern_.size() && pattern_[pos_] != ']') {
+            pos_ += pattern_[pos_] == '\\' ? 2 : 1;
+        }
+        pos_ = std::min(pos_ + 1, pattern_.size());
+    }
+
+    std::string_view pattern_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+MultiPatternMatcher::MultiPatternMatcher() : transitions_(1, kStart), nodes_(1) {}
+
+MultiPatternMatcher::MultiPatternMatcher(std::span<const std::string> patterns) {
+    // Bytes that occur in no pattern share class 0, which always falls back
+    // to the start state; this keeps the table narrow.
+    size_t class_count = 1;
+    for (const auto& pattern : patterns) {
+        for (const char byte : pattern) {
+            auto& cls = classes_[static_cast<unsigned char>(byte)];
+            if (cls == 0) {
+                cls = static_cast<uint16_t>(class_count++);
+            }
+        }
+    }
+    stride_ = class_count;
+
+    constexpr State kMissing = std::numeric_limits<State>::max();
+    transitions_.assign(stride_, kMissing);
+    nodes_.assign(1, Node{});
+
+    std::vector<std::pair<State, uint32_t>> terminals;
+    for (size_t index = 0; index < patterns.size(); ++index) {
+        if (patterns[index].empty()) {
             continue;
         }
-        if (generated_text.size() >= stop_sequence.size() &&
-            generated_text.compare(generated_text.size() - stop_sequence.size(),
-                                   stop_sequence.size(), stop_sequence) == 0) {
-            return stop_sequence.size();
+        State state = kStart;
+        for (const char byte : patterns[index]) {
+            auto& next = transitions_[state * stride_ + classes_[static_cast<unsigned char>(byte)]];
+            if (next == kMissing) {
+                next = static_cast<State>(nodes_.size());
+                nodes_.push_back(Node{nodes_[state].depth + 1});
+                transitions_.resize(transitions_.size() + stride_, kMissing);
+            }
+            state = transitions_[state * stride_ + classes_[static_cast<unsigned char>(byte)]];
+        }
+        terminals.emplace_back(state, static_cast<uint32_t>(index));
+    }
+
+    std::sort(terminals.begin(), terminals.end());
+    outputs_.reserve(terminals.size());
+    for (const auto& [state, index] : terminals) {
+        auto& node = nodes_[state];
+        if (node.output_begin == node.output_end) {
+            node.output_begin = static_cast<uint32_t>(outputs_.size());
+        }
+        outputs_.push_back(index);
+        node.output_end = static_cast<uint32_t>(outputs_.size());
+        node.longest_match = node.depth;
+    }
+
+    // Breadth-first: a state's failure target is shallower, so it is final
+    // before the state itself is visited.
+    std::vector<State> failure(nodes_.size(), kStart);
+    std::queue<State> pending;
+    for (size_t cls = 0; cls < stride_; ++cls) {
+        auto& next = transitions_[cls];
+        if (next == kMissing) {
+            next = kStart;
+        } else {
+            pending.push(next);
+        }
+    }
+    while (!pending.empty()) {
+        const State state = pending.front();
+        pending.pop();
+        for (size_t cls = 0; cls < stride_; ++cls) {
+            auto& next = transitions_[state * stride_ + cls];
+            const State fallback = transitions_[failure[state] * stride_ + cls];
+            if (next == kMissing) {
+                next = fallback;
+                continue;
+            }
+            failure[next] = fallback;
+            auto& node = nodes_[next];
+            const auto& suffix = nodes_[fallback];
+            node.dictionary_link =
+                suffix.output_begin != suffix.output_end ? fallback : suffix.dictionary_link;
+            if (node.output_begin == node.output_end) {
+                node.longest_match = suffix.longest_match;
+            }
+            pending.push(next);
+        }
+    }
+}
+
+size_t StopSequenceMatcher::match_suffix(std::string_view generated_text) const noexcept {
+    return matcher_.match_length(matcher_.advance(MultiPatternMatcher::kStart, generated_text));
+}
+
+size_t StopSequenceMatcher::feed(std::string_view piece) noexcept {
+    for (size_t index = 0; index < piece.size(); ++index) {
+        state_ = matcher_.advance(state_, piece[index]);
+        if (const size_t match = matcher_.match_length(state_); match > 0) {
+            return match + (piece.size() - index - 1);
         }
     }
     return 0;
 }
 
+ToolCallTriggerMatcher::ToolCallTriggerMatcher()
+    : automaton_(std::make_shared<const MultiPatternMatcher>()) {}
+
 ToolCallTriggerMatcher::ToolCallTriggerMatcher(
     const std::vector<common_grammar_trigger>& triggers) {
     word_triggers_.reserve(triggers.size());
     regex_triggers_.reserve(triggers.size());
 
+    std::vector<std::string> gates;
     for (const auto& trigger : triggers) {
         if (trigger.value.empty()) {
             continue;
@@ -34,9 +320,14 @@ ToolCallTriggerMatcher::ToolCallTriggerMatcher(
         case COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN:
         case COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN_FULL:
             try {
-                regex_triggers_.push_back(
-                    RegexTrigger{std::regex(trigger.value),
-                                 trigger.type == COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN_FULL});
+                RegexTrigger regex_trigger{
+                    std::regex(trigger.value),
+                    trigger.type == COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN_FULL, gates.size(), 0};
+                auto literals = RequiredLiteralScanner(trigger.value).scan();
+                gates.insert(gates.end(), std::make_move_iterator(literals.begin()),
+                             std::make_move_iterator(literals.end()));
+                regex_trigger.gate_end = gates.size();
+                regex_triggers_.push_back(std::move(regex_trigger));
             } catch (const std::regex_error&) {
                 // Malformed pattern: ignore it so runtime generation can continue.
             }
@@ -45,16 +336,46 @@ ToolCallTriggerMatcher::ToolCallTriggerMatcher(
             break;
         }
     }
+
+    gate_count_ = gates.size();
+    std::vector<std::string> patterns = word_triggers_;
+    patterns.insert(patterns.end(), std::make_move_iterator(gates.begin()),
+                    std::make_move_iterator(gates.end()));
+    automaton_ = std::make_shared<const MultiPatternMatcher>(patterns);
 }
 
 bool ToolCallTriggerMatcher::is_detected(std::string_view text) const {
-    for (const auto& trigger : word_triggers_) {
-        if (text.find(trigger) != std::string_view::npos) {
+    const size_t word_count = word_triggers_.size();
+    std::vector<bool> gates_seen(gate_count_, false);
+    bool word_seen = false;
+
+    auto state = MultiPatternMatcher::kStart;
+    for (const char byte : text) {
+        state = automaton_->advance(state, byte);
+        automaton_->for_each_match(state, [&](size_t pattern, size_t) {
+            if (pattern < word_count) {
+                word_seen = true;
+            } else {
+                gates_seen[pattern - word_count] = true;
+            }
+        });
+        if (word_seen) {
             return true;
         }
     }
+    return regex_detected(text, gates_seen);
+}
 
+bool ToolCallTriggerMatcher::regex_detected(std::string_view text,
+                                            const std::vector<bool>& gates_seen) const {
     for (const auto& trigger : regex_triggers_) {
+        if (trigger.gate_begin != trigger.gate_end &&
+            std::none_of(gates_seen.begin() + static_cast<std::ptrdiff_t>(trigger.gate_begin),
+                         gates_seen.begin() + static_cast<std::ptrdiff_t>(trigger.gate_end),
+                         [](bool seen) { return seen; })) {
+            continue;
+        }
+
         if (trigger.full_match) {
             if (std::regex_match(text.begin(), text.end(), trigger.regex)) {
                 return true;
@@ -80,49 +401,50 @@ extract_word_triggers(const std::vector<common_grammar_trigger>& triggers) {
     return ToolCallTriggerMatcher(triggers).word_triggers();
 }
 
-size_t ToolCallWordTriggerFilter::first_trigger_match(std::string_view text) const {
-    size_t earliest = std::string::npos;
-    for (const auto& trigger : borrowed_triggers_) {
-        const size_t pos = text.find(trigger);
-        if (pos != std::string::npos && (earliest == std::string::npos || pos < earliest)) {
-            earliest = pos;
-        }
-    }
-    return earliest;
-}
+ToolCallWordTriggerFilter::ToolCallWordTriggerFilter(std::span<const std::string> word_triggers)
+    : automaton_(std::make_shared<const MultiPatternMatcher>(word_triggers)),
+      word_count_(word_triggers.size()) {}
 
-size_t ToolCallWordTriggerFilter::buffered_suffix_len(std::string_view text) const {
-    size_t longest = 0;
-    for (const auto& trigger : borrowed_triggers_) {
-        const size_t max_check = std::min(text.size(), trigger.size() - 1);
-        for (size_t len = 1; len <= max_check; ++len) {
-            if (text.substr(text.size() - len) == std::string_view(trigger).substr(0, len)) {
-                longest = std::max(longest, len);
-            }
-        }
-    }
-    return longest;
-}
+ToolCallWordTriggerFilter::ToolCallWordTriggerFilter(const ToolCallTriggerMatcher& trigger_matcher)
+    : automaton_(trigger_matcher.automaton()),
+      word_count_(trigger_matcher.word_triggers().size()),
+      gates_seen_(trigger_matcher.gate_count(), false) {}
 
 std::string ToolCallWordTriggerFilter::consume(std::string_view token) {
     if (suppressing_) {
         return {};
     }
 
-    std::string candidate = pending_;
-    candidate.append(token);
+    // `pending_` always holds the suffix the automaton state still treats as
+    // a possible trigger prefix, so only the new bytes are scanned.
+    for (size_t index = 0; index < token.size(); ++index) {
+        state_ = automaton_->advance(state_, token[index]);
+        if (automaton_->match_length(state_) == 0) {
+            continue;
+        }
 
-    const size_t trigger_pos = first_trigger_match(candidate);
-    if (trigger_pos != std::string::npos) {
-        suppressing_ = true;
-        pending_.clear();
-        return candidate.substr(0, trigger_pos);
+        size_t trigger_length = 0;
+        automaton_->for_each_match(state_, [&](size_t pattern, size_t length) {
+            if (pattern < word_count_) {
+                trigger_length = std::max(trigger_length, length);
+            } else {
+                gates_seen_[pattern - word_count_] = true;
+            }
+        });
+        if (trigger_length > 0) {
+            suppressing_ = true;
+            pending_.append(token.substr(0, index + 1));
+            std::string visible = pending_.substr(0, pending_.size() - trigger_length);
+            pending_.clear();
+            return visible;
+        }
     }
 
-    const size_t suffix_len = buffered_suffix_len(candidate);
-    pending_ = candidate.substr(candidate.size() - suffix_len);
-    candidate.resize(candidate.size() - suffix_len);
-    return candidate;
+    pending_.append(token);
+    const size_t visible_length = pending_.size() - automaton_->prefix_length(state_);
+    std::string visible = pending_.substr(0, visible_length);
+    pending_.erase(0, visible_length);
+    return visible;
 }
 
 std::string ToolCallWordTriggerFilter::finalize() {
@@ -131,17 +453,21 @@ std::string ToolCallWordTriggerFilter::finalize() {
     }
     std::string trailing = std::move(pending_);
     pending_.clear();
+    state_ = MultiPatternMatcher::kStart;
     return trailing;
 }
 
-StreamFilter::StreamFilter(std::span<const std::string> word_triggers,
-                           const ToolCallTriggerMatcher* trigger_matcher)
-    : trigger_matcher_(trigger_matcher) {
+StreamFilter::StreamFilter(std::span<const std::string> word_triggers) {
     if (!word_triggers.empty()) {
         word_filter_.emplace(word_triggers);
     }
 }
 
+StreamFilter::StreamFilter(const ToolCallTriggerMatcher& trigger_matcher)
+    : trigger_matcher_(&trigger_matcher) {
+    word_filter_.emplace(trigger_matcher);
+}
+
 std::string StreamFilter::consume(std::string_view token, std::string_view accumulated_text) {
     if (suppressing_) {
         return {};
@@ -155,7 +481,8 @@ std::string StreamFilter::consume(std::string_view token, std::string_view accum
         visible_chunk.assign(token);
     }
 
-    if (!suppressing_ && trigger_matcher_ && trigger_matcher_->is_detected(accumulated_text)) {
+    if (!suppressing_ && trigger_matcher_ &&
+        trigger_matcher_->regex_detected(accumulated_text, word_filter_->gates_seen())) {
         suppressing_ = true;
         visible_chunk.clear();
     }
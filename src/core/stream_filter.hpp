@@ -1,10 +1,13 @@
 /**
  * @file stream_filter.hpp
- * @brief Helper for detecting tool-call grammar triggers in streamed text.
+ * @brief Incremental stop-sequence and tool-call trigger matching for streamed text.
  */
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <regex>
 #include <span>
@@ -17,22 +20,115 @@ struct common_grammar_trigger;
 
 namespace zoo::core {
 
-/// Matches generated text against configured stop-sequence suffixes.
+/**
+ * @brief Aho-Corasick automaton over a fixed set of byte strings.
+ *
+ * Transitions are precomputed into a dense table over the bytes that occur in
+ * any pattern, so feeding text is one table lookup per byte and allocates
+ * nothing. Callers own the current `State` and advance it with new text only.
+ */
+class MultiPatternMatcher {
+  public:
+    using State = uint32_t;
+    static constexpr State kStart = 0;
+
+    /// Builds a matcher that never matches.
+    MultiPatternMatcher();
+
+    /// Builds a matcher for `patterns`; empty patterns are ignored.
+    explicit MultiPatternMatcher(std::span<const std::string> patterns);
+
+    [[nodiscard]] bool empty() const noexcept {
+        return nodes_.size() == 1;
+    }
+
+    [[nodiscard]] State advance(State state, char byte) const noexcept {
+        return transitions_[state * stride_ + classes_[static_cast<unsigned char>(byte)]];
+    }
+
+    /// Feeds `text` from `state` and returns the resulting state.
+    [[nodiscard]] State advance(State state, std::string_view text) const noexcept {
+        for (const char byte : text) {
+            state = advance(state, byte);
+        }
+        return state;
+    }
+
+    /// Length of the longest pattern ending at `state`, or 0 when none does.
+    [[nodiscard]] size_t match_length(State state) const noexcept {
+        return nodes_[state].longest_match;
+    }
+
+    /// Length of the longest suffix of the fed text that is a prefix of a pattern.
+    [[nodiscard]] size_t prefix_length(State state) const noexcept {
+        return nodes_[state].depth;
+    }
+
+    /// Calls `fn(pattern_index, pattern_length)` for every pattern ending at `state`.
+    template <typename Fn> void for_each_match(State state, Fn&& fn) const {
+        if (nodes_[state].output_begin == nodes_[state].output_end) {
+            state = nodes_[state].dictionary_link;
+        }
+        while (state != kStart) {
+            const auto& node = nodes_[state];
+            for (uint32_t index = node.output_begin; index < node.output_end; ++index) {
+                fn(static_cast<size_t>(outputs_[index]), static_cast<size_t>(node.depth));
+            }
+            state = node.dictionary_link;
+        }
+    }
+
+  private:
+    struct Node {
+        uint32_t depth = 0;
+        uint32_t longest_match = 0;
+        // Nearest proper suffix state where a pattern ends; kStart when none.
+        State dictionary_link = kStart;
+        uint32_t output_begin = 0;
+        uint32_t output_end = 0;
+    };
+
+    std::array<uint16_t, 256> classes_{};
+    size_t stride_ = 1;
+    std::vector<State> transitions_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> outputs_;
+};
+
+/// Matches generated text against configured stop sequences.
 class StopSequenceMatcher {
   public:
     explicit StopSequenceMatcher(std::span<const std::string> stop_sequences)
-        : stop_sequences_(stop_sequences) {}
+        : matcher_(stop_sequences) {}
 
+    /// Length of the longest stop sequence that ends `generated_text`.
     [[nodiscard]] size_t match_suffix(std::string_view generated_text) const noexcept;
 
+    /**
+     * @brief Feeds the next generated piece.
+     *
+     * @return The number of trailing bytes to drop from the generated text:
+     *         the first stop sequence completed inside `piece` plus anything
+     *         after it, or 0 when no stop sequence has completed.
+     */
+    [[nodiscard]] size_t feed(std::string_view piece) noexcept;
+
   private:
-    std::span<const std::string> stop_sequences_;
+    MultiPatternMatcher matcher_;
+    MultiPatternMatcher::State state_ = MultiPatternMatcher::kStart;
 };
 
-/// Precompiled matcher for non-token tool-call grammar triggers.
+/**
+ * @brief Precompiled matcher for tool-call grammar triggers.
+ *
+ * WORD triggers and a literal that each PATTERN/PATTERN_FULL regex requires
+ * (its "gate") share one automaton. A regex only runs once one of its gate
+ * literals has appeared, so plain text never reaches `std::regex`. Regexes
+ * with no extractable literal run on every check.
+ */
 class ToolCallTriggerMatcher {
   public:
-    ToolCallTriggerMatcher() = default;
+    ToolCallTriggerMatcher();
 
     explicit ToolCallTriggerMatcher(const std::vector<common_grammar_trigger>& triggers);
 
@@ -42,22 +138,39 @@ class ToolCallTriggerMatcher {
         return word_triggers_;
     }
 
+    /// Automaton over `word_triggers()` followed by the regex gate literals.
+    [[nodiscard]] const std::shared_ptr<const MultiPatternMatcher>& automaton() const noexcept {
+        return automaton_;
+    }
+
+    [[nodiscard]] size_t gate_count() const noexcept {
+        return gate_count_;
+    }
+
+    /// Runs the regex triggers that are armed by `gates_seen` against `text`.
+    [[nodiscard]] bool regex_detected(std::string_view text,
+                                      const std::vector<bool>& gates_seen) const;
+
   private:
     struct RegexTrigger {
         std::regex regex;
         bool full_match = false;
+        // Gate literal indices [gate_begin, gate_end); an empty range always runs.
+        size_t gate_begin = 0;
+        size_t gate_end = 0;
     };
 
     std::vector<std::string> word_triggers_;
     std::vector<RegexTrigger> regex_triggers_;
+    size_t gate_count_ = 0;
+    std::shared_ptr<const MultiPatternMatcher> automaton_;
 };
 
-/// Returns true if any non-word grammar trigger is matched in the accumulated text.
+/// Returns true if any non-TOKEN grammar trigger is matched in the accumulated text.
 ///
-/// Supports PATTERN triggers (regex search) and PATTERN_FULL triggers (regex
-/// match against the full text). WORD triggers are handled by
-/// `ToolCallWordTriggerFilter` so split prefixes can be buffered safely.
-/// TOKEN triggers are skipped as they operate at the token-id level.
+/// Supports WORD triggers (literal search), PATTERN triggers (regex search) and
+/// PATTERN_FULL triggers (regex match against the full text). TOKEN triggers
+/// are skipped as they operate at the token-id level.
 bool is_tool_trigger_detected(const std::string& text,
                               const std::vector<common_grammar_trigger>& triggers);
 
@@ -67,11 +180,14 @@ std::vector<std::string> extract_word_triggers(const std::vector<common_grammar_
 /// Streams visible text while buffering possible literal trigger prefixes.
 class ToolCallWordTriggerFilter {
   public:
-    explicit ToolCallWordTriggerFilter(std::span<const std::string> word_triggers)
-        : borrowed_triggers_(word_triggers) {}
+    explicit ToolCallWordTriggerFilter(std::span<const std::string> word_triggers);
 
     explicit ToolCallWordTriggerFilter(std::vector<std::string> word_triggers)
-        : owned_triggers_(std::move(word_triggers)), borrowed_triggers_(owned_triggers_) {}
+        : ToolCallWordTriggerFilter(std::span<const std::string>(word_triggers)) {}
+
+    /// Shares the matcher's automaton. Gate literals are recorded for
+    /// `gates_seen()` but never suppress output themselves.
+    explicit ToolCallWordTriggerFilter(const ToolCallTriggerMatcher& trigger_matcher);
 
     std::string consume(std::string_view token);
     std::string finalize();
@@ -80,12 +196,15 @@ class ToolCallWordTriggerFilter {
         return suppressing_;
     }
 
-  private:
-    size_t buffered_suffix_len(std::string_view text) const;
-    size_t first_trigger_match(std::string_view text) const;
+    const std::vector<bool>& gates_seen() const noexcept {
+        return gates_seen_;
+    }
 
-    std::vector<std::string> owned_triggers_;
-    std::span<const std::string> borrowed_triggers_;
+  private:
+    std::shared_ptr<const MultiPatternMatcher> automaton_;
+    size_t word_count_ = 0;
+    MultiPatternMatcher::State state_ = MultiPatternMatcher::kStart;
+    std::vector<bool> gates_seen_;
     std::string pending_;
     bool suppressing_ = false;
 };
@@ -94,8 +213,8 @@ class ToolCallWordTriggerFilter {
 class StreamFilter {
   public:
     StreamFilter() = default;
-    StreamFilter(std::span<const std::string> word_triggers,
-                 const ToolCallTriggerMatcher* trigger_matcher = nullptr);
+    explicit StreamFilter(std::span<const std::string> word_triggers);
+    explicit StreamFilter(const ToolCallTriggerMatcher& trigger_matcher);
 
     std::string consume(std::string_view token, std::string_view accumulated_text);
     std::string finalize();
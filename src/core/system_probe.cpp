@@ -9,6 +9,7 @@
 #include <ggml-backend.h>
 #include <llama.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <thread>
 
@@ -145,4 +146,18 @@ Expected<SystemInfo> SystemProbe::probe() {
     return info;
 }
 
+ThreadRecommendation SystemProbe::recommend_threads(const SystemInfo& sys,
+                                                    int concurrent_models) {
+    if (sys.logical_cpu_count == 0) {
+        return {};
+    }
+    const int share =
+        std::max(1, static_cast<int>(sys.logical_cpu_count) / std::max(1, concurrent_models));
+
+    ThreadRecommendation recommendation;
+    recommendation.n_threads_batch = share;
+    recommendation.n_threads = share >= 4 ? share / 2 : share;
+    return recommendation;
+}
+
 } // namespace zoo::core
@@ -0,0 +1,158 @@
+/**
+ * @file token_mask.hpp
+ * @brief Precomputed vocabulary masks for grammar-constrained sampling.
+ */
+
+#pragma once
+
+#include "zoo/core/types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace zoo::core {
+
+/// Length of the UTF-8 sequence introduced by `lead`, or 0 for a continuation
+/// or invalid byte.
+[[nodiscard]] inline size_t utf8_sequence_length(unsigned char lead) noexcept {
+    if (lead < 0x80) {
+        return 1;
+    }
+    if ((lead & 0xE0) == 0xC0) {
+        return 2;
+    }
+    if ((lead & 0xF0) == 0xE0) {
+        return 3;
+    }
+    if ((lead & 0xF8) == 0xF0) {
+        return 4;
+    }
+    return 0;
+}
+
+/// Returns true when `text` is a whole number of well-formed UTF-8 sequences.
+[[nodiscard]] inline bool is_complete_utf8(std::string_view text) noexcept {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t length = utf8_sequence_length(static_cast<unsigned char>(text[pos]));
+        if (length == 0 || pos + length > text.size()) {
+            return false;
+        }
+        for (size_t i = 1; i < length; ++i) {
+            if ((static_cast<unsigned char>(text[pos + i]) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        pos += length;
+    }
+    return true;
+}
+
+/// Returns true when `text` ends partway through a UTF-8 sequence.
+[[nodiscard]] inline bool ends_inside_utf8_sequence(std::string_view text) noexcept {
+    // A sequence is at most four bytes, so only its lead can be further back.
+    const size_t begin = text.size() > 3 ? text.size() - 3 : 0;
+    for (size_t pos = text.size(); pos > begin; --pos) {
+        const auto byte = static_cast<unsigned char>(text[pos - 1]);
+        if ((byte & 0xC0) == 0x80) {
+            continue;
+        }
+        const size_t length = utf8_sequence_length(byte);
+        return length > text.size() - (pos - 1);
+    }
+    return false;
+}
+
+/**
+ * @brief Returns true when a grammar admits `piece` anywhere it admits free
+ * text of `kind`, whatever was generated before.
+ *
+ * Pieces that fail this test are not necessarily rejected; whether they fit
+ * depends on the grammar state, so they are checked against the grammar.
+ */
+[[nodiscard]] inline bool admitted_as_free_text(FreeTextKind kind,
+                                                std::string_view piece) noexcept {
+    if (piece.empty()) {
+        return false;
+    }
+    switch (kind) {
+    case FreeTextKind::String:
+        return piece.find_first_of(std::string_view("\"\\\0", 3)) == std::string_view::npos &&
+               is_complete_utf8(piece);
+    case FreeTextKind::Digits:
+        return std::ranges::all_of(piece, [](char c) { return c >= '0' && c <= '9'; });
+    case FreeTextKind::None:
+        break;
+    }
+    return false;
+}
+
+/**
+ * @brief One bit per vocabulary token.
+ */
+class TokenMask {
+  public:
+    TokenMask() = default;
+    explicit TokenMask(size_t n_tokens) : words_((n_tokens + 63) / 64), size_(n_tokens) {}
+
+    void set(size_t token) noexcept {
+        words_[token >> 6] |= uint64_t{1} << (token & 63);
+    }
+
+    [[nodiscard]] bool test(size_t token) const noexcept {
+        return token < size_ && ((words_[token >> 6] >> (token & 63)) & 1) != 0;
+    }
+
+    [[nodiscard]] size_t size() const noexcept {
+        return size_;
+    }
+
+  private:
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+};
+
+/**
+ * @brief Lazily built masks of the tokens admitted as free text, one per kind.
+ *
+ * A mask depends only on the vocabulary, so a loaded model keeps one cache
+ * for all of its sessions. Each mask is built once, on first use, and may be
+ * requested from several threads.
+ */
+class FreeTextMaskCache {
+  public:
+    /// `piece_of(token)` returns the token's text as the grammar matches it,
+    /// or an empty string for tokens the grammar must always check.
+    template <typename PieceFn>
+    [[nodiscard]] const TokenMask& get(FreeTextKind kind, size_t n_tokens, PieceFn&& piece_of) {
+        Slot& slot = slots_[static_cast<size_t>(kind)];
+        std::call_once(slot.once, [&] {
+            TokenMask mask(n_tokens);
+            if (kind != FreeTextKind::None) {
+                for (size_t token = 0; token < n_tokens; ++token) {
+                    if (admitted_as_free_text(kind, piece_of(token))) {
+                        mask.set(token);
+                    }
+                }
+            }
+            slot.mask = std::move(mask);
+        });
+        return slot.mask;
+    }
+
+  private:
+    struct Slot {
+        std::once_flag once;
+        TokenMask mask;
+    };
+
+    std::array<Slot, 3> slots_;
+};
+
+} // namespace zoo::core
@@ -499,6 +499,20 @@ Expected<ModelConfig> ModelStore::model_config(const std::string& name_or_alias)
     return core::GgufInspector::auto_configure(entry->info);
 }
 
+Expected<ModelConfig> ModelStore::model_config(const std::string& name_or_alias,
+                                               const std::string& draft_name_or_alias) const {
+    auto config = model_config(name_or_alias);
+    if (!config) {
+        return std::unexpected(config.error());
+    }
+    auto draft = find(draft_name_or_alias);
+    if (!draft) {
+        return std::unexpected(draft.error());
+    }
+    config->draft_model_path = draft->file_path;
+    return config;
+}
+
 Expected<std::unique_ptr<core::Model>>
 ModelStore::load_model(const std::string& name_or_alias, const GenerationOptions& options) const {
     auto config = model_config(name_or_alias);
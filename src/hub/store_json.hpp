@@ -25,6 +25,8 @@ inline void to_json(nlohmann::json& j, const ModelInfo& info) {
         {"layer_count", info.layer_count},
         {"head_count", info.head_count},
         {"kv_head_count", info.kv_head_count},
+        {"key_length", info.key_length},
+        {"value_length", info.value_length},
         {"context_length", info.context_length},
         {"quantization", info.quantization},
         {"metadata", info.metadata},
@@ -52,6 +54,10 @@ inline void from_json(const nlohmann::json& j, ModelInfo& info) {
         it->get_to(info.head_count);
     if (auto it = j.find("kv_head_count"); it != j.end())
         it->get_to(info.kv_head_count);
+    if (auto it = j.find("key_length"); it != j.end())
+        it->get_to(info.key_length);
+    if (auto it = j.find("value_length"); it != j.end())
+        it->get_to(info.value_length);
     if (auto it = j.find("context_length"); it != j.end())
         it->get_to(info.context_length);
     if (auto it = j.find("quantization"); it != j.end())
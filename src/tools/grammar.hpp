@@ -5,8 +5,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <zoo/tools/types.hpp>
 
@@ -167,4 +170,333 @@ class GrammarBuilder {
     }
 };
 
+/**
+ * @brief Reports the output a `GrammarBuilder::build_schema()` grammar forces next.
+ *
+ * Within the leading run of required parameters, every key, colon, comma and
+ * the closing brace is fixed once the preceding value is complete, as are the
+ * opening quote of a string and the rest of a boolean or enum value once its
+ * first bytes rule out the alternatives. Forced text omits the optional
+ * whitespace the grammar allows between tokens. From the first optional
+ * parameter on, the model chooses, and nothing is forced. `free_text()`
+ * reports where the grammar admits any string content or digits, so
+ * sampling can resolve most tokens from a precomputed mask.
+ */
+class SchemaJumpForward {
+  public:
+    explicit SchemaJumpForward(const std::vector<ToolParameter>& parameters) {
+        size_t required_count = 0;
+        while (required_count < parameters.size() && parameters[required_count].required) {
+            ++required_count;
+        }
+
+        steps_.push_back(Step{Step::Kind::Literal, "{", {}});
+        for (size_t index = 0; index < required_count; ++index) {
+            const auto& parameter = parameters[index];
+            if (index > 0) {
+                steps_.push_back(Step{Step::Kind::Literal, ",", {}});
+            }
+            steps_.push_back(Step{Step::Kind::Literal, nlohmann::json(parameter.name).dump(), {}});
+            steps_.push_back(Step{Step::Kind::Literal, ":", {}});
+            steps_.push_back(value_step(parameter));
+        }
+        if (required_count == parameters.size()) {
+            steps_.push_back(Step{Step::Kind::Literal, "}", {}});
+        }
+    }
+
+    /**
+     * @brief Where the scan of a growing output stopped.
+     *
+     * Passing one `Scan` to successive queries on the same output resumes at
+     * the step in progress, so each query only scans the bytes appended since
+     * the previous one. Each text must extend the one before it; a shorter
+     * text starts a new output and resets the scan.
+     */
+    class Scan {
+      private:
+        friend class SchemaJumpForward;
+
+        size_t step = 0;      // First step not yet complete.
+        size_t start = 0;     // Offset of that step's text.
+        size_t scanned = 0;   // Bytes of a string value searched for its closing quote.
+        bool escaped = false; // Whether the last scanned byte escapes the next.
+        size_t seen = 0;      // Length of the text the scan last ran over.
+    };
+
+    /**
+     * @brief Returns the text forced after `generated`.
+     *
+     * Empty when the model has a choice to make, when the object is complete,
+     * or when `generated` is not a prefix the grammar admits.
+     */
+    [[nodiscard]] std::string forced_continuation(std::string_view generated) const {
+        Scan scan;
+        return forced_continuation(generated, scan);
+    }
+
+    /// As above, resuming from and updating `scan`.
+    [[nodiscard]] std::string forced_continuation(std::string_view generated, Scan& scan) const {
+        const auto cursor = locate(generated, scan);
+        if (!cursor) {
+            return {};
+        }
+        const Step& step = steps_[cursor->step];
+        const std::string_view rest = cursor->rest;
+        switch (step.kind) {
+        case Step::Kind::Literal:
+            return step.text.substr(rest.size()) + emit_from(cursor->step + 1);
+        case Step::Kind::String:
+            return rest.empty() ? emit_from(cursor->step) : std::string();
+        case Step::Kind::Number:
+            return {};
+        case Step::Kind::Choice: {
+            std::vector<std::string_view> open;
+            for (const auto& choice : step.choices) {
+                if (choice.starts_with(rest)) {
+                    open.push_back(choice);
+                }
+            }
+            std::string forced(common_prefix(open).substr(rest.size()));
+            if (open.size() == 1) {
+                forced += emit_from(cursor->step + 1);
+            }
+            return forced;
+        }
+        }
+        return {};
+    }
+
+    /**
+     * @brief Classifies the output position at the end of `generated`.
+     *
+     * `String` inside the content of a free-form string value, where any text
+     * without quotes or backslashes is admitted; `Digits` inside or at the
+     * start of a number, where any run of digits is admitted; `None` anywhere
+     * else.
+     */
+    [[nodiscard]] FreeTextKind free_text(std::string_view generated) const {
+        Scan scan;
+        return free_text(generated, scan);
+    }
+
+    /// As above, resuming from and updating `scan`.
+    [[nodiscard]] FreeTextKind free_text(std::string_view generated, Scan& scan) const {
+        const auto cursor = locate(generated, scan);
+        if (!cursor) {
+            return FreeTextKind::None;
+        }
+        switch (steps_[cursor->step].kind) {
+        case Step::Kind::String:
+            return cursor->rest.empty() || ends_in_escape(cursor->rest) ? FreeTextKind::None
+                                                                         : FreeTextKind::String;
+        case Step::Kind::Number:
+            return FreeTextKind::Digits;
+        case Step::Kind::Literal:
+        case Step::Kind::Choice:
+            break;
+        }
+        return FreeTextKind::None;
+    }
+
+  private:
+    struct Step {
+        enum class Kind {
+            Literal, ///< Fixed text.
+            String,  ///< Free-form JSON string.
+            Number,  ///< Integer or number; the model decides where it ends.
+            Choice,  ///< One of a fixed set of values (enums and booleans).
+        };
+
+        Kind kind;
+        std::string text;
+        std::vector<std::string> choices;
+    };
+
+    // The step in progress where `generated` ends, and its generated part.
+    struct Cursor {
+        size_t step = 0;
+        std::string_view rest;
+    };
+
+    // Returns nullopt when `generated` completes every step or is not a prefix
+    // the grammar admits. Starts at the step `scan` stopped in and records
+    // where this call stops.
+    std::optional<Cursor> locate(std::string_view generated, Scan& scan) const {
+        if (generated.size() < scan.seen) {
+            scan = Scan{};
+        }
+        scan.seen = generated.size();
+
+        size_t pos = scan.start;
+        for (size_t index = scan.step; index < steps_.size(); ++index) {
+            const Step& step = steps_[index];
+            skip_whitespace(generated, pos);
+            if (index != scan.step) {
+                scan.step = index;
+                scan.scanned = 0;
+                scan.escaped = false;
+            }
+            scan.start = pos;
+            const std::string_view rest = generated.substr(pos);
+
+            switch (step.kind) {
+            case Step::Kind::Literal: {
+                if (rest.size() < step.text.size()) {
+                    if (!step.text.starts_with(rest)) {
+                        return std::nullopt;
+                    }
+                    return Cursor{index, rest};
+                }
+                if (!rest.starts_with(step.text)) {
+                    return std::nullopt;
+                }
+                pos += step.text.size();
+                break;
+            }
+            case Step::Kind::String: {
+                if (rest.empty()) {
+                    return Cursor{index, rest};
+                }
+                if (rest.front() != '"') {
+                    return std::nullopt;
+                }
+                const size_t end = closing_quote(rest, scan);
+                if (end == std::string_view::npos) {
+                    return Cursor{index, rest};
+                }
+                pos += end + 1;
+                break;
+            }
+            case Step::Kind::Number: {
+                const size_t length = number_length(rest);
+                if (length == rest.size()) {
+                    return Cursor{index, rest};
+                }
+                if (length == 0) {
+                    return std::nullopt;
+                }
+                pos += length;
+                break;
+            }
+            case Step::Kind::Choice: {
+                if (std::ranges::any_of(step.choices, [rest](const std::string& choice) {
+                        return choice.starts_with(rest);
+                    })) {
+                    return Cursor{index, rest};
+                }
+                size_t matched = 0;
+                for (const auto& choice : step.choices) {
+                    if (rest.starts_with(choice)) {
+                        matched = std::max(matched, choice.size());
+                    }
+                }
+                if (matched == 0) {
+                    return std::nullopt;
+                }
+                pos += matched;
+                break;
+            }
+            }
+        }
+        scan.step = steps_.size();
+        scan.start = pos;
+        return std::nullopt;
+    }
+
+    static Step value_step(const ToolParameter& parameter) {
+        if (!parameter.enum_values.empty()) {
+            Step step{Step::Kind::Choice, {}, {}};
+            for (const auto& value : parameter.enum_values) {
+                step.choices.push_back(value.dump());
+            }
+            return step;
+        }
+        switch (parameter.type) {
+        case ToolValueType::String:
+            return Step{Step::Kind::String, {}, {}};
+        case ToolValueType::Boolean:
+            return Step{Step::Kind::Choice, {}, {"true", "false"}};
+        case ToolValueType::Integer:
+        case ToolValueType::Number:
+            break;
+        }
+        return Step{Step::Kind::Number, {}, {}};
+    }
+
+    // Forced text from the start of step `index`, when nothing of it is generated yet.
+    std::string emit_from(size_t index) const {
+        std::string forced;
+        for (; index < steps_.size(); ++index) {
+            const Step& step = steps_[index];
+            switch (step.kind) {
+            case Step::Kind::Literal:
+                forced += step.text;
+                continue;
+            case Step::Kind::String:
+                forced += '"';
+                return forced;
+            case Step::Kind::Number:
+                return forced;
+            case Step::Kind::Choice: {
+                const std::vector<std::string_view> all(step.choices.begin(), step.choices.end());
+                forced += common_prefix(all);
+                if (step.choices.size() != 1) {
+                    return forced;
+                }
+                continue;
+            }
+            }
+        }
+        return forced;
+    }
+
+    static void skip_whitespace(std::string_view text, size_t& pos) {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n')) {
+            ++pos;
+        }
+    }
+
+    // Index of the quote closing the JSON string at the start of `text`,
+    // continuing from the bytes `scan` already searched.
+    static size_t closing_quote(std::string_view text, Scan& scan) {
+        size_t pos = std::max<size_t>(scan.scanned, 1);
+        for (; pos < text.size(); ++pos) {
+            if (scan.escaped) {
+                scan.escaped = false;
+            } else if (text[pos] == '\\') {
+                scan.escaped = true;
+            } else if (text[pos] == '"') {
+                return pos;
+            }
+        }
+        scan.scanned = pos;
+        return std::string_view::npos;
+    }
+
+    // Whether the unterminated JSON string `text` ends with an escaping backslash.
+    static bool ends_in_escape(std::string_view text) {
+        size_t backslashes = 0;
+        while (backslashes < text.size() && text[text.size() - 1 - backslashes] == '\\') {
+            ++backslashes;
+        }
+        return backslashes % 2 == 1;
+    }
+
+    static size_t number_length(std::string_view text) {
+        return std::min(text.size(), text.find_first_not_of("+-.0123456789eE"));
+    }
+
+    static std::string_view common_prefix(const std::vector<std::string_view>& values) {
+        std::string_view prefix = values.front();
+        for (const auto value : values) {
+            const auto mismatch = std::ranges::mismatch(prefix, value);
+            prefix = prefix.substr(0, static_cast<size_t>(mismatch.in1 - prefix.begin()));
+        }
+        return prefix;
+    }
+
+    std::vector<Step> steps_;
+};
+
 } // namespace zoo::tools
@@ -0,0 +1,259 @@
+/**
+ * @file json_stream.hpp
+ * @brief Incremental parser for the top-level fields of a streamed JSON object.
+ */
+
+#pragma once
+
+#include "zoo/core/types.hpp"
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace zoo::tools {
+
+/**
+ * @brief Parses a JSON object piece by piece as it is generated.
+ *
+ * Each byte is scanned once. A top-level field is reported as soon as its
+ * value is complete: strings, objects and arrays at their closing byte,
+ * numbers and literals at the first byte after them. Only the text of each
+ * value is handed to nlohmann::json, and the completed fields are collected
+ * into the object returned by `object()`, so the output is never parsed a
+ * second time.
+ */
+class JsonFieldStream {
+  public:
+    /**
+     * @brief Consumes the next piece of output.
+     *
+     * Calls `on_field(key, value)` for every top-level field completed within
+     * `piece`, in order. Scanning stops, and `TokenAction::Stop` is returned,
+     * as soon as `on_field` returns `TokenAction::Stop`. Input after a syntax
+     * error is ignored; see `failed()`.
+     */
+    template <typename OnField> TokenAction feed(std::string_view piece, OnField&& on_field) {
+        for (const char c : piece) {
+            if (state_ == State::Failed) {
+                break;
+            }
+            consumed_.push_back(c);
+            if (!consume(c)) {
+                continue;
+            }
+            if (on_field(std::string_view(key_), object_[key_]) == TokenAction::Stop) {
+                return TokenAction::Stop;
+            }
+        }
+        return TokenAction::Continue;
+    }
+
+    /// Whether the object has been closed.
+    [[nodiscard]] bool complete() const noexcept {
+        return state_ == State::Done;
+    }
+
+    /// Whether the output so far is not a prefix of one JSON object.
+    [[nodiscard]] bool failed() const noexcept {
+        return state_ == State::Failed;
+    }
+
+    /// Describes the syntax error when `failed()`.
+    [[nodiscard]] const std::string& error() const noexcept {
+        return error_;
+    }
+
+    /// Text consumed so far, including the byte that failed.
+    [[nodiscard]] const std::string& consumed() const noexcept {
+        return consumed_;
+    }
+
+    /// Fields completed so far, in a JSON object.
+    [[nodiscard]] const nlohmann::json& object() const noexcept {
+        return object_;
+    }
+
+    /// Moves the completed fields out, leaving an empty object.
+    [[nodiscard]] nlohmann::json take_object() noexcept {
+        return std::exchange(object_, nlohmann::json::object());
+    }
+
+  private:
+    enum class State {
+        BeforeObject,
+        BeforeKey,
+        Key,
+        AfterKey,
+        BeforeValue,
+        StringValue,
+        NestedValue,
+        ScalarValue,
+        AfterValue,
+        Done,
+        Failed,
+    };
+
+    static bool is_space(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    // Advances over one byte; returns true when it completes a field.
+    bool consume(char c) {
+        switch (state_) {
+        case State::BeforeObject:
+            if (c == '{') {
+                state_ = State::BeforeKey;
+            } else if (!is_space(c)) {
+                fail("expected '{'");
+            }
+            return false;
+        case State::BeforeKey:
+            if (c == '"') {
+                raw_.assign(1, c);
+                escaped_ = false;
+                state_ = State::Key;
+            } else if (c == '}' && object_.empty()) {
+                state_ = State::Done;
+            } else if (!is_space(c)) {
+                fail("expected a field name");
+            }
+            return false;
+        case State::Key:
+            raw_.push_back(c);
+            if (closes_string(c)) {
+                if (!decode_key()) {
+                    fail("invalid field name");
+                    return false;
+                }
+                state_ = State::AfterKey;
+            }
+            return false;
+        case State::AfterKey:
+            if (c == ':') {
+                state_ = State::BeforeValue;
+            } else if (!is_space(c)) {
+                fail("expected ':'");
+            }
+            return false;
+        case State::BeforeValue:
+            if (is_space(c)) {
+                return false;
+            }
+            raw_.assign(1, c);
+            escaped_ = false;
+            in_string_ = false;
+            if (c == '"') {
+                state_ = State::StringValue;
+            } else if (c == '{' || c == '[') {
+                depth_ = 1;
+                state_ = State::NestedValue;
+            } else {
+                state_ = State::ScalarValue;
+            }
+            return false;
+        case State::StringValue:
+            raw_.push_back(c);
+            return closes_string(c) && finish_value();
+        case State::NestedValue:
+            raw_.push_back(c);
+            if (in_string_) {
+                in_string_ = !closes_string(c);
+            } else if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{' || c == '[') {
+                ++depth_;
+            } else if ((c == '}' || c == ']') && --depth_ == 0) {
+                return finish_value();
+            }
+            return false;
+        case State::ScalarValue:
+            if (!is_space(c) && c != ',' && c != '}') {
+                raw_.push_back(c);
+                return false;
+            }
+            if (!finish_value()) {
+                return false;
+            }
+            after_value(c);
+            return true;
+        case State::AfterValue:
+            after_value(c);
+            return false;
+        case State::Done:
+            if (!is_space(c)) {
+                fail("unexpected text after the object");
+            }
+            return false;
+        case State::Failed:
+            break;
+        }
+        return false;
+    }
+
+    // Tracks escapes inside a string; returns true on its closing quote.
+    bool closes_string(char c) noexcept {
+        if (escaped_) {
+            escaped_ = false;
+            return false;
+        }
+        if (c == '\\') {
+            escaped_ = true;
+            return false;
+        }
+        return c == '"';
+    }
+
+    bool decode_key() {
+        if (raw_.find('\\') == std::string::npos) {
+            key_.assign(raw_, 1, raw_.size() - 2);
+            return true;
+        }
+        auto decoded = nlohmann::json::parse(raw_, nullptr, false);
+        if (decoded.is_discarded() || !decoded.is_string()) {
+            return false;
+        }
+        key_ = decoded.get<std::string>();
+        return true;
+    }
+
+    bool finish_value() {
+        auto value = nlohmann::json::parse(raw_, nullptr, false);
+        if (value.is_discarded()) {
+            fail("invalid value for field '" + key_ + "'");
+            return false;
+        }
+        object_[key_] = std::move(value);
+        state_ = State::AfterValue;
+        return true;
+    }
+
+    void after_value(char c) {
+        if (c == ',') {
+            state_ = State::BeforeKey;
+        } else if (c == '}') {
+            state_ = State::Done;
+        } else if (!is_space(c)) {
+            fail("expected ',' or '}'");
+        }
+    }
+
+    void fail(std::string message) {
+        error_ = std::move(message) + " at byte " + std::to_string(consumed_.size() - 1);
+        state_ = State::Failed;
+    }
+
+    State state_ = State::BeforeObject;
+    nlohmann::json object_ = nlohmann::json::object();
+    std::string consumed_;
+    std::string key_;
+    // Raw text of the key or value being scanned.
+    std::string raw_;
+    std::string error_;
+    int depth_ = 0;
+    bool escaped_ = false;
+    bool in_string_ = false;
+};
+
+} // namespace zoo::tools
@@ -322,30 +322,49 @@ Expected<void> ToolRegistry::register_tool(const std::string& name, const std::s
     return register_tool(std::move(*definition));
 }
 
-Expected<void> ToolRegistry::register_tool(ToolDefinition definition) {
+namespace {
+
+Expected<void> validate_policies(const ToolDefinition& definition) {
+    if (auto result = definition.execution.validate(); !result) {
+        return result;
+    }
+    return definition.cache.validate();
+}
+
+} // namespace
+
+void ToolRegistry::insert_definition(ToolDefinition definition) {
+    caches_.erase(definition.metadata.name);
+
     auto it = index_by_name_.find(definition.metadata.name);
     if (it != index_by_name_.end()) {
         tools_[it->second] = std::move(definition);
-        return {};
+        return;
     }
 
     const size_t index = tools_.size();
     index_by_name_.emplace(definition.metadata.name, index);
     tools_.push_back(std::move(definition));
+}
+
+Expected<void> ToolRegistry::register_tool(ToolDefinition definition) {
+    if (auto result = validate_policies(definition); !result) {
+        return result;
+    }
+    insert_definition(std::move(definition));
     return {};
 }
 
 Expected<void> ToolRegistry::register_tools(std::vector<ToolDefinition> definitions) {
-    for (auto& definition : definitions) {
-        auto it = index_by_name_.find(definition.metadata.name);
-        if (it != index_by_name_.end()) {
-            tools_[it->second] = std::move(definition);
-        } else {
-            const size_t index = tools_.size();
-            index_by_name_.emplace(definition.metadata.name, index);
-            tools_.push_back(std::move(definition));
+    for (const auto& definition : definitions) {
+        if (auto result = validate_policies(definition); !result) {
+            return result;
         }
     }
+
+    for (auto& definition : definitions) {
+        insert_definition(std::move(definition));
+    }
     return {};
 }
 
@@ -370,6 +389,93 @@ std::optional<ToolHandler> ToolRegistry::find_handler(const std::string& name) c
     return tools_[it->second].handler;
 }
 
+std::optional<ToolExecutionPolicy>
+ToolRegistry::get_execution_policy(const std::string& name) const {
+    auto it = index_by_name_.find(name);
+    if (it == index_by_name_.end()) {
+        return std::nullopt;
+    }
+    return tools_[it->second].execution;
+}
+
+std::optional<nlohmann::json> ToolRegistry::find_cached_result(const std::string& name,
+                                                               const nlohmann::json& args,
+                                                               CacheClock::time_point now) {
+    auto tool_it = index_by_name_.find(name);
+    if (tool_it == index_by_name_.end() || !tools_[tool_it->second].cache.enabled()) {
+        return std::nullopt;
+    }
+
+    auto cache_it = caches_.find(name);
+    if (cache_it == caches_.end()) {
+        ++cache_stats_.misses;
+        return std::nullopt;
+    }
+
+    // nlohmann::json keeps object keys sorted, so dump() is canonical.
+    auto& cache = cache_it->second;
+    auto entry_it = cache.index.find(args.dump());
+    if (entry_it == cache.index.end()) {
+        ++cache_stats_.misses;
+        return std::nullopt;
+    }
+    if (entry_it->second->expires_at <= now) {
+        cache.entries.erase(entry_it->second);
+        cache.index.erase(entry_it);
+        ++cache_stats_.expirations;
+        ++cache_stats_.misses;
+        return std::nullopt;
+    }
+
+    cache.entries.splice(cache.entries.begin(), cache.entries, entry_it->second);
+    ++cache_stats_.hits;
+    return cache.entries.front().result;
+}
+
+void ToolRegistry::store_cached_result(const std::string& name, const nlohmann::json& args,
+                                       nlohmann::json result, CacheClock::time_point now) {
+    auto tool_it = index_by_name_.find(name);
+    if (tool_it == index_by_name_.end()) {
+        return;
+    }
+    const auto& policy = tools_[tool_it->second].cache;
+    if (!policy.enabled()) {
+        return;
+    }
+
+    const auto expires_at =
+        policy.ttl.count() > 0 ? now + policy.ttl : CacheClock::time_point::max();
+    auto& cache = caches_[name];
+    std::string key = args.dump();
+    if (auto entry_it = cache.index.find(key); entry_it != cache.index.end()) {
+        entry_it->second->result = std::move(result);
+        entry_it->second->expires_at = expires_at;
+        cache.entries.splice(cache.entries.begin(), cache.entries, entry_it->second);
+        return;
+    }
+
+    cache.entries.push_front(ResultCache::Entry{key, std::move(result), expires_at});
+    cache.index.emplace(std::move(key), cache.entries.begin());
+    while (cache.entries.size() > policy.max_entries) {
+        cache.index.erase(cache.entries.back().key);
+        cache.entries.pop_back();
+        ++cache_stats_.evictions;
+    }
+}
+
+ToolCacheStats ToolRegistry::cache_stats() const {
+    ToolCacheStats stats = cache_stats_;
+    stats.entries = 0;
+    for (const auto& [_, cache] : caches_) {
+        stats.entries += cache.entries.size();
+    }
+    return stats;
+}
+
+void ToolRegistry::clear_cache() {
+    caches_.clear();
+}
+
 nlohmann::json ToolRegistry::get_tool_schema(const std::string& name) const {
     auto metadata = get_tool_metadata(name);
     if (!metadata) {
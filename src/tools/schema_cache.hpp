@@ -0,0 +1,121 @@
+/**
+ * @file schema_cache.hpp
+ * @brief Process-wide cache of compiled extraction schemas.
+ */
+
+#pragma once
+
+#include "tools/grammar.hpp"
+#include "zoo/core/types.hpp"
+#include "zoo/tools/registry.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zoo::tools {
+
+/**
+ * @brief An output schema normalized and compiled to a GBNF grammar.
+ */
+struct CompiledSchema {
+    std::vector<ToolParameter> parameters; ///< Normalized parameters used for validation.
+    std::string grammar;                   ///< GBNF grammar built from `parameters`.
+    SchemaJumpForward jump_forward;        ///< Forced-output oracle for `grammar`.
+};
+
+/**
+ * @brief Thread-safe LRU cache of compiled schemas keyed on canonical schema JSON.
+ *
+ * Extraction services tend to send the same few schemas repeatedly, so each
+ * is normalized and compiled once and shared by every agent in the process.
+ * Invalid schemas are not cached. The parsed llama grammar is not shared
+ * here: it is bound to one session's sampler chain, where identical grammar
+ * text is reused by the session's own sampler cache.
+ */
+class SchemaGrammarCache {
+  public:
+    static constexpr size_t kDefaultCapacity = 64;
+
+    explicit SchemaGrammarCache(size_t capacity = kDefaultCapacity)
+        : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    SchemaGrammarCache(const SchemaGrammarCache&) = delete;
+    SchemaGrammarCache& operator=(const SchemaGrammarCache&) = delete;
+
+    /// Returns the cache shared by all agents in the process.
+    static SchemaGrammarCache& shared() {
+        static SchemaGrammarCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief Returns the compiled form of `schema`, building it on a miss.
+     *
+     * Fails with `InvalidOutputSchema` when the schema cannot be normalized.
+     * Compilation runs outside the lock; concurrent misses for one schema may
+     * both compile it, and the first result stored wins.
+     */
+    [[nodiscard]] Expected<std::shared_ptr<const CompiledSchema>>
+    get(const nlohmann::json& schema) {
+        // nlohmann::json keeps object keys sorted, so dump() is canonical.
+        std::string key = schema.dump();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (auto it = index_.find(key); it != index_.end()) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                ++stats_.hits;
+                return it->second->second;
+            }
+            ++stats_.misses;
+        }
+
+        auto parameters = detail::normalize_schema(schema);
+        if (!parameters) {
+            return std::unexpected(
+                Error{ErrorCode::InvalidOutputSchema, parameters.error().message});
+        }
+        auto compiled = std::make_shared<const CompiledSchema>(
+            CompiledSchema{*parameters, GrammarBuilder::build_schema(*parameters),
+                           SchemaJumpForward(*parameters)});
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto it = index_.find(key); it != index_.end()) {
+            return it->second->second;
+        }
+        entries_.emplace_front(key, compiled);
+        index_.emplace(std::move(key), entries_.begin());
+        if (entries_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+            ++stats_.evictions;
+        }
+        return compiled;
+    }
+
+    /// Returns the hit, miss and eviction counters and the number of cached schemas.
+    [[nodiscard]] SchemaCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SchemaCacheStats stats = stats_;
+        stats.entries = entries_.size();
+        return stats;
+    }
+
+  private:
+    using Entry = std::pair<std::string, std::shared_ptr<const CompiledSchema>>;
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    SchemaCacheStats stats_;
+};
+
+} // namespace zoo::tools
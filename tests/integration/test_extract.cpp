@@ -136,6 +136,34 @@ TEST_F(LiveExtractIntegrationTest, StatelessExtractDoesNotMutateHistory) {
     EXPECT_EQ(agent->get_history(), before);
 }
 
+// A repeated extraction reuses the cached grammar sampler; resetting it must
+// restore both the grammar state and the configured seed.
+TEST_F(LiveExtractIntegrationTest, RepeatedExtractWithSameSchemaIsDeterministic) {
+    const auto cfg = config();
+    auto agent_result = zoo::Agent::create(cfg.model, cfg.agent, cfg.generation);
+    ASSERT_TRUE(agent_result.has_value()) << agent_result.error().to_string();
+    auto& agent = *agent_result;
+
+    nlohmann::json schema = {{"type", "object"},
+                             {"properties", {{"city", {{"type", "string"}}}}},
+                             {"required", nlohmann::json::array({"city"})},
+                             {"additionalProperties", false}};
+
+    const std::array<zoo::MessageView, 2> messages = {
+        zoo::MessageView{zoo::Role::System, "Extract the city mentioned in the text."},
+        zoo::MessageView{zoo::Role::User, "We spent the summer in Lisbon."},
+    };
+    const zoo::ConversationView conversation{std::span<const zoo::MessageView>(messages)};
+
+    auto first = agent->extract(schema, conversation).await_result();
+    ASSERT_TRUE(first.has_value()) << first.error().to_string();
+    auto second = agent->extract(schema, conversation).await_result();
+    ASSERT_TRUE(second.has_value()) << second.error().to_string();
+
+    EXPECT_TRUE(second->data.contains("city"));
+    EXPECT_EQ(second->data, first->data);
+}
+
 // Streaming callback must fire during extraction and extracted_data must still resolve.
 TEST_F(LiveExtractIntegrationTest, ExtractStreamsTokensAndReturnsExtractedData) {
     const auto cfg = config();
@@ -4,6 +4,7 @@
  */
 
 #include "agent/mailbox.hpp"
+#include <chrono>
 #include <gtest/gtest.h>
 #include <utility>
 
@@ -121,3 +122,57 @@ TEST(RuntimeMailboxTest, ShutdownDrainsCommandsThenStops) {
     auto drained = mailbox.pop();
     EXPECT_FALSE(drained.has_value());
 }
+
+TEST(RuntimeMailboxTest, PopsByPriorityThenDeadlineThenSubmission) {
+    RuntimeMailbox mailbox;
+    const auto now = RuntimeMailbox::Clock::now();
+
+    auto background = make_request(1);
+    background.priority = zoo::RequestPriority::Background;
+    auto normal_late = make_request(2);
+    normal_late.deadline = now + std::chrono::seconds(10);
+    auto normal_no_deadline = make_request(3);
+    auto normal_early = make_request(4);
+    normal_early.deadline = now + std::chrono::seconds(1);
+    auto interactive = make_request(5);
+    interactive.priority = zoo::RequestPriority::Interactive;
+    auto normal_no_deadline_second = make_request(6);
+
+    for (const auto& request : {background, normal_late, normal_no_deadline, normal_early,
+                                interactive, normal_no_deadline_second}) {
+        ASSERT_TRUE(mailbox.push_request(request));
+    }
+
+    for (uint32_t expected : {5u, 4u, 2u, 3u, 6u, 1u}) {
+        auto item = mailbox.pop();
+        ASSERT_TRUE(item.has_value());
+        EXPECT_EQ(as_request(*item).slot, expected);
+    }
+}
+
+TEST(RuntimeMailboxTest, EstimatesWaitFromServiceTimeAndRequestsAhead) {
+    using namespace std::chrono_literals;
+    RuntimeMailbox mailbox;
+    const auto start = RuntimeMailbox::Clock::now();
+
+    EXPECT_EQ(mailbox.estimated_wait(zoo::RequestPriority::Normal, start).count(), 0);
+
+    mailbox.begin_service(start);
+    mailbox.end_service(start + 100ms);
+
+    auto interactive = make_request(1);
+    interactive.priority = zoo::RequestPriority::Interactive;
+    auto background = make_request(2);
+    background.priority = zoo::RequestPriority::Background;
+    ASSERT_TRUE(mailbox.push_request(make_request(0)));
+    ASSERT_TRUE(mailbox.push_request(interactive));
+    ASSERT_TRUE(mailbox.push_request(background));
+
+    const auto later = start + 1s;
+    EXPECT_EQ(mailbox.estimated_wait(zoo::RequestPriority::Interactive, later), 100ms);
+    EXPECT_EQ(mailbox.estimated_wait(zoo::RequestPriority::Normal, later), 200ms);
+    EXPECT_EQ(mailbox.estimated_wait(zoo::RequestPriority::Background, later), 300ms);
+
+    mailbox.begin_service(later);
+    EXPECT_EQ(mailbox.estimated_wait(zoo::RequestPriority::Interactive, later + 40ms), 160ms);
+}
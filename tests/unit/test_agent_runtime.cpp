@@ -11,6 +11,8 @@
 #include <chrono>
 #include <deque>
 #include <future>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <thread>
@@ -39,8 +41,10 @@ using zoo::TokenCallback;
 using zoo::ToolInvocationStatus;
 using zoo::internal::agent::AgentBackend;
 using zoo::internal::agent::AgentRuntime;
+using zoo::internal::agent::BatchLanes;
 using zoo::internal::agent::GenerationResult;
 using zoo::internal::agent::HistoryMode;
+using zoo::internal::agent::LaneResult;
 using zoo::internal::agent::ParsedToolResponse;
 using zoo::internal::agent::RequestHistoryScope;
 using zoo::internal::agent::ScopeExit;
@@ -51,6 +55,95 @@ static_assert(requires { typename RequestHandle<TextResponse>; });
 static_assert(requires { typename RequestHandle<ExtractionResponse>; });
 static_assert(!zoo::internal::agent::RequestHandleResult<UnsupportedRequestResult>);
 
+// Prompts the batch lanes started from: prepared tokens, or a count of
+// prompts the lanes had to render themselves.
+struct LanePrompts {
+    std::mutex mutex;
+    std::vector<std::vector<int>> prepared;
+    int rendered = 0;
+};
+
+// Replies to each lane with scripted pieces, one per step. Steps emit nothing
+// until `hold_until_started` lanes have started, so tests can queue requests
+// before decoding begins.
+class FakeBatchLanes final : public BatchLanes {
+  public:
+    FakeBatchLanes(size_t lanes, std::map<std::string, std::vector<std::string>> replies,
+                   size_t hold_until_started, std::shared_ptr<LanePrompts> prompts)
+        : lanes_(lanes), replies_(std::move(replies)), hold_until_started_(hold_until_started),
+          prompts_(std::move(prompts)) {}
+
+    size_t size() const noexcept override {
+        return lanes_.size();
+    }
+
+    Expected<void> start(size_t lane, const std::vector<Message>& messages,
+                         const std::vector<int>* prepared_prompt, const GenerationOptions&,
+                         TokenCallback on_token, CancellationCallback should_cancel) override {
+        auto reply = replies_.find(messages.back().content);
+        if (reply == replies_.end()) {
+            return std::unexpected(Error{ErrorCode::InferenceFailed, "No scripted reply"});
+        }
+        {
+            std::lock_guard<std::mutex> lock(prompts_->mutex);
+            if (prepared_prompt != nullptr) {
+                prompts_->prepared.push_back(*prepared_prompt);
+            } else {
+                ++prompts_->rendered;
+            }
+        }
+        lanes_[lane] = Lane{&reply->second, 0, "", static_cast<int>(messages.size()), on_token,
+                            should_cancel, true};
+        ++started_;
+        return {};
+    }
+
+    std::vector<LaneResult> step() override {
+        std::vector<LaneResult> finished;
+        if (started_ < hold_until_started_) {
+            return finished;
+        }
+        for (size_t index = 0; index < lanes_.size(); ++index) {
+            Lane& lane = lanes_[index];
+            if (!lane.running) {
+                continue;
+            }
+            if (lane.should_cancel && lane.should_cancel()) {
+                lane.running = false;
+                finished.push_back(LaneResult{
+                    index, std::unexpected(Error{ErrorCode::RequestCancelled, "cancelled"})});
+                continue;
+            }
+            const std::string& piece = (*lane.pieces)[lane.next++];
+            lane.text += piece;
+            const bool stopped = lane.on_token && lane.on_token(piece) == TokenAction::Stop;
+            if (stopped || lane.next == lane.pieces->size()) {
+                lane.running = false;
+                finished.push_back(LaneResult{
+                    index, GenerationResult{lane.text, lane.prompt_tokens, false, "", {}}});
+            }
+        }
+        return finished;
+    }
+
+  private:
+    struct Lane {
+        const std::vector<std::string>* pieces = nullptr;
+        size_t next = 0;
+        std::string text;
+        int prompt_tokens = 0;
+        TokenCallback on_token;
+        CancellationCallback should_cancel;
+        bool running = false;
+    };
+
+    std::vector<Lane> lanes_;
+    std::map<std::string, std::vector<std::string>> replies_;
+    size_t hold_until_started_ = 0;
+    size_t started_ = 0;
+    std::shared_ptr<LanePrompts> prompts_;
+};
+
 class FakeBackend final : public AgentBackend {
   public:
     using GenerationAction =
@@ -89,7 +182,62 @@ class FakeBackend final : public AgentBackend {
         return last_options_;
     }
 
-    void finalize_response() override {}
+    // Encodes each message as one token holding its content length.
+    Expected<std::vector<int>> prepare_prompt(const std::vector<Message>& messages) const override {
+        std::vector<int> tokens;
+        for (const auto& message : messages) {
+            tokens.push_back(static_cast<int>(message.content.size()));
+        }
+        prepare_calls_.fetch_add(1, std::memory_order_acq_rel);
+        return tokens;
+    }
+
+    Expected<GenerationResult> generate_from_prepared(std::span<const int> prompt_tokens,
+                                                      const GenerationOptions& options,
+                                                      TokenCallback on_token,
+                                                      CancellationCallback should_cancel) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            prepared_generations_.emplace_back(prompt_tokens.begin(), prompt_tokens.end());
+        }
+        return generate_from_history(options, std::move(on_token), std::move(should_cancel));
+    }
+
+    int prepare_calls() const {
+        return prepare_calls_.load(std::memory_order_acquire);
+    }
+
+    std::vector<std::vector<int>> prepared_generations() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return prepared_generations_;
+    }
+
+    // Records each prefill together with the history it was asked to cover.
+    Expected<int> prefill_history(Role next_role, std::string_view tool_call_id,
+                                  CancellationCallback) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefills_.push_back(Prefill{next_role, std::string(tool_call_id), history_.size()});
+        if (on_prefill_) {
+            on_prefill_();
+        }
+        return 1;
+    }
+
+    struct Prefill {
+        Role next_role = Role::User;
+        std::string tool_call_id;
+        size_t history_size = 0;
+    };
+
+    std::vector<Prefill> prefills() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return prefills_;
+    }
+
+    void on_prefill(std::function<void()> callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        on_prefill_ = std::move(callback);
+    }
 
     void set_system_prompt(std::string_view prompt) override {
         std::lock_guard<std::mutex> lock(mutex_);
@@ -135,6 +283,67 @@ class FakeBackend final : public AgentBackend {
                        history_.begin() + static_cast<std::ptrdiff_t>(system_offset + erase_count));
     }
 
+    // Counts one token per content byte.
+    void trim_history_to_tokens(size_t max_tokens) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t system_offset =
+            (!history_.empty() && history_.front().role == zoo::Role::System) ? 1u : 0u;
+        size_t retained = 0;
+        for (const auto& message : history_) {
+            retained += message.content.size();
+        }
+        size_t erase_end = system_offset;
+        while (erase_end < history_.size() && retained > max_tokens) {
+            retained -= history_[erase_end++].content.size();
+        }
+        while (erase_end < history_.size() && history_[erase_end].role != zoo::Role::User) {
+            ++erase_end;
+        }
+        history_.erase(history_.begin() + static_cast<std::ptrdiff_t>(system_offset),
+                       history_.begin() + static_cast<std::ptrdiff_t>(erase_end));
+    }
+
+    Expected<void> save_session(const std::string& path, std::string_view) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        saved_sessions_[path] = history_;
+        return {};
+    }
+
+    Expected<void> load_session(const std::string& path, std::string_view) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = saved_sessions_.find(path);
+        if (it == saved_sessions_.end()) {
+            return std::unexpected(
+                Error{ErrorCode::SessionSnapshotInvalid, "No saved session", path});
+        }
+        history_ = it->second;
+        return {};
+    }
+
+    Expected<std::unique_ptr<AgentBackend>> open_session() const override {
+        return std::make_unique<FakeBackend>();
+    }
+
+    // Lanes are opened once, by the runtime constructor.
+    void enable_batch_lanes(std::map<std::string, std::vector<std::string>> replies,
+                            size_t hold_until_started) {
+        batch_replies_ = std::move(replies);
+        batch_hold_until_started_ = hold_until_started;
+    }
+
+    Expected<std::unique_ptr<BatchLanes>> open_batch_lanes(size_t lanes) const override {
+        if (batch_replies_.empty()) {
+            return std::unexpected(
+                Error{ErrorCode::ContextCreationFailed, "Fake backend has no batch lanes"});
+        }
+        return std::make_unique<FakeBatchLanes>(lanes, batch_replies_, batch_hold_until_started_,
+                                                lane_prompts_);
+    }
+
+    std::shared_ptr<LanePrompts> lane_prompts() const {
+        return lane_prompts_;
+    }
+
     bool set_tool_calling(const std::vector<zoo::CoreToolInfo>& tools) override {
         std::lock_guard<std::mutex> lock(mutex_);
         tool_calling_supported_ = !tools.empty();
@@ -175,7 +384,8 @@ class FakeBackend final : public AgentBackend {
         return "fake";
     }
 
-    bool set_schema_grammar(const std::string&) override {
+    bool set_schema_grammar(const std::string&, zoo::ForcedContinuation,
+                            zoo::FreeTextProbe) override {
         return true;
     }
 
@@ -185,8 +395,16 @@ class FakeBackend final : public AgentBackend {
     mutable std::mutex mutex_;
     std::deque<GenerationAction> generations_;
     std::vector<Message> history_;
+    std::map<std::string, std::vector<Message>> saved_sessions_;
     GenerationOptions last_options_;
     bool tool_calling_supported_ = true;
+    mutable std::atomic<int> prepare_calls_{0};
+    std::vector<std::vector<int>> prepared_generations_;
+    std::vector<Prefill> prefills_;
+    std::function<void()> on_prefill_;
+    std::map<std::string, std::vector<std::string>> batch_replies_;
+    size_t batch_hold_until_started_ = 0;
+    std::shared_ptr<LanePrompts> lane_prompts_ = std::make_shared<LanePrompts>();
 };
 
 ModelConfig make_model_config() {
@@ -286,6 +504,88 @@ TEST(AgentRuntimeTest, CancelBeforeProcessingBeginsFailsQueuedRequest) {
     EXPECT_EQ(second_result.error().code, ErrorCode::RequestCancelled);
 }
 
+TEST(AgentRuntimeTest, QueuedInteractiveRequestRunsBeforeEarlierBackgroundRequest) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto entered = std::make_shared<std::promise<void>>();
+    auto entered_future = entered->get_future();
+    auto release = std::make_shared<std::promise<void>>();
+    auto release_future = release->get_future().share();
+    backend_ptr->push_generation(
+        [entered, release_future](TokenCallback, const CancellationCallback&) {
+            entered->set_value();
+            release_future.wait();
+            return Expected<GenerationResult>(GenerationResult{"first reply", 0, false, "", {}});
+        });
+    for (const char* reply : {"second reply", "third reply"}) {
+        backend_ptr->push_generation([reply](TokenCallback, const CancellationCallback&) {
+            return Expected<GenerationResult>(GenerationResult{reply, 0, false, "", {}});
+        });
+    }
+
+    auto first = runtime.chat("first");
+    ASSERT_EQ(entered_future.wait_for(1s), std::future_status::ready);
+
+    GenerationOptions background;
+    background.priority = zoo::RequestPriority::Background;
+    GenerationOptions interactive;
+    interactive.priority = zoo::RequestPriority::Interactive;
+    auto bulk = runtime.chat("bulk", background);
+    auto urgent = runtime.chat("urgent", interactive);
+
+    release->set_value();
+    ASSERT_TRUE(first.await_result(1s).has_value());
+    auto urgent_result = urgent.await_result(1s);
+    ASSERT_TRUE(urgent_result.has_value()) << urgent_result.error().to_string();
+    EXPECT_EQ(urgent_result->text, "second reply");
+    auto bulk_result = bulk.await_result(1s);
+    ASSERT_TRUE(bulk_result.has_value()) << bulk_result.error().to_string();
+    EXPECT_EQ(bulk_result->text, "third reply");
+}
+
+TEST(AgentRuntimeTest, QueuedRequestPastItsDeadlineFailsWithoutGenerating) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto entered = std::make_shared<std::promise<void>>();
+    auto entered_future = entered->get_future();
+    auto release = std::make_shared<std::promise<void>>();
+    auto release_future = release->get_future().share();
+    backend_ptr->push_generation(
+        [entered, release_future](TokenCallback, const CancellationCallback&) {
+            entered->set_value();
+            release_future.wait();
+            return Expected<GenerationResult>(GenerationResult{"first reply", 0, false, "", {}});
+        });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"next reply", 0, false, "", {}});
+    });
+
+    auto first = runtime.chat("first");
+    ASSERT_EQ(entered_future.wait_for(1s), std::future_status::ready);
+
+    GenerationOptions short_deadline;
+    short_deadline.deadline = 1ms;
+    auto late = runtime.chat("late", short_deadline);
+    std::this_thread::sleep_for(20ms);
+    release->set_value();
+
+    ASSERT_TRUE(first.await_result(1s).has_value());
+    auto late_result = late.await_result(1s);
+    ASSERT_FALSE(late_result.has_value());
+    EXPECT_EQ(late_result.error().code, ErrorCode::RequestTimeout);
+
+    // The expired request never reached the backend.
+    auto next = runtime.chat("next").await_result(1s);
+    ASSERT_TRUE(next.has_value()) << next.error().to_string();
+    EXPECT_EQ(next->text, "next reply");
+}
+
 TEST(AgentRuntimeTest, CancelDuringGenerationPropagatesRequestCancelled) {
     auto backend = std::make_unique<FakeBackend>();
     auto* backend_ptr = backend.get();
@@ -451,6 +751,162 @@ TEST(AgentRuntimeTest, CompleteDoesNotMutatePersistentHistory) {
     EXPECT_EQ(runtime.get_history(), before);
 }
 
+TEST(AgentRuntimeTest, QueuedReplaceRequestsArePreparedWhileEarlierRequestDecodes) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto entered = std::make_shared<std::promise<void>>();
+    auto entered_future = entered->get_future();
+    auto release = std::make_shared<std::promise<void>>();
+    auto release_future = release->get_future().share();
+    backend_ptr->push_generation(
+        [entered, release_future](TokenCallback, const CancellationCallback&) {
+            entered->set_value();
+            release_future.wait();
+            return Expected<GenerationResult>(GenerationResult{"first reply", 0, false, "", {}});
+        });
+    for (const char* reply : {"second reply", "third reply"}) {
+        backend_ptr->push_generation([reply](TokenCallback, const CancellationCallback&) {
+            return Expected<GenerationResult>(GenerationResult{reply, 0, false, "", {}});
+        });
+    }
+
+    auto first = runtime.chat("first");
+    ASSERT_EQ(entered_future.wait_for(1s), std::future_status::ready);
+
+    const std::array<Message, 2> second_messages = {Message::system("abc"),
+                                                    Message::user("hello")};
+    const std::array<Message, 1> third_messages = {Message::user("x")};
+    auto second =
+        runtime.complete(zoo::ConversationView{std::span<const Message>(second_messages)});
+    auto third = runtime.complete(zoo::ConversationView{std::span<const Message>(third_messages)});
+
+    // The preparer works in submission order, so once the third prompt is
+    // being prepared the second one has already been stored.
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (backend_ptr->prepare_calls() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_GE(backend_ptr->prepare_calls(), 2);
+    release->set_value();
+
+    ASSERT_TRUE(first.await_result(1s).has_value());
+    auto second_result = second.await_result(1s);
+    ASSERT_TRUE(second_result.has_value()) << second_result.error().to_string();
+    EXPECT_EQ(second_result->text, "second reply");
+    ASSERT_TRUE(third.await_result(1s).has_value());
+
+    const auto prepared = backend_ptr->prepared_generations();
+    ASSERT_FALSE(prepared.empty());
+    EXPECT_EQ(prepared.front(), (std::vector<int>{3, 5}));
+}
+
+TEST(AgentRuntimeTest, BatchedCompletionsDecodeInterleaved) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    backend_ptr->enable_batch_lanes(
+        {{"first", {"a1", "a2", "a3"}}, {"second", {"b1", "b2", "b3"}}}, 2);
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"chat reply", 0, false, "", {}});
+    });
+    auto config = make_agent_config();
+    config.batch_sequences = 2;
+    AgentRuntime runtime(make_model_config(), config, GenerationOptions{}, std::move(backend));
+
+    std::mutex mutex;
+    std::vector<std::string> streamed;
+    auto record = [&](std::string_view token) {
+        std::lock_guard<std::mutex> lock(mutex);
+        streamed.emplace_back(token);
+    };
+    const std::array<Message, 1> first_messages = {Message::user("first")};
+    const std::array<Message, 1> second_messages = {Message::user("second")};
+    auto first = runtime.complete(zoo::ConversationView{std::span<const Message>(first_messages)},
+                                  GenerationOptions{}, record);
+    auto second = runtime.complete(
+        zoo::ConversationView{std::span<const Message>(second_messages)}, GenerationOptions{},
+        record);
+    // Appends to the shared history, so it waits for the main session.
+    auto chat = runtime.chat("hello");
+
+    auto first_result = first.await_result(1s);
+    ASSERT_TRUE(first_result.has_value()) << first_result.error().to_string();
+    EXPECT_EQ(first_result->text, "a1a2a3");
+    EXPECT_EQ(first_result->usage.prompt_tokens, 1);
+    EXPECT_EQ(first_result->usage.completion_tokens, 3);
+    auto second_result = second.await_result(1s);
+    ASSERT_TRUE(second_result.has_value()) << second_result.error().to_string();
+    EXPECT_EQ(second_result->text, "b1b2b3");
+
+    auto chat_result = chat.await_result(1s);
+    ASSERT_TRUE(chat_result.has_value()) << chat_result.error().to_string();
+    EXPECT_EQ(chat_result->text, "chat reply");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(streamed, (std::vector<std::string>{"a1", "b1", "a2", "b2", "a3", "b3"}));
+}
+
+TEST(AgentRuntimeTest, BatchedCompletionsStartFromPreparedPrompts) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    backend_ptr->enable_batch_lanes({{"first", {"a1"}}, {"second", {"b1"}}}, 2);
+    auto entered = std::make_shared<std::promise<void>>();
+    auto entered_future = entered->get_future();
+    auto release = std::make_shared<std::promise<void>>();
+    auto release_future = release->get_future().share();
+    backend_ptr->push_generation(
+        [entered, release_future](TokenCallback, const CancellationCallback&) {
+            entered->set_value();
+            release_future.wait();
+            return Expected<GenerationResult>(GenerationResult{"chat reply", 0, false, "", {}});
+        });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Alice","age":30})", 0, false, "", {}});
+    });
+    auto config = make_agent_config();
+    config.batch_sequences = 2;
+    AgentRuntime runtime(make_model_config(), config, GenerationOptions{}, std::move(backend));
+
+    auto chat = runtime.chat("hold");
+    ASSERT_EQ(entered_future.wait_for(1s), std::future_status::ready);
+
+    const std::array<Message, 1> first_messages = {Message::user("first")};
+    const std::array<Message, 1> second_messages = {Message::user("second")};
+    const std::array<Message, 1> third_messages = {Message::user("Alice is 30")};
+    auto first = runtime.complete(zoo::ConversationView{std::span<const Message>(first_messages)});
+    auto second =
+        runtime.complete(zoo::ConversationView{std::span<const Message>(second_messages)});
+    // Extraction runs on the main session; it only makes sure, through the
+    // preparer's submission order, that both completions have been prepared.
+    auto extraction = runtime.extract(simple_extraction_schema(),
+                                      zoo::ConversationView{std::span<const Message>(third_messages)});
+
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (backend_ptr->prepare_calls() < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_GE(backend_ptr->prepare_calls(), 3);
+    release->set_value();
+
+    ASSERT_TRUE(chat.await_result(1s).has_value());
+    auto first_result = first.await_result(1s);
+    ASSERT_TRUE(first_result.has_value()) << first_result.error().to_string();
+    EXPECT_EQ(first_result->text, "a1");
+    auto second_result = second.await_result(1s);
+    ASSERT_TRUE(second_result.has_value()) << second_result.error().to_string();
+    EXPECT_EQ(second_result->text, "b1");
+    auto extraction_result = extraction.await_result(1s);
+    ASSERT_TRUE(extraction_result.has_value()) << extraction_result.error().to_string();
+
+    const auto prompts = backend_ptr->lane_prompts();
+    std::lock_guard<std::mutex> lock(prompts->mutex);
+    EXPECT_EQ(prompts->rendered, 0);
+    EXPECT_EQ(prompts->prepared, (std::vector<std::vector<int>>{{5}, {6}}));
+}
+
 TEST(AgentRuntimeTest, ChatStreamingCallbackSurvivesTokenStreaming) {
     auto backend = std::make_unique<FakeBackend>();
     auto* backend_ptr = backend.get();
@@ -689,6 +1145,52 @@ TEST(AgentRuntimeTest, SetSystemPromptUpdatesHistoryThroughCommandLane) {
     EXPECT_EQ(history[0].content, "Be concise.");
 }
 
+TEST(AgentRuntimeTest, SaveAndLoadSessionRouteThroughCommandLane) {
+    auto backend = std::make_unique<FakeBackend>();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    runtime.set_system_prompt("Saved prompt.");
+    ASSERT_TRUE(runtime.save_session("session.bin", "fake-model").has_value());
+
+    runtime.set_system_prompt("Replaced prompt.");
+    ASSERT_TRUE(runtime.load_session("session.bin", "fake-model").has_value());
+
+    const auto history = runtime.get_history();
+    ASSERT_EQ(history.size(), 1u);
+    EXPECT_EQ(history[0].content, "Saved prompt.");
+
+    auto missing = runtime.load_session("missing.bin", "fake-model");
+    ASSERT_FALSE(missing.has_value());
+    EXPECT_EQ(missing.error().code, ErrorCode::SessionSnapshotInvalid);
+
+    runtime.stop();
+    auto stopped = runtime.save_session("session.bin", "fake-model");
+    ASSERT_FALSE(stopped.has_value());
+    EXPECT_EQ(stopped.error().code, ErrorCode::AgentNotRunning);
+}
+
+TEST(AgentRuntimeTest, OpenedBackendSessionKeepsIndependentHistory) {
+    auto backend = std::make_unique<FakeBackend>();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+    runtime.set_system_prompt("Parent prompt.");
+
+    auto session_backend = runtime.open_backend_session();
+    ASSERT_TRUE(session_backend.has_value()) << session_backend.error().to_string();
+    AgentRuntime session(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(*session_backend));
+    session.set_system_prompt("Session prompt.");
+
+    const auto parent_history = runtime.get_history();
+    ASSERT_EQ(parent_history.size(), 1u);
+    EXPECT_EQ(parent_history[0].content, "Parent prompt.");
+
+    const auto session_history = session.get_history();
+    ASSERT_EQ(session_history.size(), 1u);
+    EXPECT_EQ(session_history[0].content, "Session prompt.");
+}
+
 TEST(AgentRuntimeTest, TryCommandMethodsReportStoppedAgent) {
     auto backend = std::make_unique<FakeBackend>();
     AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
@@ -1081,6 +1583,255 @@ TEST(AgentRuntimeTest, StreamingCallbackRunsOffInferenceThread) {
     EXPECT_NE(callback_thread_id, inference_thread_id);
 }
 
+GenerationResult multi_tool_call_generation(
+    const std::vector<std::pair<std::string, nlohmann::json>>& calls) {
+    GenerationResult result{"", 0, true, "", {}};
+    for (size_t index = 0; index < calls.size(); ++index) {
+        result.tool_calls.push_back(zoo::OwnedToolCall{"call-" + std::to_string(index + 1),
+                                                       calls[index].first,
+                                                       calls[index].second.dump()});
+    }
+    return result;
+}
+
+TEST(AgentRuntimeTest, ToolCallsFromOneTurnRunConcurrentlyAndAppendInCallOrder) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    // Each call waits for all three to be running, so it only succeeds in parallel.
+    auto arrived = std::make_shared<std::atomic<int>>(0);
+    auto definition = zoo::tools::detail::make_tool_definition(
+        "lookup", "Waits for the other lookups", std::vector<std::string>{"value"},
+        [arrived](int value) {
+            arrived->fetch_add(1);
+            const auto give_up = std::chrono::steady_clock::now() + 2s;
+            while (arrived->load() < 3 && std::chrono::steady_clock::now() < give_up) {
+                std::this_thread::sleep_for(1ms);
+            }
+            return arrived->load() >= 3 ? value : -1;
+        });
+    ASSERT_TRUE(definition.has_value()) << definition.error().to_string();
+    ASSERT_TRUE(runtime.register_tool(std::move(*definition)).has_value());
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(multi_tool_call_generation(
+            {{"lookup", {{"value", 1}}}, {"lookup", {{"value", 2}}}, {"lookup", {{"value", 3}}}}));
+    });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"done", 0, false, "", {}});
+    });
+
+    GenerationOptions options;
+    options.record_tool_trace = true;
+    auto result = runtime.chat("look up three things", options).await_result(5s);
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    ASSERT_TRUE(result->tool_trace.has_value());
+    ASSERT_EQ(result->tool_trace->invocations.size(), 3u);
+    for (size_t index = 0; index < 3; ++index) {
+        const auto& invocation = result->tool_trace->invocations[index];
+        EXPECT_EQ(invocation.id, "call-" + std::to_string(index + 1));
+        EXPECT_EQ(invocation.result_json, nlohmann::json({{"result", index + 1}}).dump());
+    }
+
+    const auto history = runtime.get_history();
+    ASSERT_EQ(history.size(), 6u);
+    EXPECT_EQ(history[1].tool_calls.size(), 3u);
+    for (size_t index = 0; index < 3; ++index) {
+        EXPECT_EQ(history[2 + index].role, Role::Tool);
+        EXPECT_EQ(history[2 + index].tool_call_id, "call-" + std::to_string(index + 1));
+    }
+}
+
+TEST(AgentRuntimeTest, ToolConcurrencyLimitSerializesOnlyThatTool) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto running = std::make_shared<std::atomic<int>>(0);
+    auto peak = std::make_shared<std::atomic<int>>(0);
+    auto definition = zoo::tools::detail::make_tool_definition(
+        "exclusive", "One at a time", std::vector<std::string>{"value"},
+        [running, peak](int value) {
+            const int now_running = running->fetch_add(1) + 1;
+            int previous = peak->load();
+            while (previous < now_running && !peak->compare_exchange_weak(previous, now_running)) {
+            }
+            std::this_thread::sleep_for(20ms);
+            running->fetch_sub(1);
+            return value;
+        });
+    ASSERT_TRUE(definition.has_value()) << definition.error().to_string();
+    definition->execution.max_concurrency = 1;
+    ASSERT_TRUE(runtime.register_tool(std::move(*definition)).has_value());
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(multi_tool_call_generation({{"exclusive", {{"value", 1}}},
+                                                                      {"exclusive", {{"value", 2}}},
+                                                                      {"exclusive", {{"value", 3}}}}));
+    });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"done", 0, false, "", {}});
+    });
+
+    auto result = runtime.chat("go").await_result(5s);
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_EQ(peak->load(), 1);
+}
+
+TEST(AgentRuntimeTest, SlowToolTimesOutWithoutHoldingBackOtherCalls) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto release = std::make_shared<std::promise<void>>();
+    auto release_future = release->get_future().share();
+    auto slow = zoo::tools::detail::make_tool_definition(
+        "slow", "Blocks until released", std::vector<std::string>{"value"},
+        [release_future](int value) {
+            release_future.wait();
+            return value;
+        });
+    ASSERT_TRUE(slow.has_value()) << slow.error().to_string();
+    slow->execution.timeout = 50ms;
+    auto fast = zoo::tools::detail::make_tool_definition(
+        "fast", "Returns immediately", std::vector<std::string>{"value"},
+        [](int value) { return value; });
+    ASSERT_TRUE(fast.has_value()) << fast.error().to_string();
+    std::vector<zoo::tools::ToolDefinition> definitions;
+    definitions.push_back(std::move(*slow));
+    definitions.push_back(std::move(*fast));
+    ASSERT_TRUE(runtime.register_tools(std::move(definitions)).has_value());
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(
+            multi_tool_call_generation({{"slow", {{"value", 1}}}, {"fast", {{"value", 2}}}}));
+    });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"done", 0, false, "", {}});
+    });
+
+    GenerationOptions options;
+    options.record_tool_trace = true;
+    auto result = runtime.chat("go", options).await_result(5s);
+    release->set_value();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    ASSERT_TRUE(result->tool_trace.has_value());
+    ASSERT_EQ(result->tool_trace->invocations.size(), 2u);
+    const auto& timed_out = result->tool_trace->invocations[0];
+    EXPECT_EQ(timed_out.status, ToolInvocationStatus::ExecutionFailed);
+    ASSERT_TRUE(timed_out.error.has_value());
+    EXPECT_NE(timed_out.error->message.find("timed out"), std::string::npos);
+    EXPECT_EQ(result->tool_trace->invocations[1].status, ToolInvocationStatus::Succeeded);
+    EXPECT_EQ(result->tool_trace->invocations[1].result_json, R"({"result":2})");
+}
+
+TEST(AgentRuntimeTest, CachedToolResultIsReusedAcrossRequests) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto calls = std::make_shared<std::atomic<int>>(0);
+    auto definition = zoo::tools::detail::make_tool_definition(
+        "convert", "Deterministic conversion", std::vector<std::string>{"value"},
+        [calls](int value) {
+            calls->fetch_add(1);
+            return value * 10;
+        });
+    ASSERT_TRUE(definition.has_value()) << definition.error().to_string();
+    definition->cache.max_entries = 8;
+    ASSERT_TRUE(runtime.register_tool(std::move(*definition)).has_value());
+
+    for (int round = 0; round < 2; ++round) {
+        backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+            return Expected<GenerationResult>(tool_call_generation("convert", {{"value", 4}}));
+        });
+        backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+            return Expected<GenerationResult>(GenerationResult{"done", 0, false, "", {}});
+        });
+    }
+
+    GenerationOptions options;
+    options.record_tool_trace = true;
+    auto first = runtime.chat("convert 4", options).await_result(5s);
+    ASSERT_TRUE(first.has_value()) << first.error().to_string();
+    auto second = runtime.chat("convert 4 again", options).await_result(5s);
+    ASSERT_TRUE(second.has_value()) << second.error().to_string();
+
+    EXPECT_EQ(calls->load(), 1);
+    ASSERT_TRUE(first->tool_trace.has_value());
+    ASSERT_TRUE(second->tool_trace.has_value());
+    EXPECT_FALSE(first->tool_trace->invocations.front().cached);
+    EXPECT_TRUE(second->tool_trace->invocations.front().cached);
+    EXPECT_EQ(second->tool_trace->invocations.front().result_json,
+              first->tool_trace->invocations.front().result_json);
+
+    auto stats = runtime.tool_cache_stats(1s);
+    ASSERT_TRUE(stats.has_value()) << stats.error().to_string();
+    EXPECT_EQ(stats->hits, 1u);
+    EXPECT_EQ(stats->misses, 1u);
+    EXPECT_EQ(stats->entries, 1u);
+}
+
+TEST(AgentRuntimeTest, ToolCacheStatsFailAfterStop) {
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::make_unique<FakeBackend>());
+
+    auto stats = runtime.tool_cache_stats();
+    ASSERT_TRUE(stats.has_value()) << stats.error().to_string();
+    EXPECT_EQ(*stats, zoo::tools::ToolCacheStats{});
+
+    runtime.stop();
+    auto stopped = runtime.tool_cache_stats();
+    ASSERT_FALSE(stopped.has_value());
+    EXPECT_EQ(stopped.error().code, ErrorCode::AgentNotRunning);
+}
+
+TEST(AgentRuntimeTest, ToolTurnIsPrefilledWhileHandlerRuns) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    auto prefilled = std::make_shared<std::promise<void>>();
+    auto prefilled_future = prefilled->get_future().share();
+    backend_ptr->on_prefill([prefilled] { prefilled->set_value(); });
+
+    // The handler only succeeds if the prefill happens while it is still running.
+    auto definition = zoo::tools::detail::make_tool_definition(
+        "wait_for_prefill", "Waits for the prefill", std::vector<std::string>{"value"},
+        [prefilled_future](int value) {
+            return prefilled_future.wait_for(2s) == std::future_status::ready ? value : -1;
+        });
+    ASSERT_TRUE(definition.has_value()) << definition.error().to_string();
+    ASSERT_TRUE(runtime.register_tool(std::move(*definition)).has_value());
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(tool_call_generation("wait_for_prefill", {{"value", 7}}));
+    });
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"done", 0, false, "", {}});
+    });
+
+    GenerationOptions options;
+    options.record_tool_trace = true;
+    auto result = runtime.chat("go", options).await_result(5s);
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    ASSERT_TRUE(result->tool_trace.has_value());
+    EXPECT_EQ(result->tool_trace->invocations[0].result_json, R"({"result":7})");
+
+    const auto prefills = backend_ptr->prefills();
+    ASSERT_EQ(prefills.size(), 1u);
+    EXPECT_EQ(prefills[0].next_role, Role::Tool);
+    EXPECT_EQ(prefills[0].tool_call_id, "call-1");
+    EXPECT_EQ(prefills[0].history_size, 2u); // user message + assistant tool-call turn
+}
+
 TEST(AgentRuntimeTest, ToolHandlerRunsOffInferenceThread) {
     auto backend = std::make_unique<FakeBackend>();
     auto* backend_ptr = backend.get();
@@ -1235,6 +1986,28 @@ TEST(RequestHistoryScopeTest, AppendTrimsRetainedHistoryOnExit) {
     EXPECT_EQ(history[2].content, "new reply");
 }
 
+TEST(RequestHistoryScopeTest, AppendTrimsToTokenBudgetOnExit) {
+    FakeBackend backend;
+    backend.set_system_prompt("sys");
+    ASSERT_TRUE(backend.add_message(Message::user("old user").view()).has_value());
+    ASSERT_TRUE(backend.add_message(Message::assistant("old reply").view()).has_value());
+
+    // "sys" + "new user" + "new reply" is 20 bytes; the old exchange does not fit.
+    const std::vector<Message> request_messages = {Message::user("new user")};
+    {
+        auto scope = RequestHistoryScope::enter(backend, HistoryMode::Append, request_messages,
+                                                64, "chat", 24);
+        ASSERT_TRUE(scope.has_value()) << scope.error().to_string();
+        ASSERT_TRUE(backend.add_message(Message::assistant("new reply").view()).has_value());
+    }
+
+    const auto history = backend.get_history();
+    ASSERT_EQ(history.size(), 3u);
+    EXPECT_EQ(history[0].content, "sys");
+    EXPECT_EQ(history[1].content, "new user");
+    EXPECT_EQ(history[2].content, "new reply");
+}
+
 TEST(AgentRuntimeTest, ToolExecutionCompletesCleanlyBeforeRuntimeDestruction) {
     auto backend = std::make_unique<FakeBackend>();
     auto* backend_ptr = backend.get();
@@ -1,16 +1,22 @@
 /**
  * @file test_batch.cpp
- * @brief Unit tests for prompt prefill chunk planning.
+ * @brief Unit tests for prompt prefill chunk planning, batch reuse and continuous batching.
  */
 
 #include "core/batch.hpp"
 #include <gtest/gtest.h>
 
 #include <utility>
+#include <vector>
 
+using zoo::core::BatchArena;
 using zoo::core::BatchChunk;
 using zoo::core::compute_prefill_chunks;
 using zoo::core::LlamaBatchHandle;
+using zoo::core::pack_continuous_batch;
+using zoo::core::plan_continuous_batch;
+using zoo::core::SequenceCursor;
+using zoo::core::SequenceSlice;
 
 TEST(ComputePrefillChunksTest, SingleChunkFitsExactly) {
     auto chunks = compute_prefill_chunks(512, 512);
@@ -124,3 +130,117 @@ TEST(LlamaBatchHandleTest, MoveAssignmentReleasesPreviousBatchAndTransfersState)
     EXPECT_EQ(target.get().n_tokens, 1);
     EXPECT_EQ(target.get().token[0], 7);
 }
+
+TEST(LlamaBatchHandleTest, BorrowedHandleLeavesStorageIntact) {
+    LlamaBatchHandle owner(2, 0, 1);
+    owner.get().token[0] = 11;
+    {
+        auto view = LlamaBatchHandle::borrowed(owner.get());
+        EXPECT_FALSE(view.owns_storage());
+        EXPECT_EQ(view.get().n_tokens, 0);
+        view.get().token[1] = 12;
+    }
+    EXPECT_EQ(owner.get().token[0], 11);
+    EXPECT_EQ(owner.get().token[1], 12);
+}
+
+TEST(BatchArenaTest, ReusesStorageAcrossBorrows) {
+    BatchArena arena(8);
+    llama_token* first_storage = nullptr;
+    {
+        auto batch = arena.borrow(8);
+        first_storage = batch.get().token;
+        batch.get().n_tokens = 8;
+    }
+    for (int i = 0; i < 4; ++i) {
+        auto batch = arena.borrow(1 + i);
+        EXPECT_FALSE(batch.owns_storage());
+        EXPECT_EQ(batch.get().token, first_storage);
+        EXPECT_EQ(batch.get().n_tokens, 0);
+    }
+    EXPECT_EQ(arena.allocations(), 1u);
+}
+
+TEST(BatchArenaTest, OversizedBorrowFallsBackToOwningBatch) {
+    BatchArena arena(2);
+    auto batch = arena.borrow(3);
+    EXPECT_TRUE(batch.owns_storage());
+    batch.get().token[2] = 5;
+    EXPECT_EQ(arena.allocations(), 1u);
+
+    BatchArena empty;
+    auto first = empty.borrow(1);
+    auto second = empty.borrow(1);
+    EXPECT_TRUE(first.owns_storage());
+    EXPECT_TRUE(second.owns_storage());
+    EXPECT_EQ(empty.allocations(), 2u);
+}
+
+TEST(PlanContinuousBatchTest, DecodingSequencesAreScheduledBeforePrefill) {
+    const std::vector<int> pending = {40, 1, 0, 1};
+    auto slices = plan_continuous_batch(pending, 16);
+    ASSERT_EQ(slices.size(), 3u);
+    EXPECT_EQ(slices[0], (SequenceSlice{1, 1, true}));
+    EXPECT_EQ(slices[1], (SequenceSlice{3, 1, true}));
+    EXPECT_EQ(slices[2], (SequenceSlice{0, 14, false}));
+}
+
+TEST(PlanContinuousBatchTest, PrefillThatFitsEmitsLogits) {
+    const std::vector<int> pending = {5, 3};
+    auto slices = plan_continuous_batch(pending, 16);
+    ASSERT_EQ(slices.size(), 2u);
+    EXPECT_EQ(slices[0], (SequenceSlice{0, 5, true}));
+    EXPECT_EQ(slices[1], (SequenceSlice{1, 3, true}));
+}
+
+TEST(PlanContinuousBatchTest, BudgetNeverExceeded) {
+    const std::vector<int> pending = {1, 1, 1, 100};
+    auto slices = plan_continuous_batch(pending, 2);
+    ASSERT_EQ(slices.size(), 2u);
+    EXPECT_EQ(slices[0], (SequenceSlice{0, 1, true}));
+    EXPECT_EQ(slices[1], (SequenceSlice{1, 1, true}));
+}
+
+TEST(PlanContinuousBatchTest, IdleOrInvalidInputsReturnEmpty) {
+    const std::vector<int> idle = {0, 0};
+    EXPECT_TRUE(plan_continuous_batch(idle, 16).empty());
+    const std::vector<int> pending = {1};
+    EXPECT_TRUE(plan_continuous_batch(pending, 0).empty());
+}
+
+TEST(PackContinuousBatchTest, WritesTokensAndAdvancesCursors) {
+    LlamaBatchHandle batch(4, 0, 1);
+    std::vector<SequenceCursor> cursors(2);
+    cursors[0].seq_id = 0;
+    cursors[0].next_pos = 10;
+    cursors[0].pending = {7};
+    cursors[1].seq_id = 1;
+    cursors[1].next_pos = 0;
+    cursors[1].pending = {1, 2, 3, 4, 5};
+
+    ASSERT_EQ(pack_continuous_batch(batch.get(), cursors, 4), 4);
+    auto& raw = batch.get();
+    EXPECT_EQ(raw.n_tokens, 4);
+    EXPECT_EQ(raw.token[0], 7);
+    EXPECT_EQ(raw.pos[0], 10);
+    EXPECT_EQ(raw.seq_id[0][0], 0);
+    EXPECT_TRUE(raw.logits[0]);
+    EXPECT_EQ(raw.token[1], 1);
+    EXPECT_EQ(raw.seq_id[1][0], 1);
+    EXPECT_FALSE(raw.logits[3]);
+
+    EXPECT_EQ(cursors[0].logits_index, 0);
+    EXPECT_TRUE(cursors[0].pending.empty());
+    EXPECT_EQ(cursors[0].next_pos, 11);
+    EXPECT_EQ(cursors[1].logits_index, -1);
+    EXPECT_EQ(cursors[1].remaining(), 2);
+    EXPECT_EQ(cursors[1].next_pos, 3);
+
+    cursors[0].pending = {8};
+    ASSERT_EQ(pack_continuous_batch(batch.get(), cursors, 4), 3);
+    EXPECT_EQ(cursors[0].logits_index, 0);
+    EXPECT_EQ(cursors[1].logits_index, 2);
+    EXPECT_EQ(raw.token[2], 5);
+    EXPECT_EQ(raw.pos[2], 4);
+    EXPECT_TRUE(cursors[1].pending.empty());
+}
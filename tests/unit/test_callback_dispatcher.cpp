@@ -22,6 +22,7 @@ using namespace std::chrono_literals;
 using zoo::AsyncTokenCallback;
 using zoo::TokenAction;
 using zoo::internal::agent::CallbackDispatcher;
+using zoo::internal::agent::StreamingOptions;
 
 TEST(CallbackDispatcherTest, DispatchedCallbacksArriveInOrder) {
     CallbackDispatcher dispatcher;
@@ -155,6 +156,22 @@ TEST(CallbackDispatcherTest, ActionCallbackExceptionPropagatesToDispatch) {
     EXPECT_TRUE(recovered);
 }
 
+TEST(CallbackDispatcherTest, BackToBackActionCallbacksReportTheirOwnActions) {
+    CallbackDispatcher dispatcher;
+
+    int calls = 0;
+    AsyncTokenCallback callback = [&](std::string_view token) -> TokenAction {
+        ++calls;
+        return token == "stop" ? TokenAction::Stop : TokenAction::Continue;
+    };
+
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_EQ(dispatcher.dispatch(callback, i % 3 == 2 ? "stop" : "go"),
+                  i % 3 == 2 ? TokenAction::Stop : TokenAction::Continue);
+    }
+    EXPECT_EQ(calls, 2000);
+}
+
 TEST(CallbackDispatcherTest, VoidCallbackDispatchReturnsWithoutWaiting) {
     CallbackDispatcher dispatcher;
 
@@ -247,4 +264,109 @@ TEST(CallbackDispatcherTest, VoidCallbackExceptionRethrowsAtNextDispatch) {
     EXPECT_TRUE(ran);
 }
 
+TEST(CallbackDispatcherTest, CoalescesPiecesUpToChunkBytes) {
+    StreamingOptions options;
+    options.chunk_bytes = 6;
+    CallbackDispatcher dispatcher(options);
+
+    std::mutex mutex;
+    std::vector<std::string> received;
+    AsyncTokenCallback callback = [&](std::string_view chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace_back(chunk);
+    };
+
+    for (const char* piece : {"ab", "cd", "ef", "gh", "i"}) {
+        EXPECT_EQ(dispatcher.dispatch(callback, piece), TokenAction::Continue);
+    }
+    dispatcher.drain();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0], "abcdef");
+    EXPECT_EQ(received[1], "ghi");
+}
+
+TEST(CallbackDispatcherTest, CoalescingFlushesWhenCallbackChanges) {
+    StreamingOptions options;
+    options.chunk_bytes = 1024;
+    CallbackDispatcher dispatcher(options);
+
+    std::mutex mutex;
+    std::vector<std::string> received;
+    AsyncTokenCallback first = [&](std::string_view chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back("1:" + std::string(chunk));
+    };
+    AsyncTokenCallback second = [&](std::string_view chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back("2:" + std::string(chunk));
+    };
+
+    dispatcher.dispatch(first, "a");
+    dispatcher.dispatch(first, "b");
+    dispatcher.dispatch(second, "c");
+    dispatcher.drain();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0], "1:ab");
+    EXPECT_EQ(received[1], "2:c");
+}
+
+TEST(CallbackDispatcherTest, PiecesSurviveRingWraparound) {
+    StreamingOptions options;
+    options.ring_capacity = 64;
+    CallbackDispatcher dispatcher(options);
+
+    std::string expected;
+    std::string received;
+    AsyncTokenCallback callback = [&](std::string_view token) { received.append(token); };
+
+    for (int i = 0; i < 200; ++i) {
+        const std::string piece(static_cast<size_t>(i % 7 + 1), static_cast<char>('a' + i % 26));
+        expected += piece;
+        dispatcher.dispatch(callback, piece);
+    }
+    // Larger than the whole ring: delivered in several parts.
+    const std::string large(500, 'z');
+    expected += large;
+    dispatcher.dispatch(callback, large);
+    dispatcher.drain();
+
+    EXPECT_EQ(received, expected);
+}
+
+TEST(CallbackDispatcherTest, AsyncActionStopReportedOnLaterDispatch) {
+    StreamingOptions options;
+    options.async_actions = true;
+    CallbackDispatcher dispatcher(options);
+
+    std::vector<std::string> received;
+    AsyncTokenCallback callback = [&](std::string_view token) {
+        received.emplace_back(token);
+        return token == "stop" ? TokenAction::Stop : TokenAction::Continue;
+    };
+
+    EXPECT_EQ(dispatcher.dispatch(callback, "a"), TokenAction::Continue);
+    EXPECT_EQ(dispatcher.dispatch(callback, "stop"), TokenAction::Continue);
+
+    TokenAction action = TokenAction::Continue;
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (action == TokenAction::Continue && std::chrono::steady_clock::now() < deadline) {
+        action = dispatcher.dispatch(callback, "after");
+    }
+    EXPECT_EQ(action, TokenAction::Stop);
+    dispatcher.drain();
+
+    // Nothing queued behind the stop is delivered.
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[1], "stop");
+
+    // drain() starts the next pass with a clean slate.
+    EXPECT_EQ(dispatcher.dispatch(callback, "b"), TokenAction::Continue);
+    dispatcher.drain();
+    EXPECT_EQ(received.back(), "b");
+}
+
 } // namespace
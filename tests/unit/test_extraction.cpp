@@ -4,6 +4,7 @@
  */
 
 #include "agent/runtime.hpp"
+#include "tools/schema_cache.hpp"
 #include <gtest/gtest.h>
 
 #include <deque>
@@ -29,6 +30,7 @@ using zoo::TokenAction;
 using zoo::TokenCallback;
 using zoo::internal::agent::AgentBackend;
 using zoo::internal::agent::AgentRuntime;
+using zoo::internal::agent::BatchLanes;
 using zoo::internal::agent::GenerationResult;
 using zoo::internal::agent::ParsedToolResponse;
 
@@ -64,7 +66,21 @@ class FakeBackend final : public AgentBackend {
         return action(on_token, should_cancel);
     }
 
-    void finalize_response() override {}
+    Expected<std::vector<int>> prepare_prompt(const std::vector<Message>&) const override {
+        return std::unexpected(
+            Error{ErrorCode::TemplateRenderFailed, "Fake backend has no chat template"});
+    }
+
+    Expected<GenerationResult> generate_from_prepared(std::span<const int>,
+                                                      const GenerationOptions& options,
+                                                      TokenCallback on_token,
+                                                      CancellationCallback should_cancel) override {
+        return generate_from_history(options, std::move(on_token), std::move(should_cancel));
+    }
+
+    Expected<int> prefill_history(Role, std::string_view, CancellationCallback) override {
+        return 0;
+    }
 
     void set_system_prompt(std::string_view prompt) override {
         std::lock_guard<std::mutex> lock(mutex_);
@@ -110,15 +126,53 @@ class FakeBackend final : public AgentBackend {
                        history_.begin() + static_cast<std::ptrdiff_t>(system_offset + erase_count));
     }
 
+    void trim_history_to_tokens(size_t) override {}
+
+    Expected<void> save_session(const std::string&, std::string_view) override {
+        return {};
+    }
+
+    Expected<void> load_session(const std::string&, std::string_view) override {
+        return {};
+    }
+
+    Expected<std::unique_ptr<AgentBackend>> open_session() const override {
+        return std::unexpected(
+            Error{ErrorCode::ContextCreationFailed, "Fake backend has no sessions"});
+    }
+
+    Expected<std::unique_ptr<BatchLanes>> open_batch_lanes(size_t) const override {
+        return std::unexpected(
+            Error{ErrorCode::ContextCreationFailed, "Fake backend has no batch lanes"});
+    }
+
     bool set_tool_calling(const std::vector<zoo::CoreToolInfo>&) override {
         return true;
     }
 
-    bool set_schema_grammar(const std::string&) override {
+    bool set_schema_grammar(const std::string&, zoo::ForcedContinuation forced,
+                            zoo::FreeTextProbe free_text) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        forced_ = std::move(forced);
+        free_text_ = std::move(free_text);
         return true;
     }
 
-    void clear_tool_grammar() override {}
+    void clear_tool_grammar() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        forced_ = {};
+        free_text_ = {};
+    }
+
+    zoo::ForcedContinuation forced_continuation() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return forced_;
+    }
+
+    zoo::FreeTextProbe free_text_probe() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_text_;
+    }
 
     ParsedToolResponse parse_tool_response(std::string_view text) const override {
         return ParsedToolResponse{std::string(text), {}};
@@ -132,6 +186,8 @@ class FakeBackend final : public AgentBackend {
     mutable std::mutex mutex_;
     std::deque<GenerationAction> generations_;
     std::vector<Message> history_;
+    zoo::ForcedContinuation forced_;
+    zoo::FreeTextProbe free_text_;
 };
 
 ModelConfig make_model_config() {
@@ -185,6 +241,197 @@ TEST(ExtractionRuntimeTest, InvalidSchemaFailsImmediately) {
     EXPECT_EQ(result.error().code, ErrorCode::InvalidOutputSchema);
 }
 
+TEST(ExtractionRuntimeTest, SchemaIsCompiledOnceAcrossRuntimes) {
+    // A property name no other test uses keeps the shared cache entry fresh.
+    const nlohmann::json schema = {{"type", "object"},
+                                   {"properties", {{"compiled_once", {{"type", "integer"}}}}},
+                                   {"required", nlohmann::json::array({"compiled_once"})}};
+    const auto before = zoo::tools::SchemaGrammarCache::shared().stats();
+
+    for (int round = 0; round < 2; ++round) {
+        auto backend = std::make_unique<FakeBackend>();
+        auto* backend_ptr = backend.get();
+        AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                             std::move(backend));
+        backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+            return Expected<GenerationResult>(
+                GenerationResult{R"({"compiled_once":1})", 0, false, "", {}});
+        });
+
+        auto result = runtime.extract(schema, "extract").await_result();
+        ASSERT_TRUE(result.has_value()) << result.error().to_string();
+        EXPECT_EQ(result->data["compiled_once"], 1);
+    }
+
+    const auto after = zoo::tools::SchemaGrammarCache::shared().stats();
+    EXPECT_EQ(after.misses - before.misses, 1u);
+    EXPECT_EQ(after.hits - before.hits, 1u);
+}
+
+TEST(ExtractionRuntimeTest, ExtractDecodesForcedSchemaOutputInBatches) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    std::string opening;
+    std::string after_name;
+    backend_ptr->push_generation([&](TokenCallback, const CancellationCallback&) {
+        auto forced = backend_ptr->forced_continuation();
+        if (forced) {
+            opening = forced("");
+            after_name = forced(R"({"name":"Alice")");
+        }
+        GenerationResult generation{R"({"name":"Alice","age":30})", 0, false, "", {}};
+        generation.forced_tokens = 6;
+        return Expected<GenerationResult>(std::move(generation));
+    });
+
+    auto result = runtime.extract(simple_schema(), "Alice is 30").await_result();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_EQ(opening, R"({"name":")");
+    EXPECT_EQ(after_name, R"(,"age":)");
+    EXPECT_EQ(result->metrics.forced_tokens, 6);
+    EXPECT_FALSE(backend_ptr->forced_continuation());
+}
+
+TEST(ExtractionRuntimeTest, ExtractReportsFreeTextPositionsForTokenMasks) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    std::vector<zoo::FreeTextKind> kinds;
+    backend_ptr->push_generation([&](TokenCallback, const CancellationCallback&) {
+        if (auto probe = backend_ptr->free_text_probe()) {
+            kinds = {probe(R"({"name":)"), probe(R"({"name":"Al)"),
+                     probe(R"({"name":"Alice","age":3)")};
+        }
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Alice","age":30})", 0, false, "", {}});
+    });
+
+    auto result = runtime.extract(simple_schema(), "Alice is 30").await_result();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_EQ(kinds, (std::vector<zoo::FreeTextKind>{zoo::FreeTextKind::None,
+                                                     zoo::FreeTextKind::String,
+                                                     zoo::FreeTextKind::Digits}));
+    EXPECT_FALSE(backend_ptr->free_text_probe());
+}
+
+TEST(ExtractionRuntimeTest, ExtractReportsFieldsAsTheyComplete) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    std::vector<std::string> events;
+    backend_ptr->push_generation([&](TokenCallback on_token, const CancellationCallback&) {
+        for (std::string_view piece : {R"({"na)", R"(me":"Al)", R"(ice",)", R"("age":3)", "0}"}) {
+            events.push_back("piece " + std::string(piece));
+            EXPECT_EQ(on_token(piece), TokenAction::Continue);
+        }
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Alice","age":30})", 0, false, "", {}});
+    });
+
+    auto result =
+        runtime
+            .extract(simple_schema(), "Alice is 30", {}, {},
+                     [&](std::string_view field, const nlohmann::json& value) {
+                         events.push_back("field " + std::string(field) + "=" + value.dump());
+                         return TokenAction::Continue;
+                     })
+            .await_result();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_FALSE(result->partial);
+    EXPECT_EQ(result->data, nlohmann::json::parse(R"({"name":"Alice","age":30})"));
+    EXPECT_EQ(events, (std::vector<std::string>{"piece {\"na", "piece me\":\"Al",
+                                                "piece ice\",", "field name=\"Alice\"",
+                                                "piece \"age\":3", "piece 0}", "field age=30"}));
+}
+
+TEST(ExtractionRuntimeTest, FieldCallbackCanStopExtractionEarly) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    backend_ptr->push_generation([](TokenCallback on_token, const CancellationCallback&) {
+        if (on_token(R"({"name":"Mallory",)") == TokenAction::Stop) {
+            return Expected<GenerationResult>(
+                GenerationResult{R"({"name":"Mallory",)", 0, false, "", {}});
+        }
+        on_token(R"("age":41})");
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Mallory","age":41})", 0, false, "", {}});
+    });
+
+    auto result = runtime
+                      .extract(simple_schema(), "Mallory is 41", {}, {},
+                               [](std::string_view field, const nlohmann::json& value) {
+                                   return field == "name" && value == "Mallory"
+                                              ? TokenAction::Stop
+                                              : TokenAction::Continue;
+                               })
+                      .await_result();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_TRUE(result->partial);
+    EXPECT_EQ(result->data, nlohmann::json::parse(R"({"name":"Mallory"})"));
+    EXPECT_EQ(result->text, R"({"name":"Mallory",)");
+}
+
+TEST(ExtractionRuntimeTest, StoppedStatefulExtractLeavesHistoryUnchanged) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(GenerationResult{"hello", 0, false, "", {}});
+    });
+    backend_ptr->push_generation([](TokenCallback on_token, const CancellationCallback&) {
+        (void)on_token(R"({"name":"Mallory",)");
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Mallory",)", 0, false, "", {}});
+    });
+
+    ASSERT_TRUE(runtime.chat("hello").await_result().has_value());
+    const auto before = runtime.get_history();
+
+    auto result = runtime
+                      .extract(simple_schema(), "Mallory is 41", {}, {},
+                               [](std::string_view, const nlohmann::json&) {
+                                   return TokenAction::Stop;
+                               })
+                      .await_result();
+
+    ASSERT_TRUE(result.has_value()) << result.error().to_string();
+    EXPECT_TRUE(result->partial);
+    EXPECT_EQ(runtime.get_history(), before);
+}
+
+TEST(ExtractionRuntimeTest, TruncatedOutputFailsToParse) {
+    auto backend = std::make_unique<FakeBackend>();
+    auto* backend_ptr = backend.get();
+    AgentRuntime runtime(make_model_config(), make_agent_config(), GenerationOptions{},
+                         std::move(backend));
+
+    backend_ptr->push_generation([](TokenCallback, const CancellationCallback&) {
+        return Expected<GenerationResult>(
+            GenerationResult{R"({"name":"Alice","age":3)", 0, false, "", {}});
+    });
+
+    auto result = runtime.extract(simple_schema(), "Alice is 30").await_result();
+
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, ErrorCode::ExtractionFailed);
+}
+
 TEST(ExtractionRuntimeTest, StatelessExtractDoesNotMutateHistory) {
     auto backend = std::make_unique<FakeBackend>();
     auto* backend_ptr = backend.get();
@@ -188,6 +188,17 @@ TEST(AutoConfigTest, MlockOnlyWhenRamComfortablyExceedsModel) {
     EXPECT_TRUE(big_cfg->use_mlock);
 }
 
+TEST(AutoConfigTest, ThreadCountsFollowSystemRecommendation) {
+    auto info = make_synthetic_info(4ULL * kGiB, 32, 4096, 8192);
+    auto sys = make_system(16ULL * kGiB, false, 0);
+
+    auto config = zoo::core::GgufInspector::auto_configure(info, sys);
+    ASSERT_TRUE(config.has_value());
+    const auto threads = zoo::core::SystemProbe::recommend_threads(sys);
+    EXPECT_EQ(config->n_threads, threads.n_threads);
+    EXPECT_EQ(config->n_threads_batch, threads.n_threads_batch);
+}
+
 TEST(AutoConfigTest, MmapAlwaysEnabled) {
     auto info = make_synthetic_info(4ULL * kGiB, 32, 4096, 8192);
     auto sys = make_system(8ULL * kGiB, false, 0);
@@ -231,6 +242,56 @@ TEST(AutoConfigTest, GqaModelGetsLargerContextThanMha) {
     EXPECT_GT(gqa_cfg->context_size, mha_cfg->context_size);
 }
 
+TEST(KvCachePlannerTest, ComputesExactFootprintPerCacheType) {
+    // 32 layers, 8 KV heads of width 128: each K or V row holds 1024 values.
+    auto info = make_synthetic_info(4ULL * kGiB, 32, 4096, 8192, 32, 8);
+    using zoo::KvCacheType;
+
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 1), 32u * 2u * 1024u * 2u);
+    // Q8_0 stores 32 values in 34 bytes; Q4_0 stores 32 values in 18 bytes.
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 1, KvCacheType::Q8_0,
+                                                       KvCacheType::Q8_0),
+              32u * 2u * 32u * 34u);
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 1, KvCacheType::Q8_0,
+                                                       KvCacheType::Q4_0),
+              32u * (32u * 34u + 32u * 18u));
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 4096),
+              4096u * zoo::core::GgufInspector::kv_cache_bytes(info, 1));
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 0), 0u);
+}
+
+TEST(KvCachePlannerTest, PrefersExplicitHeadWidths) {
+    auto info = make_synthetic_info(4ULL * kGiB, 10, 2048, 8192, 8, 4);
+    info.key_length = 256;
+    info.value_length = 128;
+
+    EXPECT_EQ(zoo::core::GgufInspector::kv_cache_bytes(info, 1), 10u * (256u + 128u) * 4u * 2u);
+}
+
+TEST(AutoConfigTest, QuantizedKvCacheBuysLongerContext) {
+    auto info = make_synthetic_info(4ULL * kGiB, 32, 4096, 32768, 32, 8);
+    auto sys = make_system(7ULL * kGiB, false, 0); // leaves a 512 MiB KV budget
+    using zoo::KvCacheType;
+
+    auto f16 = zoo::core::GgufInspector::auto_configure(info, sys);
+    auto q8 = zoo::core::GgufInspector::auto_configure(info, sys, KvCacheType::Q8_0,
+                                                       KvCacheType::Q8_0);
+    auto q4 = zoo::core::GgufInspector::auto_configure(info, sys, KvCacheType::Q4_0,
+                                                       KvCacheType::Q4_0);
+    ASSERT_TRUE(f16.has_value());
+    ASSERT_TRUE(q8.has_value());
+    ASSERT_TRUE(q4.has_value());
+
+    EXPECT_EQ(f16->context_size, 4096);
+    EXPECT_GT(q8->context_size, f16->context_size);
+    EXPECT_GT(q4->context_size, q8->context_size);
+    EXPECT_LE(zoo::core::GgufInspector::kv_cache_bytes(info, q4->context_size, KvCacheType::Q4_0,
+                                                       KvCacheType::Q4_0),
+              512ULL * 1024ULL * 1024ULL);
+    EXPECT_EQ(q4->cache_type_k, KvCacheType::Q4_0);
+    EXPECT_EQ(q4->cache_type_v, KvCacheType::Q4_0);
+}
+
 TEST(AutoConfigTest, ContextUsesAvailableRamWhenSet) {
     auto info = make_synthetic_info(8ULL * kGiB, 32, 4096, 32768, 32, 8);
     auto sys_total = make_system(64ULL * kGiB, false, 0);
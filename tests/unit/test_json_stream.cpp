@@ -0,0 +1,113 @@
+/**
+ * @file test_json_stream.cpp
+ * @brief Unit tests for incremental parsing of streamed extraction output.
+ */
+
+#include "tools/json_stream.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using zoo::TokenAction;
+using zoo::tools::JsonFieldStream;
+
+using Fields = std::vector<std::pair<std::string, nlohmann::json>>;
+
+Fields feed_bytewise(JsonFieldStream& stream, std::string_view text) {
+    Fields fields;
+    for (size_t i = 0; i < text.size(); ++i) {
+        (void)stream.feed(text.substr(i, 1), [&](std::string_view key, const nlohmann::json& value) {
+            fields.emplace_back(std::string(key), value);
+            return TokenAction::Continue;
+        });
+    }
+    return fields;
+}
+
+TEST(JsonFieldStreamTest, ReportsEachTopLevelFieldOnce) {
+    JsonFieldStream stream;
+    const auto fields = feed_bytewise(
+        stream,
+        R"( { "name" : "A \"quoted\" }, name", "tags": ["x", "]"], "meta": {"k": [1, {"z": null}]},)"
+        R"( "age": -12.5e1, "ok": true } )");
+
+    ASSERT_TRUE(stream.complete());
+    EXPECT_FALSE(stream.failed());
+    ASSERT_EQ(fields.size(), 5u);
+    EXPECT_EQ(fields[0].first, "name");
+    EXPECT_EQ(fields[0].second, "A \"quoted\" }, name");
+    EXPECT_EQ(fields[1].second, nlohmann::json::parse(R"(["x", "]"])"));
+    EXPECT_EQ(fields[2].second, nlohmann::json::parse(R"({"k": [1, {"z": null}]})"));
+    EXPECT_EQ(fields[3].first, "age");
+    EXPECT_EQ(fields[3].second, -125.0);
+    EXPECT_EQ(fields[4].second, true);
+    EXPECT_EQ(stream.object().size(), 5u);
+}
+
+TEST(JsonFieldStreamTest, ReportsStringsAtTheirClosingQuote) {
+    JsonFieldStream stream;
+    std::vector<std::string> keys;
+    const auto on_field = [&](std::string_view key, const nlohmann::json&) {
+        keys.emplace_back(key);
+        return TokenAction::Continue;
+    };
+
+    (void)stream.feed(R"({"a":"x")", on_field);
+    EXPECT_EQ(keys, std::vector<std::string>{"a"});
+    (void)stream.feed(R"(,"b":1)", on_field);
+    EXPECT_EQ(keys, std::vector<std::string>{"a"});
+    (void)stream.feed("}", on_field);
+    EXPECT_EQ(keys, (std::vector<std::string>{"a", "b"}));
+    EXPECT_TRUE(stream.complete());
+}
+
+TEST(JsonFieldStreamTest, DecodesEscapedKeys) {
+    JsonFieldStream stream;
+    (void)feed_bytewise(stream, R"({"caf\u00e9":1})");
+
+    ASSERT_TRUE(stream.complete());
+    EXPECT_EQ(stream.object().at("caf\xC3\xA9"), 1);
+}
+
+TEST(JsonFieldStreamTest, StopsScanningWhenCallbackStops) {
+    JsonFieldStream stream;
+    const auto action =
+        stream.feed(R"({"a":1,"b":2,"c":3})", [](std::string_view key, const nlohmann::json&) {
+            return key == "b" ? TokenAction::Stop : TokenAction::Continue;
+        });
+
+    EXPECT_EQ(action, TokenAction::Stop);
+    EXPECT_FALSE(stream.complete());
+    EXPECT_EQ(stream.object(), nlohmann::json::parse(R"({"a":1,"b":2})"));
+    EXPECT_EQ(stream.consumed(), R"({"a":1,"b":2,)");
+}
+
+TEST(JsonFieldStreamTest, RejectsMalformedOutput) {
+    for (std::string_view text : {R"({"a":1,})", R"({"a" 1})", R"({"a":tru})", R"({"a":1}x)",
+                                  R"([1])"}) {
+        JsonFieldStream stream;
+        (void)feed_bytewise(stream, text);
+        EXPECT_TRUE(stream.failed()) << text;
+        EXPECT_FALSE(stream.error().empty()) << text;
+    }
+
+    JsonFieldStream truncated;
+    (void)feed_bytewise(truncated, R"({"a":1)");
+    EXPECT_FALSE(truncated.failed());
+    EXPECT_FALSE(truncated.complete());
+}
+
+TEST(JsonFieldStreamTest, AcceptsEmptyObject) {
+    JsonFieldStream stream;
+    (void)feed_bytewise(stream, "{ }");
+
+    EXPECT_TRUE(stream.complete());
+    EXPECT_TRUE(stream.object().empty());
+}
+
+} // namespace
@@ -31,7 +31,7 @@ zoo::ModelConfig make_config() {
     return config;
 }
 
-TEST(ModelToolCallingTest, RenderPromptDeltaRefreshesParserAndGrammarState) {
+TEST(ModelToolCallingTest, RenderPromptRefreshesParserAndGrammarState) {
     auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
 
     auto templates = common_chat_templates_init(nullptr, peg_native_tool_template());
@@ -54,7 +54,7 @@ TEST(ModelToolCallingTest, RenderPromptDeltaRefreshesParserAndGrammarState) {
         *model, ModelTestAccess::SamplerPolicy::native_tool_call("stale-grammar"));
     ModelTestAccess::messages(*model).push_back(zoo::Message::user("hello"));
 
-    auto prompt = ModelTestAccess::render_prompt_delta(*model);
+    auto prompt = ModelTestAccess::render_prompt(*model);
     ASSERT_TRUE(prompt.has_value()) << prompt.error().to_string();
     EXPECT_FALSE(prompt->empty());
 
@@ -77,6 +77,41 @@ TEST(ModelToolCallingTest, RenderPromptDeltaRefreshesParserAndGrammarState) {
     EXPECT_FALSE(ModelTestAccess::tool_state(*model)->parser_params.parser.empty());
 }
 
+TEST(ModelToolCallingTest, RenderPromptKeepsUnchangedToolCallingArtifacts) {
+    auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
+
+    auto templates = common_chat_templates_init(nullptr, peg_native_tool_template());
+    ASSERT_TRUE(templates);
+    ModelTestAccess::chat_templates(*model).reset(templates.release());
+
+    auto state = std::make_unique<ModelTestAccess::ToolCallingState>();
+    state->tools.push_back(
+        {"echo", "Echo text",
+         R"({"type":"object","properties":{"text":{"type":"string"}},"required":["text"]})"});
+    ModelTestAccess::tool_state(*model) = std::move(state);
+    ModelTestAccess::set_sampler_policy(*model,
+                                        ModelTestAccess::SamplerPolicy::native_tool_call(""));
+    ModelTestAccess::messages(*model).push_back(zoo::Message::user("hello"));
+
+    ASSERT_TRUE(ModelTestAccess::render_prompt(*model).has_value());
+    auto& tool_state = ModelTestAccess::tool_state(*model);
+    ASSERT_NE(tool_state, nullptr);
+    EXPECT_FALSE(tool_state->parser_source.empty());
+    ASSERT_FALSE(tool_state->trigger_matcher.word_triggers().empty());
+    const auto grammar = tool_state->grammar;
+
+    // A matcher that is only rebuilt when the triggers change stays empty.
+    tool_state->trigger_matcher = zoo::core::ToolCallTriggerMatcher();
+    ModelTestAccess::messages(*model).push_back(zoo::Message::assistant("hi"));
+    ModelTestAccess::messages(*model).push_back(zoo::Message::user("again"));
+
+    ASSERT_TRUE(ModelTestAccess::render_prompt(*model).has_value());
+    EXPECT_TRUE(tool_state->trigger_matcher.word_triggers().empty());
+    EXPECT_EQ(tool_state->grammar, grammar);
+    EXPECT_FALSE(tool_state->parser_params.parser.empty());
+    EXPECT_EQ(tool_state->parser_params.generation_prompt, "assistant:");
+}
+
 TEST(ModelGenerationOverrideTest, InheritDefaultsUsesConfiguredDefaults) {
     zoo::GenerationOptions defaults;
     defaults.max_tokens = 21;
@@ -117,7 +152,7 @@ TEST(ModelToolCallingTest, ParseToolResponseExtractsStructuredCalls) {
         *model, ModelTestAccess::SamplerPolicy::native_tool_call("stale-grammar"));
     ModelTestAccess::messages(*model).push_back(zoo::Message::user("hello"));
 
-    auto prompt = ModelTestAccess::render_prompt_delta(*model);
+    auto prompt = ModelTestAccess::render_prompt(*model);
     ASSERT_TRUE(prompt.has_value()) << prompt.error().to_string();
     ASSERT_EQ(ModelTestAccess::tool_state(*model)->parser_params.format,
               COMMON_CHAT_FORMAT_PEG_NATIVE);
@@ -159,7 +194,7 @@ TEST(ModelToolCallingTest, PlainAssistantMessageWhenNoToolState) {
     EXPECT_TRUE(msg.tool_calls.empty());
 }
 
-TEST(ModelToolCallingTest, RenderPromptDeltaDoesNotOverwriteSchemaPolicy) {
+TEST(ModelToolCallingTest, RenderPromptDoesNotOverwriteSchemaPolicy) {
     auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
 
     auto templates = common_chat_templates_init(nullptr, peg_native_tool_template());
@@ -178,7 +213,7 @@ TEST(ModelToolCallingTest, RenderPromptDeltaDoesNotOverwriteSchemaPolicy) {
                                         ModelTestAccess::SamplerPolicy::schema("schema-grammar"));
     ModelTestAccess::messages(*model).push_back(zoo::Message::user("extract"));
 
-    auto prompt = ModelTestAccess::render_prompt_delta(*model);
+    auto prompt = ModelTestAccess::render_prompt(*model);
     ASSERT_TRUE(prompt.has_value()) << prompt.error().to_string();
 
     EXPECT_EQ(ModelTestAccess::sampler_policy(*model).mode, ModelTestAccess::GrammarMode::Schema);
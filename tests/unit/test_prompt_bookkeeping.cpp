@@ -1,68 +1,149 @@
 /**
  * @file test_prompt_bookkeeping.cpp
- * @brief Unit tests for incremental prompt bookkeeping rules.
+ * @brief Unit tests for prompt token reuse planning and prompt-lookup drafting.
  */
 
 #include "core/prompt_bookkeeping.hpp"
+#include "zoo/core/types.hpp"
 #include <gtest/gtest.h>
 
-using zoo::core::commit_rendered_prompt;
-using zoo::core::history_mutation_requires_kv_reset;
-using zoo::core::note_history_mutation;
-using zoo::core::PromptHistoryMutation;
-using zoo::core::rendered_prompt_requires_kv_reset;
+#include <vector>
 
-TEST(PromptBookkeepingTest, AppendKeepsCommittedPromptLength) {
-    bool cached_messages_dirty = false;
-    int committed_prompt_len = 48;
+using zoo::core::common_token_prefix;
+using zoo::core::context_shift_discard;
+using zoo::core::find_prompt_lookup_draft;
+using zoo::core::KvShift;
+using zoo::core::plan_kv_reuse;
 
-    note_history_mutation(PromptHistoryMutation::Append, cached_messages_dirty,
-                          committed_prompt_len);
+TEST(PromptBookkeepingTest, CommonTokenPrefixStopsAtFirstDivergence) {
+    const std::vector<int> resident = {1, 10, 11, 12, 40, 41};
+    const std::vector<int> prompt = {1, 10, 11, 12, 50};
 
-    EXPECT_TRUE(cached_messages_dirty);
-    EXPECT_EQ(committed_prompt_len, 48);
-    EXPECT_FALSE(history_mutation_requires_kv_reset(PromptHistoryMutation::Append));
+    EXPECT_EQ(common_token_prefix(resident, prompt), 4u);
+    EXPECT_EQ(common_token_prefix({}, prompt), 0u);
+    EXPECT_EQ(common_token_prefix(resident, {}), 0u);
 }
 
-TEST(PromptBookkeepingTest, SameSizeRewriteInvalidatesCachedMessagesAndCheckpoint) {
-    bool cached_messages_dirty = false;
-    int committed_prompt_len = 48;
+TEST(KvReusePlanTest, PrefixOnlyKeepsSharedPrefix) {
+    // Turn two re-rendered the first assistant reply without its reasoning
+    // span, so only the tokens before that reply are reusable.
+    const std::vector<int> resident = {1, 10, 11, 20, 90, 91, 21, 22, 30};
+    const std::vector<int> prompt = {1, 10, 11, 20, 21, 22, 30, 40, 41};
 
-    note_history_mutation(PromptHistoryMutation::Rewrite, cached_messages_dirty,
-                          committed_prompt_len);
+    const auto plan = plan_kv_reuse(resident, prompt, 0);
+    EXPECT_EQ(plan.reused, 4u);
+    EXPECT_TRUE(plan.shifts.empty());
+    EXPECT_EQ(plan_kv_reuse({}, prompt, 0).reused, 0u);
+}
+
+TEST(KvReusePlanTest, PrefixOnlyLeavesOneTokenToDecode) {
+    const std::vector<int> resident = {1, 10, 11, 12, 13};
+    const std::vector<int> identical = {1, 10, 11, 12, 13};
+    const std::vector<int> shorter = {1, 10, 11};
+
+    EXPECT_EQ(plan_kv_reuse(resident, identical, 0).reused, 4u);
+    EXPECT_EQ(plan_kv_reuse(resident, shorter, 0).reused, 2u);
+}
+
+TEST(KvReusePlanTest, ShiftsMessagesKeptByTrim) {
+    // System prompt {1, 10, 11}, dropped turn {20, 21, 22}, kept turn {30..33}.
+    const std::vector<int> resident = {1, 10, 11, 20, 21, 22, 30, 31, 32, 33};
+    const std::vector<int> prompt = {1, 10, 11, 30, 31, 32, 33, 40, 41};
 
-    EXPECT_TRUE(cached_messages_dirty);
-    EXPECT_EQ(committed_prompt_len, 0);
-    EXPECT_TRUE(history_mutation_requires_kv_reset(PromptHistoryMutation::Rewrite));
+    const auto plan = plan_kv_reuse(resident, prompt, 2);
+    EXPECT_EQ(plan.reused, 7u);
+    ASSERT_EQ(plan.shifts.size(), 1u);
+    EXPECT_EQ(plan.shifts[0], (KvShift{6, 3, 4}));
 }
 
-TEST(PromptBookkeepingTest, ResetClearsCommittedPromptLength) {
-    bool cached_messages_dirty = false;
-    int committed_prompt_len = 64;
+TEST(KvReusePlanTest, IgnoresRunsShorterThanMinimum) {
+    const std::vector<int> resident = {1, 10, 20, 21, 30, 31, 32};
+    const std::vector<int> prompt = {1, 10, 30, 31, 32, 40};
 
-    note_history_mutation(PromptHistoryMutation::Reset, cached_messages_dirty,
-                          committed_prompt_len);
+    const auto short_runs = plan_kv_reuse(resident, prompt, 4);
+    EXPECT_EQ(short_runs.reused, 2u);
+    EXPECT_TRUE(short_runs.shifts.empty());
 
-    EXPECT_TRUE(cached_messages_dirty);
-    EXPECT_EQ(committed_prompt_len, 0);
-    EXPECT_TRUE(history_mutation_requires_kv_reset(PromptHistoryMutation::Reset));
+    const auto disabled = plan_kv_reuse(resident, prompt, 0);
+    EXPECT_EQ(disabled.reused, 2u);
+    EXPECT_TRUE(disabled.shifts.empty());
 }
 
-TEST(PromptBookkeepingTest, ShorterRenderedPromptRequiresKvReset) {
-    EXPECT_TRUE(rendered_prompt_requires_kv_reset(32, 31));
-    EXPECT_FALSE(rendered_prompt_requires_kv_reset(32, 32));
-    EXPECT_FALSE(rendered_prompt_requires_kv_reset(32, 40));
+TEST(KvReusePlanTest, DefaultConfigDoesNotReuseUnrelatedPrompt) {
+    // A new prompt that quotes a long resident run after a different opening
+    // must be prefilled from scratch, not shifted, unless reuse is opted into.
+    std::vector<int> resident = {1, 10, 11};
+    std::vector<int> prompt = {2, 50};
+    for (int token = 100; token < 200; ++token) {
+        resident.push_back(token);
+        prompt.push_back(token);
+    }
+
+    const auto min_run = static_cast<size_t>(zoo::ModelConfig{}.kv_reuse_min_tokens);
+    const auto plan = plan_kv_reuse(resident, prompt, min_run);
+    EXPECT_EQ(plan.reused, 0u);
+    EXPECT_TRUE(plan.shifts.empty());
 }
 
-TEST(PromptBookkeepingTest, CommitRenderedPromptAdvancesOnlyOnSuccessfulRender) {
-    int committed_prompt_len = 12;
+TEST(KvReusePlanTest, ChainsSeveralRunsInOrder) {
+    const std::vector<int> resident = {1, 20, 30, 31, 21, 40, 41, 50};
+    const std::vector<int> prompt = {1, 30, 31, 40, 41, 60};
+
+    const auto plan = plan_kv_reuse(resident, prompt, 2);
+    EXPECT_EQ(plan.reused, 5u);
+    EXPECT_EQ(plan.shifts, (std::vector<KvShift>{{2, 1, 2}, {5, 3, 2}}));
+}
+
+TEST(KvReusePlanTest, LeavesOneTokenToDecode) {
+    const std::vector<int> resident = {1, 20, 30, 31, 32};
+    const std::vector<int> prompt = {1, 30, 31, 32};
+
+    const auto plan = plan_kv_reuse(resident, prompt, 2);
+    EXPECT_EQ(plan.reused, 3u);
+    EXPECT_EQ(plan.shifts, (std::vector<KvShift>{{2, 1, 2}}));
+
+    const auto single = plan_kv_reuse(std::vector<int>{1, 20, 30}, std::vector<int>{1, 30}, 1);
+    EXPECT_EQ(single.reused, 1u);
+    EXPECT_TRUE(single.shifts.empty());
+}
 
-    commit_rendered_prompt(committed_prompt_len, 48);
-    EXPECT_EQ(committed_prompt_len, 48);
+TEST(KvReusePlanTest, ContextShiftDiscardsHalfAfterKeptPrefix) {
+    EXPECT_EQ(context_shift_discard(4096, 96), 2000u);
+    EXPECT_EQ(context_shift_discard(10, 1), 4u);
+    EXPECT_EQ(context_shift_discard(8, 8), 0u);
+    EXPECT_EQ(context_shift_discard(0, 1), 0u);
+}
+
+TEST(PromptLookupTest, CopiesTokensAfterMatchingNgram) {
+    // "... 5 6 7 8 9 ..." appeared in the prompt; output now ends in "5 6".
+    const std::vector<int> context = {1, 5, 6, 7, 8, 9, 2, 3, 5, 6};
+
+    EXPECT_EQ(find_prompt_lookup_draft(context, 2, 3), (std::vector<int>{7, 8, 9}));
+    EXPECT_EQ(find_prompt_lookup_draft(context, 2, 8), (std::vector<int>{7, 8, 9, 2, 3, 5, 6}));
+}
+
+TEST(PromptLookupTest, PrefersMostRecentMatch) {
+    const std::vector<int> context = {4, 1, 10, 4, 1, 20, 4, 1};
+
+    EXPECT_EQ(find_prompt_lookup_draft(context, 2, 1), (std::vector<int>{20}));
+}
+
+TEST(PromptLookupTest, MatchesResidentTokensFollowedByNextToken) {
+    const std::vector<int> resident = {1, 5, 6, 7, 8, 9, 2, 3, 5};
+
+    EXPECT_EQ(find_prompt_lookup_draft(resident, 6, 2, 8),
+              (std::vector<int>{7, 8, 9, 2, 3, 5, 6}));
+    EXPECT_EQ(find_prompt_lookup_draft(resident, 6, 1, 2), (std::vector<int>{7, 8}));
+    EXPECT_TRUE(find_prompt_lookup_draft(resident, 6, 3, 8).empty());
+    EXPECT_TRUE(find_prompt_lookup_draft(resident, 4, 2, 8).empty());
+    EXPECT_TRUE(find_prompt_lookup_draft({}, 6, 1, 8).empty());
+}
 
-    commit_rendered_prompt(committed_prompt_len, 0);
-    EXPECT_EQ(committed_prompt_len, 48);
+TEST(PromptLookupTest, ReturnsNothingWithoutMatch) {
+    const std::vector<int> context = {1, 2, 3, 4, 5};
 
-    commit_rendered_prompt(committed_prompt_len, -1);
-    EXPECT_EQ(committed_prompt_len, 48);
+    EXPECT_TRUE(find_prompt_lookup_draft(context, 2, 4).empty());
+    EXPECT_TRUE(find_prompt_lookup_draft(context, 5, 4).empty());
+    EXPECT_TRUE(find_prompt_lookup_draft(context, 0, 4).empty());
+    EXPECT_TRUE(find_prompt_lookup_draft(context, 2, 0).empty());
 }
@@ -82,6 +82,40 @@ TEST(RequestSlotsTest, CancelMarksActiveRequestFlag) {
     EXPECT_TRUE(after_cancel->cancelled->load(std::memory_order_acquire));
 }
 
+TEST(RequestSlotsTest, PreparedPromptIsStoredUntilRequestIsClaimed) {
+    RequestSlots slots(2);
+
+    RequestPayload payload = make_text_request("prepare me");
+    payload.history_mode = HistoryMode::Replace;
+    auto replace = slots.emplace(std::move(payload));
+    auto append = slots.emplace(make_text_request("append"));
+    ASSERT_TRUE(replace.has_value());
+    ASSERT_TRUE(append.has_value());
+    const QueuedRequest replace_request{replace->slot, replace->generation};
+    const QueuedRequest append_request{append->slot, append->generation};
+
+    EXPECT_FALSE(slots.prompt_source(append_request).has_value());
+    auto source = slots.prompt_source(replace_request);
+    ASSERT_TRUE(source.has_value());
+    ASSERT_EQ(source->size(), 1u);
+    EXPECT_EQ(source->front().content, "prepare me");
+
+    EXPECT_TRUE(slots.store_prepared_prompt(replace_request, {1, 2, 3}));
+    auto active = slots.active_request(replace_request);
+    ASSERT_TRUE(active.has_value());
+    ASSERT_NE(active->prepared_prompt, nullptr);
+    EXPECT_EQ(*active->prepared_prompt, (std::vector<int>{1, 2, 3}));
+
+    // Once claimed, late preparations are dropped.
+    EXPECT_FALSE(slots.prompt_source(replace_request).has_value());
+    EXPECT_FALSE(slots.store_prepared_prompt(replace_request, {4}));
+    EXPECT_EQ(*active->prepared_prompt, (std::vector<int>{1, 2, 3}));
+
+    auto append_active = slots.active_request(append_request);
+    ASSERT_TRUE(append_active.has_value());
+    EXPECT_EQ(append_active->prepared_prompt, nullptr);
+}
+
 TEST(RequestSlotsTest, ResolveErrorPropagatesThroughAwaitHandle) {
     RequestSlots slots(1);
 
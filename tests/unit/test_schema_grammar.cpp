@@ -4,6 +4,7 @@
  */
 
 #include "tools/grammar.hpp"
+#include "tools/schema_cache.hpp"
 #include <gtest/gtest.h>
 
 namespace {
@@ -135,4 +136,155 @@ TEST(SchemaGrammarTest, DiffersFromToolGrammar) {
     EXPECT_NE(schema_grammar.find("string ::="), std::string::npos);
 }
 
+TEST(SchemaJumpForwardTest, ForcesKeysSeparatorsAndClosingBrace) {
+    const zoo::tools::SchemaJumpForward jump_forward({
+        {"city", ToolValueType::String, true, "", {}},
+        {"active", ToolValueType::Boolean, true, "", {}},
+        {"count", ToolValueType::Integer, true, "", {}},
+    });
+
+    EXPECT_EQ(jump_forward.forced_continuation(""), R"({"city":")");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"ci)"), R"(ty":")");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Par)"), "");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris")"), R"(,"active":)");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({ "city" : "P\"aris" ,)"), R"("active":)");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris","active":)"), "");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris","active":t)"),
+              R"(rue,"count":)");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris","active":false,"count":12)"),
+              "");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris","active":false,"count":12 )"),
+              "}");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"city":"Paris","active":false,"count":12})"),
+              "");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"town")"), "");
+}
+
+TEST(SchemaJumpForwardTest, EnumValuesAreForcedOnceUnambiguous) {
+    const zoo::tools::SchemaJumpForward jump_forward({
+        {"size",
+         ToolValueType::String,
+         true,
+         "",
+         {nlohmann::json("small"), nlohmann::json("smaller"), nlohmann::json("large")}},
+        {"level", ToolValueType::Integer, true, "", {nlohmann::json(1), nlohmann::json(12)}},
+    });
+
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":)"), "\"");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":"s)"), "mall");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":"l)"), R"(arge","level":1)");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":"small","level":1)"), "");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":"small","level":12)"), "}");
+    EXPECT_EQ(jump_forward.forced_continuation(R"({"size":"small","level":1 )"), "}");
+}
+
+TEST(SchemaJumpForwardTest, OptionalParametersAreNeverForced) {
+    const zoo::tools::SchemaJumpForward mixed({
+        {"id", ToolValueType::Integer, true, "", {}},
+        {"note", ToolValueType::String, false, "", {}},
+    });
+    EXPECT_EQ(mixed.forced_continuation(""), R"({"id":)");
+    EXPECT_EQ(mixed.forced_continuation(R"({"id":3 )"), "");
+    EXPECT_EQ(mixed.forced_continuation(R"({"id":3,)"), "");
+
+    const zoo::tools::SchemaJumpForward optional_only({
+        {"note", ToolValueType::String, false, "", {}},
+    });
+    EXPECT_EQ(optional_only.forced_continuation(""), "{");
+
+    const zoo::tools::SchemaJumpForward empty(std::vector<ToolParameter>{});
+    EXPECT_EQ(empty.forced_continuation(""), "{}");
+}
+
+TEST(SchemaJumpForwardTest, ClassifiesFreeTextPositions) {
+    using zoo::FreeTextKind;
+    const zoo::tools::SchemaJumpForward schema({
+        {"city", ToolValueType::String, true, "", {}},
+        {"kind", ToolValueType::String, true, "", {nlohmann::json("a"), nlohmann::json("b")}},
+        {"count", ToolValueType::Number, true, "", {}},
+    });
+
+    EXPECT_EQ(schema.free_text(""), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"ci)"), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"city":)"), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"city":")"), FreeTextKind::String);
+    EXPECT_EQ(schema.free_text(R"({"city":"Par)"), FreeTextKind::String);
+    EXPECT_EQ(schema.free_text(R"({"city":"a\)"), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"city":"a\\)"), FreeTextKind::String);
+    EXPECT_EQ(schema.free_text(R"({"city":"Paris","kind":")"), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"city":"Paris","kind":"a","count":)"), FreeTextKind::Digits);
+    EXPECT_EQ(schema.free_text(R"({"city":"Paris","kind":"a","count":-1.5e)"),
+              FreeTextKind::Digits);
+    EXPECT_EQ(schema.free_text(R"({"city":"Paris","kind":"a","count":2 )"), FreeTextKind::None);
+    EXPECT_EQ(schema.free_text(R"({"town":")"), FreeTextKind::None);
+}
+
+TEST(SchemaJumpForwardTest, ResumedScanMatchesFullScan) {
+    const zoo::tools::SchemaJumpForward schema({
+        {"city", ToolValueType::String, true, "", {}},
+        {"kind", ToolValueType::String, true, "", {nlohmann::json("a"), nlohmann::json("b")}},
+        {"count", ToolValueType::Number, true, "", {}},
+        {"active", ToolValueType::Boolean, true, "", {}},
+    });
+    const std::string output =
+        R"({ "city" : "P\"a\\ris","kind":"b", "count":-1.5e3 ,"active":true})";
+
+    zoo::tools::SchemaJumpForward::Scan forced_scan;
+    zoo::tools::SchemaJumpForward::Scan free_scan;
+    for (size_t length = 0; length <= output.size(); ++length) {
+        const std::string_view generated = std::string_view(output).substr(0, length);
+        EXPECT_EQ(schema.forced_continuation(generated, forced_scan),
+                  schema.forced_continuation(generated))
+            << generated;
+        EXPECT_EQ(schema.free_text(generated, free_scan), schema.free_text(generated))
+            << generated;
+    }
+
+    // Shorter text starts a new output.
+    EXPECT_EQ(schema.forced_continuation("", forced_scan), R"({"city":")");
+    EXPECT_EQ(schema.free_text(R"({"city":"x)", free_scan), zoo::FreeTextKind::String);
+}
+
+TEST(SchemaGrammarCacheTest, ReusesCompiledSchemaForEquivalentJson) {
+    zoo::tools::SchemaGrammarCache cache(2);
+    const auto schema = nlohmann::json::parse(
+        R"({"type":"object","properties":{"name":{"type":"string"}},"required":["name"]})");
+    const auto reordered = nlohmann::json::parse(
+        R"({"required":["name"],"properties":{"name":{"type":"string"}},"type":"object"})");
+
+    auto first = cache.get(schema);
+    ASSERT_TRUE(first.has_value()) << first.error().to_string();
+    auto second = cache.get(reordered);
+    ASSERT_TRUE(second.has_value()) << second.error().to_string();
+
+    EXPECT_EQ(first->get(), second->get());
+    EXPECT_EQ((*first)->grammar, GrammarBuilder::build_schema((*first)->parameters));
+    ASSERT_EQ((*first)->parameters.size(), 1u);
+    EXPECT_EQ((*first)->parameters.front().name, "name");
+    EXPECT_EQ(cache.stats(), (zoo::SchemaCacheStats{1, 1, 0, 1}));
+}
+
+TEST(SchemaGrammarCacheTest, EvictsLeastRecentlyUsedAndSkipsInvalidSchemas) {
+    zoo::tools::SchemaGrammarCache cache(2);
+    auto schema_with = [](const std::string& property) {
+        return nlohmann::json{{"type", "object"},
+                              {"properties", {{property, {{"type", "integer"}}}}},
+                              {"required", nlohmann::json::array({property})}};
+    };
+
+    ASSERT_TRUE(cache.get(schema_with("a")).has_value());
+    ASSERT_TRUE(cache.get(schema_with("b")).has_value());
+    ASSERT_TRUE(cache.get(schema_with("a")).has_value());
+    ASSERT_TRUE(cache.get(schema_with("c")).has_value());
+    EXPECT_EQ(cache.stats(), (zoo::SchemaCacheStats{1, 3, 1, 2}));
+
+    ASSERT_TRUE(cache.get(schema_with("a")).has_value());
+    EXPECT_EQ(cache.stats().hits, 2u) << "most recently used schema survives eviction";
+
+    auto invalid = cache.get(nlohmann::json{{"type", "array"}});
+    ASSERT_FALSE(invalid.has_value());
+    EXPECT_EQ(invalid.error().code, zoo::ErrorCode::InvalidOutputSchema);
+    EXPECT_EQ(cache.stats().entries, 2u);
+}
+
 } // namespace
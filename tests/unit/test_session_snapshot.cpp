@@ -0,0 +1,93 @@
+/**
+ * @file test_session_snapshot.cpp
+ * @brief Unit tests for persisted session snapshot encoding.
+ */
+
+#include "core/session_snapshot.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+
+using zoo::core::check_session_snapshot_model;
+using zoo::core::decode_session_snapshot;
+using zoo::core::encode_session_snapshot;
+using zoo::core::SessionSnapshot;
+
+SessionSnapshot make_snapshot() {
+    SessionSnapshot snapshot;
+    snapshot.model_id = "3f6c2a8e-model";
+    snapshot.model_fingerprint = 0x1234abcdull;
+    snapshot.messages.push_back(zoo::Message::system("You are terse."));
+    snapshot.messages.push_back(zoo::Message::user("Weather in Oslo?"));
+    snapshot.messages.push_back(zoo::Message::assistant_with_tool_calls(
+        "", {{"call_1", "get_weather", R"({"city":"Oslo"})"}}));
+    snapshot.messages.push_back(zoo::Message::tool("4C and raining", "call_1"));
+    snapshot.kv_tokens = {1, 512, 77, 9001};
+    snapshot.sequence_state = {0x00, 0xff, 0x10, 0x7f};
+    return snapshot;
+}
+
+} // namespace
+
+TEST(SessionSnapshotTest, RoundTripsAllFields) {
+    const auto snapshot = make_snapshot();
+
+    auto decoded = decode_session_snapshot(encode_session_snapshot(snapshot));
+    ASSERT_TRUE(decoded.has_value()) << decoded.error().to_string();
+    EXPECT_EQ(*decoded, snapshot);
+}
+
+TEST(SessionSnapshotTest, RoundTripsEmptySession) {
+    const SessionSnapshot snapshot;
+
+    auto decoded = decode_session_snapshot(encode_session_snapshot(snapshot));
+    ASSERT_TRUE(decoded.has_value()) << decoded.error().to_string();
+    EXPECT_EQ(*decoded, snapshot);
+}
+
+TEST(SessionSnapshotTest, RejectsMissingHeader) {
+    auto decoded = decode_session_snapshot("not a snapshot");
+    ASSERT_FALSE(decoded.has_value());
+    EXPECT_EQ(decoded.error().code, zoo::ErrorCode::SessionSnapshotInvalid);
+}
+
+TEST(SessionSnapshotTest, RejectsOtherFormatVersion) {
+    std::string bytes = encode_session_snapshot(make_snapshot());
+    // The version field immediately follows the 8-byte magic.
+    bytes[8] = static_cast<char>(bytes[8] + 1);
+
+    auto decoded = decode_session_snapshot(bytes);
+    ASSERT_FALSE(decoded.has_value());
+    EXPECT_EQ(decoded.error().code, zoo::ErrorCode::SessionSnapshotMismatch);
+}
+
+TEST(SessionSnapshotTest, RejectsTruncatedAndTrailingBytes) {
+    const std::string bytes = encode_session_snapshot(make_snapshot());
+
+    for (size_t cut : {size_t{12}, bytes.size() / 2, bytes.size() - 1}) {
+        auto decoded = decode_session_snapshot(std::string_view(bytes).substr(0, cut));
+        ASSERT_FALSE(decoded.has_value()) << "cut at " << cut;
+        EXPECT_EQ(decoded.error().code, zoo::ErrorCode::SessionSnapshotInvalid);
+    }
+
+    auto trailing = decode_session_snapshot(bytes + "x");
+    ASSERT_FALSE(trailing.has_value());
+    EXPECT_EQ(trailing.error().code, zoo::ErrorCode::SessionSnapshotInvalid);
+}
+
+TEST(SessionSnapshotTest, ModelCheckRejectsStaleSnapshots) {
+    const auto snapshot = make_snapshot();
+
+    EXPECT_TRUE(
+        check_session_snapshot_model(snapshot, "3f6c2a8e-model", 0x1234abcdull).has_value());
+
+    auto other_id = check_session_snapshot_model(snapshot, "other-model", 0x1234abcdull);
+    ASSERT_FALSE(other_id.has_value());
+    EXPECT_EQ(other_id.error().code, zoo::ErrorCode::SessionSnapshotMismatch);
+
+    auto other_weights = check_session_snapshot_model(snapshot, "3f6c2a8e-model", 42);
+    ASSERT_FALSE(other_weights.has_value());
+    EXPECT_EQ(other_weights.error().code, zoo::ErrorCode::SessionSnapshotMismatch);
+}
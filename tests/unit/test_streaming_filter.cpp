@@ -125,7 +125,7 @@ TEST(StreamingFilterTest, StreamFilterSuppressesRegexTriggerChunk) {
     std::vector<common_grammar_trigger> triggers;
     triggers.push_back({COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN, R"(<\|tool_call_start\|>)"});
     zoo::core::ToolCallTriggerMatcher matcher(triggers);
-    zoo::core::StreamFilter filter({}, &matcher);
+    zoo::core::StreamFilter filter(matcher);
 
     EXPECT_EQ(filter.consume("hello ", "hello "), "hello ");
     EXPECT_EQ(filter.consume("<|tool_call_start|>", "hello <|tool_call_start|>"), "");
@@ -133,4 +133,59 @@ TEST(StreamingFilterTest, StreamFilterSuppressesRegexTriggerChunk) {
     EXPECT_EQ(filter.consume("hidden", "hello <|tool_call_start|>hidden"), "");
 }
 
+TEST(StreamingFilterTest, MultiPatternMatcherReportsOverlappingPatterns) {
+    const std::vector<std::string> patterns = {"he", "she", "hers"};
+    zoo::core::MultiPatternMatcher matcher{std::span<const std::string>(patterns)};
+
+    auto state = matcher.advance(zoo::core::MultiPatternMatcher::kStart, std::string_view("us"));
+    EXPECT_EQ(matcher.match_length(state), 0u);
+    EXPECT_EQ(matcher.prefix_length(state), 1u);
+
+    state = matcher.advance(state, std::string_view("he"));
+    EXPECT_EQ(matcher.match_length(state), 3u);
+    std::vector<size_t> matched;
+    matcher.for_each_match(state, [&](size_t pattern, size_t) { matched.push_back(pattern); });
+    EXPECT_EQ(matched, (std::vector<size_t>{1, 0}));
+
+    state = matcher.advance(state, std::string_view("rs"));
+    EXPECT_EQ(matcher.match_length(state), 4u);
+}
+
+TEST(StreamingFilterTest, StopSequenceMatcherFeedsAcrossPieces) {
+    std::vector<std::string> stops = {"<stop>", "END"};
+    zoo::core::StopSequenceMatcher matcher{std::span<const std::string>(stops)};
+
+    EXPECT_EQ(matcher.feed("hello <st"), 0u);
+    // The stop completes mid-piece; the stop and the rest of the piece are dropped.
+    EXPECT_EQ(matcher.feed("op> trailing"), 15u);
+}
+
+TEST(StreamingFilterTest, AlternationPatternTriggerMatchesAnyBranch) {
+    std::vector<common_grammar_trigger> triggers;
+    triggers.push_back(
+        {COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN_FULL, R"([\s\S]*?(<tool_call>|<function=)[\s\S]*)"});
+    EXPECT_TRUE(zoo::core::is_tool_trigger_detected("text <tool_call>{}", triggers));
+    EXPECT_TRUE(zoo::core::is_tool_trigger_detected("text <function=add>", triggers));
+    EXPECT_FALSE(zoo::core::is_tool_trigger_detected("text <tool_cal", triggers));
+}
+
+TEST(StreamingFilterTest, PatternWithoutLiteralStillRuns) {
+    std::vector<common_grammar_trigger> triggers;
+    triggers.push_back({COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN, R"([0-9]{3})"});
+    EXPECT_TRUE(zoo::core::is_tool_trigger_detected("call 123", triggers));
+    EXPECT_FALSE(zoo::core::is_tool_trigger_detected("call 12", triggers));
+}
+
+TEST(StreamingFilterTest, StreamFilterWaitsForRegexTailAfterLiteral) {
+    std::vector<common_grammar_trigger> triggers;
+    triggers.push_back({COMMON_GRAMMAR_TRIGGER_TYPE_PATTERN, R"(<\|tool_call_start\|>\s*\[)"});
+    zoo::core::ToolCallTriggerMatcher matcher(triggers);
+    zoo::core::StreamFilter filter(matcher);
+
+    EXPECT_EQ(filter.consume("hi <|tool_call_start|>", "hi <|tool_call_start|>"), "hi ");
+    EXPECT_FALSE(filter.suppressing());
+    EXPECT_EQ(filter.consume(" [", "hi <|tool_call_start|> ["), "");
+    EXPECT_TRUE(filter.suppressing());
+}
+
 } // namespace
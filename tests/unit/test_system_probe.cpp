@@ -25,3 +25,28 @@ TEST(SystemProbeTest, GpuVectorMatchesSupportFlag) {
         EXPECT_GE(gpu.total_vram_bytes, gpu.free_vram_bytes);
     }
 }
+
+TEST(SystemProbeTest, RecommendsHalfShareForDecodeThreads) {
+    zoo::core::SystemInfo sys;
+    sys.logical_cpu_count = 64;
+
+    const auto single = zoo::core::SystemProbe::recommend_threads(sys);
+    EXPECT_EQ(single.n_threads_batch, 64);
+    EXPECT_EQ(single.n_threads, 32);
+
+    const auto shared = zoo::core::SystemProbe::recommend_threads(sys, 4);
+    EXPECT_EQ(shared.n_threads_batch, 16);
+    EXPECT_EQ(shared.n_threads, 8);
+}
+
+TEST(SystemProbeTest, RecommendationNeverDropsBelowOneThread) {
+    zoo::core::SystemInfo sys;
+    sys.logical_cpu_count = 2;
+
+    const auto crowded = zoo::core::SystemProbe::recommend_threads(sys, 8);
+    EXPECT_EQ(crowded.n_threads_batch, 1);
+    EXPECT_EQ(crowded.n_threads, 1);
+
+    sys.logical_cpu_count = 0;
+    EXPECT_EQ(zoo::core::SystemProbe::recommend_threads(sys), zoo::core::ThreadRecommendation{});
+}
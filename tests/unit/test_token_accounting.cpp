@@ -169,4 +169,62 @@ TEST(TokenAccountingTest, TrimHistoryStartsAtUserBoundary) {
     EXPECT_EQ(model->estimated_tokens(), estimate_messages(*model, history.messages));
 }
 
+TEST(TokenAccountingTest, TrimHistoryToTokensDropsOldestExchanges) {
+    auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
+    std::vector<zoo::Message> messages = {
+        zoo::Message::system("system"),        zoo::Message::user("old question"),
+        zoo::Message::assistant("old answer"), zoo::Message::user("new question"),
+        zoo::Message::assistant("new answer"),
+    };
+    model->replace_history(zoo::HistorySnapshot{messages});
+    const std::vector<zoo::Message> kept = {messages[0], messages[3], messages[4]};
+    const int budget = estimate_messages(*model, kept);
+
+    model->trim_history_to_tokens(static_cast<size_t>(budget));
+
+    const auto history = model->get_history();
+    ASSERT_EQ(history.size(), 3u);
+    EXPECT_EQ(history[0].role, zoo::Role::System);
+    EXPECT_EQ(history[1].content, "new question");
+    EXPECT_EQ(model->estimated_tokens(), budget);
+
+    model->trim_history_to_tokens(static_cast<size_t>(budget));
+    EXPECT_EQ(model->get_history().size(), 3u);
+}
+
+TEST(TokenAccountingTest, PrefillCalibratesEstimatesToPromptSize) {
+    auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
+    model->set_system_prompt("system");
+    ASSERT_TRUE(model->add_message(zoo::Message::user("question").view()).has_value());
+
+    ModelTestAccess::record_prompt_tokens(*model, 100);
+    EXPECT_EQ(model->estimated_tokens(), 100);
+
+    ASSERT_TRUE(model->add_message(zoo::Message::assistant("answer").view()).has_value());
+    ASSERT_TRUE(model->add_message(zoo::Message::user("follow-up").view()).has_value());
+    ModelTestAccess::record_prompt_tokens(*model, 130);
+    EXPECT_EQ(model->estimated_tokens(), 130);
+
+    // Calibrated counts are what rollback and trimming subtract.
+    const int before_rollback = model->estimated_tokens();
+    ModelTestAccess::rollback_last_message(*model);
+    const int follow_up_tokens = before_rollback - model->estimated_tokens();
+    EXPECT_GT(follow_up_tokens, 0);
+    EXPECT_LT(follow_up_tokens, 30);
+}
+
+TEST(TokenAccountingTest, SwapHistoryRestoresCachedCounts) {
+    auto model = ModelTestAccess::make(make_config(), zoo::GenerationOptions{});
+    model->set_system_prompt("system");
+    ASSERT_TRUE(model->add_message(zoo::Message::user("question").view()).has_value());
+    ModelTestAccess::record_prompt_tokens(*model, 100);
+
+    const std::vector<zoo::Message> scoped = {zoo::Message::user("scoped")};
+    auto original = model->swap_history(zoo::HistorySnapshot{scoped});
+    EXPECT_EQ(model->estimated_tokens(), estimate_messages(*model, scoped));
+
+    (void)model->swap_history(std::move(original));
+    EXPECT_EQ(model->estimated_tokens(), 100);
+}
+
 } // namespace
@@ -0,0 +1,75 @@
+/**
+ * @file test_token_mask.cpp
+ * @brief Unit tests for free-text token masks used by grammar-constrained sampling.
+ */
+
+#include "core/token_mask.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using zoo::FreeTextKind;
+using zoo::core::admitted_as_free_text;
+using zoo::core::ends_inside_utf8_sequence;
+using zoo::core::FreeTextMaskCache;
+using zoo::core::is_complete_utf8;
+using zoo::core::TokenMask;
+
+TEST(TokenMaskTest, StringContentExcludesQuotesBackslashesAndPartialCharacters) {
+    EXPECT_TRUE(admitted_as_free_text(FreeTextKind::String, " Paris"));
+    EXPECT_TRUE(admitted_as_free_text(FreeTextKind::String, "caf\xC3\xA9"));
+    EXPECT_TRUE(admitted_as_free_text(FreeTextKind::String, "\n"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, ""));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, "\","));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, "a\\n"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, std::string("a\0b", 3)));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, "\xC3"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::String, "\xA9"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::None, "abc"));
+}
+
+TEST(TokenMaskTest, DigitsAdmitOnlyAsciiDigitRuns) {
+    EXPECT_TRUE(admitted_as_free_text(FreeTextKind::Digits, "2024"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::Digits, "12,"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::Digits, ".5"));
+    EXPECT_FALSE(admitted_as_free_text(FreeTextKind::Digits, " 1"));
+}
+
+TEST(TokenMaskTest, DetectsTextEndingInsideUtf8Sequence) {
+    EXPECT_TRUE(is_complete_utf8("abc"));
+    EXPECT_TRUE(is_complete_utf8("\xF0\x9F\x98\x80"));
+    EXPECT_FALSE(is_complete_utf8("\xF0\x9F\x98"));
+
+    EXPECT_FALSE(ends_inside_utf8_sequence(""));
+    EXPECT_FALSE(ends_inside_utf8_sequence("caf\xC3\xA9"));
+    EXPECT_TRUE(ends_inside_utf8_sequence("caf\xC3"));
+    EXPECT_TRUE(ends_inside_utf8_sequence("x\xF0\x9F\x98"));
+    EXPECT_FALSE(ends_inside_utf8_sequence("x\xF0\x9F\x98\x80"));
+}
+
+TEST(TokenMaskTest, CacheBuildsEachMaskOnce) {
+    const std::vector<std::string> vocab = {"\"", "abc", "12", "\\", "x1"};
+    int lookups = 0;
+    const auto piece_of = [&](size_t token) {
+        ++lookups;
+        return vocab[token];
+    };
+
+    FreeTextMaskCache cache;
+    const TokenMask& strings = cache.get(FreeTextKind::String, vocab.size(), piece_of);
+    const TokenMask& again = cache.get(FreeTextKind::String, vocab.size(), piece_of);
+    EXPECT_EQ(&strings, &again);
+    EXPECT_EQ(lookups, 5);
+    EXPECT_FALSE(strings.test(0));
+    EXPECT_TRUE(strings.test(1));
+    EXPECT_TRUE(strings.test(2));
+    EXPECT_FALSE(strings.test(3));
+    EXPECT_TRUE(strings.test(4));
+    EXPECT_FALSE(strings.test(vocab.size()));
+
+    const TokenMask& digits = cache.get(FreeTextKind::Digits, vocab.size(), piece_of);
+    EXPECT_EQ(lookups, 10);
+    EXPECT_TRUE(digits.test(2));
+    EXPECT_FALSE(digits.test(4));
+}
@@ -284,6 +284,98 @@ TEST_F(ToolRegistryTest, RegisterToolsBatchAddsAllTools) {
     EXPECT_EQ(names, std::vector<std::string>({"add", "greet"}));
 }
 
+TEST_F(ToolRegistryTest, ExecutionPolicyIsStoredAndValidated) {
+    auto definition =
+        zoo::tools::make_tool_definition("add", "Add", std::vector<std::string>{"a", "b"}, add);
+    ASSERT_TRUE(definition.has_value());
+    definition->execution.max_concurrency = 2;
+    definition->execution.timeout = std::chrono::milliseconds(250);
+    ASSERT_TRUE(registry.register_tool(*definition).has_value());
+
+    auto policy = registry.get_execution_policy("add");
+    ASSERT_TRUE(policy.has_value());
+    EXPECT_EQ(*policy, definition->execution);
+    EXPECT_FALSE(registry.get_execution_policy("missing").has_value());
+
+    auto invalid =
+        zoo::tools::make_tool_definition("greet", "Greet", std::vector<std::string>{"name"}, greet);
+    ASSERT_TRUE(invalid.has_value());
+    invalid->execution.max_concurrency = -1;
+    std::vector<zoo::tools::ToolDefinition> batch;
+    batch.push_back(std::move(*definition));
+    batch.push_back(std::move(*invalid));
+    auto result = registry.register_tools(std::move(batch));
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, zoo::ErrorCode::InvalidConfig);
+    EXPECT_FALSE(registry.has_tool("greet"));
+}
+
+TEST_F(ToolRegistryTest, CachedResultsAreKeyedOnCanonicalArguments) {
+    auto definition =
+        zoo::tools::make_tool_definition("add", "Add", std::vector<std::string>{"a", "b"}, add);
+    ASSERT_TRUE(definition.has_value());
+    definition->cache.max_entries = 2;
+    ASSERT_TRUE(registry.register_tool(std::move(*definition)).has_value());
+
+    const auto now = zoo::tools::ToolRegistry::CacheClock::now();
+    EXPECT_FALSE(registry.find_cached_result("add", json{{"a", 1}, {"b", 2}}, now).has_value());
+    registry.store_cached_result("add", json{{"a", 1}, {"b", 2}}, json{{"result", 3}}, now);
+
+    registry.store_cached_result("add", json{{"a", 2}, {"b", 2}}, json{{"result", 4}}, now);
+
+    auto hit = registry.find_cached_result("add", json::parse(R"({"b":2,"a":1})"), now);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ((*hit)["result"], 3);
+
+    // The hit made {"a":1,"b":2} the most recently used, so {"a":2,"b":2} is evicted.
+    registry.store_cached_result("add", json{{"a", 3}, {"b", 2}}, json{{"result", 5}}, now);
+    EXPECT_TRUE(registry.find_cached_result("add", json{{"a", 1}, {"b", 2}}, now).has_value());
+    EXPECT_FALSE(registry.find_cached_result("add", json{{"a", 2}, {"b", 2}}, now).has_value());
+
+    auto stats = registry.cache_stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.entries, 2u);
+}
+
+TEST_F(ToolRegistryTest, CachedResultsExpireAndAreDroppedOnReregistration) {
+    auto definition =
+        zoo::tools::make_tool_definition("add", "Add", std::vector<std::string>{"a", "b"}, add);
+    ASSERT_TRUE(definition.has_value());
+    definition->cache.max_entries = 4;
+    definition->cache.ttl = std::chrono::milliseconds(100);
+    ASSERT_TRUE(registry.register_tool(*definition).has_value());
+
+    const json args{{"a", 1}, {"b", 2}};
+    const auto now = zoo::tools::ToolRegistry::CacheClock::now();
+    registry.store_cached_result("add", args, json{{"result", 3}}, now);
+    EXPECT_TRUE(
+        registry.find_cached_result("add", args, now + std::chrono::milliseconds(99)).has_value());
+    EXPECT_FALSE(
+        registry.find_cached_result("add", args, now + std::chrono::milliseconds(100)).has_value());
+    EXPECT_EQ(registry.cache_stats().expirations, 1u);
+
+    registry.store_cached_result("add", args, json{{"result", 3}}, now);
+    ASSERT_TRUE(registry.register_tool(*definition).has_value());
+    EXPECT_FALSE(registry.find_cached_result("add", args, now).has_value());
+    EXPECT_EQ(registry.cache_stats().entries, 0u);
+
+    definition->cache.ttl = std::chrono::milliseconds(-1);
+    auto result = registry.register_tool(std::move(*definition));
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, zoo::ErrorCode::InvalidConfig);
+}
+
+TEST_F(ToolRegistryTest, ToolsWithoutCachePolicyAreNeverCached) {
+    ASSERT_TRUE(registry.register_tool("add", "Add", {"a", "b"}, add).has_value());
+
+    const json args{{"a", 1}, {"b", 2}};
+    registry.store_cached_result("add", args, json{{"result", 3}});
+    EXPECT_FALSE(registry.find_cached_result("add", args).has_value());
+    EXPECT_EQ(registry.cache_stats(), zoo::tools::ToolCacheStats{});
+}
+
 TEST_F(ToolRegistryTest, RegisterToolsBatchEmptyIsNoOp) {
     auto result = registry.register_tools({});
     ASSERT_TRUE(result.has_value());
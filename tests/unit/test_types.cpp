@@ -295,14 +295,90 @@ TEST(ModelConfigTest, ValidationRejectsBadFields) {
     config.model_path = "/dev/null";
     config.context_size = 0;
     EXPECT_FALSE(config.validate().has_value());
+
+    config.context_size = 4096;
+    config.max_sequences = 0;
+    EXPECT_FALSE(config.validate().has_value());
+
+    config.max_sequences = 1;
+    config.draft_tokens = 0;
+    EXPECT_FALSE(config.validate().has_value());
+    config.draft_tokens = zoo::ModelConfig::kMaxDraftTokens + 1;
+    EXPECT_FALSE(config.validate().has_value());
+}
+
+TEST(ModelConfigTest, ValidationRejectsMissingDraftModel) {
+    zoo::ModelConfig config;
+    config.model_path = "/dev/null";
+    config.draft_model_path = "/nonexistent/draft.gguf";
+
+    auto result = config.validate();
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, zoo::ErrorCode::InvalidModelPath);
+
+    config.draft_model_path = "/dev/null";
+    EXPECT_TRUE(config.validate().has_value());
+}
+
+TEST(ModelConfigTest, ValidationRejectsBadThreadSettings) {
+    zoo::ModelConfig config;
+    config.model_path = "/dev/null";
+    config.n_threads = 8;
+    config.n_threads_batch = 16;
+    config.cpu_mask = "0xFF";
+    config.cpu_mask_batch = "FFFF";
+    EXPECT_TRUE(config.validate().has_value());
+
+    config.n_threads = -1;
+    EXPECT_FALSE(config.validate().has_value());
+
+    config.n_threads = 8;
+    config.n_ubatch = 0;
+    auto result = config.validate();
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, zoo::ErrorCode::InvalidBatchSize);
+
+    config.n_ubatch = 512;
+    config.cpu_mask = "0xZZ";
+    EXPECT_FALSE(config.validate().has_value());
+    config.cpu_mask = "0x0";
+    EXPECT_FALSE(config.validate().has_value());
+
+    config.cpu_mask.clear();
+    config.cpu_mask_batch = "0x";
+    EXPECT_FALSE(config.validate().has_value());
+
+    config.cpu_mask_batch.clear();
+    config.kv_reuse_min_tokens = -1;
+    EXPECT_FALSE(config.validate().has_value());
+}
+
+TEST(ModelConfigTest, QuantizedValueCacheRequiresFlashAttention) {
+    zoo::ModelConfig config;
+    config.model_path = "/dev/null";
+    config.cache_type_k = zoo::KvCacheType::Q8_0;
+    config.flash_attn = zoo::FlashAttention::Disabled;
+    EXPECT_TRUE(config.validate().has_value());
+
+    config.cache_type_v = zoo::KvCacheType::Q4_0;
+    EXPECT_FALSE(config.validate().has_value());
+
+    config.flash_attn = zoo::FlashAttention::Auto;
+    EXPECT_TRUE(config.validate().has_value());
 }
 
 TEST(AgentConfigTest, DefaultsAndValidation) {
     zoo::AgentConfig config;
     EXPECT_EQ(config.max_history_messages, 64u);
+    EXPECT_EQ(config.max_history_tokens, 0u);
     EXPECT_EQ(config.request_queue_capacity, 64u);
     EXPECT_EQ(config.max_tool_iterations, 5);
     EXPECT_EQ(config.max_tool_retries, 2);
+    EXPECT_EQ(config.tool_workers, 4u);
+    EXPECT_EQ(config.stream_chunk_bytes, 0u);
+    EXPECT_EQ(config.stream_chunk_interval_ms, 0);
+    EXPECT_FALSE(config.async_token_actions);
+    EXPECT_EQ(config.batch_sequences, 1u);
     EXPECT_TRUE(config.validate().has_value());
 }
 
@@ -318,6 +394,18 @@ TEST(AgentConfigTest, ValidationRejectsInvalidFields) {
     config = {};
     config.max_tool_iterations = 0;
     EXPECT_FALSE(config.validate().has_value());
+
+    config = {};
+    config.tool_workers = 0;
+    EXPECT_FALSE(config.validate().has_value());
+
+    config = {};
+    config.stream_chunk_interval_ms = -1;
+    EXPECT_FALSE(config.validate().has_value());
+
+    config = {};
+    config.batch_sequences = 0;
+    EXPECT_FALSE(config.validate().has_value());
 }
 
 TEST(GenerationOptionsTest, DefaultsAndValidation) {
@@ -335,6 +423,26 @@ TEST(GenerationOptionsTest, ValidationRejectsZeroMaxTokens) {
     EXPECT_EQ(result.error().code, zoo::ErrorCode::InvalidConfig);
 }
 
+TEST(GenerationOptionsTest, ValidationRejectsNegativeDeadline) {
+    zoo::GenerationOptions options;
+    options.deadline = std::chrono::milliseconds(-1);
+    EXPECT_FALSE(options.validate().has_value());
+}
+
+TEST(GenerationOptionsTest, ValidationRejectsBadSpeculativeOptions) {
+    zoo::GenerationOptions options;
+    options.speculative.mode = zoo::SpeculativeMode::PromptLookup;
+    EXPECT_TRUE(options.validate().has_value());
+    EXPECT_FALSE(options.is_default());
+
+    options.speculative.ngram_size = 0;
+    EXPECT_FALSE(options.validate().has_value());
+
+    options.speculative.ngram_size = 3;
+    options.speculative.max_draft_tokens = zoo::ModelConfig::kMaxDraftTokens + 1;
+    EXPECT_FALSE(options.validate().has_value());
+}
+
 TEST(ModelConfigJsonTest, RoundTripsSerializableFields) {
     zoo::ModelConfig config;
     config.model_path = "/tmp/model.gguf";
@@ -342,12 +450,37 @@ TEST(ModelConfigJsonTest, RoundTripsSerializableFields) {
     config.n_gpu_layers = 12;
     config.use_mmap = false;
     config.use_mlock = true;
+    config.max_sequences = 4;
+    config.draft_model_path = "/models/draft.gguf";
+    config.draft_tokens = 6;
+    config.n_threads = 4;
+    config.n_threads_batch = 8;
+    config.n_ubatch = 256;
+    config.cpu_mask = "0xF0";
+    config.cpu_mask_batch = "0xFF";
+    config.numa = zoo::NumaStrategy::Distribute;
+    config.cache_type_k = zoo::KvCacheType::Q8_0;
+    config.cache_type_v = zoo::KvCacheType::Q4_0;
+    config.flash_attn = zoo::FlashAttention::Auto;
+    config.offload_kqv = false;
+    config.kv_reuse_min_tokens = 32;
+    config.context_shift = true;
 
     const nlohmann::json json = config;
     const auto round_trip = json.get<zoo::ModelConfig>();
     EXPECT_EQ(round_trip, config);
 }
 
+TEST(ModelConfigJsonTest, RejectsUnknownNumaStrategy) {
+    const nlohmann::json json = {{"model_path", "/tmp/model.gguf"}, {"numa", "interleave"}};
+    EXPECT_THROW((void)json.get<zoo::ModelConfig>(), std::invalid_argument);
+}
+
+TEST(ModelConfigJsonTest, RejectsUnknownKvCacheType) {
+    const nlohmann::json json = {{"model_path", "/tmp/model.gguf"}, {"cache_type_k", "q5_1"}};
+    EXPECT_THROW((void)json.get<zoo::ModelConfig>(), std::invalid_argument);
+}
+
 TEST(ModelConfigJsonTest, RejectsMissingModelPath) {
     const nlohmann::json json = {{"context_size", 4096}};
     EXPECT_THROW((void)json.get<zoo::ModelConfig>(), std::invalid_argument);
@@ -356,9 +489,15 @@ TEST(ModelConfigJsonTest, RejectsMissingModelPath) {
 TEST(AgentConfigJsonTest, RoundTripsSerializableFields) {
     zoo::AgentConfig config;
     config.max_history_messages = 8;
+    config.max_history_tokens = 2048;
     config.request_queue_capacity = 4;
     config.max_tool_iterations = 3;
     config.max_tool_retries = 1;
+    config.tool_workers = 8;
+    config.stream_chunk_bytes = 64;
+    config.stream_chunk_interval_ms = 20;
+    config.async_token_actions = true;
+    config.batch_sequences = 4;
 
     const nlohmann::json json = config;
     const auto round_trip = json.get<zoo::AgentConfig>();
@@ -373,15 +512,32 @@ TEST(GenerationOptionsJsonTest, RoundTripsSerializableFields) {
     options.max_tokens = 256;
     options.stop_sequences = {"</tool_call>", "User:"};
     options.record_tool_trace = true;
+    options.speculative.mode = zoo::SpeculativeMode::PromptLookup;
+    options.speculative.ngram_size = 4;
+    options.priority = zoo::RequestPriority::Interactive;
+    options.deadline = std::chrono::milliseconds(1500);
 
     const nlohmann::json json = options;
     EXPECT_EQ(json.at("sampling").at("top_k"), 12);
     EXPECT_EQ(json.at("record_tool_trace"), true);
+    EXPECT_EQ(json.at("speculative").at("mode"), "prompt_lookup");
+    EXPECT_EQ(json.at("priority"), "interactive");
+    EXPECT_EQ(json.at("deadline_ms"), 1500);
 
     const auto round_trip = json.get<zoo::GenerationOptions>();
     EXPECT_EQ(round_trip, options);
 }
 
+TEST(GenerationOptionsJsonTest, RejectsUnknownSpeculativeMode) {
+    const nlohmann::json json = {{"speculative", {{"mode", "medusa"}}}};
+    EXPECT_THROW((void)json.get<zoo::GenerationOptions>(), std::invalid_argument);
+}
+
+TEST(GenerationOptionsJsonTest, RejectsUnknownPriority) {
+    const nlohmann::json json = {{"priority", "urgent"}};
+    EXPECT_THROW((void)json.get<zoo::GenerationOptions>(), std::invalid_argument);
+}
+
 TEST(RoleValidationTest, EmptyHistoryAcceptsUser) {
     std::vector<zoo::OwnedMessage> history;
     EXPECT_TRUE(zoo::validate_role_sequence(history, zoo::Role::User).has_value());